@@ -93,6 +93,12 @@ struct TpxFileHeader
        index. Eventually, should probably be a vector. MRS*/
     //! Size of the TPR body in chars (equal to number of bytes) during I/O.
     int64_t sizeOfTprBody = 0;
+    //! Offset of the topology in the TPR body, zero for older files.
+    int64_t topologyOffset = 0;
+    //! Offset of the coordinates and velocities in the TPR body, zero for older files.
+    int64_t coordinatesOffset = 0;
+    //! Offset of the simulation parameters in the TPR body, zero for older files.
+    int64_t parametersOffset = 0;
     //! File version.
     int fileVersion = 0;
     //! File generation.
@@ -201,9 +207,15 @@ PartialDeserializedTprFile read_tpx_state(const char* fn, t_inputrec* ir, t_stat
  * will not be changed. If \p box is valid, the box will be set from
  * the information read in from the file.
  *
+ * For files that store the offsets of their sections, the box and
+ * coordinate sections are only decoded when \p box or \p x is passed,
+ * and the topology section only when \p mtop is passed. The force-field
+ * parameters are stored in the topology section together with the
+ * molecule types, so they are always decoded along with the atoms.
+ *
  * \param[in] fn Input file name.
  * \param[out] ir Input parameters to be set, or nullptr.
- * \param[out] box Box matrix.
+ * \param[out] box Box matrix, or nullptr.
  * \param[out] natoms Total atom numbers to be set, or nullptr.
  * \param[out] x Positions to be filled from file, or nullptr.
  * \param[out] v Velocities to be filled from file, or nullptr.
@@ -159,11 +159,23 @@ void close_trx(t_trxstatus* status);
 t_trxstatus* open_trx(const char* outfile, const char* filemode);
 /* Open a TRX file and return an allocated status pointer */
 
+void trx_enable_frame_index(t_trxstatus* status);
+/* Also write a frame index file for an XTC or TRR file opened with open_trx,
+ * which allows readers to skip frames without reading them.
+ * Has no effect for other file types.
+ */
+
 struct t_fileio* trx_get_fileio(t_trxstatus* status);
 /* get a fileio from a trxstatus */
 
 float trx_get_time_of_final_frame(t_trxstatus* status);
-/* get time of final frame. Only supported for TNG and XTC */
+/* get time of final frame. Only supported for TNG, XTC and TRR with a frame index */
+
+int trx_get_num_frames(t_trxstatus* status);
+/* get the number of frames of a trajectory opened with read_first_frame
+ * from its frame index, without reading the frames.
+ * Returns -1 when there is no valid frame index.
+ */
 
 gmx_bool bRmod_fd(double a, double b, double c, gmx_bool bDouble);
 /* Returns TRUE when (a - b) MOD c = 0, using a margin which is slightly
@@ -223,6 +235,8 @@ bool read_first_frame(const gmx_output_env_t* oenv,
  * defined further up in this file.
  * Memory will be allocated for flagged entries.
  * The flags are copied to fr for subsequent calls to read_next_frame.
+ * When an XTC or TRR file has a valid frame index file, frames that
+ * are skipped because of the begin time or time interval are not read.
  * Returns true when succeeded, false otherwise.
  */
 
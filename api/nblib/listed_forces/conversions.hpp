@@ -45,6 +45,8 @@
 #ifndef NBLIB_LISTEDFORCES_CONVERSION_HPP
 #define NBLIB_LISTEDFORCES_CONVERSION_HPP
 
+#include <memory>
+
 #include "gromacs/topology/forcefieldparameters.h"
 #include "gromacs/topology/idef.h"
 #include "nblib/listed_forces/traits.h"
@@ -300,6 +300,15 @@ void set_ddbox(const gmx_domdec_t&            dd,
     }
 }
 
+void set_ddbox_serial(const t_inputrec&              ir,
+                      const matrix                   box,
+                      gmx::ArrayRef<const gmx::RVec> x,
+                      gmx_ddbox_t*                   ddbox)
+{
+    low_set_ddbox(numPbcDimensions(ir.pbcType), inputrec2nboundeddim(&ir), nullptr, box, true, x,
+                  nullptr, ddbox);
+}
+
 void set_ddbox_cr(DDRole                         ddRole,
                   MPI_Comm                       communicator,
                   const ivec*                    dd_nc,
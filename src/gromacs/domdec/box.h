@@ -68,6 +68,15 @@ void set_ddbox(const gmx_domdec_t&            dd,
                gmx::ArrayRef<const gmx::RVec> x,
                gmx_ddbox_t*                   ddbox);
 
+/*! \brief Set the box and PBC data in \p ddbox for a single process without communication
+ *
+ * This is intended for offline estimates of decomposition setups.
+ */
+void set_ddbox_serial(const t_inputrec&              ir,
+                      const matrix                   box,
+                      gmx::ArrayRef<const gmx::RVec> x,
+                      gmx_ddbox_t*                   ddbox);
+
 /*! \brief Set the box and PBC data in \p ddbox */
 void set_ddbox_cr(DDRole                         ddRole,
                   MPI_Comm                       communicator,
@@ -46,8 +46,11 @@
 
 #include "config.h"
 
+#include <algorithm>
+
 #include "gromacs/domdec/domdec_network.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/mdtypes/state.h"
 #include "gromacs/utility/fatalerror.h"
 
@@ -216,14 +219,25 @@ static void dd_collect_vec_gatherv(gmx_domdec_t*                  dd,
     {
         const AtomDistribution& ma = *dd->ma;
 
-        int bufferAtom = 0;
+        /* The atom groups of all ranks are stored consecutively in rank order
+         * in ma.atomGroups, as are the received vectors in ma.rvecBuffer.
+         * So we can scatter into global order with a flat threaded loop.
+         */
+        int numAtomsTotal = 0;
         for (int rank = 0; rank < dd->nnodes; rank++)
         {
-            const auto& domainGroups = ma.domainGroups[rank];
-            for (const int& globalAtom : domainGroups.atomGroups)
-            {
-                copy_rvec(ma.rvecBuffer[bufferAtom++], v[globalAtom]);
-            }
+            numAtomsTotal += ma.domainGroups[rank].numAtoms;
+        }
+        GMX_ASSERT(numAtomsTotal <= gmx::ssize(ma.atomGroups),
+                   "The collected atom count should not exceed the system size");
+
+        const int                      numThreads = std::max(gmx_omp_nthreads_get(emntDomdec), 1);
+        gmx::ArrayRef<const int>       atomGroups = ma.atomGroups;
+        gmx::ArrayRef<const gmx::RVec> buffer     = ma.rvecBuffer;
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+        for (int bufferAtom = 0; bufferAtom < numAtomsTotal; bufferAtom++)
+        {
+            v[atomGroups[bufferAtom]] = buffer[bufferAtom];
         }
     }
 }
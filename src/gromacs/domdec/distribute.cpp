@@ -46,10 +46,12 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <vector>
 
 #include "gromacs/domdec/domdec_network.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/mdtypes/commrec.h"
 #include "gromacs/mdtypes/df_history.h"
 #include "gromacs/mdtypes/state.h"
@@ -123,15 +125,24 @@ static void distributeVecScatterv(gmx_domdec_t*                  dd,
 
         get_commbuffer_counts(&ma, &sendCounts, &displacements);
 
-        gmx::ArrayRef<gmx::RVec> buffer    = ma.rvecBuffer;
-        int                      localAtom = 0;
+        /* The atom groups of all ranks are stored consecutively in rank order
+         * in ma.atomGroups, which is also the order of the send buffer.
+         */
+        int numAtomsTotal = 0;
         for (int rank = 0; rank < dd->nnodes; rank++)
         {
-            const auto& domainGroups = ma.domainGroups[rank];
-            for (const int& globalAtom : domainGroups.atomGroups)
-            {
-                buffer[localAtom++] = globalVec[globalAtom];
-            }
+            numAtomsTotal += ma.domainGroups[rank].numAtoms;
+        }
+        GMX_ASSERT(numAtomsTotal <= gmx::ssize(ma.atomGroups),
+                   "The distributed atom count should not exceed the system size");
+
+        const int                numThreads = std::max(gmx_omp_nthreads_get(emntDomdec), 1);
+        gmx::ArrayRef<const int> atomGroups = ma.atomGroups;
+        gmx::ArrayRef<gmx::RVec> buffer     = ma.rvecBuffer;
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+        for (int localAtom = 0; localAtom < numAtomsTotal; localAtom++)
+        {
+            buffer[localAtom] = globalVec[atomGroups[localAtom]];
         }
     }
 
@@ -1014,6 +1014,11 @@ bool ddUsesUpdateGroups(const gmx_domdec_t& dd)
     return dd.comm->systemInfo.useUpdateGroups;
 }
 
+bool ddUsesLincsExpandedHalo(const gmx_domdec_t& dd)
+{
+    return dd.comm->ddSettings.useLincsExpandedHalo;
+}
+
 void dd_cycles_add(const gmx_domdec_t* dd, float cycles, int ddCycl)
 {
     /* Note that the cycles value can be incorrect, either 0 or some
@@ -2052,6 +2057,7 @@ static DDSystemInfo getSystemInfo(const gmx::MDLogger&           mdlog,
                                   DDRole                         ddRole,
                                   MPI_Comm                       communicator,
                                   const DomdecOptions&           options,
+                                  const DDSettings&              ddSettings,
                                   const gmx_mtop_t&              mtop,
                                   const t_inputrec&              ir,
                                   const matrix                   box,
@@ -2210,7 +2216,8 @@ static DDSystemInfo getSystemInfo(const gmx::MDLogger&           mdlog,
     if (systemInfo.haveSplitConstraints && options.constraintCommunicationRange <= 0)
     {
         /* There is a cell size limit due to the constraints (P-LINCS) */
-        systemInfo.constraintCommunicationRange = gmx::constr_r_max(mdlog, &mtop, &ir);
+        systemInfo.constraintCommunicationRange =
+                gmx::constr_r_max(mdlog, &mtop, &ir, ddSettings.useLincsExpandedHalo);
         GMX_LOG(mdlog.info)
                 .appendTextFormatted("Estimated maximum distance required for P-LINCS: %.3f nm",
                                      systemInfo.constraintCommunicationRange);
@@ -2647,8 +2654,10 @@ static void writeSettings(gmx::TextWriter*   log,
         }
         if (comm->systemInfo.haveSplitConstraints || comm->systemInfo.haveSplitSettles)
         {
+            const int haloDepth =
+                    gmx::lincsConstraintHaloDepth(*ir, comm->ddSettings.useLincsExpandedHalo);
             std::string separation =
-                    gmx::formatString("atoms separated by up to %d constraints", 1 + ir->nProjOrder);
+                    gmx::formatString("atoms separated by up to %d constraints", 1 + haloDepth);
             log->writeLineFormatted("%40s  %-7s %6.3f nm\n", separation.c_str(), "(-rcon)", limit);
         }
         log->ensureLineBreak();
@@ -2867,6 +2876,8 @@ static DDSettings getDDSettings(const gmx::MDLogger&     mdlog,
     ddSettings.dlb_scale_lim       = dd_getenv(mdlog, "GMX_DLB_MAX_BOX_SCALING", 10);
     ddSettings.useDDOrderZYX       = bool(dd_getenv(mdlog, "GMX_DD_ORDER_ZYX", 0));
     ddSettings.useCartesianReorder = bool(dd_getenv(mdlog, "GMX_NO_CART_REORDER", 1));
+    ddSettings.useHaloPruning      = bool(dd_getenv(mdlog, "GMX_DD_PRUNE_HALO", 0));
+    ddSettings.useLincsExpandedHalo = bool(dd_getenv(mdlog, "GMX_LINCS_EXPANDED_HALO", 0));
     ddSettings.eFlop               = dd_getenv(mdlog, "GMX_DLB_BASED_ON_FLOPS", 0);
     const int recload              = dd_getenv(mdlog, "GMX_DD_RECORD_LOAD", 1);
     ddSettings.nstDDDump           = dd_getenv(mdlog, "GMX_DD_NST_DUMP", 0);
@@ -2985,7 +2996,8 @@ DomainDecompositionBuilder::Impl::Impl(const MDLogger&      mdlog,
     }
 
     systemInfo_ = getSystemInfo(mdlog_, MASTER(cr_) ? DDRole::Master : DDRole::Agent,
-                                cr->mpiDefaultCommunicator, options_, mtop_, ir_, box, xGlobal);
+                                cr->mpiDefaultCommunicator, options_, ddSettings_, mtop_, ir_, box,
+                                xGlobal);
 
     const int  numRanksRequested         = cr_->sizeOfDefaultCommunicator;
     const bool checkForLargePrimeFactors = (options_.numCells[0] <= 0);
@@ -156,6 +156,9 @@ bool ddHaveSplitConstraints(const gmx_domdec_t& dd);
 /*! \brief Return whether update groups are used */
 bool ddUsesUpdateGroups(const gmx_domdec_t& dd);
 
+/*! \brief Return whether the constraint halo is deep enough for all LINCS iterations */
+bool ddUsesLincsExpandedHalo(const gmx_domdec_t& dd);
+
 /*! \brief Initialize data structures for bonded interactions */
 void dd_init_bondeds(FILE*                           fplog,
                      gmx_domdec_t*                   dd,
@@ -479,6 +479,12 @@ struct DDSettings
     //! Whether to use MPI Cartesian reordering of communicators, when supported (almost never)
     bool useCartesianReorder = true;
 
+    //! Whether to prune the halo using the atom extent of the receiving domain
+    bool useHaloPruning = false;
+
+    //! Whether to use a constraint halo deep enough for all LINCS iterations
+    bool useLincsExpandedHalo = false;
+
     //! Whether we should record the load
     bool recordLoad = false;
 
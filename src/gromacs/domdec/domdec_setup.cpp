@@ -621,6 +621,40 @@ static void assign_factors(const real         limit,
     }
 }
 
+/*! \brief Returns the average number of pbc_dx calls per atom in bonded interactions */
+static double bondedPbcdxPerAtom(const gmx_mtop_t&   mtop,
+                                 const t_inputrec&   ir,
+                                 const DDSystemInfo& systemInfo)
+{
+    double pbcdxr;
+
+    if (systemInfo.haveInterDomainBondeds)
+    {
+        /* If we can skip PBC for distance calculations in plain-C bondeds,
+         * we can save some time (e.g. 3D DD with pbc=xyz).
+         * Here we ignore SIMD bondeds as they always do (fast) PBC.
+         */
+        count_bonded_distances(mtop, ir, &pbcdxr, nullptr);
+        pbcdxr /= static_cast<double>(mtop.natoms);
+    }
+    else
+    {
+        /* Every molecule is a single charge group: no pbc required */
+        pbcdxr = 0;
+    }
+
+    return pbcdxr;
+}
+
+/*! \brief Returns the number of ranks doing PME work
+ *
+ * This is the number of PP ranks when not using separate PME-only ranks.
+ */
+static int numRanksDoingPmeWork(const t_inputrec& ir, int numPPRanks, int numPmeOnlyRanks)
+{
+    return (EEL_PME(ir.coulombtype) ? ((numPmeOnlyRanks > 0) ? numPmeOnlyRanks : numPPRanks) : 0);
+}
+
 /*! \brief Determine the optimal distribution of DD cells for the
  * simulation system and number of MPI ranks
  *
@@ -636,8 +670,6 @@ static gmx::IVec optimizeDDCells(const gmx::MDLogger& mdlog,
                                  const t_inputrec&    ir,
                                  const DDSystemInfo&  systemInfo)
 {
-    double pbcdxr;
-
     const int numPPRanks = numRanksRequested - numPmeOnlyRanks;
 
     GMX_LOG(mdlog.info)
@@ -654,26 +686,7 @@ static gmx::IVec optimizeDDCells(const gmx::MDLogger& mdlog,
     }
 
 
-    // For cost estimates, we need the number of ranks doing PME work,
-    // which is the number of PP ranks when not using separate
-    // PME-only ranks.
-    const int numRanksDoingPmeWork =
-            (EEL_PME(ir.coulombtype) ? ((numPmeOnlyRanks > 0) ? numPmeOnlyRanks : numPPRanks) : 0);
-
-    if (systemInfo.haveInterDomainBondeds)
-    {
-        /* If we can skip PBC for distance calculations in plain-C bondeds,
-         * we can save some time (e.g. 3D DD with pbc=xyz).
-         * Here we ignore SIMD bondeds as they always do (fast) PBC.
-         */
-        count_bonded_distances(mtop, ir, &pbcdxr, nullptr);
-        pbcdxr /= static_cast<double>(mtop.natoms);
-    }
-    else
-    {
-        /* Every molecule is a single charge group: no pbc required */
-        pbcdxr = 0;
-    }
+    const double pbcdxr = bondedPbcdxPerAtom(mtop, ir, systemInfo);
 
     if (cellSizeLimit > 0)
     {
@@ -707,7 +720,8 @@ static gmx::IVec optimizeDDCells(const gmx::MDLogger& mdlog,
     gmx::IVec itry       = { 1, 1, 1 };
     gmx::IVec numDomains = { 0, 0, 0 };
     assign_factors(cellSizeLimit, systemInfo.cutoff, box, ddbox, mtop.natoms, ir, pbcdxr,
-                   numRanksDoingPmeWork, div.size(), div.data(), mdiv.data(), &itry, &numDomains);
+                   numRanksDoingPmeWork(ir, numPPRanks, numPmeOnlyRanks), div.size(), div.data(),
+                   mdiv.data(), &itry, &numDomains);
 
     return numDomains;
 }
@@ -852,6 +866,72 @@ static int getNumPmeOnlyRanksToUse(const gmx::MDLogger& mdlog,
     return numPmeOnlyRanks;
 }
 
+DDGridCostEstimate estimateDDGridCost(const gmx_mtop_t&              mtop,
+                                      const t_inputrec&              ir,
+                                      const matrix                   box,
+                                      gmx::ArrayRef<const gmx::RVec> x,
+                                      const int                      numRanks,
+                                      const int                      numPmeRanksRequested,
+                                      const real                     cutoff,
+                                      const real                     cellSizeLimit)
+{
+    /* We only want the numbers, not the log output of the setup routines */
+    const gmx::MDLogger nullLogger;
+
+    DomdecOptions options;
+    options.numPmeRanks = numPmeRanksRequested;
+
+    DDGridCostEstimate estimate;
+    estimate.numPmeOnlyRanks = getNumPmeOnlyRanksToUse(nullLogger, options, mtop, ir, box, numRanks);
+
+    const int numPPRanks = numRanks - estimate.numPmeOnlyRanks;
+    if (numPPRanks < 1)
+    {
+        return estimate;
+    }
+
+    gmx_ddbox_t ddbox;
+    set_ddbox_serial(ir, box, x, &ddbox);
+
+    DDSystemInfo systemInfo;
+    systemInfo.cutoff                 = cutoff;
+    systemInfo.cellsizeLimit          = cellSizeLimit;
+    systemInfo.haveInterDomainBondeds = mtop.bIntermolecularInteractions;
+    for (const gmx_molblock_t& molblock : mtop.molblock)
+    {
+        if (mtop.moltype[molblock.type].atoms.nr > 1)
+        {
+            systemInfo.haveInterDomainBondeds = true;
+        }
+    }
+
+    estimate.numDomains = optimizeDDCells(nullLogger, numRanks, estimate.numPmeOnlyRanks,
+                                          cellSizeLimit, mtop, box, ddbox, ir, systemInfo);
+    if (estimate.numDomains[XX] == 0)
+    {
+        return estimate;
+    }
+
+    for (int d = 0; d < DIM; d++)
+    {
+        estimate.cellSize[d] = ddbox.box_size[d] * ddbox.skew_fac[d] / estimate.numDomains[d];
+    }
+    const real haloFraction      = comm_box_frac(estimate.numDomains, cutoff, ddbox);
+    estimate.haloVolumeFraction  = haloFraction;
+    estimate.numHaloAtomsPerRank = haloFraction * mtop.natoms / numPPRanks;
+    /* Coordinates are sent forward and forces back */
+    estimate.haloBytesPerStep = 2.0 * haloFraction * mtop.natoms * sizeof(gmx::RVec);
+
+    const float commCost =
+            comm_cost_est(cellSizeLimit, cutoff, box, ddbox, mtop.natoms, ir,
+                          bondedPbcdxPerAtom(mtop, ir, systemInfo),
+                          numRanksDoingPmeWork(ir, numPPRanks, estimate.numPmeOnlyRanks),
+                          estimate.numDomains);
+    estimate.relativeCommCost = commCost / (3.0F * mtop.natoms);
+
+    return estimate;
+}
+
 /*! \brief Sets the order of the DD dimensions, returns the number of DD dimensions */
 static int set_dd_dim(const gmx::IVec& numDDCells, const DDSettings& ddSettings, ivec* dims)
 {
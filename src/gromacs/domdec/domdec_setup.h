@@ -99,6 +99,52 @@ real getDDGridSetupCellSizeLimit(const gmx::MDLogger& mdlog,
                                  const t_inputrec&    ir,
                                  real                 systemInfoCellSizeLimit);
 
+/*! \internal
+ * \brief Offline estimate of the communication of a DD grid setup
+ *
+ * Used by tools to compare DD grids and PME rank counts without running.
+ */
+struct DDGridCostEstimate
+{
+    //! The number of separate PME ranks, 0 if none or all ranks do PME
+    int numPmeOnlyRanks = 0;
+    //! The number of domains along each dimension, all zero when no valid grid exists
+    gmx::IVec numDomains = { 0, 0, 0 };
+    //! The width of the domains along each dimension, without dynamic load balancing
+    gmx::RVec cellSize = { 0, 0, 0 };
+    //! The halo volume relative to the volume of a domain
+    real haloVolumeFraction = 0;
+    //! The average number of halo atoms per PP rank
+    real numHaloAtomsPerRank = 0;
+    //! The bytes communicated per step for the coordinate and force halo, summed over PP ranks
+    double haloBytesPerStep = 0;
+    //! The estimated PP and PME communication cost relative to communicating all atoms once
+    float relativeCommCost = 0;
+};
+
+/*! \brief Estimates the DD grid and its communication for \p numRanks ranks
+ *
+ * Uses the same grid and PME rank choices as mdrun would for a run
+ * with automated DD grid setup.
+ *
+ * \param[in] mtop                  The global topology
+ * \param[in] ir                    The input record
+ * \param[in] box                   The simulation box
+ * \param[in] x                     The global coordinates
+ * \param[in] numRanks              The total number of ranks
+ * \param[in] numPmeRanksRequested  The number of separate PME ranks, -1 for auto
+ * \param[in] cutoff                The non-bonded communication cut-off
+ * \param[in] cellSizeLimit         The minimum DD cell size
+ */
+DDGridCostEstimate estimateDDGridCost(const gmx_mtop_t&              mtop,
+                                      const t_inputrec&              ir,
+                                      const matrix                   box,
+                                      gmx::ArrayRef<const gmx::RVec> x,
+                                      int                            numRanks,
+                                      int                            numPmeRanksRequested,
+                                      real                           cutoff,
+                                      real                           cellSizeLimit);
+
 /*! \brief Determines the DD grid setup
  *
  * Either implements settings required by the user, or otherwise
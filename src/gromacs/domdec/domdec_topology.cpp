@@ -102,6 +102,9 @@ struct reverse_ilist_t
     std::vector<int> index;              /* Index for each atom into il          */
     std::vector<int> il;                 /* ftype|type|a0|...|an|ftype|...       */
     int              numAtomsInMolecule; /* The number of atoms in this molecule */
+    /* With update groups: for each ftype entry in il, tells whether all atoms
+     * of the interaction are in the same update group, empty otherwise */
+    std::vector<bool> isInternalToUpdateGroup;
 };
 
 struct MolblockIndices
@@ -733,6 +736,46 @@ static gmx_reverse_top_t make_reverse_top(const gmx_mtop_t* mtop,
     return rt;
 }
 
+/*! \brief Flags the interactions in \p ril_mt that are internal to an update group
+ *
+ * Vsites and single-atom interactions are never flagged,
+ * as their assignment does not need any atom lookups.
+ */
+static void setUpdateGroupInternalInteractions(const gmx::RangePartitioning& updateGrouping,
+                                               reverse_ilist_t*              ril_mt)
+{
+    std::vector<int> atomToGroup(ril_mt->numAtomsInMolecule);
+    for (int group = 0; group < updateGrouping.numBlocks(); group++)
+    {
+        for (int a : updateGrouping.block(group))
+        {
+            atomToGroup[a] = group;
+        }
+    }
+
+    ril_mt->isInternalToUpdateGroup.assign(ril_mt->il.size(), false);
+    for (int i_mol = 0; i_mol < ril_mt->numAtomsInMolecule; i_mol++)
+    {
+        int j = ril_mt->index[i_mol];
+        while (j < ril_mt->index[i_mol + 1])
+        {
+            const int ftype = ril_mt->il[j];
+            const int nral  = NRAL(ftype);
+            if (nral >= 2 && !(interaction_function[ftype].flags & IF_VSITE))
+            {
+                bool isInternal = true;
+                for (int k = 1; k <= nral; k++)
+                {
+                    isInternal = isInternal
+                                 && (atomToGroup[ril_mt->il[j + 1 + k]] == atomToGroup[i_mol]);
+                }
+                ril_mt->isInternalToUpdateGroup[j] = isInternal;
+            }
+            j += 2 + nral_rt(ftype);
+        }
+    }
+}
+
 void dd_make_reverse_top(FILE*                           fplog,
                          gmx_domdec_t*                   dd,
                          const gmx_mtop_t*               mtop,
@@ -756,6 +799,19 @@ void dd_make_reverse_top(FILE*                           fplog,
             make_reverse_top(mtop, ir->efep != efepNO, !dd->comm->systemInfo.haveSplitConstraints,
                              !dd->comm->systemInfo.haveSplitSettles, bBCheck, &dd->nbonded_global);
 
+    if (dd->comm->systemInfo.useUpdateGroups)
+    {
+        /* Precompute which interactions lie within a single update group.
+         * Those can be assigned without zone checks in make_bondeds_zone.
+         */
+        gmx::ArrayRef<const gmx::RangePartitioning> updateGrouping =
+                dd->comm->systemInfo.updateGroupingPerMoleculetype;
+        for (size_t mt = 0; mt < dd->reverse_top->ril_mt.size(); mt++)
+        {
+            setUpdateGroupInternalInteractions(updateGrouping[mt], &dd->reverse_top->ril_mt[mt]);
+        }
+    }
+
     dd->haveExclusions = false;
     for (const gmx_molblock_t& molb : mtop->molblock)
     {
@@ -1052,6 +1108,7 @@ static inline void check_assign_interactions_atom(int                       i,
                                                   int                       numAtomsInMolecule,
                                                   gmx::ArrayRef<const int>  index,
                                                   gmx::ArrayRef<const int>  rtil,
+                                                  const std::vector<bool>&  isInternalToUpdateGroup,
                                                   gmx_bool                  bInterMolInteractions,
                                                   int                       ind_start,
                                                   int                       ind_end,
@@ -1077,9 +1134,11 @@ static inline void check_assign_interactions_atom(int                       i,
     {
         t_iatom tiatoms[1 + MAXATOMLIST];
 
-        const int ftype  = rtil[j++];
-        auto      iatoms = gmx::constArrayRefFromArray(rtil.data() + j, rtil.size() - j);
-        const int nral   = NRAL(ftype);
+        const bool isUpdateGroupInternal =
+                !isInternalToUpdateGroup.empty() && isInternalToUpdateGroup[j];
+        const int  ftype  = rtil[j++];
+        auto       iatoms = gmx::constArrayRefFromArray(rtil.data() + j, rtil.size() - j);
+        const int  nral   = NRAL(ftype);
         if (interaction_function[ftype].flags & IF_VSITE)
         {
             assert(!bInterMolInteractions);
@@ -1096,7 +1155,29 @@ static inline void check_assign_interactions_atom(int                       i,
             /* Copy the type */
             tiatoms[0] = iatoms[0];
 
-            if (nral == 1)
+            if (isUpdateGroupInternal)
+            {
+                /* All atoms of this interaction are in the update group of atom i.
+                 * Update groups are always whole on their home rank, so we assign
+                 * the interaction in the home zone, without zone and shift checks,
+                 * and it can never be assigned from the other zones.
+                 */
+                bUse       = (iz == 0);
+                tiatoms[1] = i;
+                for (int k = 2; k <= nral && bUse; k++)
+                {
+                    const int* homeIndex = dd->ga2la->findHome(i_gl + iatoms[k] - i_mol);
+                    GMX_ASSERT(homeIndex, "All atoms of an update group should be home atoms");
+                    bUse       = (homeIndex != nullptr);
+                    tiatoms[k] = bUse ? *homeIndex : -1;
+                }
+                if (bUse && nral == 2 && bRCheck2B
+                    && dd_dist2(pbc_null, cg_cm, tiatoms[1], tiatoms[2]) >= rc2)
+                {
+                    bUse = FALSE;
+                }
+            }
+            else if (nral == 1)
             {
                 assert(!bInterMolInteractions);
                 /* Assign single-body interactions to the home zone */
@@ -1292,9 +1373,10 @@ static int make_bondeds_zone(gmx_domdec_t*                      dd,
         gmx::ArrayRef<const t_iatom> rtil  = rt->ril_mt[mt].il;
 
         check_assign_interactions_atom(i, i_gl, mol, i_mol, rt->ril_mt[mt].numAtomsInMolecule,
-                                       index, rtil, FALSE, index[i_mol], index[i_mol + 1], dd,
-                                       zones, &molb[mb], bRCheckMB, rcheck, bRCheck2B, rc2,
-                                       pbc_null, cg_cm, ip_in, idef, izone, bBCheck, &nbonded_local);
+                                       index, rtil, rt->ril_mt[mt].isInternalToUpdateGroup, FALSE,
+                                       index[i_mol], index[i_mol + 1], dd, zones, &molb[mb], bRCheckMB,
+                                       rcheck, bRCheck2B, rc2, pbc_null, cg_cm, ip_in, idef, izone,
+                                       bBCheck, &nbonded_local);
 
 
         if (rt->bIntermolecularInteractions)
@@ -1304,9 +1386,10 @@ static int make_bondeds_zone(gmx_domdec_t*                      dd,
             rtil  = rt->ril_intermol.il;
 
             check_assign_interactions_atom(i, i_gl, mol, i_mol, rt->ril_mt[mt].numAtomsInMolecule,
-                                           index, rtil, TRUE, index[i_gl], index[i_gl + 1], dd, zones,
-                                           &molb[mb], bRCheckMB, rcheck, bRCheck2B, rc2, pbc_null,
-                                           cg_cm, ip_in, idef, izone, bBCheck, &nbonded_local);
+                                           index, rtil, rt->ril_intermol.isInternalToUpdateGroup, TRUE,
+                                           index[i_gl], index[i_gl + 1], dd, zones, &molb[mb],
+                                           bRCheckMB, rcheck, bRCheck2B, rc2, pbc_null, cg_cm, ip_in,
+                                           idef, izone, bBCheck, &nbonded_local);
         }
     }
 
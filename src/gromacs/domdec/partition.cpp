@@ -48,9 +48,11 @@
 #include "config.h"
 
 #include <cassert>
+#include <cmath>
 #include <cstdio>
 
 #include <algorithm>
+#include <limits>
 
 #include "gromacs/domdec/collect.h"
 #include "gromacs/domdec/dlb.h"
@@ -66,6 +68,7 @@
 #include "gromacs/imd/imd.h"
 #include "gromacs/math/functions.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/constraintrange.h"
 #include "gromacs/mdlib/forcerec.h"
 #include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/mdlib/mdatoms.h"
@@ -1535,6 +1538,178 @@ static void set_dd_corners(const gmx_domdec_t* dd, int dim0, int dim1, int dim2,
     }
 }
 
+/*! \brief Grid over the cell face of the receiving domain for pruning the halo
+ *
+ * With 1D decomposition each receiving domain sends its sending neighbor,
+ * per cell of a coarse grid over the two dimensions orthogonal to
+ * the decomposition dimension, how far its home atoms extend towards
+ * the shared cell boundary. The sender can then skip atoms which are
+ * beyond the communication distance of every atom of the receiver,
+ * which is much more effective than the distance to the cell boundary
+ * for inhomogeneous systems, such as membranes or interfaces.
+ */
+struct HaloPruningGrid
+{
+    //! The two dimensions orthogonal to the decomposition dimension
+    int dims[2] = { -1, -1 };
+    //! The number of grid cells along dims
+    int numCells[2] = { 0, 0 };
+    //! The grid cell size along dims
+    real cellSize[2] = { 0, 0 };
+    //! The inverse grid cell size along dims
+    real invCellSize[2] = { 0, 0 };
+    //! The number of cells to search for along dims
+    int searchRange[2] = { 0, 0 };
+    //! The grid of this rank, for each cell max(x[dim]) - cell_x1[dim], lowest() when empty
+    std::vector<real> localExtent;
+    //! The grid received from the rank we send the halo to
+    std::vector<real> receiverExtent;
+};
+
+//! Returns the grid cell index along dimension \p d of \p grid for coordinate \p x
+static inline int haloPruningGridIndex(const HaloPruningGrid& grid, int d, real x)
+{
+    int index = static_cast<int>(std::floor(x * grid.invCellSize[d])) % grid.numCells[d];
+
+    return (index < 0 ? index + grid.numCells[d] : index);
+}
+
+/*! \brief Returns whether we can prune the halo using the atom extent of the receiver
+ *
+ * This is only supported for a single pulse along a single decomposition
+ * dimension in a rectangular, fully periodic unit-cell. With more
+ * dimensions the i-zones of the receiver contain communicated atoms.
+ */
+static bool useHaloPruning(const gmx_domdec_t& dd, const gmx_ddbox_t& ddbox, const matrix box)
+{
+    return (dd.comm->ddSettings.useHaloPruning && dd.ndim == 1 && dd.comm->cd[0].numPulses() == 1
+            && ddbox.npbcdim == DIM && !TRICLINIC(box) && !dd.unitCellInfo.haveScrewPBC);
+}
+
+/*! \brief Sets up the halo pruning grid of this rank and sends it backward
+ *
+ * \param[in]  dd       The domain decomposition struct
+ * \param[in]  box      The (rectangular) unit-cell
+ * \param[in]  x        The home atom coordinates
+ * \param[in]  maxDist  The maximum communication distance
+ * \param[out] grid     The grid, on return contains the extents of the receiving rank
+ */
+static void setupHaloPruningGrid(const gmx_domdec_t*            dd,
+                                 const matrix                   box,
+                                 gmx::ArrayRef<const gmx::RVec> x,
+                                 real                           maxDist,
+                                 HaloPruningGrid*               grid)
+{
+    /* Use cells of about half the communication distance, this gives
+     * a good compromise between pruning efficiency and search cost.
+     */
+    constexpr real c_cellSizeOverDistance = 0.5;
+    constexpr int  c_maxNumCellsPerDim    = 64;
+
+    const int dim = dd->dim[0];
+
+    int numCellsTotal = 1;
+    for (int d = 0; d < 2; d++)
+    {
+        const int dimT    = (dim + 1 + d) % DIM;
+        grid->dims[d]     = dimT;
+        grid->numCells[d] = std::clamp(
+                static_cast<int>(box[dimT][dimT] / (c_cellSizeOverDistance * maxDist)), 1,
+                c_maxNumCellsPerDim);
+        grid->cellSize[d]    = box[dimT][dimT] / grid->numCells[d];
+        grid->invCellSize[d] = 1 / grid->cellSize[d];
+        grid->searchRange[d] = static_cast<int>(std::ceil(maxDist * grid->invCellSize[d]));
+        numCellsTotal *= grid->numCells[d];
+    }
+
+    const real cellX1 = dd->comm->cell_x1[dim];
+
+    grid->localExtent.assign(numCellsTotal, std::numeric_limits<real>::lowest());
+    for (const gmx::RVec& xAtom : x)
+    {
+        const int index = haloPruningGridIndex(*grid, 0, xAtom[grid->dims[0]]) * grid->numCells[1]
+                          + haloPruningGridIndex(*grid, 1, xAtom[grid->dims[1]]);
+        grid->localExtent[index] = std::max(grid->localExtent[index], xAtom[dim] - cellX1);
+    }
+
+    /* We send our halo backward, so we need the grid of our backward neighbor */
+    grid->receiverExtent.resize(numCellsTotal);
+    ddSendrecv<real>(dd, 0, dddirForward, grid->localExtent, grid->receiverExtent);
+}
+
+//! The maximum number of grid cells to search in each direction for halo pruning
+static constexpr int c_maxHaloPruningSearchRange = 3;
+
+/*! \brief Returns a lower bound for the squared distance of \p x to the home atoms of the receiver
+ *
+ * \param[in] grid       The halo pruning grid
+ * \param[in] dim        The decomposition dimension
+ * \param[in] boundary   The location of our lower cell boundary along \p dim
+ * \param[in] x          The coordinate of the atom to check
+ * \param[in] maxDist2   Distances beyond this value are returned as maxDist2
+ */
+static real haloPruningDistance2(const HaloPruningGrid& grid,
+                                 int                    dim,
+                                 real                   boundary,
+                                 const rvec             x,
+                                 real                   maxDist2)
+{
+    constexpr int c_maxSearchWidth = 2 * c_maxHaloPruningSearchRange + 1;
+
+    /* Compute the minimum squared distances to the grid cells along both dimensions */
+    int  cellIndex[2][c_maxSearchWidth];
+    real cellDist2[2][c_maxSearchWidth];
+    int  searchWidth[2];
+    for (int d = 0; d < 2; d++)
+    {
+        const real xd    = x[grid.dims[d]];
+        const int  range = std::min(grid.searchRange[d], c_maxHaloPruningSearchRange);
+        const int  cell  = static_cast<int>(std::floor(xd * grid.invCellSize[d]));
+        searchWidth[d]   = 2 * range + 1;
+        for (int i = 0; i < searchWidth[d]; i++)
+        {
+            const int  c     = cell - range + i;
+            const real lower = c * grid.cellSize[d] - xd;
+            const real upper = lower + grid.cellSize[d];
+            const real dist  = (lower > 0 ? lower : (upper < 0 ? -upper : 0));
+
+            cellIndex[d][i] = c % grid.numCells[d];
+            if (cellIndex[d][i] < 0)
+            {
+                cellIndex[d][i] += grid.numCells[d];
+            }
+            cellDist2[d][i] = dist * dist;
+        }
+    }
+
+    real minDist2 = maxDist2;
+    for (int i0 = 0; i0 < searchWidth[0]; i0++)
+    {
+        if (cellDist2[0][i0] >= minDist2)
+        {
+            continue;
+        }
+        const real* extentRow = grid.receiverExtent.data() + cellIndex[0][i0] * grid.numCells[1];
+        for (int i1 = 0; i1 < searchWidth[1]; i1++)
+        {
+            const real extent = extentRow[cellIndex[1][i1]];
+            if (extent == std::numeric_limits<real>::lowest())
+            {
+                continue;
+            }
+            real       dist2 = cellDist2[0][i0] + cellDist2[1][i1];
+            const real r     = x[dim] - (boundary + extent);
+            if (r > 0)
+            {
+                dist2 += r * r;
+            }
+            minDist2 = std::min(minDist2, dist2);
+        }
+    }
+
+    return minDist2;
+}
+
 /*! \brief Add the atom groups we need to send in this pulse from this
  * zone to \p localAtomGroups and \p work. */
 static void get_zone_pulse_cgs(gmx_domdec_t*            dd,
@@ -1559,6 +1734,7 @@ static void get_zone_pulse_cgs(gmx_domdec_t*            dd,
                                rvec*                    v_0,
                                rvec*                    v_1,
                                const dd_corners_t*      c,
+                               const HaloPruningGrid*   haloPruningGrid,
                                const rvec               sf2_round,
                                gmx_bool                 bDistBonded,
                                gmx_bool                 bBondComm,
@@ -1584,6 +1760,9 @@ static void get_zone_pulse_cgs(gmx_domdec_t*            dd,
 
     bDistMB_pulse = (bDistMB && bDistBonded);
 
+    /* With halo pruning we only need distances up to the largest cut-off in use */
+    const real maxDist2 = std::max(r_comm2, (bDist2B && bDistBonded) ? r_bcomm2 : 0);
+
     /* Unpack the work data */
     std::vector<int>&       ibuf = work->atomGroupBuffer;
     std::vector<gmx::RVec>& vbuf = work->positionBuffer;
@@ -1602,6 +1781,14 @@ static void get_zone_pulse_cgs(gmx_domdec_t*            dd,
             {
                 r2 += r * r;
             }
+            if (haloPruningGrid != nullptr && r2 < maxDist2)
+            {
+                /* Replace the distance to the cell boundary by a lower bound
+                 * for the distance to the home atoms of the receiver.
+                 */
+                r2 = haloPruningDistance2(*haloPruningGrid, dim, c->c[dim_ind][zone], cg_cm[cg],
+                                          maxDist2);
+            }
             if (bDistMB_pulse)
             {
                 r = cg_cm[cg][dim] - c->bc[dim_ind];
@@ -1865,6 +2052,16 @@ static void setup_dd_communication(gmx_domdec_t* dd, matrix box, gmx_ddbox_t* dd
 
     set_dd_corners(dd, dim0, dim1, dim2, bDistMB, &corners);
 
+    HaloPruningGrid  haloPruningGridData;
+    HaloPruningGrid* haloPruningGrid = nullptr;
+    if (useHaloPruning(*dd, *ddbox, box))
+    {
+        const real maxDist2 = std::max(r_comm2, bDist2B ? r_bcomm2 : 0);
+        setupHaloPruningGrid(dd, box, gmx::constArrayRefFromArray(state->x.data(), dd->ncg_home),
+                             std::sqrt(maxDist2), &haloPruningGridData);
+        haloPruningGrid = &haloPruningGridData;
+    }
+
     /* Triclinic stuff */
     normal      = ddbox->normal;
     skew_fac_01 = 0;
@@ -2009,8 +2206,9 @@ static void setup_dd_communication(gmx_domdec_t* dd, matrix box, gmx_ddbox_t* dd
                         get_zone_pulse_cgs(dd, zonei, zone, cg0_th, cg1_th, dd->globalAtomGroupIndices,
                                            dim, dim_ind, dim0, dim1, dim2, r_comm2, r_bcomm2, box,
                                            distanceIsTriclinic, normal, skew_fac2_d, skew_fac_01,
-                                           v_d, v_0, v_1, &corners, sf2_round, bDistBonded, bBondComm,
-                                           bDist2B, bDistMB, state->x.rvec_array(), fr->cginfo,
+                                           v_d, v_0, v_1, &corners, haloPruningGrid, sf2_round,
+                                           bDistBonded, bBondComm, bDist2B, bDistMB,
+                                           state->x.rvec_array(), fr->cginfo,
                                            th == 0 ? &ind->index : &work.localAtomGroupBuffer, &work);
                     }
                     GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
@@ -2438,27 +2636,41 @@ static void set_zones_size(gmx_domdec_t*      dd,
 }
 
 /*! \brief Order data in \p dataToSort according to \p sort
+ *
+ * The gather into \p sortBuffer and the copy back are both distributed
+ * over \p numThreads OpenMP threads.
  *
  * Note: both buffers should have at least \p sort.size() elements.
  */
 template<typename T>
 static void orderVector(gmx::ArrayRef<const gmx_cgsort_t> sort,
                         gmx::ArrayRef<T>                  dataToSort,
-                        gmx::ArrayRef<T>                  sortBuffer)
+                        gmx::ArrayRef<T>                  sortBuffer,
+                        int                               numThreads)
 {
     GMX_ASSERT(dataToSort.size() >= sort.size(), "The vector needs to be sufficiently large");
     GMX_ASSERT(sortBuffer.size() >= sort.size(),
                "The sorting buffer needs to be sufficiently large");
 
-    /* Order the data into the temporary buffer */
-    size_t i = 0;
-    for (const gmx_cgsort_t& entry : sort)
+    const int numElements = sort.ssize();
+
+    /* Order the data into the temporary buffer, then copy back.
+     * Each thread copies back the same range that it gathered,
+     * so we only need the implicit barrier between the two loops.
+     */
+#pragma omp parallel num_threads(numThreads)
     {
-        sortBuffer[i++] = dataToSort[entry.ind];
+#pragma omp for schedule(static)
+        for (int i = 0; i < numElements; i++)
+        {
+            sortBuffer[i] = dataToSort[sort[i].ind];
+        }
+#pragma omp for schedule(static)
+        for (int i = 0; i < numElements; i++)
+        {
+            dataToSort[i] = sortBuffer[i];
+        }
     }
-
-    /* Copy back to the original array */
-    std::copy(sortBuffer.begin(), sortBuffer.begin() + sort.size(), dataToSort.begin());
 }
 
 /*! \brief Order data in \p dataToSort according to \p sort
@@ -2469,33 +2681,44 @@ static void orderVector(gmx::ArrayRef<const gmx_cgsort_t> sort,
 template<typename T>
 static void orderVector(gmx::ArrayRef<const gmx_cgsort_t> sort,
                         gmx::ArrayRef<T>                  vectorToSort,
-                        std::vector<T>*                   workVector)
+                        std::vector<T>*                   workVector,
+                        int                               numThreads)
 {
     if (gmx::index(workVector->size()) < sort.ssize())
     {
         workVector->resize(sort.size());
     }
-    orderVector<T>(sort, vectorToSort, *workVector);
+    orderVector<T>(sort, vectorToSort, *workVector, numThreads);
 }
 
-//! Returns the sorting order for atoms based on the nbnxn grid order in sort
-static void dd_sort_order_nbnxn(const t_forcerec* fr, std::vector<gmx_cgsort_t>* sort)
+/*! \brief Returns the sorting order for atoms based on the nbnxn grid order in sort
+ *
+ * \returns whether the order is the identity permutation of \p numHomeAtomsOld atoms,
+ *          i.e. no atoms left the domain and the grid order did not change.
+ */
+static bool dd_sort_order_nbnxn(const t_forcerec*          fr,
+                                std::vector<gmx_cgsort_t>* sort,
+                                int                        numHomeAtomsOld)
 {
     gmx::ArrayRef<const int> atomOrder = fr->nbv->getLocalAtomOrder();
 
     /* Using push_back() instead of this resize results in much slower code */
     sort->resize(atomOrder.size());
-    gmx::ArrayRef<gmx_cgsort_t> buffer    = *sort;
-    size_t                      numSorted = 0;
+    gmx::ArrayRef<gmx_cgsort_t> buffer     = *sort;
+    size_t                      numSorted  = 0;
+    bool                        isIdentity = true;
     for (int i : atomOrder)
     {
         if (i >= 0)
         {
             /* The values of nsc and ind_gl are not used in this case */
+            isIdentity = isIdentity && (i == static_cast<int>(numSorted));
             buffer[numSorted++].ind = i;
         }
     }
     sort->resize(numSorted);
+
+    return isIdentity && static_cast<int>(numSorted) == numHomeAtomsOld;
 }
 
 //! Returns the sorting state for DD.
@@ -2503,39 +2726,53 @@ static void dd_sort_state(gmx_domdec_t* dd, t_forcerec* fr, t_state* state)
 {
     gmx_domdec_sort_t* sort = dd->comm->sort.get();
 
-    dd_sort_order_nbnxn(fr, &sort->sorted);
-
-    /* We alloc with the old size, since cgindex is still old */
-    DDBufferAccess<gmx::RVec> rvecBuffer(dd->comm->rvecBuffer, dd->ncg_home);
+    const bool orderIsUnchanged = dd_sort_order_nbnxn(fr, &sort->sorted, dd->ncg_home);
 
     /* Set the new home atom/charge group count */
-    dd->ncg_home = sort->sorted.size();
+    const int numHomeAtomsOld = dd->ncg_home;
+    dd->ncg_home              = sort->sorted.size();
     if (debug)
     {
-        fprintf(debug, "Set the new home atom count to %d\n", dd->ncg_home);
+        fprintf(debug, "Set the new home atom count to %d%s\n", dd->ncg_home,
+                orderIsUnchanged ? ", order unchanged" : "");
     }
 
-    /* Reorder the state */
     gmx::ArrayRef<const gmx_cgsort_t> cgsort = sort->sorted;
     GMX_RELEASE_ASSERT(cgsort.ssize() == dd->ncg_home, "We should sort all the home atom groups");
 
-    if (state->flags & (1 << estX))
-    {
-        orderVector(cgsort, makeArrayRef(state->x), rvecBuffer.buffer);
-    }
-    if (state->flags & (1 << estV))
-    {
-        orderVector(cgsort, makeArrayRef(state->v), rvecBuffer.buffer);
-    }
-    if (state->flags & (1 << estCGP))
+    /* When the nbnxm grid order is the same as the current order,
+     * which is common with short nstlist and small home domains,
+     * there is nothing to reorder.
+     */
+    if (!orderIsUnchanged)
     {
-        orderVector(cgsort, makeArrayRef(state->cg_p), rvecBuffer.buffer);
-    }
+        const int numThreads = gmx_omp_nthreads_get(emntDomdec);
+
+        /* We alloc with the old size, since cgindex is still old.
+         * The buffer is persistent storage in comm, so the permutation
+         * does not allocate after the first few partitionings.
+         */
+        DDBufferAccess<gmx::RVec> rvecBuffer(dd->comm->rvecBuffer, numHomeAtomsOld);
 
-    /* Reorder the global cg index */
-    orderVector<int>(cgsort, dd->globalAtomGroupIndices, &sort->intBuffer);
-    /* Reorder the cginfo */
-    orderVector<int>(cgsort, fr->cginfo, &sort->intBuffer);
+        /* Reorder the state */
+        if (state->flags & (1 << estX))
+        {
+            orderVector(cgsort, makeArrayRef(state->x), rvecBuffer.buffer, numThreads);
+        }
+        if (state->flags & (1 << estV))
+        {
+            orderVector(cgsort, makeArrayRef(state->v), rvecBuffer.buffer, numThreads);
+        }
+        if (state->flags & (1 << estCGP))
+        {
+            orderVector(cgsort, makeArrayRef(state->cg_p), rvecBuffer.buffer, numThreads);
+        }
+
+        /* Reorder the global cg index */
+        orderVector<int>(cgsort, dd->globalAtomGroupIndices, &sort->intBuffer, numThreads);
+        /* Reorder the cginfo */
+        orderVector<int>(cgsort, fr->cginfo, &sort->intBuffer, numThreads);
+    }
     /* Set the home atom number */
     dd->comm->atomRanges.setEnd(DDAtomRanges::Type::Home, dd->ncg_home);
 
@@ -3094,8 +3331,10 @@ void dd_partition_system(FILE*                     fplog,
                 if (dd->comm->systemInfo.haveSplitConstraints || dd->comm->systemInfo.haveSplitSettles)
                 {
                     /* Only for inter-cg constraints we need special code */
+                    const int haloDepth = gmx::lincsConstraintHaloDepth(
+                            *ir, dd->comm->ddSettings.useLincsExpandedHalo);
                     n = dd_make_local_constraints(dd, n, &top_global, fr->cginfo.data(), constr,
-                                                  ir->nProjOrder, top_local->idef.il);
+                                                  haloDepth, top_local->idef.il);
                 }
                 break;
             default: gmx_incons("Unknown special atom type setup");
@@ -53,6 +53,7 @@
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/gmxfio_xdr.h"
 #include "gromacs/fileio/xdr_datatype.h"
+#include "gromacs/fileio/xdrbulk.h"
 #include "gromacs/fileio/xdrf.h"
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/math/vec.h"
@@ -567,18 +568,25 @@ static inline unsigned int sizeOfXdrType(int xdrType)
     return 0;
 }
 
-//! \brief Returns the XDR process function for i/o of an XDR type
-static inline xdrproc_t xdrProc(int xdrType)
+/*! \brief Reads/writes \p n elements of an XDR type at \p data
+ *
+ * The data in the file is identical to that of xdr_vector() with the element
+ * functions for \p xdrType, but the elements are converted in bulk.
+ */
+static bool_t doXdrVector(XDR* xd, char* data, int n, int xdrType)
 {
     switch (xdrType)
     {
-        case xdr_datatype_int: return reinterpret_cast<xdrproc_t>(xdr_int);
-        case xdr_datatype_float: return reinterpret_cast<xdrproc_t>(xdr_float);
-        case xdr_datatype_double: return reinterpret_cast<xdrproc_t>(xdr_double);
+        case xdr_datatype_int:
+            return gmx::xdrBulkValues<int>(xd, reinterpret_cast<int*>(data), n);
+        case xdr_datatype_float:
+            return gmx::xdrBulkValues<float>(xd, reinterpret_cast<float*>(data), n);
+        case xdr_datatype_double:
+            return gmx::xdrBulkValues<double>(xd, reinterpret_cast<double*>(data), n);
         default: GMX_RELEASE_ASSERT(false, "XDR data type not implemented");
     }
 
-    return nullptr;
+    return 0;
 }
 
 /*! \brief Lists or only reads an xdr vector from checkpoint file
@@ -594,7 +602,7 @@ static bool_t listXdrVector(XDR* xd, StatePart part, int ecpt, int nf, int xdrTy
 
     const unsigned int elemSize = sizeOfXdrType(xdrType);
     std::vector<char>  data(nf * elemSize);
-    res = xdr_vector(xd, data.data(), nf, elemSize, xdrProc(xdrType));
+    res = doXdrVector(xd, data.data(), nf, xdrType);
 
     if (list != nullptr)
     {
@@ -783,6 +791,7 @@ static int doVectorLow(XDR*                           xd,
         }
         else
         {
+            GMX_RELEASE_ASSERT(vector != nullptr, "Need a vector when no C array is passed");
             /* This conditional ensures that we don't resize on write.
              * In particular in the state where this code was written
              * vector has a size of numElemInThefile and we
@@ -804,8 +813,7 @@ static int doVectorLow(XDR*                           xd,
         {
             snew(vChar, numElemInTheFile * sizeOfXdrType(xdrTypeInTheFile));
         }
-        res = xdr_vector(xd, vChar, numElemInTheFile, sizeOfXdrType(xdrTypeInTheFile),
-                         xdrProc(xdrTypeInTheFile));
+        res = doXdrVector(xd, vChar, numElemInTheFile, xdrTypeInTheFile);
         if (res == 0)
         {
             return -1;
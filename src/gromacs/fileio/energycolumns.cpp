@@ -0,0 +1,836 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements reading and writing of energy column files.
+ *
+ * The file starts with a header containing the names and units of the
+ * energy terms, followed by chunks. Each chunk has a header with the
+ * number of frames, the offset in the energy file after the chunk,
+ * the time of the last frame and the sizes of the columns, followed
+ * by the columns. The columns are the steps, the numbers of steps and
+ * sums, the times and then, for each term, the values, averages and
+ * sums. All numbers are stored big-endian.
+ *
+ * Integer columns store the differences between consecutive values
+ * as variable-length integers. Floating-point columns store the
+ * exclusive or of the bits of consecutive values without their leading
+ * zero bytes. Double-precision values are preceded by a byte with the
+ * numbers of removed leading and trailing bytes. The energy terms are
+ * stored with the precision of the writing program; in single precision
+ * the numbers of removed bytes of four values are packed in a byte.
+ * Many energy terms are constant or change little between frames,
+ * so this removes a large part of the bytes.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "energycolumns.h"
+
+#include <cstring>
+
+#include <algorithm>
+#include <limits>
+
+#include "gromacs/fileio/enxio.h"
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/trajectory/energyframe.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace gmx
+{
+
+namespace
+{
+
+//! Magic number at the start of energy column files
+const uint32_t c_columnFileMagic = 0x45434f4c;
+//! Version of the energy column file format
+const uint32_t c_columnFileVersion = 1;
+//! Magic number at the start of each chunk
+const uint32_t c_chunkMagic = 0x4543484b;
+//! The number of frames written per chunk
+const size_t c_framesPerChunk = 1000;
+//! The number of columns with frame data, before the term columns
+const int c_numFrameColumns = 4;
+//! The number of columns per energy term
+const int c_numColumnsPerTerm = 3;
+//! The size of the fixed part of the chunk header
+const size_t c_chunkHeaderSize = 4 + 4 + 8 + 8;
+
+//! Returns the number of columns in a chunk with \p numTerms energy terms
+int numColumns(int numTerms)
+{
+    return c_numFrameColumns + c_numColumnsPerTerm * numTerms;
+}
+
+//! Appends the lowest \p numBytes bytes of \p value to \p buffer, big-endian
+void appendBytes(std::vector<unsigned char>* buffer, uint64_t value, int numBytes)
+{
+    for (int i = numBytes - 1; i >= 0; i--)
+    {
+        buffer->push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+//! Returns the big-endian number of \p numBytes bytes starting at \p data
+uint64_t extractBytes(const unsigned char* data, int numBytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < numBytes; i++)
+    {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+//! Returns the bits of \p value
+uint32_t floatToBits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+//! Returns the float with bits \p bits
+float bitsToFloat(uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//! Returns the bits of \p value
+uint64_t doubleToBits(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+//! Returns the double with bits \p bits
+double bitsToDouble(uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//! Appends the differences between consecutive \p values to \p buffer
+void encodeIntegers(ArrayRef<const int64_t> values, std::vector<unsigned char>* buffer)
+{
+    int64_t previous = 0;
+    for (const int64_t value : values)
+    {
+        // Zigzag encoding maps small negative differences to small numbers
+        const uint64_t difference = static_cast<uint64_t>(value) - static_cast<uint64_t>(previous);
+        const bool     isNegative = static_cast<int64_t>(difference) < 0;
+        uint64_t       encoded    = (difference << 1) ^ (isNegative ? ~uint64_t(0) : 0);
+        while (encoded >= 0x80)
+        {
+            buffer->push_back(static_cast<unsigned char>(encoded | 0x80));
+            encoded >>= 7;
+        }
+        buffer->push_back(static_cast<unsigned char>(encoded));
+        previous = value;
+    }
+}
+
+//! Decodes \p data into \p values, returns whether \p data contained exactly all values
+bool decodeIntegers(ArrayRef<const unsigned char> data, ArrayRef<int64_t> values)
+{
+    auto    byte     = data.begin();
+    int64_t previous = 0;
+    for (int64_t& value : values)
+    {
+        uint64_t encoded = 0;
+        int      shift   = 0;
+        do
+        {
+            if (byte == data.end() || shift >= 64)
+            {
+                return false;
+            }
+            encoded |= static_cast<uint64_t>(*byte & 0x7f) << shift;
+            shift += 7;
+        } while (*byte++ & 0x80);
+        const uint64_t difference = (encoded >> 1) ^ (encoded & 1 ? ~uint64_t(0) : 0);
+        value    = static_cast<int64_t>(static_cast<uint64_t>(previous) + difference);
+        previous = value;
+    }
+    return byte == data.end();
+}
+
+//! Appends the exclusive or of the bits of consecutive \p values to \p buffer
+void encodeDoubles(ArrayRef<const double> values, std::vector<unsigned char>* buffer)
+{
+    uint64_t previous = 0;
+    for (const double value : values)
+    {
+        const uint64_t bits       = doubleToBits(value);
+        const uint64_t difference = bits ^ previous;
+        int            leading    = 0;
+        int            trailing   = 0;
+        if (difference == 0)
+        {
+            leading = 8;
+        }
+        else
+        {
+            while ((difference >> (56 - 8 * leading)) == 0)
+            {
+                leading++;
+            }
+            while (((difference >> (8 * trailing)) & 0xff) == 0)
+            {
+                trailing++;
+            }
+        }
+        buffer->push_back(static_cast<unsigned char>((leading << 4) | trailing));
+        appendBytes(buffer, difference >> (8 * trailing), 8 - leading - trailing);
+        previous = bits;
+    }
+}
+
+//! Decodes \p data into \p values, returns whether \p data contained exactly all values
+bool decodeDoubles(ArrayRef<const unsigned char> data, ArrayRef<double> values)
+{
+    auto     byte     = data.begin();
+    uint64_t previous = 0;
+    for (double& value : values)
+    {
+        if (byte == data.end())
+        {
+            return false;
+        }
+        const int leading  = *byte >> 4;
+        const int trailing = *byte & 0xf;
+        const int numBytes = 8 - leading - trailing;
+        byte++;
+        if (numBytes < 0 || data.end() - byte < numBytes)
+        {
+            return false;
+        }
+        uint64_t difference = 0;
+        if (numBytes > 0)
+        {
+            difference = extractBytes(&*byte, numBytes) << (8 * trailing);
+        }
+        byte += numBytes;
+        previous ^= difference;
+        value = bitsToDouble(previous);
+    }
+    return byte == data.end();
+}
+
+/*! \brief Appends the exclusive or of the bits of consecutive \p values, as floats, to \p buffer
+ *
+ * Each group of four values is preceded by a byte with a two-bit code
+ * per value: the number of leading zero bytes that were removed, up
+ * to two, or three for a value that is identical to the previous one.
+ */
+void encodeFloats(ArrayRef<const double> values, std::vector<unsigned char>* buffer)
+{
+    uint32_t previous = 0;
+    for (size_t start = 0; start < values.size(); start += 4)
+    {
+        const size_t codeIndex = buffer->size();
+        buffer->push_back(0);
+        for (size_t i = start; i < std::min(start + 4, values.size()); i++)
+        {
+            const uint32_t bits       = floatToBits(values[i]);
+            const uint32_t difference = bits ^ previous;
+            int            code       = 0;
+            if (difference == 0)
+            {
+                code = 3;
+            }
+            else
+            {
+                while (code < 2 && (difference >> (24 - 8 * code)) == 0)
+                {
+                    code++;
+                }
+            }
+            (*buffer)[codeIndex] |= code << (2 * (i - start));
+            appendBytes(buffer, difference, code == 3 ? 0 : 4 - code);
+            previous = bits;
+        }
+    }
+}
+
+//! Decodes \p data into \p values, returns whether \p data contained exactly all values
+bool decodeFloats(ArrayRef<const unsigned char> data, ArrayRef<double> values)
+{
+    auto     byte     = data.begin();
+    uint32_t previous = 0;
+    for (size_t start = 0; start < values.size(); start += 4)
+    {
+        if (byte == data.end())
+        {
+            return false;
+        }
+        const int codes = *byte++;
+        for (size_t i = start; i < std::min(start + 4, values.size()); i++)
+        {
+            const int code     = (codes >> (2 * (i - start))) & 3;
+            const int numBytes = (code == 3 ? 0 : 4 - code);
+            if (data.end() - byte < numBytes)
+            {
+                return false;
+            }
+            if (numBytes > 0)
+            {
+                previous ^= extractBytes(&*byte, numBytes);
+            }
+            byte += numBytes;
+            values[i] = bitsToFloat(previous);
+        }
+    }
+    return byte == data.end();
+}
+
+//! Appends \p value to \p buffer, preceded by its length
+void appendString(std::vector<unsigned char>* buffer, const std::string& value)
+{
+    appendBytes(buffer, value.size(), 4);
+    buffer->insert(buffer->end(), value.begin(), value.end());
+}
+
+//! Reads \p numBytes bytes from \p file into \p buffer, returns whether successful
+bool readBytes(FILE* file, size_t numBytes, std::vector<unsigned char>* buffer)
+{
+    buffer->resize(numBytes);
+    return numBytes == 0 || std::fread(buffer->data(), 1, numBytes, file) == numBytes;
+}
+
+//! Reads a 32-bit number from \p file into \p value, returns whether successful
+bool readUInt32(FILE* file, uint32_t* value)
+{
+    std::vector<unsigned char> buffer;
+    if (!readBytes(file, 4, &buffer))
+    {
+        return false;
+    }
+    *value = extractBytes(buffer.data(), 4);
+    return true;
+}
+
+//! Reads a string written by appendString() from \p file, returns whether successful
+bool readString(FILE* file, std::string* value)
+{
+    uint32_t                   length;
+    std::vector<unsigned char> buffer;
+    if (!readUInt32(file, &length) || length > 1024 || !readBytes(file, length, &buffer))
+    {
+        return false;
+    }
+    value->assign(buffer.begin(), buffer.end());
+    return true;
+}
+
+//! Writes \p buffer to \p file and flushes it, throws FileIOError on failure
+void writeBuffer(FILE* file, const std::vector<unsigned char>& buffer, const std::string& fileName)
+{
+    if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()
+        || std::fflush(file) != 0)
+    {
+        GMX_THROW(FileIOError("Cannot write energy column file " + fileName
+                              + "; maybe you are out of disk space?"));
+    }
+}
+
+/*! \brief Reads the file header from \p file, returns whether successful and valid
+ *
+ * \param[in]  file       The column file, positioned at the start.
+ * \param[out] valueSize  The size of the floating-point type of the energy terms.
+ * \param[out] names      The names of the energy terms.
+ * \param[out] units      The units of the energy terms.
+ */
+bool readHeader(FILE*                     file,
+                int*                      valueSize,
+                std::vector<std::string>* names,
+                std::vector<std::string>* units)
+{
+    uint32_t magic, version, size, numTerms;
+    if (!readUInt32(file, &magic) || !readUInt32(file, &version) || !readUInt32(file, &size)
+        || !readUInt32(file, &numTerms) || magic != c_columnFileMagic
+        || version != c_columnFileVersion || (size != sizeof(float) && size != sizeof(double))
+        || numTerms > 100000)
+    {
+        return false;
+    }
+    *valueSize = size;
+    names->resize(numTerms);
+    units->resize(numTerms);
+    for (uint32_t i = 0; i < numTerms; i++)
+    {
+        if (!readString(file, &(*names)[i]) || !readString(file, &(*units)[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//! A chunk as stored in the column file
+struct StoredChunk
+{
+    //! The number of frames in the chunk
+    int numFrames;
+    //! The offset in the energy file after the chunk
+    gmx_off_t energyEndOffset;
+    //! The time of the last frame in the chunk
+    double lastTime;
+    //! The offsets of the columns, with the end of the chunk as last entry
+    std::vector<gmx_off_t> columnOffsets;
+};
+
+//! Returns the size of \p fileName, or -1 when it can not be opened
+gmx_off_t fileSize(const std::string& fileName)
+{
+    if (!gmx_fexist(fileName))
+    {
+        return -1;
+    }
+    FILE* file = gmx_ffopen(fileName, "rb");
+    gmx_fseek(file, 0, SEEK_END);
+    const gmx_off_t size = gmx_ftell(file);
+    gmx_ffclose(file);
+
+    return size;
+}
+
+/*! \brief Returns the chunks in \p file, which is positioned after the header
+ *
+ * Stops at the first incomplete or invalid chunk, and at the first
+ * chunk that does not end after the previous one in the energy file.
+ */
+std::vector<StoredChunk> readChunks(FILE* file, gmx_off_t size, int numTerms)
+{
+    std::vector<StoredChunk>   chunks;
+    std::vector<unsigned char> buffer;
+    gmx_off_t                  position = gmx_ftell(file);
+    while (readBytes(file, c_chunkHeaderSize + 4 * numColumns(numTerms), &buffer))
+    {
+        const unsigned char* data = buffer.data();
+        StoredChunk          chunk;
+        const uint32_t       magic = extractBytes(data, 4);
+        chunk.numFrames            = extractBytes(data + 4, 4);
+        chunk.energyEndOffset      = extractBytes(data + 8, 8);
+        chunk.lastTime             = bitsToDouble(extractBytes(data + 16, 8));
+        if (magic != c_chunkMagic || chunk.numFrames < 0
+            || chunk.energyEndOffset < (chunks.empty() ? 0 : chunks.back().energyEndOffset))
+        {
+            break;
+        }
+        position += buffer.size();
+        for (int c = 0; c < numColumns(numTerms); c++)
+        {
+            chunk.columnOffsets.push_back(position);
+            position += extractBytes(data + c_chunkHeaderSize + 4 * c, 4);
+        }
+        chunk.columnOffsets.push_back(position);
+        if (position > size || gmx_fseek(file, position, SEEK_SET) != 0)
+        {
+            break;
+        }
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+} // namespace
+
+std::string energyColumnFileName(const std::string& energyFileName)
+{
+    return energyFileName + ".ecol";
+}
+
+EnergyColumnWriter::EnergyColumnWriter(const std::string& energyFileName, bool append) :
+    columnFileName_(energyColumnFileName(energyFileName))
+{
+    if (!append)
+    {
+        return;
+    }
+    const gmx_off_t energyFileSize = fileSize(energyFileName);
+    if (energyFileSize <= 0)
+    {
+        return;
+    }
+
+    ener_file_t  energyFile = open_enx(energyFileName.c_str(), "r");
+    int          numTerms   = 0;
+    gmx_enxnm_t* enm        = nullptr;
+    do_enxnms(energyFile, &numTerms, &enm);
+    std::vector<std::string> names, units;
+    for (int i = 0; i < numTerms; i++)
+    {
+        names.emplace_back(enm[i].name);
+        units.emplace_back(enm[i].unit);
+    }
+    free_enxnms(numTerms, enm);
+
+    /* Keep the chunks that are still present in the (possibly truncated) energy file */
+    gmx_off_t sizeToKeep = 0;
+    if (gmx_fexist(columnFileName_))
+    {
+        FILE*                    file = gmx_ffopen(columnFileName_, "rb");
+        int                      storedValueSize;
+        std::vector<std::string> storedNames, storedUnits;
+        if (readHeader(file, &storedValueSize, &storedNames, &storedUnits)
+            && storedValueSize == sizeof(real) && storedNames == names && storedUnits == units)
+        {
+            sizeToKeep = gmx_ftell(file);
+            for (const StoredChunk& chunk : readChunks(file, fileSize(columnFileName_), numTerms))
+            {
+                if (chunk.energyEndOffset > energyFileSize)
+                {
+                    break;
+                }
+                sizeToKeep = chunk.columnOffsets.back();
+                endOffset_ = chunk.energyEndOffset;
+            }
+        }
+        gmx_ffclose(file);
+    }
+    if (sizeToKeep > 0)
+    {
+        if (gmx_truncate(columnFileName_, sizeToKeep) != 0)
+        {
+            GMX_THROW(FileIOError("Cannot truncate energy column file " + columnFileName_));
+        }
+        file_     = gmx_ffopen(columnFileName_, "ab");
+        numTerms_ = numTerms;
+        termColumns_.resize(c_numColumnsPerTerm * numTerms);
+        writtenEndOffset_ = endOffset_;
+    }
+    else
+    {
+        setTermNames(names, units);
+    }
+
+    /* Add the frames of the energy file after the kept chunks */
+    if (endOffset_ > 0)
+    {
+        gmx_fio_seek(enx_file_pointer(energyFile), endOffset_);
+    }
+    t_enxframe frame;
+    init_enxframe(&frame);
+    while (do_enx(energyFile, &frame))
+    {
+        addFrame(frame, gmx_fio_ftell(enx_file_pointer(energyFile)));
+    }
+    free_enxframe(&frame);
+    done_ener_file(energyFile);
+}
+
+EnergyColumnWriter::~EnergyColumnWriter()
+{
+    if (file_ != nullptr)
+    {
+        gmx_ffclose(file_);
+    }
+}
+
+void EnergyColumnWriter::setTermNames(ArrayRef<const std::string> names,
+                                      ArrayRef<const std::string> units)
+{
+    GMX_RELEASE_ASSERT(file_ == nullptr, "The energy term names can only be set once");
+    GMX_RELEASE_ASSERT(names.size() == units.size(), "Need a unit for each energy term");
+
+    numTerms_ = names.ssize();
+    termColumns_.resize(c_numColumnsPerTerm * numTerms_);
+
+    std::vector<unsigned char> buffer;
+    appendBytes(&buffer, c_columnFileMagic, 4);
+    appendBytes(&buffer, c_columnFileVersion, 4);
+    appendBytes(&buffer, sizeof(real), 4);
+    appendBytes(&buffer, numTerms_, 4);
+    for (int i = 0; i < numTerms_; i++)
+    {
+        appendString(&buffer, names[i]);
+        appendString(&buffer, units[i]);
+    }
+    file_ = gmx_ffopen(columnFileName_, "wb");
+    writeBuffer(file_, buffer, columnFileName_);
+}
+
+void EnergyColumnWriter::addFrame(const t_enxframe& frame, gmx_off_t endOffset)
+{
+    endOffset_ = endOffset;
+    if (file_ == nullptr || frame.nre == 0)
+    {
+        return;
+    }
+    GMX_RELEASE_ASSERT(frame.nre == numTerms_,
+                       "All frames with energies should have the same number of terms");
+
+    /* Store the values as they are read back from the energy file,
+     * where the sums are only present with more than one term */
+    const bool haveSums = frame.nsum > 1;
+    steps_.push_back(frame.step);
+    numSteps_.push_back(frame.nsteps);
+    numSums_.push_back(frame.nsum == 1 ? 0 : frame.nsum);
+    times_.push_back(frame.t);
+    for (int i = 0; i < numTerms_; i++)
+    {
+        const t_energy& energy = frame.ener[i];
+        const real      eav    = haveSums ? energy.eav : 0;
+        const real      esum   = haveSums ? energy.esum : 0;
+        termColumns_[c_numColumnsPerTerm * i].push_back(energy.e);
+        termColumns_[c_numColumnsPerTerm * i + 1].push_back(eav);
+        termColumns_[c_numColumnsPerTerm * i + 2].push_back(esum);
+    }
+    if (steps_.size() == c_framesPerChunk)
+    {
+        writeChunk();
+    }
+}
+
+void EnergyColumnWriter::finish()
+{
+    if (file_ != nullptr && (!steps_.empty() || endOffset_ != writtenEndOffset_))
+    {
+        writeChunk();
+    }
+}
+
+void EnergyColumnWriter::writeChunk()
+{
+    std::vector<std::vector<unsigned char>> columns(numColumns(numTerms_));
+    encodeIntegers(steps_, &columns[0]);
+    encodeIntegers(numSteps_, &columns[1]);
+    encodeIntegers(numSums_, &columns[2]);
+    encodeDoubles(times_, &columns[3]);
+    for (size_t c = 0; c < termColumns_.size(); c++)
+    {
+        if (sizeof(real) == sizeof(float))
+        {
+            encodeFloats(termColumns_[c], &columns[c_numFrameColumns + c]);
+        }
+        else
+        {
+            encodeDoubles(termColumns_[c], &columns[c_numFrameColumns + c]);
+        }
+    }
+
+    std::vector<unsigned char> buffer;
+    appendBytes(&buffer, c_chunkMagic, 4);
+    appendBytes(&buffer, steps_.size(), 4);
+    appendBytes(&buffer, endOffset_, 8);
+    const double lastTime = times_.empty() ? std::numeric_limits<double>::lowest() : times_.back();
+    appendBytes(&buffer, doubleToBits(lastTime), 8);
+    for (const auto& column : columns)
+    {
+        appendBytes(&buffer, column.size(), 4);
+    }
+    for (const auto& column : columns)
+    {
+        buffer.insert(buffer.end(), column.begin(), column.end());
+    }
+    writeBuffer(file_, buffer, columnFileName_);
+
+    steps_.clear();
+    numSteps_.clear();
+    numSums_.clear();
+    times_.clear();
+    for (auto& column : termColumns_)
+    {
+        column.clear();
+    }
+    writtenEndOffset_ = endOffset_;
+}
+
+EnergyColumnReader::~EnergyColumnReader()
+{
+    if (file_ != nullptr)
+    {
+        gmx_ffclose(file_);
+    }
+}
+
+std::unique_ptr<EnergyColumnReader> EnergyColumnReader::open(const std::string& energyFileName)
+{
+    const std::string columnFileName = energyColumnFileName(energyFileName);
+    if (!gmx_fexist(columnFileName))
+    {
+        return nullptr;
+    }
+    std::unique_ptr<EnergyColumnReader> reader(new EnergyColumnReader);
+    reader->columnFileName_ = columnFileName;
+    reader->file_           = gmx_ffopen(columnFileName, "rb");
+    if (!readHeader(reader->file_, &reader->valueSize_, &reader->names_, &reader->units_))
+    {
+        return nullptr;
+    }
+    const std::vector<StoredChunk> chunks =
+            readChunks(reader->file_, fileSize(columnFileName), reader->names_.size());
+    if (chunks.empty() || chunks.back().energyEndOffset != fileSize(energyFileName))
+    {
+        return nullptr;
+    }
+    for (const StoredChunk& chunk : chunks)
+    {
+        reader->chunks_.push_back({ chunk.numFrames, chunk.lastTime, chunk.columnOffsets });
+    }
+    return reader;
+}
+
+int64_t EnergyColumnReader::numFrames() const
+{
+    int64_t numFrames = 0;
+    for (const Chunk& chunk : chunks_)
+    {
+        numFrames += chunk.numFrames;
+    }
+    return numFrames;
+}
+
+void EnergyColumnReader::selectTerms(ArrayRef<const int> terms)
+{
+    for (const int term : terms)
+    {
+        GMX_RELEASE_ASSERT(term >= 0 && term < gmx::ssize(names_),
+                           "Energy term index out of range");
+    }
+    selectedTerms_.assign(terms.begin(), terms.end());
+}
+
+void EnergyColumnReader::skipToTime(real time)
+{
+    if (nextChunk_ > 0)
+    {
+        return;
+    }
+    while (nextChunk_ < gmx::ssize(chunks_)
+           && static_cast<real>(chunks_[nextChunk_].lastTime) < time)
+    {
+        nextChunk_++;
+    }
+}
+
+void EnergyColumnReader::readChunk(int chunkIndex)
+{
+    const Chunk&               chunk = chunks_[chunkIndex];
+    std::vector<unsigned char> buffer;
+    auto                       readColumn = [this, &chunk, &buffer](int column) {
+        const gmx_off_t offset = chunk.columnOffsets[column];
+        if (gmx_fseek(file_, offset, SEEK_SET) != 0
+            || !readBytes(file_, chunk.columnOffsets[column + 1] - offset, &buffer))
+        {
+            GMX_THROW(FileIOError("Cannot read energy column file " + columnFileName_));
+        }
+    };
+    auto checkColumn = [this](bool decoded) {
+        if (!decoded)
+        {
+            GMX_THROW(FileIOError("Energy column file " + columnFileName_ + " is corrupt"));
+        }
+    };
+
+    steps_.resize(chunk.numFrames);
+    numSteps_.resize(chunk.numFrames);
+    numSums_.resize(chunk.numFrames);
+    times_.resize(chunk.numFrames);
+    readColumn(0);
+    checkColumn(decodeIntegers(buffer, steps_));
+    readColumn(1);
+    checkColumn(decodeIntegers(buffer, numSteps_));
+    readColumn(2);
+    checkColumn(decodeIntegers(buffer, numSums_));
+    readColumn(3);
+    checkColumn(decodeDoubles(buffer, times_));
+
+    termColumns_.resize(c_numColumnsPerTerm * selectedTerms_.size());
+    for (size_t s = 0; s < selectedTerms_.size(); s++)
+    {
+        for (int q = 0; q < c_numColumnsPerTerm; q++)
+        {
+            std::vector<double>& values = termColumns_[c_numColumnsPerTerm * s + q];
+            values.resize(chunk.numFrames);
+            readColumn(c_numFrameColumns + c_numColumnsPerTerm * selectedTerms_[s] + q);
+            checkColumn(valueSize_ == sizeof(float) ? decodeFloats(buffer, values)
+                                                    : decodeDoubles(buffer, values));
+        }
+    }
+}
+
+bool EnergyColumnReader::readNextFrame(t_enxframe* frame)
+{
+    while (nextFrame_ >= gmx::ssize(steps_))
+    {
+        if (nextChunk_ >= gmx::ssize(chunks_))
+        {
+            return false;
+        }
+        readChunk(nextChunk_);
+        nextChunk_++;
+        nextFrame_ = 0;
+    }
+
+    const int numTerms = names_.size();
+    if (numTerms > frame->e_alloc)
+    {
+        srenew(frame->ener, numTerms);
+        frame->e_alloc = numTerms;
+    }
+    for (int i = 0; i < numTerms; i++)
+    {
+        frame->ener[i] = { 0, 0, 0 };
+    }
+    frame->t      = times_[nextFrame_];
+    frame->step   = steps_[nextFrame_];
+    frame->nsteps = numSteps_[nextFrame_];
+    frame->nsum   = numSums_[nextFrame_];
+    frame->nre    = numTerms;
+    frame->nblock = 0;
+    for (size_t s = 0; s < selectedTerms_.size(); s++)
+    {
+        t_energy& energy = frame->ener[selectedTerms_[s]];
+        energy.e         = termColumns_[c_numColumnsPerTerm * s][nextFrame_];
+        energy.eav       = termColumns_[c_numColumnsPerTerm * s + 1][nextFrame_];
+        energy.esum      = termColumns_[c_numColumnsPerTerm * s + 2][nextFrame_];
+    }
+    nextFrame_++;
+
+    return true;
+}
+
+} // namespace gmx
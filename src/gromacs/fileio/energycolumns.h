@@ -0,0 +1,246 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares reading and writing of energy column files.
+ *
+ * An energy column file stores the energy terms of the frames of an
+ * energy (.edr) file per term instead of per frame. The frames are
+ * grouped in chunks and within a chunk each quantity is stored as a
+ * separately compressed column, with the sizes of the columns in the
+ * chunk header. Readers can therefore extract a few terms, and skip
+ * chunks outside a time range, without decoding the rest of the data.
+ * Only the energy terms are stored, the blocks of the frames are not.
+ *
+ * The column file is stored next to the energy file, with the suffix
+ * returned by energyColumnFileName() appended to its name. It is only
+ * used when it covers exactly all frames of the energy file.
+ *
+ * \inlibraryapi
+ * \ingroup module_fileio
+ */
+#ifndef GMX_FILEIO_ENERGYCOLUMNS_H
+#define GMX_FILEIO_ENERGYCOLUMNS_H
+
+#include <cstdint>
+#include <cstdio>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gromacs/utility/arrayref.h"
+#include "gromacs/utility/classhelpers.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/real.h"
+
+struct t_enxframe;
+
+namespace gmx
+{
+
+//! Returns the name of the energy column file of \p energyFileName
+std::string energyColumnFileName(const std::string& energyFileName);
+
+/*! \libinternal \brief Writes the energy column file of an energy file
+ *
+ * After each frame is written to the energy file, addFrame() should be
+ * called with the energy file position after the frame. Frames are
+ * collected and written as a chunk when a chunk is full and when the
+ * writer is destroyed.
+ */
+class EnergyColumnWriter
+{
+public:
+    /*! \brief Creates a writer for the column file of \p energyFileName
+     *
+     * Without \p append, the column file is written when the names of
+     * the energy terms are set with setTermNames().
+     *
+     * With \p append, the chunks of the existing column file that are
+     * still covered by the (possibly truncated) energy file are kept
+     * and the frames of the energy file after those chunks are read
+     * back to continue the column file. The energy file should contain
+     * the names of the energy terms.
+     *
+     * \throws FileIOError when the column file can not be written.
+     */
+    EnergyColumnWriter(const std::string& energyFileName, bool append);
+    ~EnergyColumnWriter();
+
+    /*! \brief Sets the names and units of the energy terms and writes the file header
+     *
+     * \throws FileIOError when writing to the column file fails.
+     */
+    void setTermNames(ArrayRef<const std::string> names, ArrayRef<const std::string> units);
+
+    /*! \brief Adds the energy terms of \p frame, which ends at \p endOffset in the energy file
+     *
+     * Frames without energy terms only update the end offset.
+     *
+     * \throws FileIOError when writing to the column file fails.
+     */
+    void addFrame(const t_enxframe& frame, gmx_off_t endOffset);
+
+    /*! \brief Writes the remaining frames, should be called before closing the energy file
+     *
+     * \throws FileIOError when writing to the column file fails.
+     */
+    void finish();
+
+private:
+    //! Writes the collected frames as a chunk
+    void writeChunk();
+
+    //! The name of the column file
+    std::string columnFileName_;
+    //! The column file, nullptr until the header has been written
+    FILE* file_ = nullptr;
+    //! The number of energy terms
+    int numTerms_ = 0;
+    //! The offset in the energy file after the last frame added
+    gmx_off_t endOffset_ = 0;
+    //! The offset in the energy file at the end of the last chunk written
+    gmx_off_t writtenEndOffset_ = -1;
+    //! Steps of the collected frames
+    std::vector<int64_t> steps_;
+    //! Numbers of steps between the collected frames
+    std::vector<int64_t> numSteps_;
+    //! Numbers of energy sums of the collected frames
+    std::vector<int64_t> numSums_;
+    //! Times of the collected frames
+    std::vector<double> times_;
+    //! Values, averages and sums of each term of the collected frames
+    std::vector<std::vector<double>> termColumns_;
+
+    GMX_DISALLOW_COPY_AND_ASSIGN(EnergyColumnWriter);
+};
+
+/*! \libinternal \brief Reads selected energy terms from an energy column file
+ *
+ * Frames are returned in the same way as by do_enx(), except that
+ * only the selected terms are set and frames without energy terms
+ * and the blocks of frames are not present.
+ */
+class EnergyColumnReader
+{
+public:
+    ~EnergyColumnReader();
+
+    /*! \brief Returns a reader for the column file of \p energyFileName
+     *
+     * Returns nullptr when there is no column file, or when it does not
+     * cover exactly all frames of the energy file. The latter is the
+     * case when the energy file was modified after the column file was
+     * written or when the energy file is still being written.
+     */
+    static std::unique_ptr<EnergyColumnReader> open(const std::string& energyFileName);
+
+    //! Returns the names of the energy terms
+    ArrayRef<const std::string> termNames() const { return names_; }
+    //! Returns the total number of frames
+    int64_t numFrames() const;
+
+    /*! \brief Selects the terms to read, by their index in termNames()
+     *
+     * Only the columns of these terms are read and decoded.
+     */
+    void selectTerms(ArrayRef<const int> terms);
+
+    /*! \brief Skips the chunks that contain only frames before \p time
+     *
+     * Only whole chunks are skipped, so frames before \p time can
+     * still be returned. Has effect only before the first frame is read.
+     */
+    void skipToTime(real time);
+
+    /*! \brief Reads the next frame into \p frame, returns false when there are no more frames
+     *
+     * \throws FileIOError when the column file can not be read or is corrupt.
+     */
+    bool readNextFrame(t_enxframe* frame);
+
+private:
+    //! Location and contents of a chunk in the column file
+    struct Chunk
+    {
+        //! The number of frames in the chunk
+        int numFrames;
+        //! The time of the last frame in the chunk
+        double lastTime;
+        //! The offsets of the columns in the file, with the end of the chunk as last entry
+        std::vector<gmx_off_t> columnOffsets;
+    };
+
+    EnergyColumnReader() = default;
+
+    //! Reads and decodes the selected columns of chunk \p chunkIndex
+    void readChunk(int chunkIndex);
+
+    //! The name of the column file
+    std::string columnFileName_;
+    //! The column file
+    FILE* file_ = nullptr;
+    //! The size of the floating-point type of the stored energy terms
+    int valueSize_ = 0;
+    //! The names of the energy terms
+    std::vector<std::string> names_;
+    //! The units of the energy terms
+    std::vector<std::string> units_;
+    //! The chunks in the file
+    std::vector<Chunk> chunks_;
+    //! The selected terms
+    std::vector<int> selectedTerms_;
+    //! The index of the next chunk to read
+    int nextChunk_ = 0;
+    //! The index of the next frame in the current chunk
+    int nextFrame_ = 0;
+    //! Steps of the current chunk
+    std::vector<int64_t> steps_;
+    //! Numbers of steps between the frames of the current chunk
+    std::vector<int64_t> numSteps_;
+    //! Numbers of energy sums of the frames of the current chunk
+    std::vector<int64_t> numSums_;
+    //! Times of the frames of the current chunk
+    std::vector<double> times_;
+    //! Values, averages and sums of the selected terms of the current chunk
+    std::vector<std::vector<double>> termColumns_;
+
+    GMX_DISALLOW_COPY_AND_ASSIGN(EnergyColumnReader);
+};
+
+} // namespace gmx
+
+#endif
@@ -43,7 +43,10 @@
 #include <cstring>
 
 #include <algorithm>
+#include <string>
+#include <vector>
 
+#include "gromacs/fileio/energycolumns.h"
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/gmxfio_xdr.h"
 #include "gromacs/fileio/xdrf.h"
@@ -94,6 +97,8 @@ struct ener_file
     t_fileio*  fio;
     int        framenr;
     real       frametime;
+    /* Writes the energy column file, only set when requested */
+    gmx::EnergyColumnWriter* columnWriter;
 };
 
 static void enxsubblock_init(t_enxsubblock* sb)
@@ -435,6 +440,17 @@ void do_enxnms(ener_file_t ef, int* nre, gmx_enxnm_t** nms)
     }
 
     edr_strings(xdr, bRead, file_version, *nre, nms);
+
+    if (!bRead && ef->columnWriter)
+    {
+        std::vector<std::string> names, units;
+        for (int i = 0; i < *nre; i++)
+        {
+            names.emplace_back((*nms)[i].name);
+            units.emplace_back((*nms)[i].unit);
+        }
+        ef->columnWriter->setTermNames(names, units);
+    }
 }
 
 static gmx_bool do_eheader(ener_file_t ef,
@@ -757,6 +773,12 @@ void close_enx(ener_file_t ef)
         // Nothing to do
         return;
     }
+    if (ef->columnWriter)
+    {
+        ef->columnWriter->finish();
+        delete ef->columnWriter;
+        ef->columnWriter = nullptr;
+    }
     if (gmx_fio_close(ef->fio) != 0)
     {
         gmx_file(
@@ -878,6 +900,13 @@ t_fileio* enx_file_pointer(const ener_file* ef)
     return ef->fio;
 }
 
+void enx_enable_columns(ener_file_t ef, gmx_bool bAppend)
+{
+    GMX_RELEASE_ASSERT(!gmx_fio_getread(ef->fio),
+                       "Energy column files need an energy file opened for writing");
+    ef->columnWriter = new gmx::EnergyColumnWriter(gmx_fio_getname(ef->fio), bAppend);
+}
+
 static void convert_full_sums(ener_old_t* ener_old, t_enxframe* fr)
 {
     int    nstep_all;
@@ -1112,6 +1141,10 @@ gmx_bool do_enx(ener_file_t ef, t_enxframe* fr)
         {
             gmx_file("Cannot write energy file; maybe you are out of disk space?");
         }
+        if (bOK && ef->columnWriter)
+        {
+            ef->columnWriter->addFrame(*fr, gmx_fio_ftell(ef->fio));
+        }
     }
 
     if (!bOK)
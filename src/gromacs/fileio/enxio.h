@@ -164,6 +164,13 @@ ener_file_t open_enx(const char* fn, const char* mode);
 
 struct t_fileio* enx_file_pointer(const ener_file* ef);
 
+/* Also write an energy column file for an energy file opened for writing
+ * with open_enx, which allows readers to extract selected energy terms
+ * without reading whole frames. With bAppend, the existing column file
+ * is continued for an energy file opened for appending.
+ */
+void enx_enable_columns(ener_file_t ef, gmx_bool bAppend);
+
 /* Free the contents of ef */
 void close_enx(ener_file_t ef);
 
@@ -46,6 +46,7 @@
 #include <limits>
 
 #include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/xdrbulk.h"
 #include "gromacs/fileio/xdrf.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/gmxassert.h"
@@ -321,15 +322,14 @@ do_xdr(t_fileio* fio, void* item, std::size_t nitem, int eio, const char* desc,
             }
             break;
         case eioNRVEC:
-            ptr = nullptr;
-            res = 1;
-            for (std::size_t j = 0; j < nitem && res; j++)
+            ptr = item ? (static_cast<rvec*>(item))[0] : nullptr;
+            if (fio->bDouble)
             {
-                if (item)
-                {
-                    ptr = (static_cast<rvec*>(item))[j];
-                }
-                res = static_cast<bool_t>(do_xdr(fio, ptr, 1, eioRVEC, desc, srcfile, line));
+                res = static_cast<bool_t>(gmx::xdrBulkValues<double>(fio->xdr, ptr, nitem * DIM));
+            }
+            else
+            {
+                res = static_cast<bool_t>(gmx::xdrBulkValues<float>(fio->xdr, ptr, nitem * DIM));
             }
             break;
         case eioIVEC:
@@ -592,14 +592,31 @@ gmx_bool gmx_fio_doe_opaque(t_fileio* fio, char* data, std::size_t size, const c
 
 /* Array reading & writing */
 
+/* Reads or writes n values, stored as FileValue in the file, with one bulk XDR call */
+template<typename FileValue, typename Value>
+static gmx_bool
+gmx_fio_ndo_bulk(t_fileio* fio, Value* item, int n, const char* desc, const char* srcfile, int line)
+{
+    GMX_RELEASE_ASSERT(fio->xdr != nullptr, "Implementation error: NULL XDR pointers");
+    if (n < 0)
+    {
+        gmx_fatal(FARGS, "Trying to %s a negative number of items (%d) for %s, src %s, line %d",
+                  fio->bRead ? "read" : "write", n, desc, srcfile, line);
+    }
+    return gmx::xdrBulkValues<FileValue>(fio->xdr, item, n);
+}
+
 gmx_bool gmx_fio_ndoe_real(t_fileio* fio, real* item, int n, const char* desc, const char* srcfile, int line)
 {
-    gmx_bool ret = TRUE;
-    int      i;
+    gmx_bool ret;
     gmx_fio_lock(fio);
-    for (i = 0; i < n; i++)
+    if (fio->bDouble)
     {
-        ret = ret && do_xdr(fio, &(item[i]), 1, eioREAL, desc, srcfile, line);
+        ret = gmx_fio_ndo_bulk<double>(fio, item, n, desc, srcfile, line);
+    }
+    else
+    {
+        ret = gmx_fio_ndo_bulk<float>(fio, item, n, desc, srcfile, line);
     }
     gmx_fio_unlock(fio);
     return ret;
@@ -608,13 +625,9 @@ gmx_bool gmx_fio_ndoe_real(t_fileio* fio, real* item, int n, const char* desc, c
 
 gmx_bool gmx_fio_ndoe_float(t_fileio* fio, float* item, int n, const char* desc, const char* srcfile, int line)
 {
-    gmx_bool ret = TRUE;
-    int      i;
+    gmx_bool ret;
     gmx_fio_lock(fio);
-    for (i = 0; i < n; i++)
-    {
-        ret = ret && do_xdr(fio, &(item[i]), 1, eioFLOAT, desc, srcfile, line);
-    }
+    ret = gmx_fio_ndo_bulk<float>(fio, item, n, desc, srcfile, line);
     gmx_fio_unlock(fio);
     return ret;
 }
@@ -622,13 +635,9 @@ gmx_bool gmx_fio_ndoe_float(t_fileio* fio, float* item, int n, const char* desc,
 
 gmx_bool gmx_fio_ndoe_double(t_fileio* fio, double* item, int n, const char* desc, const char* srcfile, int line)
 {
-    gmx_bool ret = TRUE;
-    int      i;
+    gmx_bool ret;
     gmx_fio_lock(fio);
-    for (i = 0; i < n; i++)
-    {
-        ret = ret && do_xdr(fio, &(item[i]), 1, eioDOUBLE, desc, srcfile, line);
-    }
+    ret = gmx_fio_ndo_bulk<double>(fio, item, n, desc, srcfile, line);
     gmx_fio_unlock(fio);
     return ret;
 }
@@ -660,13 +669,9 @@ gmx_bool gmx_fio_ndoe_gmx_bool(t_fileio* fio, gmx_bool* item, int n, const char*
 
 gmx_bool gmx_fio_ndoe_int(t_fileio* fio, int* item, int n, const char* desc, const char* srcfile, int line)
 {
-    gmx_bool ret = TRUE;
-    int      i;
+    gmx_bool ret;
     gmx_fio_lock(fio);
-    for (i = 0; i < n; i++)
-    {
-        ret = ret && do_xdr(fio, &(item[i]), 1, eioINT, desc, srcfile, line);
-    }
+    ret = gmx_fio_ndo_bulk<int>(fio, item, n, desc, srcfile, line);
     gmx_fio_unlock(fio);
     return ret;
 }
@@ -44,10 +44,13 @@
 #include <cstring>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/fileio/xdr_datatype.h"
 #include "gromacs/fileio/xdrf.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 
 /* This is just for clarity - it can never be anything but 4! */
 #define XDR_INT_SIZE 4
@@ -369,6 +372,476 @@ static void receiveints(int buf[], const int num_of_ints, int num_of_bits, const
     nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
 }
 
+/*____________________________________________________________________________
+ |
+ | compress_coords - compress size 3d coordinates into buf
+ |
+ | Uses ip as scratch space for size*3 ints. On return, minint, maxint and
+ | *firstSmallidx hold the parameters that decompress_coords needs, buf[0]
+ | holds the number of bytes of compressed data, which starts at &buf[3].
+ | Returns 0 when the coordinates can not be represented with this
+ | precision, 1 otherwise.
+ */
+
+static int compress_coords(const float* fp,
+                           int          size,
+                           float        precision,
+                           int*         ip,
+                           int*         buf,
+                           int          minint[],
+                           int          maxint[],
+                           int*         firstSmallidx)
+{
+    int          mindiff, *lip, diff;
+    int          lint1, lint2, lint3, oldlint1, oldlint2, oldlint3, smallidx;
+    int          minidx, maxidx;
+    unsigned     sizeint[3], sizesmall[3], bitsizeint[3], size3, *luip;
+    int          k;
+    int          smallnum, smaller, larger, i, is_small, is_smaller, run, prevrun;
+    const float* lfp;
+    float        lf;
+    int          tmp, *thiscoord, prevcoord[3];
+    unsigned int tmpcoord[30];
+    unsigned int bitsize;
+    int          errval = 1;
+
+    size3         = size * 3;
+    bitsizeint[0] = bitsizeint[1] = bitsizeint[2] = 0;
+    prevcoord[0] = prevcoord[1] = prevcoord[2] = 0;
+
+    /* buf[0-2] are special and do not contain actual data */
+    buf[0] = buf[1] = buf[2] = 0;
+    minint[0] = minint[1] = minint[2] = INT_MAX;
+    maxint[0] = maxint[1] = maxint[2] = INT_MIN;
+    prevrun                           = -1;
+    lfp                               = fp;
+    lip                               = ip;
+    mindiff                           = INT_MAX;
+    oldlint1 = oldlint2 = oldlint3 = 0;
+    while (lfp < fp + size3)
+    {
+        /* find nearest integer */
+        if (*lfp >= 0.0)
+        {
+            lf = *lfp * precision + 0.5;
+        }
+        else
+        {
+            lf = *lfp * precision - 0.5;
+        }
+        if (std::fabs(lf) > maxAbsoluteInt)
+        {
+            /* scaling would cause overflow */
+            errval = 0;
+        }
+        lint1 = static_cast<int>(lf);
+        if (lint1 < minint[0])
+        {
+            minint[0] = lint1;
+        }
+        if (lint1 > maxint[0])
+        {
+            maxint[0] = lint1;
+        }
+        *lip++ = lint1;
+        lfp++;
+        if (*lfp >= 0.0)
+        {
+            lf = *lfp * precision + 0.5;
+        }
+        else
+        {
+            lf = *lfp * precision - 0.5;
+        }
+        if (std::fabs(lf) > maxAbsoluteInt)
+        {
+            /* scaling would cause overflow */
+            errval = 0;
+        }
+        lint2 = static_cast<int>(lf);
+        if (lint2 < minint[1])
+        {
+            minint[1] = lint2;
+        }
+        if (lint2 > maxint[1])
+        {
+            maxint[1] = lint2;
+        }
+        *lip++ = lint2;
+        lfp++;
+        if (*lfp >= 0.0)
+        {
+            lf = *lfp * precision + 0.5;
+        }
+        else
+        {
+            lf = *lfp * precision - 0.5;
+        }
+        if (std::abs(lf) > maxAbsoluteInt)
+        {
+            /* scaling would cause overflow */
+            errval = 0;
+        }
+        lint3 = static_cast<int>(lf);
+        if (lint3 < minint[2])
+        {
+            minint[2] = lint3;
+        }
+        if (lint3 > maxint[2])
+        {
+            maxint[2] = lint3;
+        }
+        *lip++ = lint3;
+        lfp++;
+        diff = std::abs(oldlint1 - lint1) + std::abs(oldlint2 - lint2) + std::abs(oldlint3 - lint3);
+        if (diff < mindiff && lfp > fp + 3)
+        {
+            mindiff = diff;
+        }
+        oldlint1 = lint1;
+        oldlint2 = lint2;
+        oldlint3 = lint3;
+    }
+    if (static_cast<float>(maxint[0]) - static_cast<float>(minint[0]) >= maxAbsoluteInt
+        || static_cast<float>(maxint[1]) - static_cast<float>(minint[1]) >= maxAbsoluteInt
+        || static_cast<float>(maxint[2]) - static_cast<float>(minint[2]) >= maxAbsoluteInt)
+    {
+        /* turning value in unsigned by subtracting minint
+         * would cause overflow
+         */
+        errval = 0;
+    }
+    sizeint[0] = maxint[0] - minint[0] + 1;
+    sizeint[1] = maxint[1] - minint[1] + 1;
+    sizeint[2] = maxint[2] - minint[2] + 1;
+
+    /* check if one of the sizes is to big to be multiplied */
+    if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff)
+    {
+        bitsizeint[0] = sizeofint(sizeint[0]);
+        bitsizeint[1] = sizeofint(sizeint[1]);
+        bitsizeint[2] = sizeofint(sizeint[2]);
+        bitsize       = 0; /* flag the use of large sizes */
+    }
+    else
+    {
+        bitsize = sizeofints(3, sizeint);
+    }
+    luip     = reinterpret_cast<unsigned int*>(ip);
+    smallidx = FIRSTIDX;
+    while (smallidx < LASTIDX && magicints[smallidx] < mindiff)
+    {
+        smallidx++;
+    }
+    *firstSmallidx = smallidx;
+
+    maxidx       = std::min(LASTIDX, smallidx + 8);
+    minidx       = maxidx - 8; /* often this equal smallidx */
+    smaller      = magicints[std::max(FIRSTIDX, smallidx - 1)] / 2;
+    smallnum     = magicints[smallidx] / 2;
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    larger                                     = magicints[maxidx] / 2;
+    i                                          = 0;
+    while (i < size)
+    {
+        is_small  = 0;
+        thiscoord = reinterpret_cast<int*>(luip) + i * 3;
+        if (smallidx < maxidx && i >= 1 && std::abs(thiscoord[0] - prevcoord[0]) < larger
+            && std::abs(thiscoord[1] - prevcoord[1]) < larger
+            && std::abs(thiscoord[2] - prevcoord[2]) < larger)
+        {
+            is_smaller = 1;
+        }
+        else if (smallidx > minidx)
+        {
+            is_smaller = -1;
+        }
+        else
+        {
+            is_smaller = 0;
+        }
+        if (i + 1 < size)
+        {
+            if (std::abs(thiscoord[0] - thiscoord[3]) < smallnum
+                && std::abs(thiscoord[1] - thiscoord[4]) < smallnum
+                && std::abs(thiscoord[2] - thiscoord[5]) < smallnum)
+            {
+                /* interchange first with second atom for better
+                 * compression of water molecules
+                 */
+                tmp          = thiscoord[0];
+                thiscoord[0] = thiscoord[3];
+                thiscoord[3] = tmp;
+                tmp          = thiscoord[1];
+                thiscoord[1] = thiscoord[4];
+                thiscoord[4] = tmp;
+                tmp          = thiscoord[2];
+                thiscoord[2] = thiscoord[5];
+                thiscoord[5] = tmp;
+                is_small     = 1;
+            }
+        }
+        tmpcoord[0] = thiscoord[0] - minint[0];
+        tmpcoord[1] = thiscoord[1] - minint[1];
+        tmpcoord[2] = thiscoord[2] - minint[2];
+        if (bitsize == 0)
+        {
+            sendbits(buf, bitsizeint[0], tmpcoord[0]);
+            sendbits(buf, bitsizeint[1], tmpcoord[1]);
+            sendbits(buf, bitsizeint[2], tmpcoord[2]);
+        }
+        else
+        {
+            sendints(buf, 3, bitsize, sizeint, tmpcoord);
+        }
+        prevcoord[0] = thiscoord[0];
+        prevcoord[1] = thiscoord[1];
+        prevcoord[2] = thiscoord[2];
+        thiscoord    = thiscoord + 3;
+        i++;
+
+        run = 0;
+        if (is_small == 0 && is_smaller == -1)
+        {
+            is_smaller = 0;
+        }
+        while (is_small && run < 8 * 3)
+        {
+            if (is_smaller == -1
+                && (SQR(thiscoord[0] - prevcoord[0]) + SQR(thiscoord[1] - prevcoord[1])
+                            + SQR(thiscoord[2] - prevcoord[2])
+                    >= smaller * smaller))
+            {
+                is_smaller = 0;
+            }
+
+            tmpcoord[run++] = thiscoord[0] - prevcoord[0] + smallnum;
+            tmpcoord[run++] = thiscoord[1] - prevcoord[1] + smallnum;
+            tmpcoord[run++] = thiscoord[2] - prevcoord[2] + smallnum;
+
+            prevcoord[0] = thiscoord[0];
+            prevcoord[1] = thiscoord[1];
+            prevcoord[2] = thiscoord[2];
+
+            i++;
+            thiscoord = thiscoord + 3;
+            is_small  = 0;
+            if (i < size && abs(thiscoord[0] - prevcoord[0]) < smallnum
+                && abs(thiscoord[1] - prevcoord[1]) < smallnum
+                && abs(thiscoord[2] - prevcoord[2]) < smallnum)
+            {
+                is_small = 1;
+            }
+        }
+        if (run != prevrun || is_smaller != 0)
+        {
+            prevrun = run;
+            sendbits(buf, 1, 1); /* flag the change in run-length */
+            sendbits(buf, 5, run + is_smaller + 1);
+        }
+        else
+        {
+            sendbits(buf, 1, 0); /* flag the fact that runlength did not change */
+        }
+        for (k = 0; k < run; k += 3)
+        {
+            sendints(buf, 3, smallidx, sizesmall, &tmpcoord[k]);
+        }
+        if (is_smaller != 0)
+        {
+            smallidx += is_smaller;
+            if (is_smaller < 0)
+            {
+                smallnum = smaller;
+                smaller  = magicints[smallidx - 1] / 2;
+            }
+            else
+            {
+                smaller  = smallnum;
+                smallnum = magicints[smallidx] / 2;
+            }
+            sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+        }
+    }
+    if (buf[1] != 0)
+    {
+        buf[0]++;
+    }
+
+    return errval;
+}
+
+/*____________________________________________________________________________
+ |
+ | decompress_coords - decompress size 3d coordinates from buf
+ |
+ | The inverse of compress_coords. buf[0] should hold the number of bytes of
+ | compressed data, which starts at &buf[3]. Uses ip as scratch space for
+ | size*3 ints.
+ */
+
+static void decompress_coords(int       size,
+                              float     precision,
+                              const int minint[],
+                              const int maxint[],
+                              int       smallidx,
+                              int*      ip,
+                              int*      buf,
+                              float*    fp)
+{
+    int*         lip;
+    unsigned     sizeint[3], sizesmall[3], bitsizeint[3];
+    int          flag, k;
+    int          smallnum, smaller, i, is_smaller, run;
+    float*       lfp;
+    int          tmp, *thiscoord, prevcoord[3];
+    unsigned int bitsize;
+    float        inv_precision;
+
+    bitsizeint[0] = bitsizeint[1] = bitsizeint[2] = 0;
+
+    sizeint[0] = maxint[0] - minint[0] + 1;
+    sizeint[1] = maxint[1] - minint[1] + 1;
+    sizeint[2] = maxint[2] - minint[2] + 1;
+
+    /* check if one of the sizes is to big to be multiplied */
+    if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff)
+    {
+        bitsizeint[0] = sizeofint(sizeint[0]);
+        bitsizeint[1] = sizeofint(sizeint[1]);
+        bitsizeint[2] = sizeofint(sizeint[2]);
+        bitsize       = 0; /* flag the use of large sizes */
+    }
+    else
+    {
+        bitsize = sizeofints(3, sizeint);
+    }
+
+    smaller      = magicints[std::max(FIRSTIDX, smallidx - 1)] / 2;
+    smallnum     = magicints[smallidx] / 2;
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+
+    buf[0] = buf[1] = buf[2] = 0;
+
+    lfp           = fp;
+    inv_precision = 1.0 / precision;
+    run           = 0;
+    i             = 0;
+    lip           = ip;
+    while (i < size)
+    {
+        thiscoord = reinterpret_cast<int*>(lip) + i * 3;
+
+        if (bitsize == 0)
+        {
+            thiscoord[0] = receivebits(buf, bitsizeint[0]);
+            thiscoord[1] = receivebits(buf, bitsizeint[1]);
+            thiscoord[2] = receivebits(buf, bitsizeint[2]);
+        }
+        else
+        {
+            receiveints(buf, 3, bitsize, sizeint, thiscoord);
+        }
+
+        i++;
+        thiscoord[0] += minint[0];
+        thiscoord[1] += minint[1];
+        thiscoord[2] += minint[2];
+
+        prevcoord[0] = thiscoord[0];
+        prevcoord[1] = thiscoord[1];
+        prevcoord[2] = thiscoord[2];
+
+
+        flag       = receivebits(buf, 1);
+        is_smaller = 0;
+        if (flag == 1)
+        {
+            run        = receivebits(buf, 5);
+            is_smaller = run % 3;
+            run -= is_smaller;
+            is_smaller--;
+        }
+        if (run > 0)
+        {
+            thiscoord += 3;
+            for (k = 0; k < run; k += 3)
+            {
+                receiveints(buf, 3, smallidx, sizesmall, thiscoord);
+                i++;
+                thiscoord[0] += prevcoord[0] - smallnum;
+                thiscoord[1] += prevcoord[1] - smallnum;
+                thiscoord[2] += prevcoord[2] - smallnum;
+                if (k == 0)
+                {
+                    /* interchange first with second atom for better
+                     * compression of water molecules
+                     */
+                    tmp          = thiscoord[0];
+                    thiscoord[0] = prevcoord[0];
+                    prevcoord[0] = tmp;
+                    tmp          = thiscoord[1];
+                    thiscoord[1] = prevcoord[1];
+                    prevcoord[1] = tmp;
+                    tmp          = thiscoord[2];
+                    thiscoord[2] = prevcoord[2];
+                    prevcoord[2] = tmp;
+                    *lfp++       = prevcoord[0] * inv_precision;
+                    *lfp++       = prevcoord[1] * inv_precision;
+                    *lfp++       = prevcoord[2] * inv_precision;
+                }
+                else
+                {
+                    prevcoord[0] = thiscoord[0];
+                    prevcoord[1] = thiscoord[1];
+                    prevcoord[2] = thiscoord[2];
+                }
+                *lfp++ = thiscoord[0] * inv_precision;
+                *lfp++ = thiscoord[1] * inv_precision;
+                *lfp++ = thiscoord[2] * inv_precision;
+            }
+        }
+        else
+        {
+            *lfp++ = thiscoord[0] * inv_precision;
+            *lfp++ = thiscoord[1] * inv_precision;
+            *lfp++ = thiscoord[2] * inv_precision;
+        }
+        smallidx += is_smaller;
+        if (is_smaller < 0)
+        {
+            smallnum = smaller;
+            if (smallidx > FIRSTIDX)
+            {
+                smaller = magicints[smallidx - 1] / 2;
+            }
+            else
+            {
+                smaller = 0;
+            }
+        }
+        else if (is_smaller > 0)
+        {
+            smaller  = smallnum;
+            smallnum = magicints[smallidx] / 2;
+        }
+        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    }
+}
+
+/* Read or write the parameters and the size of a compressed coordinate block */
+static int xdr_compressed_coords_header(XDR* xdrs,
+                                        int  minint[],
+                                        int  maxint[],
+                                        int* smallidx,
+                                        int* nbyte)
+{
+    return (xdr_int(xdrs, &(minint[0])) != 0 && xdr_int(xdrs, &(minint[1])) != 0
+            && xdr_int(xdrs, &(minint[2])) != 0 && xdr_int(xdrs, &(maxint[0])) != 0
+            && xdr_int(xdrs, &(maxint[1])) != 0 && xdr_int(xdrs, &(maxint[2])) != 0
+            && xdr_int(xdrs, smallidx) != 0 && xdr_int(xdrs, nbyte) != 0);
+}
+
 /*____________________________________________________________________________
  |
  | xdr3dfcoord - read or write compressed 3d coordinates to xdr file.
@@ -408,25 +881,14 @@ int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision)
     int      prealloc_ip[3 * 16], prealloc_buf[3 * 20];
     int      we_should_free = 0;
 
-    int          minint[3], maxint[3], mindiff, *lip, diff;
-    int          lint1, lint2, lint3, oldlint1, oldlint2, oldlint3, smallidx;
-    int          minidx, maxidx;
-    unsigned     sizeint[3], sizesmall[3], bitsizeint[3], size3, *luip;
-    int          flag, k;
-    int          smallnum, smaller, larger, i, is_small, is_smaller, run, prevrun;
-    float *      lfp, lf;
-    int          tmp, *thiscoord, prevcoord[3];
-    unsigned int tmpcoord[30];
+    int      minint[3], maxint[3], smallidx;
+    unsigned size3;
+    int      i;
+    int      bufsize, lsize;
+    int      errval;
+    int      rc;
 
-    int          bufsize, lsize;
-    unsigned int bitsize;
-    float        inv_precision;
-    int          errval = 1;
-    int          rc;
-
-    bRead         = (xdrs->x_op == XDR_DECODE);
-    bitsizeint[0] = bitsizeint[1] = bitsizeint[2] = 0;
-    prevcoord[0] = prevcoord[1] = prevcoord[2] = 0;
+    bRead = (xdrs->x_op == XDR_DECODE);
 
     // The static analyzer warns about garbage values for thiscoord[] further
     // down. It might be thrown off by all the reinterpret_casts, but we might
@@ -477,286 +939,11 @@ int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision)
                 exit(1);
             }
         }
-        /* buf[0-2] are special and do not contain actual data */
-        buf[0] = buf[1] = buf[2] = 0;
-        minint[0] = minint[1] = minint[2] = INT_MAX;
-        maxint[0] = maxint[1] = maxint[2] = INT_MIN;
-        prevrun                           = -1;
-        lfp                               = fp;
-        lip                               = ip;
-        mindiff                           = INT_MAX;
-        oldlint1 = oldlint2 = oldlint3 = 0;
-        while (lfp < fp + size3)
-        {
-            /* find nearest integer */
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (std::fabs(lf) > maxAbsoluteInt)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint1 = static_cast<int>(lf);
-            if (lint1 < minint[0])
-            {
-                minint[0] = lint1;
-            }
-            if (lint1 > maxint[0])
-            {
-                maxint[0] = lint1;
-            }
-            *lip++ = lint1;
-            lfp++;
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (std::fabs(lf) > maxAbsoluteInt)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint2 = static_cast<int>(lf);
-            if (lint2 < minint[1])
-            {
-                minint[1] = lint2;
-            }
-            if (lint2 > maxint[1])
-            {
-                maxint[1] = lint2;
-            }
-            *lip++ = lint2;
-            lfp++;
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (std::abs(lf) > maxAbsoluteInt)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint3 = static_cast<int>(lf);
-            if (lint3 < minint[2])
-            {
-                minint[2] = lint3;
-            }
-            if (lint3 > maxint[2])
-            {
-                maxint[2] = lint3;
-            }
-            *lip++ = lint3;
-            lfp++;
-            diff = std::abs(oldlint1 - lint1) + std::abs(oldlint2 - lint2) + std::abs(oldlint3 - lint3);
-            if (diff < mindiff && lfp > fp + 3)
-            {
-                mindiff = diff;
-            }
-            oldlint1 = lint1;
-            oldlint2 = lint2;
-            oldlint3 = lint3;
-        }
-        if ((xdr_int(xdrs, &(minint[0])) == 0) || (xdr_int(xdrs, &(minint[1])) == 0)
-            || (xdr_int(xdrs, &(minint[2])) == 0) || (xdr_int(xdrs, &(maxint[0])) == 0)
-            || (xdr_int(xdrs, &(maxint[1])) == 0) || (xdr_int(xdrs, &(maxint[2])) == 0))
-        {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
-        }
-
-        if (static_cast<float>(maxint[0]) - static_cast<float>(minint[0]) >= maxAbsoluteInt
-            || static_cast<float>(maxint[1]) - static_cast<float>(minint[1]) >= maxAbsoluteInt
-            || static_cast<float>(maxint[2]) - static_cast<float>(minint[2]) >= maxAbsoluteInt)
-        {
-            /* turning value in unsigned by subtracting minint
-             * would cause overflow
-             */
-            errval = 0;
-        }
-        sizeint[0] = maxint[0] - minint[0] + 1;
-        sizeint[1] = maxint[1] - minint[1] + 1;
-        sizeint[2] = maxint[2] - minint[2] + 1;
-
-        /* check if one of the sizes is to big to be multiplied */
-        if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff)
-        {
-            bitsizeint[0] = sizeofint(sizeint[0]);
-            bitsizeint[1] = sizeofint(sizeint[1]);
-            bitsizeint[2] = sizeofint(sizeint[2]);
-            bitsize       = 0; /* flag the use of large sizes */
-        }
-        else
-        {
-            bitsize = sizeofints(3, sizeint);
-        }
-        luip     = reinterpret_cast<unsigned int*>(ip);
-        smallidx = FIRSTIDX;
-        while (smallidx < LASTIDX && magicints[smallidx] < mindiff)
-        {
-            smallidx++;
-        }
-        if (xdr_int(xdrs, &smallidx) == 0)
-        {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
-        }
-
-        maxidx       = std::min(LASTIDX, smallidx + 8);
-        minidx       = maxidx - 8; /* often this equal smallidx */
-        smaller      = magicints[std::max(FIRSTIDX, smallidx - 1)] / 2;
-        smallnum     = magicints[smallidx] / 2;
-        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
-        larger                                     = magicints[maxidx] / 2;
-        i                                          = 0;
-        while (i < *size)
-        {
-            is_small  = 0;
-            thiscoord = reinterpret_cast<int*>(luip) + i * 3;
-            if (smallidx < maxidx && i >= 1 && std::abs(thiscoord[0] - prevcoord[0]) < larger
-                && std::abs(thiscoord[1] - prevcoord[1]) < larger
-                && std::abs(thiscoord[2] - prevcoord[2]) < larger)
-            {
-                is_smaller = 1;
-            }
-            else if (smallidx > minidx)
-            {
-                is_smaller = -1;
-            }
-            else
-            {
-                is_smaller = 0;
-            }
-            if (i + 1 < *size)
-            {
-                if (std::abs(thiscoord[0] - thiscoord[3]) < smallnum
-                    && std::abs(thiscoord[1] - thiscoord[4]) < smallnum
-                    && std::abs(thiscoord[2] - thiscoord[5]) < smallnum)
-                {
-                    /* interchange first with second atom for better
-                     * compression of water molecules
-                     */
-                    tmp          = thiscoord[0];
-                    thiscoord[0] = thiscoord[3];
-                    thiscoord[3] = tmp;
-                    tmp          = thiscoord[1];
-                    thiscoord[1] = thiscoord[4];
-                    thiscoord[4] = tmp;
-                    tmp          = thiscoord[2];
-                    thiscoord[2] = thiscoord[5];
-                    thiscoord[5] = tmp;
-                    is_small     = 1;
-                }
-            }
-            tmpcoord[0] = thiscoord[0] - minint[0];
-            tmpcoord[1] = thiscoord[1] - minint[1];
-            tmpcoord[2] = thiscoord[2] - minint[2];
-            if (bitsize == 0)
-            {
-                sendbits(buf, bitsizeint[0], tmpcoord[0]);
-                sendbits(buf, bitsizeint[1], tmpcoord[1]);
-                sendbits(buf, bitsizeint[2], tmpcoord[2]);
-            }
-            else
-            {
-                sendints(buf, 3, bitsize, sizeint, tmpcoord);
-            }
-            prevcoord[0] = thiscoord[0];
-            prevcoord[1] = thiscoord[1];
-            prevcoord[2] = thiscoord[2];
-            thiscoord    = thiscoord + 3;
-            i++;
 
-            run = 0;
-            if (is_small == 0 && is_smaller == -1)
-            {
-                is_smaller = 0;
-            }
-            while (is_small && run < 8 * 3)
-            {
-                if (is_smaller == -1
-                    && (SQR(thiscoord[0] - prevcoord[0]) + SQR(thiscoord[1] - prevcoord[1])
-                                + SQR(thiscoord[2] - prevcoord[2])
-                        >= smaller * smaller))
-                {
-                    is_smaller = 0;
-                }
+        errval = compress_coords(fp, *size, *precision, ip, buf, minint, maxint, &smallidx);
 
-                tmpcoord[run++] = thiscoord[0] - prevcoord[0] + smallnum;
-                tmpcoord[run++] = thiscoord[1] - prevcoord[1] + smallnum;
-                tmpcoord[run++] = thiscoord[2] - prevcoord[2] + smallnum;
-
-                prevcoord[0] = thiscoord[0];
-                prevcoord[1] = thiscoord[1];
-                prevcoord[2] = thiscoord[2];
-
-                i++;
-                thiscoord = thiscoord + 3;
-                is_small  = 0;
-                if (i < *size && abs(thiscoord[0] - prevcoord[0]) < smallnum
-                    && abs(thiscoord[1] - prevcoord[1]) < smallnum
-                    && abs(thiscoord[2] - prevcoord[2]) < smallnum)
-                {
-                    is_small = 1;
-                }
-            }
-            if (run != prevrun || is_smaller != 0)
-            {
-                prevrun = run;
-                sendbits(buf, 1, 1); /* flag the change in run-length */
-                sendbits(buf, 5, run + is_smaller + 1);
-            }
-            else
-            {
-                sendbits(buf, 1, 0); /* flag the fact that runlength did not change */
-            }
-            for (k = 0; k < run; k += 3)
-            {
-                sendints(buf, 3, smallidx, sizesmall, &tmpcoord[k]);
-            }
-            if (is_smaller != 0)
-            {
-                smallidx += is_smaller;
-                if (is_smaller < 0)
-                {
-                    smallnum = smaller;
-                    smaller  = magicints[smallidx - 1] / 2;
-                }
-                else
-                {
-                    smaller  = smallnum;
-                    smallnum = magicints[smallidx] / 2;
-                }
-                sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
-            }
-        }
-        if (buf[1] != 0)
-        {
-            buf[0]++;
-        }
         /* buf[0] holds the length in bytes */
-        if (xdr_int(xdrs, &(buf[0])) == 0)
+        if (xdr_compressed_coords_header(xdrs, minint, maxint, &smallidx, &(buf[0])) == 0)
         {
             if (we_should_free)
             {
@@ -766,7 +953,6 @@ int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision)
             return 0;
         }
 
-
         rc = errval
              * (xdr_opaque(xdrs, reinterpret_cast<char*>(&(buf[3])), static_cast<unsigned int>(buf[0])));
         if (we_should_free)
@@ -824,11 +1010,8 @@ int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision)
             }
         }
 
-        buf[0] = buf[1] = buf[2] = 0;
-
-        if ((xdr_int(xdrs, &(minint[0])) == 0) || (xdr_int(xdrs, &(minint[1])) == 0)
-            || (xdr_int(xdrs, &(minint[2])) == 0) || (xdr_int(xdrs, &(maxint[0])) == 0)
-            || (xdr_int(xdrs, &(maxint[1])) == 0) || (xdr_int(xdrs, &(maxint[2])) == 0))
+        /* buf[0] holds the length in bytes */
+        if (xdr_compressed_coords_header(xdrs, minint, maxint, &smallidx, &(buf[0])) == 0)
         {
             if (we_should_free)
             {
@@ -838,24 +1021,7 @@ int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision)
             return 0;
         }
 
-        sizeint[0] = maxint[0] - minint[0] + 1;
-        sizeint[1] = maxint[1] - minint[1] + 1;
-        sizeint[2] = maxint[2] - minint[2] + 1;
-
-        /* check if one of the sizes is to big to be multiplied */
-        if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff)
-        {
-            bitsizeint[0] = sizeofint(sizeint[0]);
-            bitsizeint[1] = sizeofint(sizeint[1]);
-            bitsizeint[2] = sizeofint(sizeint[2]);
-            bitsize       = 0; /* flag the use of large sizes */
-        }
-        else
-        {
-            bitsize = sizeofints(3, sizeint);
-        }
-
-        if (xdr_int(xdrs, &smallidx) == 0)
+        if (xdr_opaque(xdrs, reinterpret_cast<char*>(&(buf[3])), static_cast<unsigned int>(buf[0])) == 0)
         {
             if (we_should_free)
             {
@@ -865,147 +1031,178 @@ int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision)
             return 0;
         }
 
-        smaller      = magicints[std::max(FIRSTIDX, smallidx - 1)] / 2;
-        smallnum     = magicints[smallidx] / 2;
-        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+        decompress_coords(*size, *precision, minint, maxint, smallidx, ip, buf, fp);
+    }
+    if (we_should_free)
+    {
+        free(ip);
+        free(buf);
+    }
+    return 1;
+}
 
-        /* buf[0] holds the length in bytes */
+/*! \brief A block of compressed coordinates in a chunked XTC frame */
+struct CompressedCoordinatesChunk
+{
+    //! Minimum of the integer coordinates
+    int minint[3];
+    //! Maximum of the integer coordinates
+    int maxint[3];
+    //! The initial index for small differences
+    int smallidx;
+    //! Whether the coordinates could be represented with the precision
+    int errval = 1;
+    //! Bit-packing buffer, buf[0] holds the number of bytes, which start at buf[3]
+    std::vector<int> buf;
+};
 
-        if (xdr_int(xdrs, &(buf[0])) == 0)
-        {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
-        }
+//! Returns the first atom of chunk \p chunk when \p size atoms are divided over \p numChunks chunks
+static int chunkStart(int size, int numChunks, int chunk)
+{
+    return static_cast<int>((static_cast<int64_t>(size) * chunk) / numChunks);
+}
 
+//! Returns the size of the bit-packing buffer in ints for \p size coordinate triplets
+static int compressionBufferSize(int size)
+{
+    return std::max(static_cast<int>(size * 3 * 1.2), 3 * 20);
+}
 
-        if (xdr_opaque(xdrs, reinterpret_cast<char*>(&(buf[3])), static_cast<unsigned int>(buf[0])) == 0)
+/*____________________________________________________________________________
+ |
+ | xdr3dfcoord_chunked - read or write compressed 3d coordinates in chunks
+ |
+ | The same as xdr3dfcoord, but the coordinates are divided into chunks of
+ | at least atomsPerChunk atoms that are compressed independently, using
+ | OpenMP threads. When reading, the number of chunks is read from the file
+ | and atomsPerChunk is not used. After the number of atoms and the
+ | precision, the number of chunks is stored, followed by the data of each
+ | chunk in the same layout as the compressed data of xdr3dfcoord.
+ */
+
+int xdr3dfcoord_chunked(XDR* xdrs, float* fp, int* size, float* precision, int atomsPerChunk)
+{
+    const gmx_bool bRead = (xdrs->x_op == XDR_DECODE);
+    int            lsize = *size;
+    int            numChunks;
+
+    if (xdr_int(xdrs, &lsize) == 0)
+    {
+        return 0;
+    }
+    if (bRead && *size != 0 && lsize != *size)
+    {
+        fprintf(stderr,
+                "wrong number of coordinates in xdr3dfcoord_chunked; "
+                "%d arg vs %d in file",
+                *size, lsize);
+    }
+    *size = lsize;
+    /* when the number of coordinates is small, don't try to compress */
+    if (*size <= 9)
+    {
+        if (bRead)
         {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
+            *precision = -1;
         }
+        return (xdr_vector(xdrs, reinterpret_cast<char*>(fp), static_cast<unsigned int>(*size * 3),
+                           static_cast<unsigned int>(sizeof(*fp)),
+                           reinterpret_cast<xdrproc_t>(xdr_float)));
+    }
+    if (xdr_float(xdrs, precision) == 0)
+    {
+        return 0;
+    }
 
+    if (!bRead)
+    {
+        /* Each chunk needs more than 9 atoms to be compressed */
+        numChunks = std::max(1, *size / std::max(atomsPerChunk, 10));
+    }
+    if (xdr_int(xdrs, &numChunks) == 0 || numChunks < 1 || numChunks > *size / 10)
+    {
+        return 0;
+    }
 
-        buf[0] = buf[1] = buf[2] = 0;
+    std::vector<CompressedCoordinatesChunk> chunks(numChunks);
+    const int numThreads = std::min(gmx_omp_get_max_threads(), numChunks);
 
-        lfp           = fp;
-        inv_precision = 1.0 / *precision;
-        run           = 0;
-        i             = 0;
-        lip           = ip;
-        while (i < lsize)
+    if (!bRead)
+    {
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+        for (int c = 0; c < numChunks; c++)
         {
-            thiscoord = reinterpret_cast<int*>(lip) + i * 3;
-
-            if (bitsize == 0)
-            {
-                thiscoord[0] = receivebits(buf, bitsizeint[0]);
-                thiscoord[1] = receivebits(buf, bitsizeint[1]);
-                thiscoord[2] = receivebits(buf, bitsizeint[2]);
-            }
-            else
+            try
             {
-                receiveints(buf, 3, bitsize, sizeint, thiscoord);
-            }
-
-            i++;
-            thiscoord[0] += minint[0];
-            thiscoord[1] += minint[1];
-            thiscoord[2] += minint[2];
-
-            prevcoord[0] = thiscoord[0];
-            prevcoord[1] = thiscoord[1];
-            prevcoord[2] = thiscoord[2];
+                CompressedCoordinatesChunk& chunk = chunks[c];
+                const int                   start = chunkStart(*size, numChunks, c);
+                const int        chunkSize = chunkStart(*size, numChunks, c + 1) - start;
+                std::vector<int> ip(chunkSize * 3);
 
-
-            flag       = receivebits(buf, 1);
-            is_smaller = 0;
-            if (flag == 1)
-            {
-                run        = receivebits(buf, 5);
-                is_smaller = run % 3;
-                run -= is_smaller;
-                is_smaller--;
-            }
-            if (run > 0)
-            {
-                thiscoord += 3;
-                for (k = 0; k < run; k += 3)
-                {
-                    receiveints(buf, 3, smallidx, sizesmall, thiscoord);
-                    i++;
-                    thiscoord[0] += prevcoord[0] - smallnum;
-                    thiscoord[1] += prevcoord[1] - smallnum;
-                    thiscoord[2] += prevcoord[2] - smallnum;
-                    if (k == 0)
-                    {
-                        /* interchange first with second atom for better
-                         * compression of water molecules
-                         */
-                        tmp          = thiscoord[0];
-                        thiscoord[0] = prevcoord[0];
-                        prevcoord[0] = tmp;
-                        tmp          = thiscoord[1];
-                        thiscoord[1] = prevcoord[1];
-                        prevcoord[1] = tmp;
-                        tmp          = thiscoord[2];
-                        thiscoord[2] = prevcoord[2];
-                        prevcoord[2] = tmp;
-                        *lfp++       = prevcoord[0] * inv_precision;
-                        *lfp++       = prevcoord[1] * inv_precision;
-                        *lfp++       = prevcoord[2] * inv_precision;
-                    }
-                    else
-                    {
-                        prevcoord[0] = thiscoord[0];
-                        prevcoord[1] = thiscoord[1];
-                        prevcoord[2] = thiscoord[2];
-                    }
-                    *lfp++ = thiscoord[0] * inv_precision;
-                    *lfp++ = thiscoord[1] * inv_precision;
-                    *lfp++ = thiscoord[2] * inv_precision;
-                }
+                chunk.buf.resize(compressionBufferSize(chunkSize));
+                chunk.errval = compress_coords(fp + start * 3, chunkSize, *precision, ip.data(),
+                                               chunk.buf.data(), chunk.minint, chunk.maxint,
+                                               &chunk.smallidx);
             }
-            else
-            {
-                *lfp++ = thiscoord[0] * inv_precision;
-                *lfp++ = thiscoord[1] * inv_precision;
-                *lfp++ = thiscoord[2] * inv_precision;
-            }
-            smallidx += is_smaller;
-            if (is_smaller < 0)
-            {
-                smallnum = smaller;
-                if (smallidx > FIRSTIDX)
-                {
-                    smaller = magicints[smallidx - 1] / 2;
-                }
-                else
-                {
-                    smaller = 0;
-                }
-            }
-            else if (is_smaller > 0)
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
+    }
+
+    int errval = 1;
+    for (int c = 0; c < numChunks; c++)
+    {
+        CompressedCoordinatesChunk& chunk = chunks[c];
+        int                         nbyte = 0;
+        if (!bRead)
+        {
+            nbyte = chunk.buf[0];
+        }
+        if (xdr_compressed_coords_header(xdrs, chunk.minint, chunk.maxint, &chunk.smallidx, &nbyte)
+            == 0)
+        {
+            return 0;
+        }
+        if (bRead)
+        {
+            const int chunkSize =
+                    chunkStart(*size, numChunks, c + 1) - chunkStart(*size, numChunks, c);
+            chunk.buf.resize(compressionBufferSize(chunkSize));
+            if (nbyte < 0 || nbyte > (static_cast<int>(chunk.buf.size()) - 3) * XDR_INT_SIZE
+                || chunk.smallidx < FIRSTIDX || chunk.smallidx >= LASTIDX)
             {
-                smaller  = smallnum;
-                smallnum = magicints[smallidx] / 2;
+                return 0;
             }
-            sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+            chunk.buf[0] = nbyte;
         }
+        if (xdr_opaque(xdrs, reinterpret_cast<char*>(&(chunk.buf[3])),
+                       static_cast<unsigned int>(nbyte))
+            == 0)
+        {
+            return 0;
+        }
+        errval *= chunk.errval;
     }
-    if (we_should_free)
+
+    if (bRead)
     {
-        free(ip);
-        free(buf);
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+        for (int c = 0; c < numChunks; c++)
+        {
+            try
+            {
+                CompressedCoordinatesChunk& chunk = chunks[c];
+                const int                   start = chunkStart(*size, numChunks, c);
+                const int        chunkSize = chunkStart(*size, numChunks, c + 1) - start;
+                std::vector<int> ip(chunkSize * 3);
+
+                decompress_coords(chunkSize, *precision, chunk.minint, chunk.maxint,
+                                  chunk.smallidx, ip.data(), chunk.buf.data(), fp + start * 3);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
     }
-    return 1;
+
+    return errval;
 }
 
 
@@ -1021,6 +1218,8 @@ int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision)
    The second 4 bytes are the number of atoms in the frame, and is
    assumed to be constant. The third 4 bytes are the frame number.
    The last 4 bytes are a floating point representation of the time.
+   Frames with chunked coordinates, see xdr3dfcoord_chunked, have the
+   same header, but with magic number 2022 (0x000007E6).
 
  ********************************************************************/
 
@@ -1028,6 +1227,9 @@ int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision)
 #ifndef XTC_MAGIC
 #    define XTC_MAGIC 1995
 #endif
+#ifndef XTC_CHUNKED_MAGIC
+#    define XTC_CHUNKED_MAGIC 2022
+#endif
 
 static const int header_size = 16;
 
@@ -1055,7 +1257,7 @@ static int xtc_at_header_start(FILE* fp, XDR* xdrs, int natoms, int* timestep, f
         }
     }
     /* quick return */
-    if (i_inp[0] != XTC_MAGIC)
+    if (i_inp[0] != XTC_MAGIC && i_inp[0] != XTC_CHUNKED_MAGIC)
     {
         if (gmx_fseek(fp, off + XDR_INT_SIZE, SEEK_SET))
         {
@@ -0,0 +1,272 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for energy column files.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/energycolumns.h"
+
+#include <cmath>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/enxio.h"
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/trajectory/energyframe.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of energy terms in the test files
+const int c_numTerms = 3;
+
+/*! \brief Writes \p numFrames frames to \p filename, starting at frame \p firstFrame
+ *
+ * Frame i has step 10*i and time 0.02*i. When opening with mode "w",
+ * the names of the energy terms are also written.
+ *
+ * \returns The offsets in the energy file after each frame.
+ */
+std::vector<gmx_off_t> writeFrames(const std::string& filename,
+                                   const char*        mode,
+                                   int                firstFrame,
+                                   int                numFrames,
+                                   bool               withColumns)
+{
+    ener_file_t energyFile = open_enx(filename.c_str(), mode);
+    if (withColumns)
+    {
+        enx_enable_columns(energyFile, mode[0] == 'a');
+    }
+    if (mode[0] == 'w')
+    {
+        char        names[c_numTerms][10] = { "Potential", "Pressure", "Volume" };
+        char        units[c_numTerms][10] = { "kJ/mol", "bar", "nm^3" };
+        gmx_enxnm_t enm[c_numTerms];
+        for (int i = 0; i < c_numTerms; i++)
+        {
+            enm[i].name = names[i];
+            enm[i].unit = units[i];
+        }
+        int          numTerms = c_numTerms;
+        gmx_enxnm_t* enmPtr   = enm;
+        do_enxnms(energyFile, &numTerms, &enmPtr);
+    }
+
+    std::vector<gmx_off_t> offsets;
+    std::vector<t_energy>  energies(c_numTerms);
+    t_enxframe             fr;
+    init_enxframe(&fr);
+    fr.nre  = c_numTerms;
+    fr.ener = energies.data();
+    for (int frame = firstFrame; frame < firstFrame + numFrames; frame++)
+    {
+        fr.step   = 10 * frame;
+        fr.t      = 0.02 * frame;
+        fr.nsteps = (frame == 0 ? 1 : 10);
+        fr.nsum   = (frame == 0 ? 1 : 10);
+        for (int i = 0; i < c_numTerms; i++)
+        {
+            energies[i].e    = -1000 * (i + 1) + std::sin(0.1 * frame + i);
+            energies[i].eav  = 0.5 * frame + i;
+            energies[i].esum = -10000 * (i + 1) + 0.25 * frame;
+        }
+        do_enx(energyFile, &fr);
+        offsets.push_back(gmx_fio_ftell(enx_file_pointer(energyFile)));
+    }
+    done_ener_file(energyFile);
+
+    return offsets;
+}
+
+//! Returns all frames of \p filename read with do_enx
+std::vector<t_enxframe> readFrames(const std::string& filename)
+{
+    ener_file_t  energyFile = open_enx(filename.c_str(), "r");
+    int          numTerms   = 0;
+    gmx_enxnm_t* enm        = nullptr;
+    do_enxnms(energyFile, &numTerms, &enm);
+    free_enxnms(numTerms, enm);
+
+    std::vector<t_enxframe> frames;
+    t_enxframe              fr;
+    init_enxframe(&fr);
+    while (do_enx(energyFile, &fr))
+    {
+        frames.push_back(fr);
+        snew(frames.back().ener, fr.nre);
+        std::copy(fr.ener, fr.ener + fr.nre, frames.back().ener);
+    }
+    free_enxframe(&fr);
+    done_ener_file(energyFile);
+
+    return frames;
+}
+
+//! Frees the energies of \p frames
+void freeFrames(std::vector<t_enxframe>* frames)
+{
+    for (t_enxframe& fr : *frames)
+    {
+        sfree(fr.ener);
+    }
+}
+
+//! Test fixture for energy column files
+class EnergyColumnsTest : public TemporaryFileTest<>
+{
+public:
+    EnergyColumnsTest() : TemporaryFileTest("ener.edr") {}
+
+    ~EnergyColumnsTest() override { std::remove(energyColumnFileName(filename_).c_str()); }
+};
+
+TEST_F(EnergyColumnsTest, ReadsSelectedTermsAsInEnergyFile)
+{
+    writeFrames(filename_, "w", 0, 2500, true);
+    std::vector<t_enxframe> frames = readFrames(filename_);
+    ASSERT_EQ(2500, frames.size());
+
+    auto reader = EnergyColumnReader::open(filename_);
+    ASSERT_NE(nullptr, reader);
+    ASSERT_EQ(c_numTerms, reader->termNames().size());
+    EXPECT_EQ("Pressure", reader->termNames()[1]);
+    EXPECT_EQ(2500, reader->numFrames());
+
+    const std::vector<int> terms = { 2, 0 };
+    reader->selectTerms(terms);
+    t_enxframe fr;
+    init_enxframe(&fr);
+    for (const t_enxframe& expected : frames)
+    {
+        ASSERT_TRUE(reader->readNextFrame(&fr));
+        EXPECT_EQ(expected.step, fr.step);
+        EXPECT_EQ(expected.t, fr.t);
+        EXPECT_EQ(expected.nsteps, fr.nsteps);
+        EXPECT_EQ(expected.nsum, fr.nsum);
+        ASSERT_EQ(c_numTerms, fr.nre);
+        for (const int term : terms)
+        {
+            EXPECT_EQ(expected.ener[term].e, fr.ener[term].e);
+            if (expected.nsum > 1)
+            {
+                EXPECT_EQ(expected.ener[term].eav, fr.ener[term].eav);
+                EXPECT_EQ(expected.ener[term].esum, fr.ener[term].esum);
+            }
+        }
+        // Terms that were not selected are not read
+        EXPECT_EQ(0, fr.ener[1].e);
+    }
+    EXPECT_FALSE(reader->readNextFrame(&fr));
+    free_enxframe(&fr);
+    freeFrames(&frames);
+}
+
+TEST_F(EnergyColumnsTest, SkipsChunksBeforeTime)
+{
+    writeFrames(filename_, "w", 0, 2500, true);
+
+    auto reader = EnergyColumnReader::open(filename_);
+    ASSERT_NE(nullptr, reader);
+    reader->skipToTime(30);
+    t_enxframe fr;
+    init_enxframe(&fr);
+    ASSERT_TRUE(reader->readNextFrame(&fr));
+    // Frame 1500 at time 30 is in the second chunk
+    EXPECT_EQ(10000, fr.step);
+    free_enxframe(&fr);
+}
+
+TEST_F(EnergyColumnsTest, IsIgnoredAfterEnergyFileIsModified)
+{
+    writeFrames(filename_, "w", 0, 5, true);
+    EXPECT_NE(nullptr, EnergyColumnReader::open(filename_));
+
+    writeFrames(filename_, "a", 5, 1, false);
+    EXPECT_EQ(nullptr, EnergyColumnReader::open(filename_));
+}
+
+TEST_F(EnergyColumnsTest, IsContinuedWhenAppendingToTruncatedEnergyFile)
+{
+    const std::vector<gmx_off_t> offsets = writeFrames(filename_, "w", 0, 1500, true);
+    // Truncate as mdrun does when appending from a checkpoint,
+    // this removes frames from the last chunk and keeps the first chunk
+    ASSERT_EQ(0, gmx_truncate(filename_, offsets[1199]));
+    writeFrames(filename_, "a", 1200, 100, true);
+
+    auto reader = EnergyColumnReader::open(filename_);
+    ASSERT_NE(nullptr, reader);
+    EXPECT_EQ(1300, reader->numFrames());
+    const std::vector<int> terms = { 1 };
+    reader->selectTerms(terms);
+    t_enxframe fr;
+    init_enxframe(&fr);
+    for (int frame = 0; frame < 1300; frame++)
+    {
+        ASSERT_TRUE(reader->readNextFrame(&fr));
+        EXPECT_EQ(10 * frame, fr.step);
+    }
+    EXPECT_FALSE(reader->readNextFrame(&fr));
+    free_enxframe(&fr);
+}
+
+TEST_F(EnergyColumnsTest, IsRebuiltWhenAppendingWithoutColumnFile)
+{
+    writeFrames(filename_, "w", 0, 20, false);
+    writeFrames(filename_, "a", 20, 5, true);
+
+    auto reader = EnergyColumnReader::open(filename_);
+    ASSERT_NE(nullptr, reader);
+    EXPECT_EQ(25, reader->numFrames());
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -49,7 +49,9 @@
 #include <gtest/gtest.h>
 
 #include "gromacs/utility/path.h"
+#include "gromacs/utility/real.h"
 
+#include "testutils/setenv.h"
 #include "testutils/simulationdatabase.h"
 #include "testutils/testfilemanager.h"
 
@@ -76,4 +78,37 @@ TEST_F(TngTest, CloseBeforeOpenIsNotFatal)
     gmx_tng_close(&tng);
 }
 
+TEST_F(TngTest, FrameSetsHave100FramesForSmallSystems)
+{
+    EXPECT_EQ(100, gmx_tng_frames_per_frame_set(1, 1));
+    EXPECT_EQ(100, gmx_tng_frames_per_frame_set(10000, 3));
+    // Invalid sizes are treated like a single atom or block
+    EXPECT_EQ(100, gmx_tng_frames_per_frame_set(0, 0));
+}
+
+TEST_F(TngTest, FrameSetsAreLimitedTo512MiBForLargeSystems)
+{
+    const long maxBytes = 512L * 1024 * 1024;
+    const int  numAtoms = 10000000;
+    EXPECT_EQ(static_cast<int>(maxBytes / (numAtoms * 3 * sizeof(real))),
+              gmx_tng_frames_per_frame_set(numAtoms, 1));
+    EXPECT_EQ(static_cast<int>(maxBytes / (3 * numAtoms * 3 * sizeof(real))),
+              gmx_tng_frames_per_frame_set(numAtoms, 3));
+    // A frame set always contains at least one frame
+    EXPECT_EQ(1, gmx_tng_frames_per_frame_set(100000000, 3));
+}
+
+TEST_F(TngTest, FramesPerFrameSetCanBeSetInEnvironment)
+{
+    gmx::test::gmxSetenv("GMX_TNG_FRAMES_PER_FRAME_SET", "7", 1);
+    EXPECT_EQ(7, gmx_tng_frames_per_frame_set(1, 1));
+    EXPECT_EQ(7, gmx_tng_frames_per_frame_set(100000000, 3));
+    // Values that are not positive numbers are ignored
+    gmx::test::gmxSetenv("GMX_TNG_FRAMES_PER_FRAME_SET", "0", 1);
+    EXPECT_EQ(100, gmx_tng_frames_per_frame_set(1, 1));
+    gmx::test::gmxSetenv("GMX_TNG_FRAMES_PER_FRAME_SET", "many", 1);
+    EXPECT_EQ(100, gmx_tng_frames_per_frame_set(1, 1));
+    gmx::test::gmxUnsetenv("GMX_TNG_FRAMES_PER_FRAME_SET");
+}
+
 } // namespace
@@ -0,0 +1,254 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for reading and writing TPR files.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/tpxio.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/state.h"
+#include "gromacs/topology/topology.h"
+
+#include "testutils/testfilemanager.h"
+#include "testutils/tprfilegenerator.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Checks that the topologies \p reference and \p test describe the same system
+void compareTopologies(const gmx_mtop_t& reference, const gmx_mtop_t& test)
+{
+    EXPECT_STREQ(*reference.name, *test.name);
+    EXPECT_EQ(reference.natoms, test.natoms);
+    EXPECT_EQ(reference.moltype.size(), test.moltype.size());
+    EXPECT_EQ(reference.molblock.size(), test.molblock.size());
+    EXPECT_EQ(reference.ffparams.numTypes(), test.ffparams.numTypes());
+}
+
+//! Checks that the input records \p reference and \p test have the same main parameters
+void compareInputrecs(const t_inputrec& reference, const t_inputrec& test)
+{
+    EXPECT_EQ(reference.eI, test.eI);
+    EXPECT_EQ(reference.nsteps, test.nsteps);
+    EXPECT_EQ(reference.delta_t, test.delta_t);
+    EXPECT_EQ(reference.pbcType, test.pbcType);
+    EXPECT_EQ(reference.rlist, test.rlist);
+    EXPECT_EQ(reference.opts.ngtc, test.opts.ngtc);
+}
+
+//! Checks that \p box equals \p referenceBox
+void compareBoxes(const matrix referenceBox, const matrix box)
+{
+    for (int d = 0; d < DIM; d++)
+    {
+        for (int e = 0; e < DIM; e++)
+        {
+            EXPECT_EQ(referenceBox[d][e], box[d][e]);
+        }
+    }
+}
+
+//! Checks that the states \p reference and \p test have the same box and coordinates
+void compareStates(const t_state& reference, const t_state& test)
+{
+    ASSERT_EQ(reference.natoms, test.natoms);
+    compareBoxes(reference.box, test.box);
+    for (int i = 0; i < reference.natoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_EQ(reference.x[i][d], test.x[i][d]);
+        }
+    }
+}
+
+//! Test fixture with a TPR file generated by grompp
+class TpxIOTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() { s_tprFileHandle = new TprAndFileManager("lysozyme"); }
+
+    static void TearDownTestCase()
+    {
+        delete s_tprFileHandle;
+        s_tprFileHandle = nullptr;
+    }
+
+    //! Checks partial reads of \p filename against a full read
+    static void checkPartialReads(const std::string& filename)
+    {
+        t_inputrec ir;
+        t_state    state;
+        gmx_mtop_t mtop;
+        read_tpx_state(filename.c_str(), &ir, &state, &mtop);
+
+        // Topology and parameters without a state
+        {
+            t_inputrec partialIr;
+            gmx_mtop_t partialMtop;
+            int        natoms = -1;
+            read_tpx(filename.c_str(), &partialIr, nullptr, &natoms, nullptr, nullptr,
+                     &partialMtop);
+            compareInputrecs(ir, partialIr);
+            compareTopologies(mtop, partialMtop);
+            EXPECT_EQ(mtop.natoms, natoms);
+        }
+        // Only the parameters, as used by gmx energy and gmx awh
+        {
+            t_inputrec partialIr;
+            read_tpx(filename.c_str(), &partialIr, nullptr, nullptr, nullptr, nullptr, nullptr);
+            compareInputrecs(ir, partialIr);
+        }
+        // Box and coordinates without a topology
+        {
+            matrix            box;
+            std::vector<RVec> x(state.natoms);
+            read_tpx(filename.c_str(), nullptr, box, nullptr, as_rvec_array(x.data()), nullptr,
+                     nullptr);
+            compareBoxes(state.box, box);
+            for (int i = 0; i < state.natoms; i++)
+            {
+                EXPECT_EQ(state.x[i][XX], x[i][XX]);
+                EXPECT_EQ(state.x[i][YY], x[i][YY]);
+                EXPECT_EQ(state.x[i][ZZ], x[i][ZZ]);
+            }
+        }
+    }
+
+    //! Checks that the body for communication to other ranks has the topology and parameters
+    static void checkCommunicatedBody(const std::string& filename)
+    {
+        t_inputrec                 ir;
+        t_state                    state;
+        gmx_mtop_t                 mtop;
+        PartialDeserializedTprFile partialDeserializedTpr =
+                read_tpx_state(filename.c_str(), &ir, &state, &mtop);
+
+        // The box and coordinate sections are not communicated
+        const TpxFileHeader& header = partialDeserializedTpr.header;
+        EXPECT_FALSE(header.bBox);
+        EXPECT_FALSE(header.bX);
+        EXPECT_FALSE(header.bV);
+        EXPECT_EQ(0, header.topologyOffset);
+        EXPECT_EQ(header.coordinatesOffset, header.parametersOffset);
+        EXPECT_EQ(static_cast<int64_t>(partialDeserializedTpr.body.size()), header.sizeOfTprBody);
+
+        t_inputrec communicatedIr;
+        gmx_mtop_t communicatedMtop;
+        completeTprDeserialization(&partialDeserializedTpr, &communicatedIr, &communicatedMtop);
+        compareInputrecs(ir, communicatedIr);
+        compareTopologies(mtop, communicatedMtop);
+    }
+
+    //! Checks that writing the contents of \p filename and reading them back gives the same system
+    void checkRoundTrip(const std::string& filename)
+    {
+        t_inputrec ir;
+        t_state    state;
+        gmx_mtop_t mtop;
+        read_tpx_state(filename.c_str(), &ir, &state, &mtop);
+
+        const std::string copyName = fileManager_.getTemporaryFilePath("copy.tpr");
+        write_tpx_state(copyName.c_str(), &ir, &state, &mtop);
+
+        const TpxFileHeader header = readTpxHeader(copyName.c_str(), false);
+        EXPECT_GT(header.topologyOffset, 0);
+        EXPECT_GT(header.coordinatesOffset, header.topologyOffset);
+        EXPECT_GT(header.parametersOffset, header.coordinatesOffset);
+
+        t_inputrec copyIr;
+        t_state    copyState;
+        gmx_mtop_t copyMtop;
+        read_tpx_state(copyName.c_str(), &copyIr, &copyState, &copyMtop);
+        compareInputrecs(ir, copyIr);
+        compareStates(state, copyState);
+        compareTopologies(mtop, copyMtop);
+
+        checkPartialReads(copyName);
+        checkCommunicatedBody(copyName);
+    }
+
+    //! Manages the written files
+    TestFileManager fileManager_;
+    //! The TPR file generated by grompp
+    static TprAndFileManager* s_tprFileHandle;
+};
+
+TprAndFileManager* TpxIOTest::s_tprFileHandle = nullptr;
+
+TEST_F(TpxIOTest, ReadsPartsOfFile)
+{
+    checkPartialReads(s_tprFileHandle->tprName());
+}
+
+TEST_F(TpxIOTest, CommunicatesTopologyAndParameters)
+{
+    checkCommunicatedBody(s_tprFileHandle->tprName());
+}
+
+TEST_F(TpxIOTest, RoundTripGivesTheSameSystem)
+{
+    checkRoundTrip(s_tprFileHandle->tprName());
+}
+
+TEST_F(TpxIOTest, ReadsFileWithoutSectionOffsets)
+{
+    const std::string filename = TestFileManager::getInputFilePath("version2016.tpr");
+    EXPECT_EQ(0, readTpxHeader(filename.c_str(), false).parametersOffset);
+
+    checkPartialReads(filename);
+    checkCommunicatedBody(filename);
+    checkRoundTrip(filename);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,279 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for frame index files of XTC and TRR trajectories.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/trajectoryframeindex.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/oenv.h"
+#include "gromacs/fileio/timecontrol.h"
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+#include "gromacs/utility/futil.h"
+
+#include "testutils/testfilemanager.h"
+#include "testutils/trajectoryfilegenerator.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+/*! \brief Writes \p numFrames frames of the test trajectory to \p filename
+ *
+ * In TRR files, every third frame has no coordinates.
+ */
+void writeFrames(const std::string& filename,
+                 const char*        mode,
+                 int                firstFrame,
+                 int                numFrames,
+                 bool               withIndex)
+{
+    writeTestTrajectoryFrames(
+            filename,
+            mode,
+            firstFrame,
+            numFrames,
+            [withIndex](t_trxstatus* status) {
+                if (withIndex)
+                {
+                    trx_enable_frame_index(status);
+                }
+            },
+            [](int frame, t_trxframe* fr) { fr->bX = !fr->bV || frame % 3 != 2; });
+}
+
+//! Returns the times of the frames with coordinates read from \p filename
+std::vector<real> readTimes(const std::string& filename)
+{
+    gmx_output_env_t* oenv;
+    output_env_init_default(&oenv);
+
+    std::vector<real> times;
+    t_trxstatus*      status;
+    t_trxframe        fr;
+    if (read_first_frame(oenv, &status, filename.c_str(), &fr, TRX_NEED_X))
+    {
+        do
+        {
+            times.push_back(fr.time);
+            // Check that the coordinates belong to the frame
+            EXPECT_FLOAT_EQ(0.2 * fr.time, fr.x[0][XX]);
+        } while (read_next_frame(oenv, status, &fr));
+    }
+    close_trx(status);
+    done_frame(&fr);
+    output_env_done(oenv);
+
+    return times;
+}
+
+//! Returns the size of \p filename
+std::streamoff fileSize(const std::string& filename)
+{
+    return std::ifstream(filename, std::ios::binary | std::ios::ate).tellg();
+}
+
+//! Test fixture, parametrized by the trajectory file extension
+class TrajectoryFrameIndexTest : public TemporaryFileTest<::testing::TestWithParam<const char*>>
+{
+public:
+    TrajectoryFrameIndexTest() :
+        filenameWithoutIndex_(
+                fileManager_.getTemporaryFilePath(std::string("noindex.") + GetParam()))
+    {
+        filename_ = fileManager_.getTemporaryFilePath(std::string("traj.") + GetParam());
+    }
+
+    ~TrajectoryFrameIndexTest() override
+    {
+        unsetTimeValue(TBEGIN);
+        unsetTimeValue(TEND);
+        unsetTimeValue(TDELTA);
+        std::remove(frameIndexFileName(filename_).c_str());
+    }
+
+    //! The same trajectory as \p filename_, but without a frame index
+    std::string filenameWithoutIndex_;
+};
+
+TEST_P(TrajectoryFrameIndexTest, ListsAllFrames)
+{
+    writeFrames(filename_, "w", 0, 10, true);
+
+    const auto index = readTrajectoryFrameIndex(filename_);
+    ASSERT_EQ(10, index.size());
+    EXPECT_EQ(0, index[0].offset);
+    for (int frame = 0; frame < 10; frame++)
+    {
+        EXPECT_EQ(10 * frame, index[frame].step);
+        EXPECT_EQ(0.5 * frame, index[frame].time);
+        if (frame > 0)
+        {
+            EXPECT_GT(index[frame].offset, index[frame - 1].offset);
+        }
+    }
+}
+
+TEST_P(TrajectoryFrameIndexTest, ReadsTheSameFramesAsWithoutIndex)
+{
+    writeFrames(filename_, "w", 0, 20, true);
+    writeFrames(filenameWithoutIndex_, "w", 0, 20, false);
+    EXPECT_EQ(readTimes(filenameWithoutIndex_), readTimes(filename_));
+
+    setTimeValue(TBEGIN, 2.6);
+    setTimeValue(TEND, 8);
+    EXPECT_EQ(readTimes(filenameWithoutIndex_), readTimes(filename_));
+
+    setTimeValue(TDELTA, 1.5);
+    const std::vector<real> times = readTimes(filename_);
+    EXPECT_EQ(readTimes(filenameWithoutIndex_), times);
+    EXPECT_FALSE(times.empty());
+
+    setTimeValue(TBEGIN, 100);
+    EXPECT_TRUE(readTimes(filename_).empty());
+}
+
+TEST_P(TrajectoryFrameIndexTest, IsIgnoredAfterTrajectoryIsModified)
+{
+    writeFrames(filename_, "w", 0, 5, true);
+    writeFrames(filename_, "a", 5, 1, false);
+
+    EXPECT_TRUE(readTrajectoryFrameIndex(filename_).empty());
+    // All frames are still read, frames 2 and 5 of the TRR file have no coordinates
+    const size_t numFramesWithCoordinates = (GetParam() == std::string("trr") ? 4 : 6);
+    EXPECT_EQ(numFramesWithCoordinates, readTimes(filename_).size());
+}
+
+TEST_P(TrajectoryFrameIndexTest, IsIgnoredAfterTrajectoryIsReplaced)
+{
+    writeFrames(filename_, "w", 0, 5, true);
+    const auto index = readTrajectoryFrameIndex(filename_);
+    ASSERT_EQ(5, index.size());
+    const std::streamoff size = fileSize(filename_);
+    // A trajectory of the same size, but with different steps
+    writeFrames(filename_, "w", 3, 5, false);
+    ASSERT_EQ(size, fileSize(filename_));
+    ASSERT_TRUE(gmx_fexist(frameIndexFileName(filename_)));
+
+    EXPECT_TRUE(readTrajectoryFrameIndex(filename_).empty());
+}
+
+TEST_P(TrajectoryFrameIndexTest, ReportsNumberOfFrames)
+{
+    writeFrames(filename_, "w", 0, 7, true);
+    writeFrames(filenameWithoutIndex_, "w", 0, 7, false);
+
+    gmx_output_env_t* oenv;
+    output_env_init_default(&oenv);
+    for (const auto& filename : { filename_, filenameWithoutIndex_ })
+    {
+        t_trxstatus* status;
+        t_trxframe   fr;
+        ASSERT_TRUE(read_first_frame(oenv, &status, filename.c_str(), &fr, TRX_READ_X));
+        EXPECT_EQ(filename == filename_ ? 7 : -1, trx_get_num_frames(status));
+        close_trx(status);
+        done_frame(&fr);
+    }
+    output_env_done(oenv);
+}
+
+TEST_P(TrajectoryFrameIndexTest, WriterDoesNotBackUpTheIndex)
+{
+    const std::string indexFileName = frameIndexFileName(filename_);
+    gmx_set_max_backup_count(99);
+    {
+        TrajectoryFrameIndexWriter writer(filename_, false);
+        writer.addFrame(100, 0, 0);
+    }
+    const std::streamoff sizeWithFrame = fileSize(indexFileName);
+    {
+        TrajectoryFrameIndexWriter writer(filename_, false);
+    }
+    gmx_set_max_backup_count(0);
+
+    const std::string backupName =
+            fileManager_.getTemporaryFilePath(std::string("#traj.") + GetParam() + ".fidx.1#");
+    EXPECT_FALSE(gmx_fexist(backupName));
+    // The index was truncated in place
+    EXPECT_LT(fileSize(indexFileName), sizeWithFrame);
+}
+
+TEST_P(TrajectoryFrameIndexTest, IsContinuedWhenAppendingToTruncatedTrajectory)
+{
+    writeFrames(filename_, "w", 0, 10, true);
+    const auto index = readTrajectoryFrameIndex(filename_);
+    ASSERT_EQ(10, index.size());
+    // Truncate as mdrun does when appending from a checkpoint
+    ASSERT_EQ(0, gmx_truncate(filename_, index[6].offset));
+
+    writeFrames(filename_, "a", 6, 3, true);
+    const auto appendedIndex = readTrajectoryFrameIndex(filename_);
+    ASSERT_EQ(9, appendedIndex.size());
+    for (int frame = 0; frame < 9; frame++)
+    {
+        EXPECT_EQ(index[frame].offset, appendedIndex[frame].offset);
+        EXPECT_EQ(10 * frame, appendedIndex[frame].step);
+    }
+}
+
+TEST_P(TrajectoryFrameIndexTest, IsNotContinuedWhenFramesAreMissing)
+{
+    writeFrames(filename_, "w", 0, 3, true);
+    writeFrames(filename_, "a", 3, 1, false);
+
+    TrajectoryFrameIndexWriter writer(filename_, true);
+    EXPECT_FALSE(writer.isWriting());
+    EXPECT_FALSE(gmx_fexist(frameIndexFileName(filename_)));
+}
+
+INSTANTIATE_TEST_CASE_P(WithXtcAndTrr, TrajectoryFrameIndexTest, ::testing::Values("xtc", "trr"));
+
+} // namespace
+} // namespace test
+} // namespace gmx
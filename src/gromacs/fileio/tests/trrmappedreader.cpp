@@ -0,0 +1,311 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the memory-mapped TRR reader.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/trrmappedreader.h"
+
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/oenv.h"
+#include "gromacs/fileio/trrio.h"
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+#include "gromacs/utility/futil.h"
+
+#include "testutils/testasserts.h"
+#include "testutils/testfilemanager.h"
+#include "testutils/trajectoryfilegenerator.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of frames in the test trajectories
+const int c_numFrames = 3;
+
+/*! \brief Writes the test trajectory to \p filename
+ *
+ * The frames have the vectors from testTrajectoryVectors(). Frame 0 has
+ * all data, frame 1 only coordinates and frame 2 velocities and forces,
+ * but no box, which write_trxframe() cannot leave out.
+ */
+void writeTestTrajectory(const std::string& filename)
+{
+    t_fileio* fio = gmx_trr_open(filename.c_str(), "w");
+    matrix    box = { { 3, 0, 0 }, { 0.5, 4, 0 }, { 0.25, 0.75, 5 } };
+    for (int frame = 0; frame < c_numFrames; frame++)
+    {
+        std::vector<RVec> x = testTrajectoryVectors(frame, 0);
+        std::vector<RVec> v = testTrajectoryVectors(frame, 1);
+        std::vector<RVec> f = testTrajectoryVectors(frame, 2);
+        gmx_trr_write_frame(fio,
+                            10 * frame,
+                            0.5 * frame,
+                            0.1 * frame,
+                            frame == 2 ? nullptr : box,
+                            c_numTestTrajectoryAtoms,
+                            frame == 2 ? nullptr : as_rvec_array(x.data()),
+                            frame == 1 ? nullptr : as_rvec_array(v.data()),
+                            frame == 1 ? nullptr : as_rvec_array(f.data()));
+    }
+    gmx_trr_close(fio);
+}
+
+//! Checks that \p actual matches \p expected
+void checkVectors(ArrayRef<const RVec> expected, ArrayRef<const RVec> actual)
+{
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(expected[i][d], actual[i][d], defaultRealTolerance());
+        }
+    }
+}
+
+//! Copies the first \p size bytes of file \p source to \p dest
+void copyFilePrefix(const std::string& source, const std::string& dest, long size)
+{
+    FILE*             in = gmx_ffopen(source, "rb");
+    std::vector<char> buffer(size);
+    ASSERT_EQ(1U, fread(buffer.data(), size, 1, in));
+    gmx_ffclose(in);
+    FILE* out = gmx_ffopen(dest, "wb");
+    ASSERT_EQ(1U, fwrite(buffer.data(), size, 1, out));
+    gmx_ffclose(out);
+}
+
+//! Test fixture that writes the test trajectory
+class TrrMappedReaderTest : public TemporaryFileTest<>
+{
+public:
+    TrrMappedReaderTest() : TemporaryFileTest("traj.trr") { writeTestTrajectory(filename_); }
+};
+
+TEST_F(TrrMappedReaderTest, ReadsAllFrames)
+{
+    if (!TrrMappedReader::isSupported())
+    {
+        return;
+    }
+    TrrMappedReader reader(filename_);
+    for (int frame = 0; frame < c_numFrames; frame++)
+    {
+        SCOPED_TRACE("Frame " + std::to_string(frame));
+        ASSERT_EQ(TrrFrameStatus::Ok, reader.readNextFrame());
+        const gmx_trr_header_t& header = reader.header();
+        EXPECT_EQ(c_numTestTrajectoryAtoms, header.natoms);
+        EXPECT_EQ(10 * frame, header.step);
+        EXPECT_REAL_EQ_TOL(0.5 * frame, header.t, defaultRealTolerance());
+        EXPECT_REAL_EQ_TOL(0.1 * frame, header.lambda, defaultRealTolerance());
+
+        matrix box;
+        EXPECT_EQ(frame != 2, reader.copyBox(box));
+        if (frame != 2)
+        {
+            EXPECT_REAL_EQ_TOL(0.5, box[YY][XX], defaultRealTolerance());
+            EXPECT_REAL_EQ_TOL(5, box[ZZ][ZZ], defaultRealTolerance());
+        }
+
+        EXPECT_EQ(frame != 2, reader.hasVectors(TrrVectors::Coordinates));
+        EXPECT_EQ(frame != 1, reader.hasVectors(TrrVectors::Velocities));
+        EXPECT_EQ(frame != 1, reader.hasVectors(TrrVectors::Forces));
+        const TrrVectors kinds[] = { TrrVectors::Coordinates, TrrVectors::Velocities,
+                                     TrrVectors::Forces };
+        for (int kind = 0; kind < 3; kind++)
+        {
+            if (reader.hasVectors(kinds[kind]))
+            {
+                checkVectors(testTrajectoryVectors(frame, kind), reader.vectors(kinds[kind]));
+            }
+            else
+            {
+                EXPECT_TRUE(reader.vectors(kinds[kind]).empty());
+            }
+        }
+    }
+    EXPECT_EQ(TrrFrameStatus::EndOfFile, reader.readNextFrame());
+}
+
+TEST_F(TrrMappedReaderTest, CopiesVectors)
+{
+    if (!TrrMappedReader::isSupported())
+    {
+        return;
+    }
+    TrrMappedReader reader(filename_);
+    ASSERT_EQ(TrrFrameStatus::Ok, reader.readNextFrame());
+    std::vector<RVec> f(c_numTestTrajectoryAtoms);
+    reader.copyVectors(TrrVectors::Forces, f);
+    checkVectors(testTrajectoryVectors(0, 2), f);
+}
+
+TEST_F(TrrMappedReaderTest, SeeksToFrame)
+{
+    if (!TrrMappedReader::isSupported())
+    {
+        return;
+    }
+    TrrMappedReader reader(filename_);
+    ASSERT_EQ(TrrFrameStatus::Ok, reader.readNextFrame());
+    const gmx_off_t secondFrame = reader.position();
+    ASSERT_EQ(TrrFrameStatus::Ok, reader.readNextFrame());
+    ASSERT_EQ(TrrFrameStatus::Ok, reader.readNextFrame());
+    reader.seek(secondFrame);
+    ASSERT_EQ(TrrFrameStatus::Ok, reader.readNextFrame());
+    EXPECT_EQ(10, reader.header().step);
+    checkVectors(testTrajectoryVectors(1, 0), reader.vectors(TrrVectors::Coordinates));
+}
+
+TEST_F(TrrMappedReaderTest, ReportsIncompleteFrames)
+{
+    if (!TrrMappedReader::isSupported())
+    {
+        return;
+    }
+    gmx_off_t frameSize;
+    {
+        TrrMappedReader reader(filename_);
+        ASSERT_EQ(TrrFrameStatus::Ok, reader.readNextFrame());
+        frameSize = reader.position();
+    }
+    std::string truncatedFilename = fileManager_.getTemporaryFilePath("truncated.trr");
+
+    copyFilePrefix(filename_, truncatedFilename, frameSize + 20);
+    {
+        TrrMappedReader reader(truncatedFilename);
+        ASSERT_EQ(TrrFrameStatus::Ok, reader.readNextFrame());
+        EXPECT_EQ(TrrFrameStatus::IncompleteHeader, reader.readNextFrame());
+    }
+
+    copyFilePrefix(filename_, truncatedFilename, frameSize - 4);
+    {
+        TrrMappedReader reader(truncatedFilename);
+        EXPECT_EQ(TrrFrameStatus::IncompleteData, reader.readNextFrame());
+    }
+}
+
+TEST_F(TrrMappedReaderTest, ThrowsOnOtherFiles)
+{
+    if (!TrrMappedReader::isSupported())
+    {
+        return;
+    }
+    std::string otherFilename = fileManager_.getTemporaryFilePath("other.trr");
+    FILE*       fp            = gmx_ffopen(otherFilename, "w");
+    fprintf(fp, "This is not a trajectory\n");
+    gmx_ffclose(fp);
+
+    TrrMappedReader reader(otherFilename);
+    EXPECT_THROW_GMX(reader.readNextFrame(), FileIOError);
+}
+
+TEST_F(TrrMappedReaderTest, ReadsFramesLikeFio)
+{
+    gmx_output_env_t* oenv;
+    output_env_init_default(&oenv);
+
+    t_fileio*    fio = gmx_trr_open(filename_.c_str(), "r");
+    t_trxstatus* status;
+    t_trxframe   fr;
+    ASSERT_TRUE(read_first_frame(oenv, &status, filename_.c_str(), &fr,
+                                 TRX_READ_X | TRX_READ_V | TRX_READ_F));
+    for (int frame = 0; frame < c_numFrames; frame++)
+    {
+        SCOPED_TRACE("Frame " + std::to_string(frame));
+        if (frame > 0)
+        {
+            ASSERT_TRUE(read_next_frame(oenv, status, &fr));
+        }
+        int64_t           step;
+        real              t, lambda;
+        int               natoms;
+        matrix            box;
+        std::vector<RVec> x(c_numTestTrajectoryAtoms);
+        std::vector<RVec> v(c_numTestTrajectoryAtoms);
+        std::vector<RVec> f(c_numTestTrajectoryAtoms);
+        ASSERT_TRUE(gmx_trr_read_frame(fio,
+                                       &step,
+                                       &t,
+                                       &lambda,
+                                       box,
+                                       &natoms,
+                                       as_rvec_array(x.data()),
+                                       as_rvec_array(v.data()),
+                                       as_rvec_array(f.data())));
+        EXPECT_EQ(step, fr.step);
+        EXPECT_EQ(t, fr.time);
+        EXPECT_EQ(lambda, fr.lambda);
+        EXPECT_EQ(frame != 2, fr.bBox);
+        EXPECT_EQ(frame != 2, fr.bX);
+        EXPECT_EQ(frame != 1, fr.bV);
+        EXPECT_EQ(frame != 1, fr.bF);
+        if (fr.bX)
+        {
+            checkVectors(x, arrayRefFromArray(reinterpret_cast<RVec*>(fr.x), fr.natoms));
+        }
+        if (fr.bF)
+        {
+            checkVectors(f, arrayRefFromArray(reinterpret_cast<RVec*>(fr.f), fr.natoms));
+        }
+    }
+    EXPECT_FALSE(read_next_frame(oenv, status, &fr));
+
+    gmx_trr_close(fio);
+    close_trx(status);
+    done_frame(&fr);
+    output_env_done(oenv);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
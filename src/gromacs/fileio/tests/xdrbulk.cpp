@@ -0,0 +1,200 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for bulk conversion of arrays to and from XDR streams.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/xdrbulk.h"
+
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/gmxfio_xdr.h"
+#include "gromacs/utility/futil.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Returns the contents of the file \p filename
+std::vector<char> readFileContents(const std::string& filename)
+{
+    FILE*             fp = gmx_ffopen(filename, "rb");
+    std::vector<char> contents;
+    char              buffer[4096];
+    size_t            numRead;
+    while ((numRead = std::fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    {
+        contents.insert(contents.end(), buffer, buffer + numRead);
+    }
+    gmx_ffclose(fp);
+    return contents;
+}
+
+//! Returns \p count values with varying bit patterns, including negative values
+template<typename Value>
+std::vector<Value> makeValues(int count)
+{
+    std::vector<Value> values(count);
+    for (int i = 0; i < count; i++)
+    {
+        values[i] = static_cast<Value>((i % 2 == 0 ? 1 : -1) * (i * 37 + 0.123456789 * i));
+    }
+    return values;
+}
+
+class XdrBulkTest : public ::testing::Test
+{
+public:
+    //! Writes \p values with one \p xdrProc call per value to \p filename
+    template<typename Value>
+    void writePerValue(const std::string& filename, std::vector<Value> values, xdrproc_t xdrProc)
+    {
+        t_fileio* fio = gmx_fio_open(filename.c_str(), "w");
+        XDR*      xd  = gmx_fio_getxdr(fio);
+        for (Value& value : values)
+        {
+            ASSERT_TRUE(xdrProc(xd, &value));
+        }
+        gmx_fio_close(fio);
+    }
+
+    //! Writes \p values stored as \p FileValue in bulk to \p filename
+    template<typename FileValue, typename Value>
+    void writeBulk(const std::string& filename, std::vector<Value> values, int count)
+    {
+        t_fileio* fio = gmx_fio_open(filename.c_str(), "w");
+        ASSERT_TRUE(xdrBulkValues<FileValue>(gmx_fio_getxdr(fio),
+                                             values.empty() ? nullptr : values.data(), count));
+        gmx_fio_close(fio);
+    }
+
+    //! Reads \p count values stored as \p FileValue in bulk from \p filename
+    template<typename FileValue, typename Value>
+    std::vector<Value> readBulk(const std::string& filename, int count)
+    {
+        std::vector<Value> values(count);
+        t_fileio*          fio = gmx_fio_open(filename.c_str(), "r");
+        EXPECT_TRUE(xdrBulkValues<FileValue>(gmx_fio_getxdr(fio), values.data(), count));
+        gmx_fio_close(fio);
+        return values;
+    }
+
+    //! Checks that bulk and per-value writing give identical files that read back correctly
+    template<typename Value>
+    void checkIdenticalToPerValue(xdrproc_t xdrProc)
+    {
+        // Use more values than are converted per block
+        const std::vector<Value> values = makeValues<Value>(2503);
+        writePerValue(perValueFile_, values, xdrProc);
+        writeBulk<Value>(bulkFile_, values, values.size());
+        EXPECT_EQ(readFileContents(perValueFile_), readFileContents(bulkFile_));
+        EXPECT_EQ(values, (readBulk<Value, Value>(perValueFile_, values.size())));
+    }
+
+    TestFileManager fileManager_;
+    //! File written with per-value calls, with an extension that gmx_fio_open opens as XDR
+    std::string perValueFile_ = fileManager_.getTemporaryFilePath("pervalue.edr");
+    //! File written in bulk
+    std::string bulkFile_ = fileManager_.getTemporaryFilePath("bulk.edr");
+};
+
+TEST_F(XdrBulkTest, FloatsAreIdenticalToPerValueCalls)
+{
+    checkIdenticalToPerValue<float>(reinterpret_cast<xdrproc_t>(xdr_float));
+}
+
+TEST_F(XdrBulkTest, DoublesAreIdenticalToPerValueCalls)
+{
+    checkIdenticalToPerValue<double>(reinterpret_cast<xdrproc_t>(xdr_double));
+}
+
+TEST_F(XdrBulkTest, IntsAreIdenticalToPerValueCalls)
+{
+    checkIdenticalToPerValue<int>(reinterpret_cast<xdrproc_t>(xdr_int));
+}
+
+TEST_F(XdrBulkTest, ConvertsPrecision)
+{
+    const std::vector<float> floats = makeValues<float>(1500);
+    writeBulk<double>(bulkFile_, floats, floats.size());
+    EXPECT_EQ(floats, (readBulk<double, float>(bulkFile_, floats.size())));
+
+    const std::vector<double> doubles(floats.begin(), floats.end());
+    writeBulk<float>(bulkFile_, doubles, doubles.size());
+    EXPECT_EQ(doubles, (readBulk<float, double>(bulkFile_, doubles.size())));
+}
+
+TEST_F(XdrBulkTest, WritesZerosWithoutValues)
+{
+    writeBulk<float>(bulkFile_, std::vector<float>(), 1100);
+    EXPECT_EQ(std::vector<char>(1100 * sizeof(float), 0), readFileContents(bulkFile_));
+
+    t_fileio* fio = gmx_fio_open(bulkFile_.c_str(), "r");
+    EXPECT_TRUE(xdrBulkValues<float>(gmx_fio_getxdr(fio), static_cast<float*>(nullptr), 1100));
+    EXPECT_FALSE(xdrBulkValues<float>(gmx_fio_getxdr(fio), static_cast<float*>(nullptr), 1));
+    gmx_fio_close(fio);
+}
+
+TEST_F(XdrBulkTest, ConvertsByteOrder)
+{
+    const std::vector<int> values = { 0x01020304, -2 };
+    std::vector<char>      bytes(values.size() * sizeof(int));
+    toXdrByteOrder<int>(values.data(), values.size(), bytes.data());
+    const std::vector<char> expected = { 1, 2, 3, 4, -1, -1, -1, -2 };
+    EXPECT_EQ(expected, bytes);
+
+    std::vector<int> converted(values.size());
+    fromXdrByteOrder<int>(bytes.data(), bytes.size() / sizeof(int), converted.data());
+    EXPECT_EQ(values, converted);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
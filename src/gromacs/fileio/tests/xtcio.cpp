@@ -0,0 +1,163 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for reading and writing XTC frames.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/xtcio.h"
+
+#include <cmath>
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Returns coordinates of \p numAtoms atoms in water-like triplets on a lattice
+std::vector<RVec> makeCoordinates(int numAtoms)
+{
+    std::vector<RVec> x(numAtoms);
+    for (int i = 0; i < numAtoms; i++)
+    {
+        const int  molecule = i / 3;
+        const RVec oxygen(0.31 * (molecule % 10), 0.31 * ((molecule / 10) % 10),
+                          0.31 * (molecule / 100));
+        const RVec offset(0.01 * std::sin(1.3 * molecule), 0.01 * std::cos(0.7 * molecule), 0.0);
+        x[i] = oxygen + offset;
+        if (i % 3 == 1)
+        {
+            x[i][XX] += 0.1;
+        }
+        else if (i % 3 == 2)
+        {
+            x[i][XX] -= 0.033;
+            x[i][YY] += 0.094;
+        }
+    }
+    return x;
+}
+
+//! Test fixture, parametrized by the number of atoms and the number of atoms per chunk
+class XtcChunkedFrameTest : public ::testing::TestWithParam<std::tuple<int, int>>
+{
+};
+
+TEST_P(XtcChunkedFrameTest, ReadsTheSameCoordinatesAsNormalFrames)
+{
+    const int               numAtoms      = std::get<0>(GetParam());
+    const int               atomsPerChunk = std::get<1>(GetParam());
+    const real              precision     = 1000;
+    const std::vector<RVec> x             = makeCoordinates(numAtoms);
+    const matrix            box           = { { 3, 0, 0 }, { 0, 3.1, 0 }, { 0, 0, 3.2 } };
+
+    TestFileManager   fileManager;
+    const std::string filename = fileManager.getTemporaryFilePath("chunked.xtc");
+
+    // Write a chunked frame between two normal frames
+    const rvec* xWrite = as_rvec_array(x.data());
+    t_fileio*   fio    = open_xtc(filename.c_str(), "w");
+    ASSERT_EQ(1, write_xtc_chunked(fio, numAtoms, 1, 0.5, box, xWrite, precision, 0));
+    ASSERT_EQ(1, write_xtc_chunked(fio, numAtoms, 2, 1.0, box, xWrite, precision, atomsPerChunk));
+    ASSERT_EQ(1, write_xtc_chunked(fio, numAtoms, 3, 1.5, box, xWrite, precision, 0));
+    close_xtc(fio);
+
+    fio = open_xtc(filename.c_str(), "r");
+    int      readNumAtoms;
+    int64_t  step;
+    real     time;
+    real     readPrecision;
+    matrix   readBox;
+    rvec*    xNormal = nullptr;
+    gmx_bool bOK;
+    ASSERT_EQ(1, read_first_xtc(fio, &readNumAtoms, &step, &time, readBox, &xNormal,
+                                &readPrecision, &bOK));
+    ASSERT_EQ(numAtoms, readNumAtoms);
+    EXPECT_EQ(1, step);
+
+    std::vector<RVec> xChunked(numAtoms);
+    ASSERT_EQ(1, read_next_xtc(fio, numAtoms, &step, &time, readBox, as_rvec_array(xChunked.data()),
+                               &readPrecision, &bOK));
+    EXPECT_EQ(2, step);
+    EXPECT_EQ(1.0, time);
+    for (int d = 0; d < DIM; d++)
+    {
+        EXPECT_EQ(box[d][d], readBox[d][d]);
+    }
+    for (int i = 0; i < numAtoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_EQ(xNormal[i][d], xChunked[i][d]) << "atom " << i << " dim " << d;
+            EXPECT_NEAR(x[i][d], xChunked[i][d], 0.5 / precision + 1e-6);
+        }
+    }
+
+    std::vector<RVec> xLast(numAtoms);
+    ASSERT_EQ(1, read_next_xtc(fio, numAtoms, &step, &time, readBox, as_rvec_array(xLast.data()),
+                               &readPrecision, &bOK));
+    EXPECT_EQ(3, step);
+    EXPECT_EQ(0, read_next_xtc(fio, numAtoms, &step, &time, readBox, as_rvec_array(xLast.data()),
+                               &readPrecision, &bOK));
+
+    close_xtc(fio);
+    sfree(xNormal);
+}
+
+INSTANTIATE_TEST_CASE_P(WithVariousSizes,
+                        XtcChunkedFrameTest,
+                        ::testing::Combine(::testing::Values(7, 10, 35, 2503),
+                                           ::testing::Values(10, 64, 1000)));
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -55,4 +55,6 @@ real rTimeValue(int tcontrol);
 
 void setTimeValue(int tcontrol, real value);
 
+void unsetTimeValue(int tcontrol);
+
 #endif
@@ -39,6 +39,7 @@
 #include "config.h"
 
 #include <cmath>
+#include <cstdlib>
 
 #include <algorithm>
 #include <iterator>
@@ -215,6 +216,40 @@ void gmx_tng_close(gmx_tng_trajectory_t* gmx_tng)
 #endif
 }
 
+/* By default try to write 100 frames (of actual output) in each frame set.
+ * This number is the number of outputs of the most frequently written data
+ * type per frame set.
+ * TODO for 5.1: Verify that 100 frames per frame set is efficient for most
+ * setups regarding compression efficiency and compression time. Make this
+ * a hidden command-line option? */
+const int defaultFramesPerFrameSet = 100;
+
+/* TNG keeps all frames of a frame set in memory until the set is full and
+ * is compressed and written. For large systems, fewer frames are used per
+ * frame set, so that the uncompressed particle data of a frame set stays
+ * below this size. This also limits the time spent compressing a frame set. */
+const std::int64_t maxFrameSetParticleDataBytes = 512 * 1024 * 1024;
+
+int gmx_tng_frames_per_frame_set(int numAtoms, int numParticleBlocks)
+{
+    const char* env = getenv("GMX_TNG_FRAMES_PER_FRAME_SET");
+    if (env != nullptr)
+    {
+        const int numFrames = std::atoi(env);
+        if (numFrames > 0)
+        {
+            return numFrames;
+        }
+    }
+
+    const std::int64_t bytesPerFrame =
+            static_cast<std::int64_t>(std::max(numAtoms, 1)) * DIM * sizeof(real)
+            * std::max(numParticleBlocks, 1);
+    return static_cast<int>(std::clamp(maxFrameSetParticleDataBytes / bytesPerFrame,
+                                       static_cast<std::int64_t>(1),
+                                       static_cast<std::int64_t>(defaultFramesPerFrameSet)));
+}
+
 #if GMX_USE_TNG
 static void addTngMoleculeFromTopology(gmx_tng_trajectory_t gmx_tng,
                                        const char*          moleculeName,
@@ -376,24 +411,18 @@ static int greatest_common_divisor_if_positive(int n1, int n2)
     return std::gcd(n1, n2);
 }
 
-/* By default try to write 100 frames (of actual output) in each frame set.
- * This number is the number of outputs of the most frequently written data
- * type per frame set.
- * TODO for 5.1: Verify that 100 frames per frame set is efficient for most
- * setups regarding compression efficiency and compression time. Make this
- * a hidden command-line option? */
-const int defaultFramesPerFrameSet = 100;
-
 /*! \libinternal \brief  Set the number of frames per frame
  * set according to output intervals.
  * The default is that 100 frames are written of the data
- * that is written most often. */
+ * that is written most often, fewer for large systems. */
 static void tng_set_frames_per_frame_set(gmx_tng_trajectory_t gmx_tng,
                                          const gmx_bool       bUseLossyCompression,
-                                         const t_inputrec*    ir)
+                                         const t_inputrec*    ir,
+                                         int                  numAtoms)
 {
     int              gcd = -1;
     tng_trajectory_t tng = gmx_tng->tng;
+    int              numParticleBlocks;
 
     /* Set the number of frames per frame set to contain at least
      * defaultFramesPerFrameSet of the lowest common denominator of
@@ -402,25 +431,30 @@ static void tng_set_frames_per_frame_set(gmx_tng_trajectory_t gmx_tng,
     if (bUseLossyCompression)
     {
         gcd = ir->nstxout_compressed;
+        /* Without uncompressed output, velocities and forces are also written */
+        numParticleBlocks = 1 + (ir->nstxout == 0 ? (ir->nstvout > 0) + (ir->nstfout > 0) : 0);
     }
     else
     {
         gcd = greatest_common_divisor_if_positive(ir->nstxout, ir->nstvout);
         gcd = greatest_common_divisor_if_positive(gcd, ir->nstfout);
+        numParticleBlocks = (ir->nstxout > 0) + (ir->nstvout > 0) + (ir->nstfout > 0);
     }
     if (0 >= gcd)
     {
         return;
     }
 
-    tng_num_frames_per_frame_set_set(tng, gcd * defaultFramesPerFrameSet);
+    const int numFrames = gmx_tng_frames_per_frame_set(numAtoms, numParticleBlocks);
+    tng_num_frames_per_frame_set_set(tng, gcd * numFrames);
 }
 
 /*! \libinternal \brief Set the data-writing intervals, and number of
  * frames per frame set */
 static void set_writing_intervals(gmx_tng_trajectory_t gmx_tng,
                                   const gmx_bool       bUseLossyCompression,
-                                  const t_inputrec*    ir)
+                                  const t_inputrec*    ir,
+                                  int                  numAtoms)
 {
     tng_trajectory_t tng = gmx_tng->tng;
 
@@ -438,7 +472,7 @@ static void set_writing_intervals(gmx_tng_trajectory_t gmx_tng,
     int  gcd = -1, lowest = -1;
     char compression;
 
-    tng_set_frames_per_frame_set(gmx_tng, bUseLossyCompression, ir);
+    tng_set_frames_per_frame_set(gmx_tng, bUseLossyCompression, ir, numAtoms);
 
     if (bUseLossyCompression)
     {
@@ -530,7 +564,7 @@ void gmx_tng_prepare_md_writing(gmx_tng_trajectory_t gmx_tng, const gmx_mtop_t*
 {
 #if GMX_USE_TNG
     gmx_tng_add_mtop(gmx_tng, mtop);
-    set_writing_intervals(gmx_tng, FALSE, ir);
+    set_writing_intervals(gmx_tng, FALSE, ir, mtop->natoms);
     tng_time_per_frame_set(gmx_tng->tng, ir->delta_t * PICO);
     gmx_tng->timePerFrameIsSet = true;
 #else
@@ -744,7 +778,7 @@ void gmx_tng_prepare_low_prec_writing(gmx_tng_trajectory_t gmx_tng, const gmx_mt
 #if GMX_USE_TNG
     gmx_tng_add_mtop(gmx_tng, mtop);
     add_selection_groups(gmx_tng, mtop);
-    set_writing_intervals(gmx_tng, TRUE, ir);
+    set_writing_intervals(gmx_tng, TRUE, ir, mtop->natoms);
     tng_time_per_frame_set(gmx_tng->tng, ir->delta_t * PICO);
     gmx_tng->timePerFrameIsSet = true;
     gmx_tng_set_compression_precision(gmx_tng, ir->x_compression_precision);
@@ -67,6 +67,19 @@ void gmx_tng_open(const char* filename, char mode, gmx_tng_trajectory_t* tng_dat
 /*! \brief Finish writing a TNG trajectory file */
 void gmx_tng_close(gmx_tng_trajectory_t* tng);
 
+/*! \brief Returns the number of frames per TNG frame set of the most frequently written data
+ *
+ * This is 100, or fewer when the uncompressed particle data of a frame
+ * set, with \p numParticleBlocks blocks of \p numAtoms atoms per frame,
+ * would take more than 512 MiB, but at least 1. A positive value of the
+ * environment variable GMX_TNG_FRAMES_PER_FRAME_SET overrides this.
+ *
+ * \param numAtoms           Number of atoms written per frame
+ * \param numParticleBlocks  Number of particle data blocks (positions,
+ *                           velocities, forces) written per frame
+ */
+int gmx_tng_frames_per_frame_set(int numAtoms, int numParticleBlocks);
+
 /*!\brief Add molecular topology information to TNG output (if
  * available)
  *
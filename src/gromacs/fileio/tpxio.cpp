@@ -134,6 +134,7 @@ enum tpxv
     tpxv_StoreNonBondedInteractionExclusionGroup, /**< Store the non bonded interaction exclusion group in the topology */
     tpxv_VSite1,                                  /**< Added 1 type virtual site */
     tpxv_MTS,                                     /**< Added multiple time stepping */
+    tpxv_AddBodySectionOffsets, /**< Added offsets of the sections of the TPR body to the header */
     tpxv_Count                                    /**< the total number of tpxv versions */
 };
 
@@ -2610,6 +2611,16 @@ static void do_mtop(gmx::ISerializer* serializer, gmx_mtop_t* mtop, int file_ver
     }
 }
 
+/*! \brief Returns whether the header \p tpx contains the offsets of the sections of the TPR body
+ *
+ * With these offsets, the sections can be deserialized independently,
+ * so parts that are not needed can be skipped.
+ */
+static bool hasBodySectionOffsets(const TpxFileHeader& tpx)
+{
+    return tpx.fileVersion >= tpxv_AddBodySectionOffsets && tpx.fileGeneration >= 27;
+}
+
 /*! \brief
  * Read the first part of the TPR file to find general system information.
  *
@@ -2763,6 +2774,12 @@ static void do_tpxheader(gmx::FileIOXdrSerializer* serializer,
         }
         serializer->doInt64(&tpx->sizeOfTprBody);
     }
+    if (hasBodySectionOffsets(*tpx))
+    {
+        serializer->doInt64(&tpx->topologyOffset);
+        serializer->doInt64(&tpx->coordinatesOffset);
+        serializer->doInt64(&tpx->parametersOffset);
+    }
 
     if ((tpx->fileGeneration > tpx_generation))
     {
@@ -3093,19 +3110,6 @@ static PbcType do_tpx_body(gmx::ISerializer* serializer,
     return pbcType;
 }
 
-/*! \brief
- * Overload for do_tpx_body that defaults to state vectors being nullptr.
- *
- * \param[in] serializer Abstract serializer used to read/write data.
- * \param[in] tpx The file header data.
- * \param[in,out] ir Datastructures with simulation parameters.
- * \param[in,out] mtop Global topology.
- */
-static PbcType do_tpx_body(gmx::ISerializer* serializer, TpxFileHeader* tpx, t_inputrec* ir, gmx_mtop_t* mtop)
-{
-    return do_tpx_body(serializer, tpx, ir, nullptr, nullptr, nullptr, mtop);
-}
-
 static t_fileio* open_tpx(const char* fn, const char* mode)
 {
     return gmx_fio_open(fn, mode);
@@ -3165,6 +3169,166 @@ static void doTpxBodyBuffer(gmx::ISerializer* serializer, gmx::ArrayRef<char> bu
     serializer->doOpaque(buffer.data(), buffer.size());
 }
 
+/*! \brief
+ * Appends the data serialized by \p serializer as a section to \p body.
+ *
+ * \param[in,out] body The TPR body.
+ * \param[in] serializer Serializer containing the section.
+ * \param[out] offset The offset of the section in \p body.
+ */
+static void appendTpxBodySection(std::vector<char>*       body,
+                                 gmx::InMemorySerializer* serializer,
+                                 int64_t*                 offset)
+{
+    std::vector<char> section = serializer->finishAndGetBuffer();
+    *offset                   = body->size();
+    body->insert(body->end(), section.begin(), section.end());
+}
+
+/*! \brief
+ * Serializes the TPR body and stores the offsets of its sections in \p tpx.
+ *
+ * The sections are stored in the order of do_tpx_body, so the body
+ * can also be read sequentially. If \p state is nullptr, the box
+ * and coordinate sections are empty. The force-field parameters are
+ * serialized within the topology by do_mtop, before the molecule
+ * types that refer to them, so they cannot be skipped separately.
+ *
+ * \param[in,out] tpx The file header.
+ * \param[in] ir Parameter and system information.
+ * \param[in] state The simulation state, or nullptr.
+ * \param[in] mtop Global topology.
+ * \returns The serialized TPR body.
+ */
+static std::vector<char> serializeTpxBody(TpxFileHeader* tpx,
+                                          t_inputrec*    ir,
+                                          t_state*       state,
+                                          gmx_mtop_t*    mtop)
+{
+    GMX_RELEASE_ASSERT(hasBodySectionOffsets(*tpx), "Can only serialize the current TPR version");
+
+    // Long-term we should move to use little endian in files to avoid extra byte swapping,
+    // but since we just used the default XDR format (which is big endian) for the TPR
+    // header it would cause third-party libraries reading our raw data to tear their hair
+    // if we swap the endian in the middle of the file, so we stick to big endian in the
+    // TPR file for now - and thus we ask the serializer to swap if this host is little endian.
+    const auto endianSwapBehavior = gmx::EndianSwapBehavior::SwapIfHostIsLittleEndian;
+
+    gmx::InMemorySerializer boxSerializer(endianSwapBehavior);
+    if (state)
+    {
+        do_tpx_state_first(&boxSerializer, tpx, state);
+    }
+    std::vector<char> body = boxSerializer.finishAndGetBuffer();
+
+    gmx::InMemorySerializer topologySerializer(endianSwapBehavior);
+    do_tpx_mtop(&topologySerializer, tpx, mtop);
+    appendTpxBodySection(&body, &topologySerializer, &tpx->topologyOffset);
+
+    gmx::InMemorySerializer coordinatesSerializer(endianSwapBehavior);
+    if (state)
+    {
+        do_tpx_state_second(&coordinatesSerializer, tpx, state, nullptr, nullptr);
+    }
+    appendTpxBodySection(&body, &coordinatesSerializer, &tpx->coordinatesOffset);
+
+    gmx::InMemorySerializer parametersSerializer(endianSwapBehavior);
+    do_tpx_ir(&parametersSerializer, tpx, ir);
+    appendTpxBodySection(&body, &parametersSerializer, &tpx->parametersOffset);
+
+    tpx->sizeOfTprBody = body.size();
+
+    return body;
+}
+
+/*! \brief
+ * Deserializes a TPR body with section offsets, skipping the sections that are not needed.
+ *
+ * The topology is only deserialized when \p mtop is not nullptr
+ * and the box and coordinates only when \p state is not nullptr.
+ * The arguments are the same as for do_tpx_body.
+ *
+ * \param[in] tpx The file header data.
+ * \param[in] body The TPR body.
+ * \param[out] ir Datastructures with simulation parameters.
+ * \param[out] state Global state data.
+ * \param[out] x Individual coordinates for processing, deprecated.
+ * \param[out] v Individual velocities for processing, deprecated.
+ * \param[out] mtop Global topology.
+ */
+static PbcType deserializeTpxBodySections(TpxFileHeader*            tpx,
+                                          gmx::ArrayRef<const char> body,
+                                          t_inputrec*               ir,
+                                          t_state*                  state,
+                                          rvec*                     x,
+                                          rvec*                     v,
+                                          gmx_mtop_t*               mtop)
+{
+    const int64_t bodySize = body.ssize();
+    if (tpx->topologyOffset < 0 || tpx->coordinatesOffset < tpx->topologyOffset
+        || tpx->parametersOffset < tpx->coordinatesOffset || bodySize < tpx->parametersOffset)
+    {
+        gmx_fatal(FARGS, "The section offsets in the TPR file header are inconsistent");
+    }
+    const auto endianSwapBehavior = gmx::EndianSwapBehavior::SwapIfHostIsLittleEndian;
+
+    // Returns the part of the body from offset begin up to offset end
+    auto section = [body](int64_t begin, int64_t end) { return body.subArray(begin, end - begin); };
+
+    if (state)
+    {
+        gmx::InMemoryDeserializer deserializer(section(0, tpx->topologyOffset), tpx->isDouble,
+                                               endianSwapBehavior);
+        do_tpx_state_first(&deserializer, tpx, state);
+    }
+    if (mtop)
+    {
+        gmx::InMemoryDeserializer deserializer(section(tpx->topologyOffset, tpx->coordinatesOffset),
+                                               tpx->isDouble, endianSwapBehavior);
+        do_tpx_mtop(&deserializer, tpx, mtop);
+    }
+    if (state)
+    {
+        gmx::InMemoryDeserializer deserializer(
+                section(tpx->coordinatesOffset, tpx->parametersOffset), tpx->isDouble,
+                endianSwapBehavior);
+        do_tpx_state_second(&deserializer, tpx, state, x, v);
+    }
+    gmx::InMemoryDeserializer deserializer(section(tpx->parametersOffset, bodySize), tpx->isDouble,
+                                           endianSwapBehavior);
+    PbcType pbcType = do_tpx_ir(&deserializer, tpx, ir);
+    do_tpx_finalize(tpx, ir, state, mtop);
+
+    return pbcType;
+}
+
+/*! \brief
+ * Removes the box and coordinate sections from a TPR body with section offsets.
+ *
+ * The topology and parameter sections are kept as they are,
+ * so the result can be communicated to nodes that do not need the state.
+ *
+ * \param[in,out] partialDeserializedTpr The header and body to modify.
+ */
+static void removeTpxBodyStateSections(PartialDeserializedTprFile* partialDeserializedTpr)
+{
+    TpxFileHeader*     header = &partialDeserializedTpr->header;
+    std::vector<char>* body   = &partialDeserializedTpr->body;
+
+    const int64_t      topologySize = header->coordinatesOffset - header->topologyOffset;
+
+    body->erase(body->begin() + header->coordinatesOffset,
+                body->begin() + header->parametersOffset);
+    body->erase(body->begin(), body->begin() + header->topologyOffset);
+    header->topologyOffset    = 0;
+    header->coordinatesOffset = topologySize;
+    header->parametersOffset  = topologySize;
+    header->sizeOfTprBody     = body->size();
+    header->bBox              = false;
+    header->bX                = false;
+    header->bV                = false;
+}
+
 /*! \brief
  * Populates simulation datastructures.
  *
@@ -3184,7 +3348,7 @@ static void doTpxBodyBuffer(gmx::ISerializer* serializer, gmx::ArrayRef<char> bu
  * \param[in] tpx The file header.
  * \param[in] serializer The Serialization interface used to read the TPR.
  * \param[out] ir Input rec to populate.
- * \param[out] state State vectors to populate.
+ * \param[out] state State vectors to populate, can be nullptr for files with section offsets.
  * \param[out] x Coordinates to populate if needed.
  * \param[out] v Velocities to populate if needed.
  * \param[out] mtop Global topology to populate.
@@ -3199,6 +3363,9 @@ static PartialDeserializedTprFile readTpxBody(TpxFileHeader*    tpx,
                                               rvec*             v,
                                               gmx_mtop_t*       mtop)
 {
+    GMX_RELEASE_ASSERT(state != nullptr || hasBodySectionOffsets(*tpx),
+                       "Reading a TPR file without section offsets requires a state");
+
     PartialDeserializedTprFile partialDeserializedTpr;
     if (tpx->fileVersion >= tpxv_AddSizeField && tpx->fileGeneration >= 27)
     {
@@ -3213,19 +3380,24 @@ static PartialDeserializedTprFile readTpxBody(TpxFileHeader*    tpx,
     {
         partialDeserializedTpr.pbcType = do_tpx_body(serializer, tpx, ir, state, x, v, mtop);
     }
+    // With section offsets, we only need to drop the box and coordinate
+    // sections from the body as read from file, which avoids serializing
+    // the inputrec and mtop again for communication to nodes.
+    if (hasBodySectionOffsets(*tpx))
+    {
+        removeTpxBodyStateSections(&partialDeserializedTpr);
+        return partialDeserializedTpr;
+    }
     // Update header to system info for communication to nodes.
     // As we only need to communicate the inputrec and mtop to other nodes,
     // we prepare a new char buffer with the information we have already read
     // in on master.
     partialDeserializedTpr.header = populateTpxHeader(*state, ir, mtop);
-    // Long-term we should move to use little endian in files to avoid extra byte swapping,
-    // but since we just used the default XDR format (which is big endian) for the TPR
-    // header it would cause third-party libraries reading our raw data to tear their hair
-    // if we swap the endian in the middle of the file, so we stick to big endian in the
-    // TPR file for now - and thus we ask the serializer to swap if this host is little endian.
-    gmx::InMemorySerializer tprBodySerializer(gmx::EndianSwapBehavior::SwapIfHostIsLittleEndian);
-    do_tpx_body(&tprBodySerializer, &partialDeserializedTpr.header, ir, mtop);
-    partialDeserializedTpr.body = tprBodySerializer.finishAndGetBuffer();
+    partialDeserializedTpr.body =
+            serializeTpxBody(&partialDeserializedTpr.header, ir, nullptr, mtop);
+    partialDeserializedTpr.header.bBox = false;
+    partialDeserializedTpr.header.bX   = false;
+    partialDeserializedTpr.header.bV   = false;
 
     return partialDeserializedTpr;
 }
@@ -3259,19 +3431,10 @@ void write_tpx_state(const char* fn, const t_inputrec* ir, const t_state* state,
 
     t_fileio* fio;
 
-    TpxFileHeader tpx = populateTpxHeader(*state, ir, mtop);
-    // Long-term we should move to use little endian in files to avoid extra byte swapping,
-    // but since we just used the default XDR format (which is big endian) for the TPR
-    // header it would cause third-party libraries reading our raw data to tear their hair
-    // if we swap the endian in the middle of the file, so we stick to big endian in the
-    // TPR file for now - and thus we ask the serializer to swap if this host is little endian.
-    gmx::InMemorySerializer tprBodySerializer(gmx::EndianSwapBehavior::SwapIfHostIsLittleEndian);
-
-    do_tpx_body(&tprBodySerializer, &tpx, const_cast<t_inputrec*>(ir), const_cast<t_state*>(state),
-                nullptr, nullptr, const_cast<gmx_mtop_t*>(mtop));
-
-    std::vector<char> tprBody = tprBodySerializer.finishAndGetBuffer();
-    tpx.sizeOfTprBody         = tprBody.size();
+    TpxFileHeader     tpx     = populateTpxHeader(*state, ir, mtop);
+    std::vector<char> tprBody = serializeTpxBody(&tpx, const_cast<t_inputrec*>(ir),
+                                                 const_cast<t_state*>(state),
+                                                 const_cast<gmx_mtop_t*>(mtop));
 
     fio = open_tpx(fn, "w");
     gmx::FileIOXdrSerializer serializer(fio);
@@ -3288,6 +3451,11 @@ PbcType completeTprDeserialization(PartialDeserializedTprFile* partialDeserializ
                                    rvec*                       v,
                                    gmx_mtop_t*                 mtop)
 {
+    if (hasBodySectionOffsets(partialDeserializedTpr->header))
+    {
+        return deserializeTpxBodySections(&partialDeserializedTpr->header,
+                                          partialDeserializedTpr->body, ir, state, x, v, mtop);
+    }
     // Long-term we should move to use little endian in files to avoid extra byte swapping,
     // but since we just used the default XDR format (which is big endian) for the TPR
     // header it would cause third-party libraries reading our raw data to tear their hair
@@ -3328,8 +3496,11 @@ PbcType read_tpx(const char* fn, t_inputrec* ir, matrix box, int* natoms, rvec*
     fio = open_tpx(fn, "r");
     gmx::FileIOXdrSerializer serializer(fio);
     do_tpxheader(&serializer, &tpx, fn, fio, ir == nullptr);
+    // With section offsets, the box and coordinate sections are skipped when not needed.
+    // Older files are read sequentially, which requires a state.
+    const bool needState = (box != nullptr || x != nullptr || !hasBodySectionOffsets(tpx));
     PartialDeserializedTprFile partialDeserializedTpr =
-            readTpxBody(&tpx, &serializer, ir, &state, x, v, mtop);
+            readTpxBody(&tpx, &serializer, ir, needState ? &state : nullptr, x, v, mtop);
     close_tpx(fio);
     if (mtop != nullptr && natoms != nullptr)
     {
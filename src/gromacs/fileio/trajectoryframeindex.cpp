@@ -0,0 +1,304 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements reading and writing of frame index files for XTC and TRR trajectories.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "trajectoryframeindex.h"
+
+#include <cstdio>
+
+#include <algorithm>
+
+#include "gromacs/fileio/filetypes.h"
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/gmxfio_xdr.h"
+#include "gromacs/fileio/trrio.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/real.h"
+
+namespace gmx
+{
+
+namespace
+{
+
+//! Magic number at the start of frame index files
+const int c_frameIndexMagic = 0x46494458;
+//! Version of the frame index file format
+const int c_frameIndexVersion = 1;
+
+/*! \brief A frame as stored in the index file
+ *
+ * Only the end offset of each frame is stored, the start of a frame
+ * is the end of the previous frame, so the frames are contiguous.
+ */
+struct StoredFrame
+{
+    //! Offset just after the end of the frame
+    int64_t endOffset;
+    //! Step of the frame
+    int64_t step;
+    //! Time of the frame
+    double time;
+};
+
+//! Reads or writes the index file header, returns whether successful and valid
+bool doHeader(XDR* xdr)
+{
+    int magic   = c_frameIndexMagic;
+    int version = c_frameIndexVersion;
+    return xdr_int(xdr, &magic) && xdr_int(xdr, &version) && magic == c_frameIndexMagic
+           && version == c_frameIndexVersion;
+}
+
+//! Reads or writes one frame, returns whether successful
+bool doFrame(XDR* xdr, StoredFrame* frame)
+{
+    return xdr_int64(xdr, &frame->endOffset) && xdr_int64(xdr, &frame->step)
+           && xdr_double(xdr, &frame->time);
+}
+
+/*! \brief Returns the frames stored in \p indexFileName
+ *
+ * Stops at the first incomplete frame or the first frame that does not
+ * end after the previous one. Returns an empty list when the file does
+ * not exist or has an invalid header.
+ */
+std::vector<StoredFrame> readStoredFrames(const std::string& indexFileName)
+{
+    std::vector<StoredFrame> frames;
+    if (!gmx_fexist(indexFileName))
+    {
+        return frames;
+    }
+    FILE* file = gmx_ffopen(indexFileName, "rb");
+    XDR   xdr;
+    xdrstdio_create(&xdr, file, XDR_DECODE);
+    if (doHeader(&xdr))
+    {
+        StoredFrame frame;
+        while (doFrame(&xdr, &frame)
+               && frame.endOffset > (frames.empty() ? 0 : frames.back().endOffset))
+        {
+            frames.push_back(frame);
+        }
+    }
+    xdr_destroy(&xdr);
+    gmx_ffclose(file);
+
+    return frames;
+}
+
+//! Returns the size of \p fileName, or -1 when it can not be opened
+gmx_off_t fileSize(const std::string& fileName)
+{
+    if (!gmx_fexist(fileName))
+    {
+        return -1;
+    }
+    FILE* file = gmx_ffopen(fileName, "rb");
+    gmx_fseek(file, 0, SEEK_END);
+    const gmx_off_t size = gmx_ftell(file);
+    gmx_ffclose(file);
+
+    return size;
+}
+
+/*! \brief Returns whether the frame at \p offset in \p fio has step \p step
+ *
+ * Only the frame header is read. Returns false when there is no valid
+ * frame header at \p offset.
+ */
+bool frameHasStep(t_fileio* fio, int fileType, gmx_off_t offset, int64_t step)
+{
+    /* A TRR frame header with the wrong magic number is a fatal error, so check it first */
+    const int c_trrMagic = 1993;
+    XDR*      xdr        = gmx_fio_getxdr(fio);
+    int       magic;
+    if (gmx_fio_seek(fio, offset) != 0 || !xdr_int(xdr, &magic))
+    {
+        return false;
+    }
+    if (fileType == efXTC)
+    {
+        int natoms, xtcStep;
+        return xdr_int(xdr, &natoms) && xdr_int(xdr, &xtcStep) && xtcStep == step;
+    }
+    if (magic != c_trrMagic || gmx_fio_seek(fio, offset) != 0)
+    {
+        return false;
+    }
+    gmx_trr_header_t header;
+    gmx_bool         bOK;
+    return gmx_trr_read_frame_header(fio, &header, &bOK) && bOK && header.step == step;
+}
+
+/*! \brief Returns whether the first and last frames in \p index match \p trajectoryFile
+ *
+ * This catches a trajectory that was replaced by a different one with
+ * the same size, without reading all frames.
+ */
+bool frameHeadersMatch(const std::string&                            trajectoryFile,
+                       const std::vector<TrajectoryFrameIndexEntry>& index)
+{
+    t_fileio*  fio      = gmx_fio_open(trajectoryFile.c_str(), "r");
+    const int  fileType = fn2ftp(trajectoryFile.c_str());
+    const bool match    = frameHasStep(fio, fileType, index.front().offset, index.front().step)
+                       && frameHasStep(fio, fileType, index.back().offset, index.back().step);
+    gmx_fio_close(fio);
+
+    return match;
+}
+
+} // namespace
+
+std::string frameIndexFileName(const std::string& trajectoryFileName)
+{
+    return trajectoryFileName + ".fidx";
+}
+
+std::vector<TrajectoryFrameIndexEntry> readTrajectoryFrameIndex(const std::string& trajectoryFile)
+{
+    std::vector<TrajectoryFrameIndexEntry> index;
+
+    const std::vector<StoredFrame> frames = readStoredFrames(frameIndexFileName(trajectoryFile));
+    if (frames.empty() || frames.back().endOffset != fileSize(trajectoryFile))
+    {
+        return index;
+    }
+    index.reserve(frames.size());
+    gmx_off_t offset = 0;
+    for (const StoredFrame& frame : frames)
+    {
+        index.push_back({ offset, frame.step, frame.time });
+        offset = frame.endOffset;
+    }
+    if (!frameHeadersMatch(trajectoryFile, index))
+    {
+        index.clear();
+    }
+
+    return index;
+}
+
+TrajectoryFrameIndexWriter::TrajectoryFrameIndexWriter(const std::string& trajectoryFileName,
+                                                       bool               append) :
+    trajectoryFileType_(fn2ftp(trajectoryFileName.c_str())),
+    indexFileName_(frameIndexFileName(trajectoryFileName))
+{
+    GMX_RELEASE_ASSERT(trajectoryFileType_ == efXTC || trajectoryFileType_ == efTRR,
+                       "Frame indices are only supported for XTC and TRR files");
+
+    std::vector<StoredFrame> framesToKeep;
+    if (append)
+    {
+        /* Keep the frames that are still present in the (possibly truncated) trajectory */
+        const gmx_off_t trajectorySize = std::max<gmx_off_t>(fileSize(trajectoryFileName), 0);
+        for (const StoredFrame& frame : readStoredFrames(indexFileName_))
+        {
+            if (frame.endOffset <= trajectorySize)
+            {
+                framesToKeep.push_back(frame);
+            }
+        }
+        const gmx_off_t indexedSize = framesToKeep.empty() ? 0 : framesToKeep.back().endOffset;
+        if (indexedSize != trajectorySize)
+        {
+            /* We can not index the frames that are missing from the index */
+            if (gmx_fexist(indexFileName_))
+            {
+                std::remove(indexFileName_.c_str());
+            }
+            return;
+        }
+    }
+
+    /* The index belongs to the trajectory, which is backed up or
+     * truncated in place by its writer, so we should not back up the index.
+     */
+    file_ = std::fopen(indexFileName_.c_str(), "wb");
+    if (file_ == nullptr)
+    {
+        GMX_THROW(FileIOError("Cannot open frame index file " + indexFileName_));
+    }
+    xdrstdio_create(&xdr_, file_, XDR_ENCODE);
+    bool ok = doHeader(&xdr_);
+    for (StoredFrame& frame : framesToKeep)
+    {
+        ok = ok && doFrame(&xdr_, &frame);
+    }
+    if (!ok || std::fflush(file_) != 0)
+    {
+        GMX_THROW(FileIOError("Cannot write frame index file " + indexFileName_));
+    }
+}
+
+TrajectoryFrameIndexWriter::~TrajectoryFrameIndexWriter()
+{
+    if (file_ != nullptr)
+    {
+        xdr_destroy(&xdr_);
+        std::fclose(file_);
+    }
+}
+
+void TrajectoryFrameIndexWriter::addFrame(gmx_off_t endOffset, int64_t step, double time)
+{
+    if (file_ == nullptr)
+    {
+        return;
+    }
+
+    /* Store the step and time as they are read back from the trajectory */
+    StoredFrame frame = { endOffset, step, static_cast<real>(time) };
+    if (trajectoryFileType_ == efXTC)
+    {
+        frame.step = static_cast<int>(step);
+        frame.time = static_cast<float>(frame.time);
+    }
+    if (!doFrame(&xdr_, &frame) || std::fflush(file_) != 0)
+    {
+        GMX_THROW(FileIOError("Cannot write frame index file " + indexFileName_
+                              + "; maybe you are out of disk space?"));
+    }
+}
+
+} // namespace gmx
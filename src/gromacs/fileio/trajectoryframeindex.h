@@ -0,0 +1,143 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares reading and writing of frame index files for XTC and TRR trajectories.
+ *
+ * A frame index file stores the file offset, step and time of each frame
+ * of a trajectory, so frames can be located without scanning the
+ * trajectory. The index is stored next to the trajectory, with the
+ * suffix returned by frameIndexFileName() appended to its name.
+ *
+ * \inlibraryapi
+ * \ingroup module_fileio
+ */
+#ifndef GMX_FILEIO_TRAJECTORYFRAMEINDEX_H
+#define GMX_FILEIO_TRAJECTORYFRAMEINDEX_H
+
+#include <cstdint>
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/utility/classhelpers.h"
+#include "gromacs/utility/futil.h"
+
+namespace gmx
+{
+
+//! Returns the name of the frame index file of \p trajectoryFileName
+std::string frameIndexFileName(const std::string& trajectoryFileName);
+
+/*! \libinternal \brief Location, step and time of a trajectory frame
+ *
+ * The step and time are stored as they are read back from the
+ * trajectory, e.g. with the step truncated to int and the time
+ * rounded to float for XTC files.
+ */
+struct TrajectoryFrameIndexEntry
+{
+    //! Offset of the start of the frame in the trajectory file
+    gmx_off_t offset;
+    //! Step of the frame
+    int64_t step;
+    //! Time of the frame
+    double time;
+};
+
+/*! \brief Returns the frame index of the XTC or TRR file \p trajectoryFile
+ *
+ * Returns an empty list when there is no frame index file, or when it
+ * does not cover exactly all frames of the trajectory. The latter is
+ * the case when the trajectory was modified after the index was
+ * written or when the trajectory is still being written. The index
+ * covers the trajectory when the last frame ends at the end of the
+ * file and the steps of the first and last frame match the frame
+ * headers in the trajectory.
+ */
+std::vector<TrajectoryFrameIndexEntry> readTrajectoryFrameIndex(const std::string& trajectoryFile);
+
+/*! \libinternal \brief Writes the frame index file of an XTC or TRR trajectory
+ *
+ * After each frame is written to the trajectory, addFrame() should
+ * be called with the trajectory file position after the frame.
+ * The index file is flushed after each frame, so it always covers
+ * all frames that have been flushed to the trajectory file.
+ */
+class TrajectoryFrameIndexWriter
+{
+public:
+    /*! \brief Opens the frame index file of \p trajectoryFileName
+     *
+     * With \p append, the existing index is continued after the frames
+     * that are present in the trajectory, which might have been
+     * truncated when restarting a simulation. When the existing index
+     * does not cover these frames, no index is written and the existing
+     * index file is removed, which can be checked with isWriting().
+     * No backup is made of an existing index file, as it belongs to the
+     * trajectory, which is backed up or appended to by its writer.
+     *
+     * \throws FileIOError when the index file can not be opened.
+     */
+    TrajectoryFrameIndexWriter(const std::string& trajectoryFileName, bool append);
+    ~TrajectoryFrameIndexWriter();
+
+    //! Returns whether frames are added to the index
+    bool isWriting() const { return file_ != nullptr; }
+
+    /*! \brief Adds a frame that ends at \p endOffset in the trajectory file
+     *
+     * \throws FileIOError when writing to the index file fails.
+     */
+    void addFrame(gmx_off_t endOffset, int64_t step, double time);
+
+private:
+    //! The file type of the trajectory, efXTC or efTRR
+    int trajectoryFileType_;
+    //! The index file, nullptr when not writing
+    FILE* file_ = nullptr;
+    //! The XDR handle for the index file
+    XDR xdr_;
+    //! The name of the index file
+    std::string indexFileName_;
+
+    GMX_DISALLOW_COPY_AND_ASSIGN(TrajectoryFrameIndexWriter);
+};
+
+} // namespace gmx
+
+#endif
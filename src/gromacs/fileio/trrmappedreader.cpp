@@ -0,0 +1,394 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements the memory-mapped TRR reader.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "trrmappedreader.h"
+
+#include "config.h"
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstring>
+
+#include <limits>
+
+#if HAVE_MMAP
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include "gromacs/fileio/xdrbulk.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/stringutil.h"
+
+namespace gmx
+{
+
+namespace
+{
+
+//! Magic number at the start of each TRR frame
+const int c_trrMagic = 1993;
+//! The number of size fields in a TRR frame header
+const int c_numHeaderSizes = 11;
+
+//! Converts \p count big-endian reals of size \p realSize at \p src to \p dest
+void convertReals(const char* src, int realSize, int64_t count, real* dest)
+{
+    if (realSize == sizeof(float))
+    {
+        fromXdrByteOrder<float>(src, count, dest);
+    }
+    else
+    {
+        fromXdrByteOrder<double>(src, count, dest);
+    }
+}
+
+//! Returns the size of reals in a TRR frame with \p header, as nFloatSize() in trrio.cpp
+int realSizeOfFrame(const gmx_trr_header_t& header, const std::string& filename)
+{
+    int realSize = 0;
+    if (header.box_size)
+    {
+        realSize = header.box_size / (DIM * DIM);
+    }
+    else if (header.natoms > 0 && header.x_size)
+    {
+        realSize = header.x_size / (header.natoms * DIM);
+    }
+    else if (header.natoms > 0 && header.v_size)
+    {
+        realSize = header.v_size / (header.natoms * DIM);
+    }
+    else if (header.natoms > 0 && header.f_size)
+    {
+        realSize = header.f_size / (header.natoms * DIM);
+    }
+    if (realSize != sizeof(float) && realSize != sizeof(double))
+    {
+        GMX_THROW(FileIOError("Can not determine precision of trr file " + filename));
+    }
+    return realSize;
+}
+
+} // namespace
+
+bool TrrMappedReader::isSupported()
+{
+    return HAVE_MMAP;
+}
+
+TrrMappedReader::TrrMappedReader(const std::string& filename) : filename_(filename)
+{
+    for (auto& offset : vectorOffset_)
+    {
+        offset = -1;
+    }
+    header_ = {};
+#if HAVE_MMAP
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0)
+    {
+        GMX_THROW(FileIOError("Could not open " + filename + " for reading"));
+    }
+    try
+    {
+        ensureMapped(1);
+    }
+    catch (...)
+    {
+        close();
+        throw;
+    }
+#else
+    GMX_THROW(NotImplementedError("Memory-mapped file reading is not supported on this platform"));
+#endif
+}
+
+TrrMappedReader::~TrrMappedReader()
+{
+    close();
+}
+
+void TrrMappedReader::close()
+{
+#if HAVE_MMAP
+    if (data_ != nullptr)
+    {
+        munmap(const_cast<char*>(data_), mappedSize_);
+        data_       = nullptr;
+        mappedSize_ = 0;
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+#endif
+}
+
+bool TrrMappedReader::ensureMapped(gmx_off_t size)
+{
+    if (size <= mappedSize_)
+    {
+        return true;
+    }
+#if HAVE_MMAP
+    struct stat fileStatus;
+    if (fstat(fd_, &fileStatus) != 0)
+    {
+        GMX_THROW(FileIOError("Could not determine the size of " + filename_));
+    }
+    const gmx_off_t fileSize = fileStatus.st_size;
+    if (fileSize < size)
+    {
+        return false;
+    }
+    if (static_cast<uint64_t>(fileSize) > std::numeric_limits<size_t>::max())
+    {
+        GMX_THROW(FileIOError("File " + filename_ + " is too large to map into memory"));
+    }
+    // The file has grown since it was mapped, map it again as a whole
+    if (data_ != nullptr)
+    {
+        munmap(const_cast<char*>(data_), mappedSize_);
+        data_       = nullptr;
+        mappedSize_ = 0;
+    }
+    void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED)
+    {
+        GMX_THROW(FileIOError("Could not map " + filename_ + " into memory"));
+    }
+    // Trajectories are mostly read front to back, so ask for aggressive read-ahead
+    posix_madvise(mapping, fileSize, POSIX_MADV_SEQUENTIAL);
+    data_       = static_cast<const char*>(mapping);
+    mappedSize_ = fileSize;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void TrrMappedReader::seek(gmx_off_t offset)
+{
+    position_ = offset;
+}
+
+TrrFrameStatus TrrMappedReader::readNextFrame()
+{
+    boxOffset_ = -1;
+    for (int i = 0; i < static_cast<int>(TrrVectors::Count); i++)
+    {
+        vectorOffset_[i] = -1;
+        converted_[i]    = false;
+    }
+
+    gmx_off_t pos     = position_;
+    auto      readInt = [this, &pos](int* value) {
+        if (!ensureMapped(pos + sizeof(uint32_t)))
+        {
+            return false;
+        }
+        uint32_t bits;
+        std::memcpy(&bits, data_ + pos, sizeof(bits));
+#if !GMX_INTEGER_BIG_ENDIAN
+        bits = swapBytes(bits);
+#endif
+        std::memcpy(value, &bits, sizeof(bits));
+        pos += sizeof(bits);
+        return true;
+    };
+
+    int magic = 0;
+    if (!readInt(&magic))
+    {
+        return TrrFrameStatus::EndOfFile;
+    }
+    if (magic != c_trrMagic)
+    {
+        GMX_THROW(FileIOError(formatString(
+                "Failed to find GROMACS magic number in trr frame header at offset %" PRId64
+                " of %s, so this is not a trr file",
+                static_cast<int64_t>(position_), filename_.c_str())));
+    }
+    // The version string, stored as its buffer size and the XDR string
+    int bufferSize   = 0;
+    int stringLength = 0;
+    if (!readInt(&bufferSize) || !readInt(&stringLength))
+    {
+        return TrrFrameStatus::IncompleteHeader;
+    }
+    if (stringLength < 0 || stringLength > bufferSize)
+    {
+        GMX_THROW(FileIOError("Invalid version string in trr file " + filename_));
+    }
+    pos += (stringLength + 3) / 4 * 4;
+
+    int sizes[c_numHeaderSizes];
+    for (int& size : sizes)
+    {
+        if (!readInt(&size))
+        {
+            return TrrFrameStatus::IncompleteHeader;
+        }
+    }
+    header_           = {};
+    header_.ir_size   = sizes[0];
+    header_.e_size    = sizes[1];
+    header_.box_size  = sizes[2];
+    header_.vir_size  = sizes[3];
+    header_.pres_size = sizes[4];
+    header_.top_size  = sizes[5];
+    header_.sym_size  = sizes[6];
+    header_.x_size    = sizes[7];
+    header_.v_size    = sizes[8];
+    header_.f_size    = sizes[9];
+    header_.natoms    = sizes[10];
+    if (header_.natoms < 0)
+    {
+        GMX_THROW(FileIOError("Invalid number of atoms in trr file " + filename_));
+    }
+    realSize_        = realSizeOfFrame(header_, filename_);
+    header_.bDouble  = (realSize_ == sizeof(double));
+    int step         = 0;
+    if (!readInt(&step) || !readInt(&header_.nre) || !ensureMapped(pos + 2 * realSize_))
+    {
+        return TrrFrameStatus::IncompleteHeader;
+    }
+    // As with gmx_fio, the step is stored as int
+    header_.step = step;
+    convertReals(data_ + pos, realSize_, 1, &header_.t);
+    convertReals(data_ + pos + realSize_, realSize_, 1, &header_.lambda);
+    pos += 2 * realSize_;
+
+    const gmx_off_t matrixSize  = DIM * DIM * realSize_;
+    const gmx_off_t vectorsSize = static_cast<gmx_off_t>(header_.natoms) * DIM * realSize_;
+    if (header_.box_size)
+    {
+        boxOffset_ = pos;
+        pos += matrixSize;
+    }
+    if (header_.vir_size)
+    {
+        pos += matrixSize;
+    }
+    if (header_.pres_size)
+    {
+        pos += matrixSize;
+    }
+    const int vectorSizes[] = { header_.x_size, header_.v_size, header_.f_size };
+    for (int i = 0; i < static_cast<int>(TrrVectors::Count); i++)
+    {
+        if (vectorSizes[i])
+        {
+            vectorOffset_[i] = pos;
+            pos += vectorsSize;
+        }
+    }
+    if (!ensureMapped(pos))
+    {
+        boxOffset_ = -1;
+        for (auto& offset : vectorOffset_)
+        {
+            offset = -1;
+        }
+        return TrrFrameStatus::IncompleteData;
+    }
+    position_ = pos;
+
+    return TrrFrameStatus::Ok;
+}
+
+bool TrrMappedReader::hasVectors(TrrVectors which) const
+{
+    return vectorOffset_[static_cast<int>(which)] >= 0;
+}
+
+bool TrrMappedReader::copyBox(matrix box) const
+{
+    if (boxOffset_ < 0)
+    {
+        return false;
+    }
+    convertReals(data_ + boxOffset_, realSize_, DIM * DIM, box[0]);
+    return true;
+}
+
+ArrayRef<const RVec> TrrMappedReader::vectors(TrrVectors which)
+{
+    const int index = static_cast<int>(which);
+    if (vectorOffset_[index] < 0)
+    {
+        return {};
+    }
+    const char* src = data_ + vectorOffset_[index];
+    // Without byte swapping or conversion, the data can be used where it is
+    if (GMX_INTEGER_BIG_ENDIAN && realSize_ == sizeof(real)
+        && reinterpret_cast<std::uintptr_t>(src) % alignof(RVec) == 0)
+    {
+        return arrayRefFromArray(reinterpret_cast<const RVec*>(src), header_.natoms);
+    }
+    if (!converted_[index])
+    {
+        buffer_[index].resize(header_.natoms);
+        copyVectors(which, buffer_[index]);
+        converted_[index] = true;
+    }
+    return buffer_[index];
+}
+
+void TrrMappedReader::copyVectors(TrrVectors which, ArrayRef<RVec> dest) const
+{
+    const int index = static_cast<int>(which);
+    GMX_RELEASE_ASSERT(vectorOffset_[index] >= 0, "Can only copy vectors present in the frame");
+    GMX_RELEASE_ASSERT(dest.ssize() >= header_.natoms, "The destination should hold all atoms");
+    convertReals(data_ + vectorOffset_[index],
+                 realSize_,
+                 static_cast<int64_t>(header_.natoms) * DIM,
+                 as_rvec_array(dest.data())[0]);
+}
+
+} // namespace gmx
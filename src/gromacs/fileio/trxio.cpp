@@ -43,8 +43,11 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 
+#include <vector>
+
 #include "gromacs/fileio/checkpoint.h"
 #include "gromacs/fileio/confio.h"
 #include "gromacs/fileio/filetypes.h"
@@ -57,7 +60,9 @@
 #include "gromacs/fileio/timecontrol.h"
 #include "gromacs/fileio/tngio.h"
 #include "gromacs/fileio/tpxio.h"
+#include "gromacs/fileio/trajectoryframeindex.h"
 #include "gromacs/fileio/trrio.h"
+#include "gromacs/fileio/trrmappedreader.h"
 #include "gromacs/fileio/xdrf.h"
 #include "gromacs/fileio/xtcio.h"
 #include "gromacs/math/vec.h"
@@ -66,6 +71,7 @@
 #include "gromacs/topology/symtab.h"
 #include "gromacs/topology/topology.h"
 #include "gromacs/trajectory/trajectoryframe.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/gmxassert.h"
@@ -94,6 +100,14 @@ struct t_trxstatus
     double               DT, BOX[3];
     gmx_bool             bReadBox;
     char*                persistent_line; /* Persistent line for reading g96 trajectories */
+    /* Frame index of an XTC or TRR file opened for reading, nullptr when not available */
+    std::vector<gmx::TrajectoryFrameIndexEntry>* frameIndex;
+    int frameIndexNext; /* The position in frameIndex of the next frame to read */
+    /* Writes the frame index of an XTC or TRR file opened for writing, can be nullptr */
+    gmx::TrajectoryFrameIndexWriter* frameIndexWriter;
+    gmx_bool                         bAppend; /* Whether open_trx opened the file for appending */
+    /* Reads a TRR file through a memory mapping, nullptr when reading through fio */
+    gmx::TrrMappedReader* trrReader;
 #if GMX_USE_PLUGINS
     gmx_vmdplugin_t* vmdplugin;
 #endif
@@ -165,8 +179,13 @@ static void status_init(t_trxstatus* status)
     status->__frame         = -1;
     status->t0              = 0;
     status->tf              = 0;
-    status->persistent_line = nullptr;
-    status->tng             = nullptr;
+    status->persistent_line  = nullptr;
+    status->tng              = nullptr;
+    status->frameIndex       = nullptr;
+    status->frameIndexNext   = 0;
+    status->frameIndexWriter = nullptr;
+    status->bAppend          = FALSE;
+    status->trrReader        = nullptr;
 }
 
 
@@ -240,7 +259,11 @@ float trx_get_time_of_final_frame(t_trxstatus* status)
     gmx_bool  bOK;
     float     lasttime = -1;
 
-    if (filetype == efXTC)
+    if (status->frameIndex)
+    {
+        lasttime = status->frameIndex->back().time;
+    }
+    else if (filetype == efXTC)
     {
         lasttime = xdr_xtc_get_last_frame_time(gmx_fio_getfp(stfio), gmx_fio_getxdr(stfio),
                                                status->natoms, &bOK);
@@ -260,11 +283,16 @@ float trx_get_time_of_final_frame(t_trxstatus* status)
     }
     else
     {
-        gmx_incons("Only supported for TNG and XTC");
+        gmx_incons("Only supported for TNG, XTC and indexed TRR");
     }
     return lasttime;
 }
 
+int trx_get_num_frames(t_trxstatus* status)
+{
+    return status->frameIndex ? static_cast<int>(status->frameIndex->size()) : -1;
+}
+
 void clear_trxframe(t_trxframe* fr, gmx_bool bFirst)
 {
     fr->not_ok    = 0;
@@ -303,6 +331,15 @@ void setTrxFramePbcType(t_trxframe* fr, PbcType pbcType)
     fr->pbcType = pbcType;
 }
 
+/* Adds the frame just written to the frame index, when one is written */
+static void addFrameToIndex(t_trxstatus* status, int64_t step, real time)
+{
+    if (status->frameIndexWriter)
+    {
+        status->frameIndexWriter->addFrame(gmx_fio_ftell(status->fio), step, time);
+    }
+}
+
 int write_trxframe_indexed(t_trxstatus* status, const t_trxframe* fr, int nind, const int* ind, gmx_conect gc)
 {
     char  title[STRLEN];
@@ -389,10 +426,14 @@ int write_trxframe_indexed(t_trxstatus* status, const t_trxframe* fr, int nind,
     switch (ftp)
     {
         case efTNG: gmx_write_tng_from_trxframe(status->tng, fr, nind); break;
-        case efXTC: write_xtc(status->fio, nind, fr->step, fr->time, fr->box, xout, prec); break;
+        case efXTC:
+            write_xtc(status->fio, nind, fr->step, fr->time, fr->box, xout, prec);
+            addFrameToIndex(status, fr->step, fr->time);
+            break;
         case efTRR:
             gmx_trr_write_frame(status->fio, nframes_read(status), fr->time, fr->step, fr->box,
                                 nind, xout, vout, fout);
+            addFrameToIndex(status, nframes_read(status), fr->time);
             break;
         case efGRO:
         case efPDB:
@@ -526,11 +567,13 @@ int write_trxframe(t_trxstatus* status, t_trxframe* fr, gmx_conect gc)
     {
         case efXTC:
             write_xtc(status->fio, fr->natoms, fr->step, fr->time, fr->box, fr->x, prec);
+            addFrameToIndex(status, fr->step, fr->time);
             break;
         case efTRR:
             gmx_trr_write_frame(status->fio, fr->step, fr->time, fr->lambda, fr->box, fr->natoms,
                                 fr->bX ? fr->x : nullptr, fr->bV ? fr->v : nullptr,
                                 fr->bF ? fr->f : nullptr);
+            addFrameToIndex(status, fr->step, fr->time);
             break;
         case efGRO:
         case efPDB:
@@ -599,6 +642,9 @@ void close_trx(t_trxstatus* status)
         return;
     }
     gmx_tng_close(&status->tng);
+    delete status->frameIndexWriter;
+    delete status->frameIndex;
+    delete status->trrReader;
     if (status->fio)
     {
         gmx_fio_close(status->fio);
@@ -625,15 +671,147 @@ t_trxstatus* open_trx(const char* outfile, const char* filemode)
     snew(stat, 1);
     status_init(stat);
 
-    stat->fio = gmx_fio_open(outfile, filemode);
+    stat->fio     = gmx_fio_open(outfile, filemode);
+    stat->bAppend = (filemode[0] == 'a');
     return stat;
 }
 
+void trx_enable_frame_index(t_trxstatus* status)
+{
+    const int ftp = gmx_fio_getftp(status->fio);
+    if ((ftp == efXTC || ftp == efTRR) && status->frameIndexWriter == nullptr)
+    {
+        status->frameIndexWriter =
+                new gmx::TrajectoryFrameIndexWriter(gmx_fio_getname(status->fio), status->bAppend);
+    }
+}
+
+/* Seeks to the next frame that will not be skipped according to the
+ * time control settings, using the frame index. Returns FALSE when
+ * there is no such frame.
+ */
+static gmx_bool seek_next_frame_with_index(t_trxstatus* status, const t_trxframe* fr)
+{
+    const std::vector<gmx::TrajectoryFrameIndexEntry>& frameIndex = *status->frameIndex;
+
+    int next = status->frameIndexNext;
+    if (!(status->flags & TRX_DONT_SKIP))
+    {
+        while (next < static_cast<int>(frameIndex.size())
+               && check_times2(frameIndex[next].time, status->t0, fr->bDouble) < 0)
+        {
+            next++;
+        }
+    }
+    if (next == static_cast<int>(frameIndex.size()))
+    {
+        return FALSE;
+    }
+    if (next != status->frameIndexNext)
+    {
+        gmx_fio_seek(status->fio, frameIndex[next].offset);
+        status->frameIndexNext = next;
+    }
+
+    return TRUE;
+}
+
+/* Checks that the frame just read matches the frame index */
+static void check_frame_with_index(t_trxstatus* status, const t_trxframe* fr)
+{
+    const int64_t indexStep = (*status->frameIndex)[status->frameIndexNext].step;
+    if (fr->step != indexStep)
+    {
+        gmx_fatal(FARGS,
+                  "Frame %d of trajectory %s has step %" PRId64
+                  ", whereas its frame index file %s lists step %" PRId64
+                  ". Remove the frame index file.",
+                  status->frameIndexNext, gmx_fio_getname(status->fio), fr->step,
+                  gmx::frameIndexFileName(gmx_fio_getname(status->fio)).c_str(), indexStep);
+    }
+    status->frameIndexNext++;
+}
+
+/* Copies the vectors \p which of the last frame read by the memory-mapped
+ * reader to *v, when requested by \p readFlags, as gmx_trr_read_frame_data does.
+ */
+static void copy_mapped_vectors(t_trxstatus*    status,
+                                int             readFlags,
+                                gmx::TrrVectors which,
+                                int             natoms,
+                                rvec**          v,
+                                gmx_bool*       bPresent)
+{
+    if (!(status->flags & readFlags))
+    {
+        return;
+    }
+    if (*v == nullptr)
+    {
+        snew(*v, natoms);
+    }
+    *bPresent = status->trrReader->hasVectors(which);
+    if (*bPresent)
+    {
+        status->trrReader->copyVectors(
+                which, gmx::arrayRefFromArray(reinterpret_cast<gmx::RVec*>(*v), natoms));
+    }
+}
+
+/* Reads the next TRR frame with the memory-mapped reader */
+static gmx_bool gmx_next_frame_mapped(t_trxstatus* status, t_trxframe* fr)
+{
+    gmx::TrrMappedReader* reader = status->trrReader;
+
+    /* Continue at the fio position, which is changed by seeking and rewinding */
+    reader->seek(gmx_fio_ftell(status->fio));
+    const gmx::TrrFrameStatus frameStatus = reader->readNextFrame();
+    if (frameStatus != gmx::TrrFrameStatus::Ok)
+    {
+        if (frameStatus == gmx::TrrFrameStatus::IncompleteHeader)
+        {
+            fr->not_ok = HEADER_NOT_OK;
+        }
+        else if (frameStatus == gmx::TrrFrameStatus::IncompleteData)
+        {
+            fr->not_ok = DATA_NOT_OK;
+        }
+        return FALSE;
+    }
+    gmx_fio_seek(status->fio, reader->position());
+
+    const gmx_trr_header_t& sh = reader->header();
+    fr->bDouble                = sh.bDouble;
+    fr->natoms                 = sh.natoms;
+    fr->bStep                  = TRUE;
+    fr->step                   = sh.step;
+    fr->bTime                  = TRUE;
+    fr->time                   = sh.t;
+    fr->bLambda                = TRUE;
+    fr->bFepState              = TRUE;
+    fr->lambda                 = sh.lambda;
+    fr->bBox                   = reader->copyBox(fr->box);
+
+    copy_mapped_vectors(status, TRX_READ_X | TRX_NEED_X, gmx::TrrVectors::Coordinates, fr->natoms,
+                        &fr->x, &fr->bX);
+    copy_mapped_vectors(status, TRX_READ_V | TRX_NEED_V, gmx::TrrVectors::Velocities, fr->natoms,
+                        &fr->v, &fr->bV);
+    copy_mapped_vectors(status, TRX_READ_F | TRX_NEED_F, gmx::TrrVectors::Forces, fr->natoms,
+                        &fr->f, &fr->bF);
+
+    return TRUE;
+}
+
 static gmx_bool gmx_next_frame(t_trxstatus* status, t_trxframe* fr)
 {
     gmx_trr_header_t sh;
     gmx_bool         bOK, bRet;
 
+    if (status->trrReader)
+    {
+        return gmx_next_frame_mapped(status, fr);
+    }
+
     bRet = FALSE;
 
     if (gmx_trr_read_frame_header(status->fio, &sh, &bOK))
@@ -792,7 +970,20 @@ bool read_next_frame(const gmx_output_env_t* oenv, t_trxstatus* status, t_trxfra
         }
         switch (ftp)
         {
-            case efTRR: bRet = gmx_next_frame(status, fr); break;
+            case efTRR:
+                if (status->frameIndex)
+                {
+                    bRet = seek_next_frame_with_index(status, fr) && gmx_next_frame(status, fr);
+                    if (bRet)
+                    {
+                        check_frame_with_index(status, fr);
+                    }
+                }
+                else
+                {
+                    bRet = gmx_next_frame(status, fr);
+                }
+                break;
             case efCPT:
                 /* Checkpoint files can not contain mulitple frames */
                 break;
@@ -805,7 +996,15 @@ bool read_next_frame(const gmx_output_env_t* oenv, t_trxstatus* status, t_trxfra
                 break;
             }
             case efXTC:
-                if (bTimeSet(TBEGIN) && (status->tf < rTimeValue(TBEGIN)))
+                if (status->frameIndex)
+                {
+                    if (!seek_next_frame_with_index(status, fr))
+                    {
+                        bRet = false;
+                        break;
+                    }
+                }
+                else if (bTimeSet(TBEGIN) && (status->tf < rTimeValue(TBEGIN)))
                 {
                     if (xtc_seek_time(status->fio, rTimeValue(TBEGIN), fr->natoms, TRUE))
                     {
@@ -830,6 +1029,10 @@ bool read_next_frame(const gmx_output_env_t* oenv, t_trxstatus* status, t_trxfra
                        but from bOK from read_next_xtc this can't be distinguished */
                     fr->not_ok = DATA_NOT_OK;
                 }
+                if (bRet && status->frameIndex)
+                {
+                    check_frame_with_index(status, fr);
+                }
                 break;
             case efTNG: bRet = gmx_read_next_tng_frame(status->tng, fr, nullptr, 0); break;
             case efPDB: bRet = pdb_next_x(status, gmx_fio_getfp(status->fio), fr); break;
@@ -908,9 +1111,31 @@ bool read_first_frame(const gmx_output_env_t* oenv, t_trxstatus** status, const
     {
         fio = (*status)->fio = gmx_fio_open(fn, "r");
     }
+    if (ftp == efXTC || ftp == efTRR)
+    {
+        /* With a frame index, frames to skip are not read */
+        std::vector<gmx::TrajectoryFrameIndexEntry> frameIndex = gmx::readTrajectoryFrameIndex(fn);
+        if (!frameIndex.empty())
+        {
+            (*status)->frameIndex =
+                    new std::vector<gmx::TrajectoryFrameIndexEntry>(std::move(frameIndex));
+        }
+    }
     switch (ftp)
     {
-        case efTRR: break;
+        case efTRR:
+            if (gmx::TrrMappedReader::isSupported() && getenv("GMX_TRR_NO_MMAP") == nullptr)
+            {
+                try
+                {
+                    (*status)->trrReader = new gmx::TrrMappedReader(fn);
+                }
+                catch (const gmx::FileIOError&)
+                {
+                    /* E.g. the file is too large for the address space, read through fio */
+                }
+            }
+            break;
         case efCPT:
             read_checkpoint_trxframe(fio, fr);
             bFirst = FALSE;
@@ -959,6 +1184,10 @@ bool read_first_frame(const gmx_output_env_t* oenv, t_trxstatus** status, const
                 fr->bX    = TRUE;
                 fr->bBox  = TRUE;
                 printcount(*status, oenv, fr->time, FALSE);
+                if ((*status)->frameIndex)
+                {
+                    check_frame_with_index(*status, fr);
+                }
             }
             bFirst = FALSE;
             break;
@@ -1077,6 +1306,7 @@ gmx_bool read_next_x(const gmx_output_env_t* oenv, t_trxstatus* status, real* t,
 void rewind_trj(t_trxstatus* status)
 {
     initcount(status);
+    status->frameIndexNext = 0;
 
     gmx_fio_rewind(status->fio);
 }
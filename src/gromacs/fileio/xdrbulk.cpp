@@ -0,0 +1,161 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements bulk conversion of arrays to and from XDR streams.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "xdrbulk.h"
+
+#include "config.h"
+
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+
+namespace gmx
+{
+
+namespace
+{
+
+//! The number of values converted per xdr_opaque() call
+constexpr std::size_t c_valuesPerBlock = 1024;
+
+//! Unsigned integer type with the size of \p Value, used for byte swapping
+template<typename Value>
+using BitsOf = std::conditional_t<sizeof(Value) == sizeof(uint64_t), uint64_t, uint32_t>;
+
+} // namespace
+
+template<typename FileValue, typename Value>
+void fromXdrByteOrder(const char* src, std::size_t count, Value* dest)
+{
+    using Bits = BitsOf<FileValue>;
+    static_assert(sizeof(FileValue) == sizeof(Bits), "Bits should hold a FileValue");
+    for (std::size_t i = 0; i < count; i++)
+    {
+        Bits bits;
+        std::memcpy(&bits, src + i * sizeof(Bits), sizeof(Bits));
+#if !GMX_INTEGER_BIG_ENDIAN
+        bits = swapBytes(bits);
+#endif
+        FileValue value;
+        std::memcpy(&value, &bits, sizeof(value));
+        dest[i] = value;
+    }
+}
+
+template<typename FileValue, typename Value>
+void toXdrByteOrder(const Value* src, std::size_t count, char* dest)
+{
+    using Bits = BitsOf<FileValue>;
+    static_assert(sizeof(FileValue) == sizeof(Bits), "Bits should hold a FileValue");
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const FileValue value = static_cast<FileValue>(src[i]);
+        Bits            bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+#if !GMX_INTEGER_BIG_ENDIAN
+        bits = swapBytes(bits);
+#endif
+        std::memcpy(dest + i * sizeof(Bits), &bits, sizeof(Bits));
+    }
+}
+
+template<typename FileValue, typename Value>
+bool xdrBulkValues(XDR* xdrs, Value* values, std::size_t count)
+{
+    if (xdrs->x_op == XDR_FREE)
+    {
+        return true;
+    }
+
+    std::array<char, c_valuesPerBlock * sizeof(FileValue)> buffer;
+    for (std::size_t start = 0; start < count; start += c_valuesPerBlock)
+    {
+        const std::size_t  numValues = std::min(c_valuesPerBlock, count - start);
+        const unsigned int numBytes  = numValues * sizeof(FileValue);
+        if (xdrs->x_op == XDR_ENCODE)
+        {
+            if (values != nullptr)
+            {
+                toXdrByteOrder<FileValue>(values + start, numValues, buffer.data());
+            }
+            else
+            {
+                std::fill(buffer.begin(), buffer.begin() + numBytes, 0);
+            }
+            if (!xdr_opaque(xdrs, buffer.data(), numBytes))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (!xdr_opaque(xdrs, buffer.data(), numBytes))
+            {
+                return false;
+            }
+            if (values != nullptr)
+            {
+                fromXdrByteOrder<FileValue>(buffer.data(), numValues, values + start);
+            }
+        }
+    }
+
+    return true;
+}
+
+//! Instantiates the conversion routines for \p FileValue and \p Value
+#define INSTANTIATE_XDR_BULK(FileValue, Value)                                                \
+    template void fromXdrByteOrder<FileValue, Value>(const char*, std::size_t, Value*);       \
+    template void toXdrByteOrder<FileValue, Value>(const Value*, std::size_t, char*);         \
+    template bool xdrBulkValues<FileValue, Value>(XDR*, Value*, std::size_t);
+
+INSTANTIATE_XDR_BULK(float, float)
+INSTANTIATE_XDR_BULK(float, double)
+INSTANTIATE_XDR_BULK(double, float)
+INSTANTIATE_XDR_BULK(double, double)
+INSTANTIATE_XDR_BULK(int, int)
+
+#undef INSTANTIATE_XDR_BULK
+
+} // namespace gmx
@@ -0,0 +1,104 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares bulk conversion of arrays to and from XDR streams.
+ *
+ * XDR stores 4- and 8-byte values in big-endian byte order. Instead of
+ * one xdr_float() or xdr_double() call per value, the routines here
+ * convert blocks of values with loops that have no dependencies between
+ * iterations, so compilers vectorize the byte swapping, and move each
+ * block through a single xdr_opaque() call. Since the value sizes are
+ * multiples of four bytes, xdr_opaque() adds no padding and the data
+ * in the stream is identical to that written by the per-value calls.
+ *
+ * \inlibraryapi
+ * \ingroup module_fileio
+ */
+#ifndef GMX_FILEIO_XDRBULK_H
+#define GMX_FILEIO_XDRBULK_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "gromacs/fileio/xdrf.h"
+
+namespace gmx
+{
+
+//! Swaps the byte order of \p value
+inline uint32_t swapBytes(uint32_t value)
+{
+    return (value >> 24) | ((value >> 8) & 0xff00U) | ((value << 8) & 0xff0000U) | (value << 24);
+}
+
+//! Swaps the byte order of \p value
+inline uint64_t swapBytes(uint64_t value)
+{
+    return (static_cast<uint64_t>(swapBytes(static_cast<uint32_t>(value))) << 32)
+           | swapBytes(static_cast<uint32_t>(value >> 32));
+}
+
+/*! \brief Converts \p count big-endian values of type \p FileValue at \p src to \p dest
+ *
+ * Instantiated for \p FileValue float, double and int, with \p Value
+ * float and double for the floating-point types and int for int.
+ */
+template<typename FileValue, typename Value>
+void fromXdrByteOrder(const char* src, std::size_t count, Value* dest);
+
+/*! \brief Converts \p count values at \p src to big-endian values of type \p FileValue at \p dest
+ *
+ * Instantiated for the same types as fromXdrByteOrder().
+ */
+template<typename FileValue, typename Value>
+void toXdrByteOrder(const Value* src, std::size_t count, char* dest);
+
+/*! \brief Reads or writes \p count values stored as \p FileValue in \p xdrs
+ *
+ * The stream contents are identical to calling xdr_float(), xdr_double()
+ * or xdr_int() for each value. When \p values is nullptr, zeros are
+ * written or the values read are discarded.
+ *
+ * Instantiated for the same types as fromXdrByteOrder().
+ *
+ * \returns Whether the data could be read or written.
+ */
+template<typename FileValue, typename Value>
+bool xdrBulkValues(XDR* xdrs, Value* values, std::size_t count);
+
+} // namespace gmx
+
+#endif
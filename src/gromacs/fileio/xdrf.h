@@ -58,6 +58,11 @@
 /* Read or write reduced precision *float* coordinates */
 int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision);
 
+/* Read or write reduced precision *float* coordinates in chunks of at least
+ * atomsPerChunk atoms, which are compressed or decompressed in parallel.
+ * atomsPerChunk is only used for writing. */
+int xdr3dfcoord_chunked(XDR* xdrs, float* fp, int* size, float* precision, int atomsPerChunk);
+
 
 /* Read or write a *real* value (stored as float) */
 int xdr_real(XDR* xdrs, real* r);
@@ -39,6 +39,7 @@
 
 #include "xtcio.h"
 
+#include <cstdlib>
 #include <cstring>
 
 #include "gromacs/fileio/gmxfio.h"
@@ -50,6 +51,8 @@
 #include "gromacs/utility/smalloc.h"
 
 #define XTC_MAGIC 1995
+/* Magic number of frames with the coordinates compressed in independent chunks */
+#define XTC_CHUNKED_MAGIC 2022
 
 
 static int xdr_r2f(XDR* xdrs, real* r, gmx_bool gmx_unused bRead)
@@ -87,9 +90,41 @@ void close_xtc(t_fileio* fio)
 
 static void check_xtc_magic(int magic)
 {
-    if (magic != XTC_MAGIC)
+    if (magic != XTC_MAGIC && magic != XTC_CHUNKED_MAGIC)
     {
-        gmx_fatal(FARGS, "Magic Number Error in XTC file (read %d, should be %d)", magic, XTC_MAGIC);
+        gmx_fatal(FARGS, "Magic Number Error in XTC file (read %d, should be %d or %d)", magic,
+                  XTC_MAGIC, XTC_CHUNKED_MAGIC);
+    }
+}
+
+/*! \brief Returns the number of atoms per chunk set by the user, 0 means unchunked frames
+ *
+ * Set by the GMX_XTC_CHUNK_SIZE environment variable.
+ */
+static int xtcAtomsPerChunkFromEnvironment()
+{
+    const char* env = getenv("GMX_XTC_CHUNK_SIZE");
+    if (env == nullptr)
+    {
+        return 0;
+    }
+    /* With fewer atoms per chunk, the per-chunk overhead reduces the compression */
+    const int defaultAtomsPerChunk = 50000;
+    const int atomsPerChunk        = std::atoi(env);
+
+    return atomsPerChunk > 0 ? atomsPerChunk : defaultAtomsPerChunk;
+}
+
+/* Read or write the coordinates, chunked when atomsPerChunk > 0 */
+static int xdr_xtc_coords(XDR* xd, float* fp, int* natoms, float* prec, int atomsPerChunk)
+{
+    if (atomsPerChunk > 0)
+    {
+        return xdr3dfcoord_chunked(xd, fp, natoms, prec, atomsPerChunk);
+    }
+    else
+    {
+        return xdr3dfcoord(xd, fp, natoms, prec);
     }
 }
 
@@ -138,7 +173,10 @@ static int xtc_header(XDR* xd, int* magic, int* natoms, int64_t* step, real* tim
     return result;
 }
 
-static int xtc_coord(XDR* xd, int* natoms, rvec* box, rvec* x, real* prec, gmx_bool bRead)
+/* Read or write box and coordinates. When reading, atomsPerChunk should be
+ * positive for frames with the chunked magic number. */
+static int
+xtc_coord(XDR* xd, int* natoms, rvec* box, rvec* x, real* prec, gmx_bool bRead, int atomsPerChunk)
 {
     int i, j, result;
 #if GMX_DOUBLE
@@ -176,7 +214,7 @@ static int xtc_coord(XDR* xd, int* natoms, rvec* box, rvec* x, real* prec, gmx_b
         }
         fprec = *prec;
     }
-    result = XTC_CHECK("x", xdr3dfcoord(xd, ftmp, natoms, &fprec));
+    result = XTC_CHECK("x", xdr_xtc_coords(xd, ftmp, natoms, &fprec, atomsPerChunk));
 
     /* Copy from temp. array if reading */
     if (bRead)
@@ -191,16 +229,23 @@ static int xtc_coord(XDR* xd, int* natoms, rvec* box, rvec* x, real* prec, gmx_b
     }
     sfree(ftmp);
 #else
-    result = XTC_CHECK("x", xdr3dfcoord(xd, x[0], natoms, prec));
+    result = XTC_CHECK("x", xdr_xtc_coords(xd, x[0], natoms, prec, atomsPerChunk));
 #endif
 
     return result;
 }
 
 
-int write_xtc(t_fileio* fio, int natoms, int64_t step, real time, const rvec* box, const rvec* x, real prec)
+int write_xtc_chunked(t_fileio*   fio,
+                      int         natoms,
+                      int64_t     step,
+                      real        time,
+                      const rvec* box,
+                      const rvec* x,
+                      real        prec,
+                      int         atomsPerChunk)
 {
-    int      magic_number = XTC_MAGIC;
+    int      magic_number = (atomsPerChunk > 0 ? XTC_CHUNKED_MAGIC : XTC_MAGIC);
     XDR*     xd;
     gmx_bool bDum;
     int      bOK;
@@ -221,8 +266,8 @@ int write_xtc(t_fileio* fio, int natoms, int64_t step, real time, const rvec* bo
     }
 
     /* write data */
-    bOK = xtc_coord(xd, &natoms, const_cast<rvec*>(box), const_cast<rvec*>(x), &prec,
-                    FALSE); /* bOK will be 1 if writing went well */
+    bOK = xtc_coord(xd, &natoms, const_cast<rvec*>(box), const_cast<rvec*>(x), &prec, FALSE,
+                    atomsPerChunk); /* bOK will be 1 if writing went well */
 
     if (bOK)
     {
@@ -234,6 +279,13 @@ int write_xtc(t_fileio* fio, int natoms, int64_t step, real time, const rvec* bo
     return bOK; /* 0 if bad, 1 if writing went well */
 }
 
+int write_xtc(t_fileio* fio, int natoms, int64_t step, real time, const rvec* box, const rvec* x, real prec)
+{
+    static const int atomsPerChunk = xtcAtomsPerChunkFromEnvironment();
+
+    return write_xtc_chunked(fio, natoms, step, time, box, x, prec, atomsPerChunk);
+}
+
 int read_first_xtc(t_fileio* fio, int* natoms, int64_t* step, real* time, matrix box, rvec** x, real* prec, gmx_bool* bOK)
 {
     int  magic;
@@ -253,7 +305,7 @@ int read_first_xtc(t_fileio* fio, int* natoms, int64_t* step, real* time, matrix
 
     snew(*x, *natoms);
 
-    *bOK = (xtc_coord(xd, natoms, box, *x, prec, TRUE) != 0);
+    *bOK = (xtc_coord(xd, natoms, box, *x, prec, TRUE, magic == XTC_CHUNKED_MAGIC ? 1 : 0) != 0);
 
     return static_cast<int>(*bOK);
 }
@@ -281,7 +333,7 @@ int read_next_xtc(t_fileio* fio, int natoms, int64_t* step, real* time, matrix b
         gmx_fatal(FARGS, "Frame contains more atoms (%d) than expected (%d)", n, natoms);
     }
 
-    *bOK = (xtc_coord(xd, &natoms, box, x, prec, TRUE) != 0);
+    *bOK = (xtc_coord(xd, &natoms, box, x, prec, TRUE, magic == XTC_CHUNKED_MAGIC ? 1 : 0) != 0);
 
     return static_cast<int>(*bOK);
 }
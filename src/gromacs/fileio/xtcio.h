@@ -76,6 +76,21 @@ int read_next_xtc(struct t_fileio* fio, int natoms, int64_t* step, real* time, m
 /* Read subsequent frames */
 
 int write_xtc(struct t_fileio* fio, int natoms, int64_t step, real time, const rvec* box, const rvec* x, real prec);
-/* Write a frame to xtc file */
+/* Write a frame to xtc file. When the GMX_XTC_CHUNK_SIZE environment
+ * variable is set, the frame is written as with write_xtc_chunked. */
+
+int write_xtc_chunked(struct t_fileio* fio,
+                      int              natoms,
+                      int64_t          step,
+                      real             time,
+                      const rvec*      box,
+                      const rvec*      x,
+                      real             prec,
+                      int              atomsPerChunk);
+/* Write a frame to xtc file with the coordinates divided into chunks of
+ * at least atomsPerChunk atoms, which are compressed in parallel and can
+ * be decompressed in parallel. With atomsPerChunk=0 a normal frame is
+ * written. Chunked frames have a different magic number and can only be
+ * read by GROMACS 2022 and later. */
 
 #endif
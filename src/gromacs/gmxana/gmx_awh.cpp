@@ -560,10 +560,7 @@ int gmx_awh(int argc, char* argv[])
 
     /* We just need the AWH parameters from inputrec. These are used to initialize
        the AWH reader when we have a frame to read later on. */
-    gmx_mtop_t mtop;
-    int        natoms;
-    matrix     box;
-    read_tpx(ftp2fn(efTPR, nfile, fnm), &ir, box, &natoms, nullptr, nullptr, &mtop);
+    read_tpx(ftp2fn(efTPR, nfile, fnm), &ir, nullptr, nullptr, nullptr, nullptr, nullptr);
 
     if (!ir.bDoAwh)
     {
@@ -42,12 +42,15 @@
 #include <cstring>
 
 #include <algorithm>
+#include <memory>
 
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/commandline/viewit.h"
 #include "gromacs/correlationfunctions/autocorr.h"
+#include "gromacs/fileio/energycolumns.h"
 #include "gromacs/fileio/enxio.h"
 #include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/timecontrol.h"
 #include "gromacs/fileio/tpxio.h"
 #include "gromacs/fileio/trxio.h"
 #include "gromacs/fileio/xvgr.h"
@@ -310,12 +313,9 @@ static int* select_by_name(int nre, gmx_enxnm_t* nm, int* nset)
 
 static void get_dhdl_parms(const char* topnm, t_inputrec* ir)
 {
-    gmx_mtop_t mtop;
-    int        natoms;
-    matrix     box;
-
-    /* all we need is the ir to be able to write the label */
-    read_tpx(topnm, ir, box, &natoms, nullptr, nullptr, &mtop);
+    /* all we need is the ir to be able to write the label,
+     * so the topology and coordinates are not read */
+    read_tpx(topnm, ir, nullptr, nullptr, nullptr, nullptr, nullptr);
 }
 
 static void einstein_visco(const char*             fn,
@@ -1884,6 +1884,36 @@ int gmx_energy(int argc, char* argv[])
         get_dhdl_parms(ftp2fn(efTPR, NFILE, fnm), ir);
     }
 
+    /* With an energy column file, we only need to read the selected terms */
+    std::unique_ptr<gmx::EnergyColumnReader> columnReader;
+    if (!bDHDL)
+    {
+        columnReader = gmx::EnergyColumnReader::open(ftp2fn(efEDR, NFILE, fnm));
+    }
+    if (columnReader)
+    {
+        gmx::ArrayRef<const std::string> columnNames = columnReader->termNames();
+        bool                             bSameNames  = (columnNames.ssize() == nre);
+        for (i = 0; i < nre && bSameNames; i++)
+        {
+            bSameNames = (columnNames[i] == enm[i].name);
+        }
+        if (bSameNames)
+        {
+            columnReader->selectTerms(gmx::constArrayRefFromArray(set, nset));
+            if (bTimeSet(TBEGIN))
+            {
+                columnReader->skipToTime(rTimeValue(TBEGIN));
+            }
+            fprintf(stderr, "Reading the selected energy terms from %s\n",
+                    gmx::energyColumnFileName(ftp2fn(efEDR, NFILE, fnm)).c_str());
+        }
+        else
+        {
+            columnReader.reset();
+        }
+    }
+
     /* Initiate energies and set them to zero */
     edat.nsteps    = 0;
     edat.npoints   = 0;
@@ -1905,7 +1935,14 @@ int gmx_energy(int argc, char* argv[])
          */
         do
         {
-            bCont = do_enx(fp, &(frame[NEXT]));
+            if (columnReader)
+            {
+                bCont = columnReader->readNextFrame(&(frame[NEXT]));
+            }
+            else
+            {
+                bCont = do_enx(fp, &(frame[NEXT]));
+            }
             if (bCont)
             {
                 timecheck = check_times(frame[NEXT].t);
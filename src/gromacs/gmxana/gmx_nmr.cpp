@@ -166,9 +166,8 @@ static void get_orires_parms(const char* topnm, t_inputrec* ir, int* nor, int* n
     int        natoms, i;
     t_iatom*   iatom;
     int        nb;
-    matrix     box;
 
-    read_tpx(topnm, ir, box, &natoms, nullptr, nullptr, &mtop);
+    read_tpx(topnm, ir, nullptr, &natoms, nullptr, nullptr, &mtop);
     top = gmx_mtop_t_to_t_topology(&mtop, FALSE);
 
     ip    = top.idef.iparams;
@@ -82,8 +82,12 @@
 using namespace gmx; // TODO: Remove when this file is moved into gmx namespace
 
 const EnumerationArray<BondedKernelFlavor, std::string> c_bondedKernelFlavorStrings = {
-    "forces, using SIMD when available", "forces, not using SIMD",
-    "forces, virial, and energy (ie. not using SIMD)", "forces and energy (ie. not using SIMD)"
+    "forces, using SIMD when available",
+    "forces, not using SIMD",
+    "forces, virial, and energy (ie. not using SIMD)",
+    "forces and energy (ie. not using SIMD)",
+    "forces, virial, and energy, using SIMD when available",
+    "forces and energy, using SIMD when available"
 };
 namespace
 {
@@ -1853,6 +1857,80 @@ inline void gmx_simdcall do_dih_fup_noshiftf_simd(const int* ai,
     transposeScatterIncrU<4>(reinterpret_cast<real*>(f), ak, f_k_x, f_k_y, f_k_z);
     transposeScatterDecrU<4>(reinterpret_cast<real*>(f), al, mf_l_x, mf_l_y, mf_l_z);
 }
+
+/*! \brief As do_dih_fup_noshiftf_simd, but also accumulates the shift forces
+ * when the kernel flavor requires the virial
+ *
+ * The shift indices depend on the atom pair and are only needed on
+ * virial steps, so these are computed per SIMD lane with plain C code.
+ */
+template<BondedKernelFlavor flavor>
+inline void gmx_simdcall do_dih_fup_simd(const int*   ai,
+                                         const int*   aj,
+                                         const int*   ak,
+                                         const int*   al,
+                                         SimdReal     p,
+                                         SimdReal     q,
+                                         SimdReal     f_i_x,
+                                         SimdReal     f_i_y,
+                                         SimdReal     f_i_z,
+                                         SimdReal     mf_l_x,
+                                         SimdReal     mf_l_y,
+                                         SimdReal     mf_l_z,
+                                         rvec4        f[],
+                                         rvec         fshift[],
+                                         const t_pbc* pbc,
+                                         const rvec   x[])
+{
+    do_dih_fup_noshiftf_simd(ai, aj, ak, al, p, q, f_i_x, f_i_y, f_i_z, mf_l_x, mf_l_y, mf_l_z, f);
+
+    if (computeVirial(flavor))
+    {
+        /* Store f_i, f_j, f_k and -f_l, with the sign convention of the force update */
+        alignas(GMX_SIMD_ALIGNMENT) real fbuf[4 * DIM * GMX_SIMD_REAL_WIDTH];
+        real*                            f_i  = fbuf + 0 * DIM * GMX_SIMD_REAL_WIDTH;
+        real*                            f_j  = fbuf + 1 * DIM * GMX_SIMD_REAL_WIDTH;
+        real*                            f_k  = fbuf + 2 * DIM * GMX_SIMD_REAL_WIDTH;
+        real*                            mf_l = fbuf + 3 * DIM * GMX_SIMD_REAL_WIDTH;
+
+        SimdReal sx = p * f_i_x + q * mf_l_x;
+        SimdReal sy = p * f_i_y + q * mf_l_y;
+        SimdReal sz = p * f_i_z + q * mf_l_z;
+        store(f_i + XX * GMX_SIMD_REAL_WIDTH, f_i_x);
+        store(f_i + YY * GMX_SIMD_REAL_WIDTH, f_i_y);
+        store(f_i + ZZ * GMX_SIMD_REAL_WIDTH, f_i_z);
+        store(f_j + XX * GMX_SIMD_REAL_WIDTH, f_i_x - sx);
+        store(f_j + YY * GMX_SIMD_REAL_WIDTH, f_i_y - sy);
+        store(f_j + ZZ * GMX_SIMD_REAL_WIDTH, f_i_z - sz);
+        store(f_k + XX * GMX_SIMD_REAL_WIDTH, mf_l_x - sx);
+        store(f_k + YY * GMX_SIMD_REAL_WIDTH, mf_l_y - sy);
+        store(f_k + ZZ * GMX_SIMD_REAL_WIDTH, mf_l_z - sz);
+        store(mf_l + XX * GMX_SIMD_REAL_WIDTH, mf_l_x);
+        store(mf_l + YY * GMX_SIMD_REAL_WIDTH, mf_l_y);
+        store(mf_l + ZZ * GMX_SIMD_REAL_WIDTH, mf_l_z);
+
+        for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            int t1 = CENTRAL;
+            int t2 = CENTRAL;
+            int t3 = CENTRAL;
+            if (pbc)
+            {
+                rvec dx;
+                t1 = pbc_rvec_sub(pbc, x[ai[s]], x[aj[s]], dx);
+                t2 = pbc_rvec_sub(pbc, x[ak[s]], x[aj[s]], dx);
+                t3 = pbc_rvec_sub(pbc, x[al[s]], x[aj[s]], dx);
+            }
+            for (int d = 0; d < DIM; d++)
+            {
+                fshift[t1][d] += f_i[d * GMX_SIMD_REAL_WIDTH + s];
+                fshift[CENTRAL][d] -= f_j[d * GMX_SIMD_REAL_WIDTH + s];
+                fshift[t2][d] += f_k[d * GMX_SIMD_REAL_WIDTH + s];
+                fshift[t3][d] -= mf_l[d * GMX_SIMD_REAL_WIDTH + s];
+            }
+        }
+    }
+}
 #endif // GMX_SIMD_HAVE_REAL
 
 /*! \brief Computes and returns the proper dihedral force
@@ -1909,7 +1987,7 @@ real dopdihs_min(real cpA, real cpB, real phiA, real phiB, int mult, real phi, r
 }
 
 template<BondedKernelFlavor flavor>
-std::enable_if_t<flavor != BondedKernelFlavor::ForcesSimdWhenAvailable || !GMX_SIMD_HAVE_REAL, real>
+std::enable_if_t<!useSimdWhenAvailable(flavor) || !GMX_SIMD_HAVE_REAL, real>
 pdihs(int             nbonds,
       const t_iatom   forceatoms[],
       const t_iparams forceparams[],
@@ -1964,13 +2042,13 @@ pdihs(int             nbonds,
 
 /* As pdihs above, but using SIMD to calculate multiple dihedrals at once */
 template<BondedKernelFlavor flavor>
-std::enable_if_t<flavor == BondedKernelFlavor::ForcesSimdWhenAvailable, real>
+std::enable_if_t<useSimdWhenAvailable(flavor), real>
 pdihs(int             nbonds,
       const t_iatom   forceatoms[],
       const t_iparams forceparams[],
       const rvec      x[],
       rvec4           f[],
-      rvec gmx_unused fshift[],
+      rvec            fshift[],
       const t_pbc*    pbc,
       real gmx_unused lambda,
       real gmx_unused* dvdlambda,
@@ -1997,6 +2075,7 @@ pdihs(int             nbonds,
     SimdReal                                 sin_S, cos_S;
     SimdReal                                 mddphi_S;
     SimdReal                                 sf_i_S, msf_l_S;
+    SimdReal                                 vtot_S = setZero();
     alignas(GMX_SIMD_ALIGNMENT) real         pbc_simd[9 * GMX_SIMD_REAL_WIDTH];
 
     /* Extract aligned pointer for parameters and variables */
@@ -2057,6 +2136,11 @@ pdihs(int             nbonds,
         sf_i_S   = mddphi_S * nrkj_m2_S;
         msf_l_S  = mddphi_S * nrkj_n2_S;
 
+        if (computeEnergy(flavor))
+        {
+            vtot_S = fma(cp_S, SimdReal(1.0) + cos_S, vtot_S);
+        }
+
         /* After this m?_S will contain f[i] */
         mx_S = sf_i_S * mx_S;
         my_S = sf_i_S * my_S;
@@ -2067,24 +2151,25 @@ pdihs(int             nbonds,
         ny_S = msf_l_S * ny_S;
         nz_S = msf_l_S * nz_S;
 
-        do_dih_fup_noshiftf_simd(ai, aj, ak, al, p_S, q_S, mx_S, my_S, mz_S, nx_S, ny_S, nz_S, f);
+        do_dih_fup_simd<flavor>(ai, aj, ak, al, p_S, q_S, mx_S, my_S, mz_S, nx_S, ny_S, nz_S, f,
+                                fshift, pbc, x);
     }
 
-    return 0;
+    return computeEnergy(flavor) ? reduce(vtot_S) : 0;
 }
 
 /* This is mostly a copy of the SIMD flavor of pdihs above, but with using
  * the RB potential instead of a harmonic potential.
- * This function can replace rbdihs() when no energy and virial are needed.
+ * This function can replace rbdihs() when there are no perturbed parameters.
  */
 template<BondedKernelFlavor flavor>
-std::enable_if_t<flavor == BondedKernelFlavor::ForcesSimdWhenAvailable, real>
+std::enable_if_t<useSimdWhenAvailable(flavor), real>
 rbdihs(int             nbonds,
        const t_iatom   forceatoms[],
        const t_iparams forceparams[],
        const rvec      x[],
        rvec4           f[],
-       rvec gmx_unused fshift[],
+       rvec            fshift[],
        const t_pbc*    pbc,
        real gmx_unused lambda,
        real gmx_unused* dvdlambda,
@@ -2110,6 +2195,7 @@ rbdihs(int             nbonds,
     SimdReal                         parm_S, c_S;
     SimdReal                         sin_S, cos_S;
     SimdReal                         sf_i_S, msf_l_S;
+    SimdReal                         vtot_S = setZero();
     alignas(GMX_SIMD_ALIGNMENT) real pbc_simd[9 * GMX_SIMD_REAL_WIDTH];
 
     SimdReal pi_S(M_PI);
@@ -2135,10 +2221,10 @@ rbdihs(int             nbonds,
             /* At the end fill the arrays with the last atoms and 0 params */
             if (i + s * nfa1 < nbonds)
             {
-                /* We don't need the first parameter, since that's a constant
-                 * which only affects the energies, not the forces.
+                /* The first parameter is a constant which only affects
+                 * the energies, not the forces.
                  */
-                for (j = 1; j < NR_RBDIHS; j++)
+                for (j = 0; j < NR_RBDIHS; j++)
                 {
                     parm[j * GMX_SIMD_REAL_WIDTH + s] = forceparams[type].rbdihs.rbcA[j];
                 }
@@ -2150,7 +2236,7 @@ rbdihs(int             nbonds,
             }
             else
             {
-                for (j = 1; j < NR_RBDIHS; j++)
+                for (j = 0; j < NR_RBDIHS; j++)
                 {
                     parm[j * GMX_SIMD_REAL_WIDTH + s] = 0;
                 }
@@ -2169,12 +2255,21 @@ rbdihs(int             nbonds,
         ddphi_S  = setZero();
         c_S      = one_S;
         cosfac_S = one_S;
+        SimdReal v_S = computeEnergy(flavor) ? load<SimdReal>(parm) : setZero();
         for (j = 1; j < NR_RBDIHS; j++)
         {
             parm_S   = load<SimdReal>(parm + j * GMX_SIMD_REAL_WIDTH);
             ddphi_S  = fma(c_S * parm_S, cosfac_S, ddphi_S);
             cosfac_S = cosfac_S * cos_S;
             c_S      = c_S + one_S;
+            if (computeEnergy(flavor))
+            {
+                v_S = fma(parm_S, cosfac_S, v_S);
+            }
+        }
+        if (computeEnergy(flavor))
+        {
+            vtot_S = vtot_S + v_S;
         }
 
         /* Note that here we do not use the minus sign which is present
@@ -2195,28 +2290,136 @@ rbdihs(int             nbonds,
         ny_S = msf_l_S * ny_S;
         nz_S = msf_l_S * nz_S;
 
-        do_dih_fup_noshiftf_simd(ai, aj, ak, al, p_S, q_S, mx_S, my_S, mz_S, nx_S, ny_S, nz_S, f);
+        do_dih_fup_simd<flavor>(ai, aj, ak, al, p_S, q_S, mx_S, my_S, mz_S, nx_S, ny_S, nz_S, f,
+                                fshift, pbc, x);
     }
 
-    return 0;
+    return computeEnergy(flavor) ? reduce(vtot_S) : 0;
+}
+
+/* As idihs below, but using SIMD to calculate multiple dihedrals at once */
+template<BondedKernelFlavor flavor>
+std::enable_if_t<useSimdWhenAvailable(flavor), real>
+idihs(int             nbonds,
+      const t_iatom   forceatoms[],
+      const t_iparams forceparams[],
+      const rvec      x[],
+      rvec4           f[],
+      rvec            fshift[],
+      const t_pbc*    pbc,
+      real gmx_unused lambda,
+      real gmx_unused* dvdlambda,
+      const t_mdatoms gmx_unused* md,
+      t_fcdata gmx_unused* fcd,
+      int gmx_unused* global_atom_index)
+{
+    const int                                nfa1 = 5;
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t ai[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t aj[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t ak[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t al[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real         coeff[2 * GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real         pbc_simd[9 * GMX_SIMD_REAL_WIDTH];
+
+    const SimdReal deg2rad_S(DEG2RAD);
+    const SimdReal twoPi_S(2 * M_PI);
+    const SimdReal invTwoPi_S(1 / (2 * M_PI));
+    const SimdReal half_S(0.5);
+    SimdReal       vtot_S = setZero();
+
+    set_pbc_simd(pbc, pbc_simd);
+
+    /* nbonds is the number of dihedrals times nfa1, here we step GMX_SIMD_REAL_WIDTH dihs */
+    for (int i = 0; i < nbonds; i += GMX_SIMD_REAL_WIDTH * nfa1)
+    {
+        /* Collect atoms quadruplets for GMX_SIMD_REAL_WIDTH dihedrals.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        int iu = i;
+        for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            const int type = forceatoms[iu];
+            ai[s]          = forceatoms[iu + 1];
+            aj[s]          = forceatoms[iu + 2];
+            ak[s]          = forceatoms[iu + 3];
+            al[s]          = forceatoms[iu + 4];
+
+            /* At the end fill the arrays with the last atoms and 0 params */
+            if (i + s * nfa1 < nbonds)
+            {
+                coeff[s]                       = forceparams[type].harmonic.krA;
+                coeff[GMX_SIMD_REAL_WIDTH + s] = forceparams[type].harmonic.rA;
+
+                if (iu + nfa1 < nbonds)
+                {
+                    iu += nfa1;
+                }
+            }
+            else
+            {
+                coeff[s]                       = 0;
+                coeff[GMX_SIMD_REAL_WIDTH + s] = 0;
+            }
+        }
+
+        SimdReal phi_S, mx_S, my_S, mz_S, nx_S, ny_S, nz_S, nrkj_m2_S, nrkj_n2_S, p_S, q_S;
+
+        /* Calculate GMX_SIMD_REAL_WIDTH dihedral angles at once */
+        dih_angle_simd(x, ai, aj, ak, al, pbc_simd, &phi_S, &mx_S, &my_S, &mz_S, &nx_S, &ny_S,
+                       &nz_S, &nrkj_m2_S, &nrkj_n2_S, &p_S, &q_S);
+
+        const SimdReal k_S    = load<SimdReal>(coeff);
+        const SimdReal phi0_S = load<SimdReal>(coeff + GMX_SIMD_REAL_WIDTH) * deg2rad_S;
+
+        /* Take phi-phi0 modulo (-Pi,Pi), see idihs() */
+        SimdReal dp_S = phi_S - phi0_S;
+        dp_S          = dp_S - twoPi_S * round(dp_S * invTwoPi_S);
+
+        /* This is -ddphi of the plain-C code */
+        const SimdReal mddphi_S = -k_S * dp_S;
+
+        if (computeEnergy(flavor))
+        {
+            vtot_S = fma(half_S * k_S, dp_S * dp_S, vtot_S);
+        }
+
+        const SimdReal sf_i_S  = mddphi_S * nrkj_m2_S;
+        const SimdReal msf_l_S = mddphi_S * nrkj_n2_S;
+
+        /* After this m?_S will contain f[i] */
+        mx_S = sf_i_S * mx_S;
+        my_S = sf_i_S * my_S;
+        mz_S = sf_i_S * mz_S;
+
+        /* After this m?_S will contain -f[l] */
+        nx_S = msf_l_S * nx_S;
+        ny_S = msf_l_S * ny_S;
+        nz_S = msf_l_S * nz_S;
+
+        do_dih_fup_simd<flavor>(ai, aj, ak, al, p_S, q_S, mx_S, my_S, mz_S, nx_S, ny_S, nz_S, f,
+                                fshift, pbc, x);
+    }
+
+    return computeEnergy(flavor) ? reduce(vtot_S) : 0;
 }
 
 #endif // GMX_SIMD_HAVE_REAL
 
 
 template<BondedKernelFlavor flavor>
-real idihs(int             nbonds,
-           const t_iatom   forceatoms[],
-           const t_iparams forceparams[],
-           const rvec      x[],
-           rvec4           f[],
-           rvec            fshift[],
-           const t_pbc*    pbc,
-           real            lambda,
-           real*           dvdlambda,
-           const t_mdatoms gmx_unused* md,
-           t_fcdata gmx_unused* fcd,
-           int gmx_unused* global_atom_index)
+std::enable_if_t<!useSimdWhenAvailable(flavor) || !GMX_SIMD_HAVE_REAL, real>
+idihs(int             nbonds,
+      const t_iatom   forceatoms[],
+      const t_iparams forceparams[],
+      const rvec      x[],
+      rvec4           f[],
+      rvec            fshift[],
+      const t_pbc*    pbc,
+      real            lambda,
+      real*           dvdlambda,
+      const t_mdatoms gmx_unused* md,
+      t_fcdata gmx_unused* fcd,
+      int gmx_unused* global_atom_index)
 {
     int  i, type, ai, aj, ak, al;
     int  t1, t2, t3;
@@ -2821,7 +3024,7 @@ real cbtdihs(int             nbonds,
 }
 
 template<BondedKernelFlavor flavor>
-std::enable_if_t<flavor != BondedKernelFlavor::ForcesSimdWhenAvailable || !GMX_SIMD_HAVE_REAL, real>
+std::enable_if_t<!useSimdWhenAvailable(flavor) || !GMX_SIMD_HAVE_REAL, real>
 rbdihs(int             nbonds,
        const t_iatom   forceatoms[],
        const t_iparams forceparams[],
@@ -3977,7 +4180,9 @@ gmx::EnumerationArray<BondedKernelFlavor, std::array<BondedInteractions, F_NRE>>
     c_bondedInteractionFunctions<BondedKernelFlavor::ForcesSimdWhenAvailable>,
     c_bondedInteractionFunctions<BondedKernelFlavor::ForcesNoSimd>,
     c_bondedInteractionFunctions<BondedKernelFlavor::ForcesAndVirialAndEnergy>,
-    c_bondedInteractionFunctions<BondedKernelFlavor::ForcesAndEnergy>
+    c_bondedInteractionFunctions<BondedKernelFlavor::ForcesAndEnergy>,
+    c_bondedInteractionFunctions<BondedKernelFlavor::ForcesAndVirialAndEnergySimdWhenAvailable>,
+    c_bondedInteractionFunctions<BondedKernelFlavor::ForcesAndEnergySimdWhenAvailable>
 };
 
 //! \endcond
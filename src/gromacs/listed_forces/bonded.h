@@ -136,7 +136,9 @@ enum class BondedKernelFlavor
     ForcesNoSimd,             //!< Compute only forces, do not use SIMD
     ForcesAndVirialAndEnergy, //!< Compute forces, virial and energy (no SIMD)
     ForcesAndEnergy,          //!< Compute forces and energy (no SIMD)
-    Count                     //!< The number of flavors
+    ForcesAndVirialAndEnergySimdWhenAvailable, //!< Compute forces, virial and energy, use SIMD when available; should not be used with perturbed parameters
+    ForcesAndEnergySimdWhenAvailable, //!< Compute forces and energy, use SIMD when available; should not be used with perturbed parameters
+    Count                             //!< The number of flavors
 };
 
 //! Helper strings for human-readable messages
@@ -146,20 +148,30 @@ extern const gmx::EnumerationArray<BondedKernelFlavor, std::string, BondedKernel
 static constexpr inline bool computeEnergy(const BondedKernelFlavor flavor)
 {
     return (flavor == BondedKernelFlavor::ForcesAndVirialAndEnergy
-            || flavor == BondedKernelFlavor::ForcesAndEnergy);
+            || flavor == BondedKernelFlavor::ForcesAndEnergy
+            || flavor == BondedKernelFlavor::ForcesAndVirialAndEnergySimdWhenAvailable
+            || flavor == BondedKernelFlavor::ForcesAndEnergySimdWhenAvailable);
 }
 
 /*! \brief Returns whether the virial should be computed */
 static constexpr inline bool computeVirial(const BondedKernelFlavor flavor)
 {
-    return (flavor == BondedKernelFlavor::ForcesAndVirialAndEnergy);
+    return (flavor == BondedKernelFlavor::ForcesAndVirialAndEnergy
+            || flavor == BondedKernelFlavor::ForcesAndVirialAndEnergySimdWhenAvailable);
 }
 
 /*! \brief Returns whether the energy and/or virial should be computed */
 static constexpr inline bool computeEnergyOrVirial(const BondedKernelFlavor flavor)
 {
-    return (flavor == BondedKernelFlavor::ForcesAndVirialAndEnergy
-            || flavor == BondedKernelFlavor::ForcesAndEnergy);
+    return computeEnergy(flavor) || computeVirial(flavor);
+}
+
+/*! \brief Returns whether SIMD kernels should be used, when available */
+static constexpr inline bool useSimdWhenAvailable(const BondedKernelFlavor flavor)
+{
+    return (flavor == BondedKernelFlavor::ForcesSimdWhenAvailable
+            || flavor == BondedKernelFlavor::ForcesAndVirialAndEnergySimdWhenAvailable
+            || flavor == BondedKernelFlavor::ForcesAndEnergySimdWhenAvailable);
 }
 
 /*! \brief Calculates bonded interactions for simple bonded types
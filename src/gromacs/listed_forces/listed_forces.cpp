@@ -144,9 +144,37 @@ static void selectInteractions(InteractionDefinitions*                  idef,
     }
 }
 
+/*! \brief Returns whether each atom occurs at most once in the position restraint list \p il
+ *
+ * Returns true without checking when running with a single thread.
+ */
+static bool restrainedAtomsAreUnique(const InteractionList& il,
+                                     const int              numAtoms,
+                                     const int              numThreads)
+{
+    if (numThreads == 1 || il.empty())
+    {
+        return true;
+    }
+
+    std::vector<bool> isRestrained(numAtoms, false);
+    for (int i = 0; i < il.size(); i += 2)
+    {
+        const int atom = il.iatoms[i + 1];
+        if (isRestrained[atom])
+        {
+            return false;
+        }
+        isRestrained[atom] = true;
+    }
+    return true;
+}
+
 void ListedForces::setup(const InteractionDefinitions& domainIdef, const int numAtomsForce, const bool useGpu)
 {
-    if (interactionSelection_.all())
+    const bool sortSpatially = (threading_->useSpatialDivision && threading_->nthreads > 1);
+
+    if (interactionSelection_.all() && !sortSpatially)
     {
         // Avoid the overhead of copying all interaction lists by simply setting the reference to the domain idef
         idef_ = &domainIdef;
@@ -157,7 +185,8 @@ void ListedForces::setup(const InteractionDefinitions& domainIdef, const int num
 
         selectInteractions(&idefSelection_, domainIdef, interactionSelection_);
 
-        idefSelection_.ilsort = domainIdef.ilsort;
+        idefSelection_.ilsort                      = domainIdef.ilsort;
+        idefSelection_.numNonperturbedInteractions = domainIdef.numNonperturbedInteractions;
 
         if (interactionSelection_.test(static_cast<int>(ListedForces::InteractionGroup::Rest)))
         {
@@ -169,10 +198,26 @@ void ListedForces::setup(const InteractionDefinitions& domainIdef, const int num
             idefSelection_.iparams_posres.clear();
             idefSelection_.iparams_fbposres.clear();
         }
+
+        if (sortSpatially)
+        {
+            sortBondedInteractionsSpatially(&idefSelection_);
+        }
     }
 
     setup_bonded_threading(threading_.get(), numAtomsForce, useGpu, *idef_);
 
+    /* Position restraint threads add forces directly to the force buffer,
+     * which is only thread-safe when each atom is restrained at most once.
+     */
+    const int  numThreads = threading_->nthreads;
+    const bool posresAtomsAreUnique =
+            restrainedAtomsAreUnique(idef_->il[F_POSRES], numAtomsForce, numThreads);
+    const bool fbposresAtomsAreUnique =
+            restrainedAtomsAreUnique(idef_->il[F_FBPOSRES], numAtomsForce, numThreads);
+    posresNumThreads_   = posresAtomsAreUnique ? numThreads : 1;
+    fbposresNumThreads_ = fbposresAtomsAreUnique ? numThreads : 1;
+
     if (idef_->ilsort == ilsortFE_SORTED)
     {
         forceBufferLambda_.resize(numAtomsForce * sizeof(rvec4) / sizeof(real));
@@ -372,21 +417,25 @@ BondedKernelFlavor selectBondedKernelFlavor(const gmx::StepWorkload& stepWork,
                                             const bool               useSimdKernels,
                                             const bool               havePerturbedInteractions)
 {
+    const bool useSimd = (useSimdKernels && !havePerturbedInteractions);
+
     BondedKernelFlavor flavor;
     if (stepWork.computeEnergy || stepWork.computeVirial)
     {
         if (stepWork.computeVirial)
         {
-            flavor = BondedKernelFlavor::ForcesAndVirialAndEnergy;
+            flavor = useSimd ? BondedKernelFlavor::ForcesAndVirialAndEnergySimdWhenAvailable
+                             : BondedKernelFlavor::ForcesAndVirialAndEnergy;
         }
         else
         {
-            flavor = BondedKernelFlavor::ForcesAndEnergy;
+            flavor = useSimd ? BondedKernelFlavor::ForcesAndEnergySimdWhenAvailable
+                             : BondedKernelFlavor::ForcesAndEnergy;
         }
     }
     else
     {
-        if (useSimdKernels && !havePerturbedInteractions)
+        if (useSimd)
         {
             flavor = BondedKernelFlavor::ForcesSimdWhenAvailable;
         }
@@ -473,8 +522,13 @@ real calc_one_bond(int                           thread,
         /* TODO The execution time for pairs might be nice to account
            to its own subtimer, but first wallcycle needs to be
            extended to support calling from multiple threads. */
+        /* The number of non-perturbed pairs in the range of this thread */
+        const int numNonperturbed =
+                (idef.ilsort == ilsortFE_SORTED
+                         ? std::clamp(numNonperturbedInteractions - nb0, 0, nbn)
+                         : nbn);
         do_pairs(ftype, nbn, iatoms.data() + nb0, iparams.data(), x, f, fshift, pbc, lambda, dvdl,
-                 md, fr, havePerturbedInteractions, stepWork, grpp, global_atom_index);
+                 md, fr, numNonperturbed, stepWork, grpp, global_atom_index);
     }
 
     if (thread == 0)
@@ -684,9 +738,15 @@ void calc_listed_lambda(const InteractionDefinitions& idef,
 
                 gmx::StepWorkload tempFlags;
                 tempFlags.computeEnergy = true;
-                real v = calc_one_bond(0, ftype, idef, iatomsPerturbed, iatomsPerturbed.ssize(),
-                                       workDivision, x, f, fshift, fr, pbc_null, grpp, nrnb, lambda,
-                                       dvdl.data(), md, fcd, tempFlags, global_atom_index);
+                /* All interactions in this list are perturbed, so we should
+                 * not use the kernels that ignore the B-state parameters.
+                 */
+                const int numNonperturbedInteractionsInList = 0;
+
+                real v = calc_one_bond(0, ftype, idef, iatomsPerturbed,
+                                       numNonperturbedInteractionsInList, workDivision, x, f, fshift,
+                                       fr, pbc_null, grpp, nrnb, lambda, dvdl.data(), md, fcd,
+                                       tempFlags, global_atom_index);
                 epot[ftype] += v;
             }
         }
@@ -742,12 +802,17 @@ void ListedForces::calculate(struct gmx_wallcycle*                     wcycle,
 
         if (!idef.il[F_POSRES].empty())
         {
-            posres_wrapper(nrnb, idef, &pbc_full, x, enerd, lambda, fr, &forceOutputs->forceWithVirial());
+            /* With foreign lambdas, these are computed in the same pass */
+            const bool computeForeignLambdas = (fepvals->n_lambda > 0 && stepWork.computeDhdl);
+            posres_wrapper(nrnb, idef, &pbc_full, x, enerd, lambda,
+                           computeForeignLambdas ? fepvals : nullptr, fr, posresNumThreads_,
+                           &posresThreadOutput_, &forceOutputs->forceWithVirial());
         }
 
         if (!idef.il[F_FBPOSRES].empty())
         {
-            fbposres_wrapper(nrnb, idef, &pbc_full, x, enerd, fr, &forceOutputs->forceWithVirial());
+            fbposres_wrapper(nrnb, idef, &pbc_full, x, enerd, fr, fbposresNumThreads_,
+                             &posresThreadOutput_, &forceOutputs->forceWithVirial());
         }
 
         /* Do pre force calculation stuff which might require communication */
@@ -776,10 +841,6 @@ void ListedForces::calculate(struct gmx_wallcycle*                     wcycle,
     if (fepvals->n_lambda > 0 && stepWork.computeDhdl)
     {
         real dvdl[efptNR] = { 0 };
-        if (!idef.il[F_POSRES].empty())
-        {
-            posres_wrapper_lambda(wcycle, fepvals, idef, &pbc_full, x, enerd, lambda, fr);
-        }
         if (idef.ilsort != ilsortNO_FE)
         {
             wallcycle_sub_start(wcycle, ewcsLISTED_FEP);
@@ -81,6 +81,7 @@
 #include "gromacs/utility/classhelpers.h"
 
 struct bonded_threading_t;
+struct PosresOutput;
 struct gmx_enerdata_t;
 struct gmx_ffparams_t;
 struct gmx_grppairener_t;
@@ -230,6 +231,12 @@ private:
     std::vector<real> forceBufferLambda_;
     //! Shift force buffer for free-energy forces
     std::vector<gmx::RVec> shiftForceBufferLambda_;
+    //! The number of threads for position restraints, 1 with multiple restraints per atom
+    int posresNumThreads_ = 1;
+    //! The number of threads for flat-bottomed position restraints, 1 with multiple per atom
+    int fbposresNumThreads_ = 1;
+    //! Per-thread energy and virial output of (flat-bottomed) position restraints
+    std::vector<PosresOutput> posresThreadOutput_;
 
     GMX_DISALLOW_COPY_AND_ASSIGN(ListedForces);
 };
@@ -148,6 +148,14 @@ struct bonded_threading_t
      */
     //! Maximum thread count for uniform distribution of bondeds over threads
     int max_nthread_uniform = 0;
+    /*! \brief Whether to sort bondeds spatially and divide them by locality at all thread counts
+     *
+     * With this set, the interactions of each type are ordered on their lowest
+     * (local) atom index and all types are divided together over the threads
+     * in contiguous atom ranges. This minimizes the number of force blocks each
+     * thread touches and thus the reduction cost at high thread counts.
+     */
+    bool useSpatialDivision = false;
 
     //! The division of work in the t_list over threads.
     WorkDivision workDivision;
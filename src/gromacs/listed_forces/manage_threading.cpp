@@ -56,6 +56,7 @@
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include "gromacs/listed_forces/gpubonded.h"
 #include "gromacs/pbcutil/ishift.h"
@@ -75,6 +76,25 @@ typedef struct
     int                    nat;   /**< nr of atoms involved in a single ftype interaction */
 } ilist_data_t;
 
+/*! \brief Returns the atom index used to order an interaction for locality
+ *
+ * \param[in] iatoms              Pointer to the type entry of the interaction
+ * \param[in] nat                 The number of atoms in the interaction
+ * \param[in] useLowestAtomIndex  Whether to use the lowest instead of the first atom index
+ */
+static inline int localityAtomIndex(const int* iatoms, const int nat, const bool useLowestAtomIndex)
+{
+    int index = iatoms[1];
+    if (useLowestAtomIndex)
+    {
+        for (int a = 2; a <= nat; a++)
+        {
+            index = std::min(index, iatoms[a]);
+        }
+    }
+    return index;
+}
+
 /*! \brief Divides listed interactions over threads
  *
  * This routine attempts to divide all interactions of the numType bondeds
@@ -100,7 +120,7 @@ static void divide_bondeds_by_locality(bonded_threading_t* bt, int numType, cons
         ind[f] = 0;
         /* Initialize the next atom index array */
         assert(!ild[f].il->empty());
-        at_ind[f] = ild[f].il->iatoms[1];
+        at_ind[f] = localityAtomIndex(ild[f].il->iatoms.data(), ild[f].nat, bt->useSpatialDivision);
     }
 
     nat_sum = 0;
@@ -139,7 +159,8 @@ static void divide_bondeds_by_locality(bonded_threading_t* bt, int numType, cons
              * in bonded interactions are usually in increasing order.
              * If they are not assigned in increasing order, the balancing
              * is still good, but the memory access and reduction cost will
-             * be higher.
+             * be higher. With spatial division the interactions have been
+             * sorted on their lowest atom index, which we then compare.
              */
             int f_min;
 
@@ -163,7 +184,8 @@ static void divide_bondeds_by_locality(bonded_threading_t* bt, int numType, cons
             /* Update the first unassigned atom index for this type */
             if (ind[f_min] < ild[f_min].il->size())
             {
-                at_ind[f_min] = ild[f_min].il->iatoms[ind[f_min] + 1];
+                at_ind[f_min] = localityAtomIndex(ild[f_min].il->iatoms.data() + ind[f_min],
+                                                  ild[f_min].nat, bt->useSpatialDivision);
             }
             else
             {
@@ -253,7 +275,8 @@ static void divide_bondeds_over_threads(bonded_threading_t*           bt,
                 bt->workDivision.setBound(fType, t, 0);
             }
         }
-        else if (numThreads <= bt->max_nthread_uniform || fType == F_DISRES)
+        else if ((numThreads <= bt->max_nthread_uniform && !bt->useSpatialDivision)
+                 || fType == F_DISRES)
         {
             /* On up to 4 threads, load balancing the bonded work
              * is more important than minimizing the reduction cost.
@@ -326,6 +349,86 @@ static void divide_bondeds_over_threads(bonded_threading_t*           bt,
     }
 }
 
+/*! \brief Stable sort of interactions \p begin to \p end in \p il on their lowest atom index
+ *
+ * \p order, \p key and \p buffer are working arrays.
+ */
+static void sortInteractionsOnLowestAtom(InteractionList*  il,
+                                         const int         nat,
+                                         const int         begin,
+                                         const int         end,
+                                         std::vector<int>* order,
+                                         std::vector<int>* key,
+                                         std::vector<int>* buffer)
+{
+    const int stride          = 1 + nat;
+    const int numInteractions = (end - begin) / stride;
+    if (numInteractions <= 1)
+    {
+        return;
+    }
+
+    int* iatoms = il->iatoms.data() + begin;
+
+    order->resize(numInteractions);
+    key->resize(numInteractions);
+    bool isSorted = true;
+    for (int i = 0; i < numInteractions; i++)
+    {
+        (*order)[i] = i;
+        (*key)[i]   = localityAtomIndex(iatoms + i * stride, nat, true);
+        isSorted    = isSorted && (i == 0 || (*key)[i - 1] <= (*key)[i]);
+    }
+    if (isSorted)
+    {
+        return;
+    }
+
+    /* A stable sort keeps multiple terms acting on the same atoms,
+     * such as multiple proper dihedrals, in their original order.
+     */
+    std::stable_sort(order->begin(), order->end(),
+                     [key](int a, int b) { return (*key)[a] < (*key)[b]; });
+
+    buffer->resize(end - begin);
+    for (int i = 0; i < numInteractions; i++)
+    {
+        std::copy(iatoms + (*order)[i] * stride, iatoms + ((*order)[i] + 1) * stride,
+                  buffer->begin() + i * stride);
+    }
+    std::copy(buffer->begin(), buffer->end(), iatoms);
+}
+
+void sortBondedInteractionsSpatially(InteractionDefinitions* idef)
+{
+    std::vector<int> order;
+    std::vector<int> key;
+    std::vector<int> buffer;
+
+    for (int ftype = 0; ftype < F_NRE; ftype++)
+    {
+        /* Distance and orientation restraints with the same label
+         * need to stay together and in order.
+         */
+        if (!ftype_is_bonded_potential(ftype) || ftype == F_DISRES || ftype == F_ORIRES)
+        {
+            continue;
+        }
+
+        InteractionList& il  = idef->il[ftype];
+        const int        nat = NRAL(ftype);
+        /* Perturbed interactions are stored after the non-perturbed ones,
+         * this division needs to be maintained.
+         */
+        const int numNonperturbed = (idef->ilsort == ilsortFE_SORTED
+                                             ? idef->numNonperturbedInteractions[ftype]
+                                             : il.size());
+
+        sortInteractionsOnLowestAtom(&il, nat, 0, numNonperturbed, &order, &key, &buffer);
+        sortInteractionsOnLowestAtom(&il, nat, numNonperturbed, il.size(), &order, &key, &buffer);
+    }
+}
+
 //! Construct a reduction mask for which parts (blocks) of the force array are touched on which thread task
 static void calc_bonded_reduction_mask(int                           natoms,
                                        f_thread_t*                   f_thread,
@@ -539,4 +642,11 @@ bonded_threading_t::bonded_threading_t(const int numThreads, const int numEnergy
     {
         max_nthread_uniform = max_nthread_uniform_default;
     }
+
+    useSpatialDivision = (getenv("GMX_BONDED_SPATIAL_DIVISION") != nullptr);
+    if (useSpatialDivision && fplog != nullptr)
+    {
+        fprintf(fplog,
+                "\nUsing spatially sorted division of bondeds over threads set by env.var.\n");
+    }
 }
@@ -49,6 +49,15 @@
 struct bonded_threading_t;
 class InteractionDefinitions;
 
+/*! \brief Sorts the bonded interactions of each type on their lowest atom index
+ *
+ * With domain decomposition the local atoms are ordered spatially,
+ * so this orders the interactions spatially. Perturbed interactions
+ * are kept after the non-perturbed ones. Distance and orientation
+ * restraints, which are grouped by label, are not reordered.
+ */
+void sortBondedInteractionsSpatially(InteractionDefinitions* idef);
+
 /*! \brief Divide the listed interactions over the threads and GPU
  *
  * Uses fr->nthreads for the number of threads, and sets up the
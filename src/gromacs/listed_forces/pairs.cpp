@@ -48,6 +48,8 @@
 
 #include <cmath>
 
+#include <vector>
+
 #include "gromacs/listed_forces/bonded.h"
 #include "gromacs/math/functions.h"
 #include "gromacs/math/vec.h"
@@ -73,6 +75,13 @@
 
 using namespace gmx; // TODO: Remove when this file is moved into gmx namespace
 
+/*! \brief Whether we issued a warning for a pair beyond the table limit
+ *
+ * This check isn't race free. But it doesn't matter because if a race occurs the only
+ * disadvantage is that the warning is printed twice.
+ */
+static gmx_bool warned_rlimit = FALSE;
+
 /*! \brief Issue a warning if a listed interaction is beyond a table limit */
 static void warning_rlimit(const rvec* x, int ai, int aj, int* global_atom_index, real r, real rlimit)
 {
@@ -355,7 +364,6 @@ static real do_pairs_general(int                 ftype,
     real            fscal, velec, vvdw;
     real*           energygrp_elec;
     real*           energygrp_vdw;
-    static gmx_bool warned_rlimit = FALSE;
     /* Free energy stuff */
     gmx_bool   bFreeEnergy;
     real       LFC[2], LFV[2], DLF[2], lfac_coul[2], lfac_vdw[2], dlfac_coul[2], dlfac_vdw[2];
@@ -476,8 +484,6 @@ static real do_pairs_general(int                 ftype,
 
         if (r2 >= fr->pairsTable->r * fr->pairsTable->r)
         {
-            /* This check isn't race free. But it doesn't matter because if a race occurs the only
-             * disadvantage is that the warning is printed twice */
             if (!warned_rlimit)
             {
                 warning_rlimit(x, ai, aj, global_atom_index, sqrt(r2), fr->pairsTable->r);
@@ -528,31 +534,53 @@ static real do_pairs_general(int                 ftype,
 /*! \brief Calculate pairs, only for plain-LJ + plain Coulomb normal type.
  *
  * This function is templated for real/SimdReal and for optimization.
+ * Energies are accumulated into the energy group matrices
+ * \p energygrp_elec and \p energygrp_vdw, when requested by \p flavor.
+ * The shift forces, when requested, are computed using plain-C code
+ * with \p pbcScalar, which should be nullptr when no PBC is used.
+ * Pairs involving perturbed atoms are not computed, but instead appended
+ * to \p freeEnergyPairs, when that is not nullptr.
  */
-template<typename T, int pack_size, typename pbc_type>
-static void do_pairs_simple(int              nbonds,
-                            const t_iatom    iatoms[],
-                            const t_iparams  iparams[],
-                            const rvec       x[],
-                            rvec4            f[],
-                            const pbc_type   pbc,
-                            const t_mdatoms* md,
-                            const real       scale_factor)
+template<BondedKernelFlavor flavor, typename T, int pack_size, typename pbc_type>
+static void do_pairs_simple(int                   ftype,
+                            int                   nbonds,
+                            const t_iatom         iatoms[],
+                            const t_iparams       iparams[],
+                            const rvec            x[],
+                            rvec4                 f[],
+                            rvec                  fshift[],
+                            const pbc_type        pbc,
+                            const t_pbc*          pbcScalar,
+                            const t_mdatoms*      md,
+                            const real            scale_factor,
+                            const real            tableRange,
+                            real*                 energygrp_elec,
+                            real*                 energygrp_vdw,
+                            std::vector<t_iatom>* freeEnergyPairs,
+                            int*                  global_atom_index)
 {
     const int nfa1 = 1 + 2;
 
     T six(6);
     T twelve(12);
     T ef(scale_factor);
+    T tableRange2(tableRange * tableRange);
+
+    /* With a single energy group we can sum energies over all pairs */
+    const bool haveSingleEnergyGroup = (md->nenergrp == 1);
+    T          velecSum(0);
+    T          vvdwSum(0);
 
 #if GMX_SIMD_HAVE_REAL
     alignas(GMX_SIMD_ALIGNMENT) std::int32_t ai[pack_size];
     alignas(GMX_SIMD_ALIGNMENT) std::int32_t aj[pack_size];
     alignas(GMX_SIMD_ALIGNMENT) real         coeff[3 * pack_size];
+    alignas(GMX_SIMD_ALIGNMENT) real         buf[3 * pack_size];
 #else
     std::int32_t ai[pack_size];
     std::int32_t aj[pack_size];
     real         coeff[3 * pack_size];
+    real         buf[3 * pack_size];
 #endif
 
     /* nbonds is #pairs*nfa1, here we step pack_size pairs */
@@ -570,9 +598,37 @@ static void do_pairs_simple(int              nbonds,
 
             if (i + s * nfa1 < nbonds)
             {
-                coeff[0 * pack_size + s] = iparams[itype].lj14.c6A;
-                coeff[1 * pack_size + s] = iparams[itype].lj14.c12A;
-                coeff[2 * pack_size + s] = md->chargeA[ai[s]] * md->chargeA[aj[s]];
+                switch (ftype)
+                {
+                    case F_LJ14:
+                        coeff[0 * pack_size + s] = iparams[itype].lj14.c6A;
+                        coeff[1 * pack_size + s] = iparams[itype].lj14.c12A;
+                        coeff[2 * pack_size + s] = md->chargeA[ai[s]] * md->chargeA[aj[s]];
+                        break;
+                    case F_LJC14_Q:
+                        coeff[0 * pack_size + s] = iparams[itype].ljc14.c6;
+                        coeff[1 * pack_size + s] = iparams[itype].ljc14.c12;
+                        coeff[2 * pack_size + s] = iparams[itype].ljc14.qi * iparams[itype].ljc14.qj
+                                                   * iparams[itype].ljc14.fqq;
+                        break;
+                    case F_LJC_PAIRS_NB:
+                        coeff[0 * pack_size + s] = iparams[itype].ljcnb.c6;
+                        coeff[1 * pack_size + s] = iparams[itype].ljcnb.c12;
+                        coeff[2 * pack_size + s] =
+                                iparams[itype].ljcnb.qi * iparams[itype].ljcnb.qj;
+                        break;
+                    default: GMX_RELEASE_ASSERT(false, "Unsupported pair interaction type");
+                }
+
+                if (freeEnergyPairs != nullptr && (md->bPerturbed[ai[s]] || md->bPerturbed[aj[s]]))
+                {
+                    /* Leave this pair to the free-energy kernel, zero its contribution here */
+                    freeEnergyPairs->insert(
+                            freeEnergyPairs->end(), iatoms + iu, iatoms + iu + nfa1);
+                    coeff[0 * pack_size + s] = 0;
+                    coeff[1 * pack_size + s] = 0;
+                    coeff[2 * pack_size + s] = 0;
+                }
 
                 /* Avoid indexing the iatoms array out of bounds.
                  * We pad the coordinate indices with the last atom pair.
@@ -600,15 +656,28 @@ static void do_pairs_simple(int              nbonds,
         T c12 = load<T>(coeff + 1 * pack_size);
         T qq  = load<T>(coeff + 2 * pack_size);
 
-        /* We could save these operations by storing 6*C6,12*C12 */
-        c6  = six * c6;
-        c12 = twelve * c12;
-
         T dr[DIM];
         pbc_dx_aiuc(pbc, xi, xj, dr);
 
-        T rsq   = dr[XX] * dr[XX] + dr[YY] * dr[YY] + dr[ZZ] * dr[ZZ];
-        T rinv  = gmx::invsqrt(rsq);
+        T rsq = dr[XX] * dr[XX] + dr[YY] * dr[YY] + dr[ZZ] * dr[ZZ];
+
+        /* Pairs beyond the table range are skipped, as in do_pairs_general() */
+        const auto beyondTableRange = (tableRange2 <= rsq);
+        if (anyTrue(beyondTableRange))
+        {
+            store(buf, rsq);
+            for (int s = 0; s < pack_size; s++)
+            {
+                if (i + s * nfa1 < nbonds && buf[s] >= tableRange * tableRange && !warned_rlimit)
+                {
+                    warning_rlimit(x, ai[s], aj[s], global_atom_index, std::sqrt(buf[s]),
+                                   tableRange);
+                    warned_rlimit = TRUE;
+                }
+            }
+        }
+
+        T rinv  = selectByNotMask(gmx::invsqrt(rsq), beyondTableRange);
         T rinv2 = rinv * rinv;
         T rinv6 = rinv2 * rinv2 * rinv2;
 
@@ -616,7 +685,7 @@ static void do_pairs_simple(int              nbonds,
         T cfr = ef * qq * rinv;
 
         /* Calculate the LJ force * r and add it to the Coulomb part */
-        T fr = gmx::fma(fms(c12, rinv6, c6), rinv6, cfr);
+        T fr = gmx::fma(fms(twelve * c12, rinv6, six * c6), rinv6, cfr);
 
         T finvr = fr * rinv2;
         T fx    = finvr * dr[XX];
@@ -629,6 +698,148 @@ static void do_pairs_simple(int              nbonds,
          */
         transposeScatterIncrU<4>(reinterpret_cast<real*>(f), ai, fx, fy, fz);
         transposeScatterDecrU<4>(reinterpret_cast<real*>(f), aj, fx, fy, fz);
+
+        if (computeEnergy(flavor))
+        {
+            T velec = cfr;
+            T vvdw  = fms(c12, rinv6, c6) * rinv6;
+            if (haveSingleEnergyGroup)
+            {
+                velecSum = velecSum + velec;
+                vvdwSum  = vvdwSum + vvdw;
+            }
+            else
+            {
+                store(buf + 0 * pack_size, velec);
+                store(buf + 1 * pack_size, vvdw);
+                for (int s = 0; s < pack_size; s++)
+                {
+                    const int gid = GID(md->cENER[ai[s]], md->cENER[aj[s]], md->nenergrp);
+                    energygrp_elec[gid] += buf[0 * pack_size + s];
+                    energygrp_vdw[gid] += buf[1 * pack_size + s];
+                }
+            }
+        }
+
+        if (computeVirial(flavor) && pbcScalar != nullptr)
+        {
+            store(buf + XX * pack_size, fx);
+            store(buf + YY * pack_size, fy);
+            store(buf + ZZ * pack_size, fz);
+            for (int s = 0; s < pack_size; s++)
+            {
+                rvec      dx;
+                const int fshift_index = pbc_dx_aiuc(pbcScalar, x[ai[s]], x[aj[s]], dx);
+                if (fshift_index != CENTRAL)
+                {
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        fshift[fshift_index][d] += buf[d * pack_size + s];
+                        fshift[CENTRAL][d] -= buf[d * pack_size + s];
+                    }
+                }
+            }
+        }
+    }
+
+    if (computeEnergy(flavor) && haveSingleEnergyGroup)
+    {
+        energygrp_elec[0] += reduce(velecSum);
+        energygrp_vdw[0] += reduce(vvdwSum);
+    }
+}
+
+/*! \brief Calculate pairs with do_pairs_simple() for the flavor \p flavor
+ *
+ * Pairs that need the free-energy kernel are appended to \p freeEnergyPairs,
+ * when not nullptr.
+ */
+template<BondedKernelFlavor flavor>
+static void do_pairs_simple_flavor(int                   ftype,
+                                   int                   nbonds,
+                                   const t_iatom         iatoms[],
+                                   const t_iparams       iparams[],
+                                   const rvec            x[],
+                                   rvec4                 f[],
+                                   rvec                  fshift[],
+                                   const struct t_pbc*   pbc,
+                                   const t_mdatoms*      md,
+                                   const t_forcerec*     fr,
+                                   gmx_grppairener_t*    grppener,
+                                   std::vector<t_iatom>* freeEnergyPairs,
+                                   int*                  global_atom_index)
+{
+    const bool isLJ14Type     = (ftype == F_LJ14 || ftype == F_LJC14_Q);
+    real*      energygrp_elec = grppener->ener[isLJ14Type ? egCOUL14 : egCOULSR].data();
+    real*      energygrp_vdw  = grppener->ener[isLJ14Type ? egLJ14 : egLJSR].data();
+
+    /* The plain Coulomb scaling factor, for F_LJ14 this includes fudgeQQ */
+    const real   scaleFactor = fr->ic->epsfac * (ftype == F_LJ14 ? fr->fudgeQQ : 1.0_real);
+    const real   tableRange  = fr->pairsTable->r;
+    const t_pbc* pbcScalar   = fr->bMolPBC ? pbc : nullptr;
+
+#if GMX_SIMD_HAVE_REAL
+    if (fr->use_simd_kernels)
+    {
+        alignas(GMX_SIMD_ALIGNMENT) real pbc_simd[9 * GMX_SIMD_REAL_WIDTH];
+        set_pbc_simd(pbc, pbc_simd);
+
+        do_pairs_simple<flavor, SimdReal, GMX_SIMD_REAL_WIDTH, const real*>(
+                ftype, nbonds, iatoms, iparams, x, f, fshift, pbc_simd, pbcScalar, md, scaleFactor,
+                tableRange, energygrp_elec, energygrp_vdw, freeEnergyPairs, global_atom_index);
+    }
+    else
+#endif
+    {
+        /* This construct is needed because pbc_dx_aiuc doesn't accept pbc=NULL */
+        t_pbc        pbc_no;
+        const t_pbc* pbc_nonnull;
+
+        if (pbc != nullptr)
+        {
+            pbc_nonnull = pbc;
+        }
+        else
+        {
+            set_pbc(&pbc_no, PbcType::No, nullptr);
+            pbc_nonnull = &pbc_no;
+        }
+
+        do_pairs_simple<flavor, real, 1, const t_pbc*>(
+                ftype, nbonds, iatoms, iparams, x, f, fshift, pbc_nonnull, pbcScalar, md,
+                scaleFactor, tableRange, energygrp_elec, energygrp_vdw, freeEnergyPairs,
+                global_atom_index);
+    }
+}
+
+/*! \brief Calculate pairs with do_pairs_general() with energies and, when requested, the virial */
+static void do_pairs_general_energy(int                      ftype,
+                                    int                      nbonds,
+                                    const t_iatom            iatoms[],
+                                    const t_iparams          iparams[],
+                                    const rvec               x[],
+                                    rvec4                    f[],
+                                    rvec                     fshift[],
+                                    const struct t_pbc*      pbc,
+                                    const real*              lambda,
+                                    real*                    dvdl,
+                                    const t_mdatoms*         md,
+                                    const t_forcerec*        fr,
+                                    const gmx::StepWorkload& stepWork,
+                                    gmx_grppairener_t*       grppener,
+                                    int*                     global_atom_index)
+{
+    if (stepWork.computeVirial)
+    {
+        do_pairs_general<BondedKernelFlavor::ForcesAndVirialAndEnergy>(
+                ftype, nbonds, iatoms, iparams, x, f, fshift, pbc, lambda, dvdl, md, fr, grppener,
+                global_atom_index);
+    }
+    else
+    {
+        do_pairs_general<BondedKernelFlavor::ForcesAndEnergy>(ftype, nbonds, iatoms, iparams, x, f,
+                                                              fshift, pbc, lambda, dvdl, md, fr,
+                                                              grppener, global_atom_index);
     }
 }
 
@@ -645,62 +856,56 @@ void do_pairs(int                      ftype,
               real*                    dvdl,
               const t_mdatoms*         md,
               const t_forcerec*        fr,
-              const bool               havePerturbedInteractions,
+              const int                numNonperturbed,
               const gmx::StepWorkload& stepWork,
               gmx_grppairener_t*       grppener,
               int*                     global_atom_index)
 {
-    if (ftype == F_LJ14 && fr->ic->vdwtype != evdwUSER && !EEL_USER(fr->ic->eeltype)
-        && !havePerturbedInteractions && (!stepWork.computeVirial && !stepWork.computeEnergy))
+    if (fr->ic->vdwtype != evdwUSER && !EEL_USER(fr->ic->eeltype))
     {
-        /* We use a fast code-path for plain LJ 1-4 without FEP.
-         *
-         * TODO: Add support for energies (straightforward) and virial
-         * in the SIMD template. For the virial it's inconvenient to store
-         * the force sums for the shifts and we should directly calculate
-         * and sum the virial for the shifts. But we should do this
-         * at once for the angles and dihedrals as well.
+        /* We use a fast code-path for plain LJ + plain Coulomb pairs.
+         * Only perturbed pairs, which are sorted to the end of the list,
+         * and pairs involving perturbed atoms need the free-energy kernel.
          */
-#if GMX_SIMD_HAVE_REAL
-        if (fr->use_simd_kernels)
-        {
-            alignas(GMX_SIMD_ALIGNMENT) real pbc_simd[9 * GMX_SIMD_REAL_WIDTH];
-            set_pbc_simd(pbc, pbc_simd);
+        const bool checkPerturbedAtoms = (fr->efep != efepNO && md->nPerturbed != 0);
 
-            do_pairs_simple<SimdReal, GMX_SIMD_REAL_WIDTH, const real*>(
-                    nbonds, iatoms, iparams, x, f, pbc_simd, md, fr->ic->epsfac * fr->fudgeQQ);
+        std::vector<t_iatom>  freeEnergyPairs;
+        std::vector<t_iatom>* freeEnergyPairsPtr = checkPerturbedAtoms ? &freeEnergyPairs : nullptr;
+        if (stepWork.computeVirial)
+        {
+            do_pairs_simple_flavor<BondedKernelFlavor::ForcesAndVirialAndEnergySimdWhenAvailable>(
+                    ftype, numNonperturbed, iatoms, iparams, x, f, fshift, pbc, md, fr, grppener,
+                    freeEnergyPairsPtr, global_atom_index);
+        }
+        else if (stepWork.computeEnergy)
+        {
+            do_pairs_simple_flavor<BondedKernelFlavor::ForcesAndEnergySimdWhenAvailable>(
+                    ftype, numNonperturbed, iatoms, iparams, x, f, fshift, pbc, md, fr, grppener,
+                    freeEnergyPairsPtr, global_atom_index);
         }
         else
-#endif
         {
-            /* This construct is needed because pbc_dx_aiuc doesn't accept pbc=NULL */
-            t_pbc        pbc_no;
-            const t_pbc* pbc_nonnull;
-
-            if (pbc != nullptr)
-            {
-                pbc_nonnull = pbc;
-            }
-            else
-            {
-                set_pbc(&pbc_no, PbcType::No, nullptr);
-                pbc_nonnull = &pbc_no;
-            }
+            do_pairs_simple_flavor<BondedKernelFlavor::ForcesSimdWhenAvailable>(
+                    ftype, numNonperturbed, iatoms, iparams, x, f, fshift, pbc, md, fr, grppener,
+                    freeEnergyPairsPtr, global_atom_index);
+        }
 
-            do_pairs_simple<real, 1, const t_pbc*>(nbonds, iatoms, iparams, x, f, pbc_nonnull, md,
-                                                   fr->ic->epsfac * fr->fudgeQQ);
+        if (!freeEnergyPairs.empty())
+        {
+            do_pairs_general_energy(ftype, freeEnergyPairs.size(), freeEnergyPairs.data(), iparams,
+                                    x, f, fshift, pbc, lambda, dvdl, md, fr, stepWork, grppener,
+                                    global_atom_index);
+        }
+        if (numNonperturbed < nbonds)
+        {
+            do_pairs_general_energy(ftype, nbonds - numNonperturbed, iatoms + numNonperturbed,
+                                    iparams, x, f, fshift, pbc, lambda, dvdl, md, fr, stepWork,
+                                    grppener, global_atom_index);
         }
-    }
-    else if (stepWork.computeVirial)
-    {
-        do_pairs_general<BondedKernelFlavor::ForcesAndVirialAndEnergy>(
-                ftype, nbonds, iatoms, iparams, x, f, fshift, pbc, lambda, dvdl, md, fr, grppener,
-                global_atom_index);
     }
     else
     {
-        do_pairs_general<BondedKernelFlavor::ForcesAndEnergy>(ftype, nbonds, iatoms, iparams, x, f,
-                                                              fshift, pbc, lambda, dvdl, md, fr,
-                                                              grppener, global_atom_index);
+        do_pairs_general_energy(ftype, nbonds, iatoms, iparams, x, f, fshift, pbc, lambda, dvdl, md,
+                                fr, stepWork, grppener, global_atom_index);
     }
 }
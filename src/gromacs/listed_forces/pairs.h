@@ -62,6 +62,8 @@ class StepWorkload;
 /*! \brief Calculate VdW/charge listed pair interactions (usually 1-4
  * interactions).
  *
+ * The first \p numNonperturbed entries of \p iatoms should contain
+ * pairs without perturbed parameters or charges.
  * global_atom_index is only passed for printing error messages.
  */
 void do_pairs(int                      ftype,
@@ -76,7 +78,7 @@ void do_pairs(int                      ftype,
               real*                    dvdl,
               const t_mdatoms*         md,
               const t_forcerec*        fr,
-              bool                     havePerturbedPairs,
+              int                      numNonperturbed,
               const gmx::StepWorkload& stepWork,
               gmx_grppairener_t*       grppener,
               int*                     global_atom_index);
@@ -47,8 +47,13 @@
 
 #include "position_restraints.h"
 
+#include "config.h"
+
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+
+#include <vector>
 
 #include "gromacs/gmxlib/nrnb.h"
 #include "gromacs/math/functions.h"
@@ -59,16 +64,97 @@
 #include "gromacs/mdtypes/inputrec.h"
 #include "gromacs/mdtypes/md_enums.h"
 #include "gromacs/pbcutil/pbc.h"
-#include "gromacs/timing/wallcycle.h"
+#include "gromacs/pbcutil/pbc_simd.h"
+#include "gromacs/simd/simd.h"
 #include "gromacs/topology/idef.h"
+#include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 
-struct gmx_wallcycle;
+void PosresOutput::reset(int numLambdas)
+{
+    energy.assign(numLambdas, 0);
+    dvdlambda.assign(numLambdas, 0);
+    clear_rvec(virial);
+}
 
 namespace
 {
 
+//! The number of entries in the interaction list per (flat-bottomed) position restraint
+constexpr int c_posresStride = 2;
+
+/*! \brief Returns the COM of the reference positions scaled with the box
+ *
+ * Only the first \p npbcdim dimensions are set, the others are zero.
+ */
+void scaledReferenceCom(const t_pbc* pbc,
+                        int          refcoord_scaling,
+                        int          npbcdim,
+                        const rvec   com,
+                        rvec         com_sc)
+{
+    clear_rvec(com_sc);
+    if (refcoord_scaling == erscCOM)
+    {
+        for (int m = 0; m < npbcdim; m++)
+        {
+            assert(npbcdim <= DIM);
+            for (int d = m; d < npbcdim; d++)
+            {
+                com_sc[m] += com[d] * pbc->box[d][m];
+            }
+        }
+    }
+}
+
+/*! \brief Runs \p kernel for the restraints in \p il divided over \p numThreads threads
+ *
+ * Each thread gets a contiguous range of restraints and accumulates into its own
+ * element of \p threadOutput, set up for \p numLambdas lambda values. The outputs
+ * are summed in thread order into the first element, which is returned.
+ */
+template<typename Kernel>
+const PosresOutput& runOverThreads(const InteractionList&     il,
+                                   int                        numThreads,
+                                   int                        numLambdas,
+                                   std::vector<PosresOutput>* threadOutput,
+                                   Kernel                     kernel)
+{
+    const int numRestraints = il.size() / c_posresStride;
+
+    threadOutput->resize(numThreads);
+
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+    for (int thread = 0; thread < numThreads; thread++)
+    {
+        try
+        {
+            const int begin = c_posresStride * ((numRestraints * thread) / numThreads);
+            const int end   = c_posresStride * ((numRestraints * (thread + 1)) / numThreads);
+
+            (*threadOutput)[thread].reset(numLambdas);
+            kernel(begin, end, &(*threadOutput)[thread]);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+    }
+
+    PosresOutput& output = (*threadOutput)[0];
+    for (int thread = 1; thread < numThreads; thread++)
+    {
+        const PosresOutput& threadOut = (*threadOutput)[thread];
+        for (int l = 0; l < numLambdas; l++)
+        {
+            output.energy[l] += threadOut.energy[l];
+            output.dvdlambda[l] += threadOut.dvdlambda[l];
+        }
+        rvec_inc(output.virial, threadOut.virial);
+    }
+
+    return output;
+}
+
 /*! \brief returns dx, rdist, and dpdl for functions posres() and fbposres()
  */
 void posres_dx(const rvec   x,
@@ -185,46 +271,33 @@ real do_fbposres_cylinder(int fbdim, rvec fm, rvec dx, real rfb, real kk, gmx_bo
 }
 
 /*! \brief Compute energies and forces for flat-bottomed position restraints
+ * \p begin to \p end in \p forceatoms
  *
- * Returns the flat-bottomed potential. Same PBC treatment as in
- * normal position restraints */
-real fbposres(int                   nbonds,
-              const t_iatom         forceatoms[],
-              const t_iparams       forceparams[],
-              const rvec            x[],
-              gmx::ForceWithVirial* forceWithVirial,
-              const t_pbc*          pbc,
-              int                   refcoord_scaling,
-              PbcType               pbcType,
-              const rvec            com)
+ * Accumulates the flat-bottomed potential and virial in \p output.
+ * Same PBC treatment as in normal position restraints */
+void fbposres(int             begin,
+              int             end,
+              const t_iatom   forceatoms[],
+              const t_iparams forceparams[],
+              const rvec      x[],
+              rvec            f[],
+              const t_pbc*    pbc,
+              int             refcoord_scaling,
+              int             npbcdim,
+              const rvec      com_sc,
+              PosresOutput*   output)
 /* compute flat-bottomed positions restraints */
 {
-    int              i, ai, m, d, type, npbcdim = 0, fbdim;
+    int              i, ai, m, type, fbdim;
     const t_iparams* pr;
     real             kk, v;
     real             dr, dr2, rfb, rfb2, fact;
-    rvec             com_sc, rdist, dx, dpdl, fm;
+    rvec             rdist, dx, dpdl, fm;
     gmx_bool         bInvert;
 
-    npbcdim = numPbcDimensions(pbcType);
-    GMX_ASSERT((pbcType == PbcType::No) == (npbcdim == 0), "");
-    if (refcoord_scaling == erscCOM)
-    {
-        clear_rvec(com_sc);
-        for (m = 0; m < npbcdim; m++)
-        {
-            assert(npbcdim <= DIM);
-            for (d = m; d < npbcdim; d++)
-            {
-                com_sc[m] += com[d] * pbc->box[d][m];
-            }
-        }
-    }
-
-    rvec* f      = as_rvec_array(forceWithVirial->force_.data());
-    real  vtot   = 0.0;
-    rvec  virial = { 0 };
-    for (i = 0; (i < nbonds);)
+    real vtot   = 0.0;
+    rvec virial = { 0 };
+    for (i = begin; (i < end);)
     {
         type = forceatoms[i++];
         ai   = forceatoms[i++];
@@ -308,97 +381,244 @@ real fbposres(int                   nbonds,
         }
     }
 
-    forceWithVirial->addVirialContribution(virial);
-
-    return vtot;
+    output->energy[0] += vtot;
+    rvec_inc(output->virial, virial);
 }
 
 
-/*! \brief Compute energies and forces, when requested, for position restraints
+/*! \brief Compute energies and forces for position restraints \p begin to \p end in \p forceatoms
+ *
+ * Energies and dV/dlambda are accumulated in \p output for all values in
+ * \p lambdas, forces and the virial only for the first value.
  *
  * Note that position restraints require a different pbc treatment
  * from other bondeds */
-template<bool computeForce>
-real posres(int                   nbonds,
-            const t_iatom         forceatoms[],
-            const t_iparams       forceparams[],
-            const rvec            x[],
-            gmx::ForceWithVirial* forceWithVirial,
-            const struct t_pbc*   pbc,
-            real                  lambda,
-            real*                 dvdlambda,
-            int                   refcoord_scaling,
-            PbcType               pbcType,
-            const rvec            comA,
-            const rvec            comB)
+void posres(int                       begin,
+            int                       end,
+            const t_iatom             forceatoms[],
+            const t_iparams           forceparams[],
+            const rvec                x[],
+            rvec                      f[],
+            const struct t_pbc*       pbc,
+            gmx::ArrayRef<const real> lambdas,
+            int                       refcoord_scaling,
+            int                       npbcdim,
+            const rvec                comA_sc,
+            const rvec                comB_sc,
+            PosresOutput*             output)
 {
-    int              i, ai, m, d, type, npbcdim = 0;
+    int              i, ai, m, type;
     const t_iparams* pr;
     real             kk, fm;
-    rvec             comA_sc, comB_sc, rdist, dpdl, dx;
+    rvec             rdist, dpdl, dx;
 
-    npbcdim = numPbcDimensions(pbcType);
-    GMX_ASSERT((pbcType == PbcType::No) == (npbcdim == 0), "");
-    if (refcoord_scaling == erscCOM)
+    /* Use intermediate virial buffer to reduce reduction rounding errors */
+    rvec virial = { 0 };
+    for (i = begin; (i < end);)
     {
-        clear_rvec(comA_sc);
-        clear_rvec(comB_sc);
-        for (m = 0; m < npbcdim; m++)
+        type = forceatoms[i++];
+        ai   = forceatoms[i++];
+        pr   = &forceparams[type];
+
+        for (gmx::index l = 0; l < lambdas.ssize(); l++)
         {
-            assert(npbcdim <= DIM);
-            for (d = m; d < npbcdim; d++)
+            const real lambda = lambdas[l];
+            const real L1     = 1.0 - lambda;
+
+            /* return dx, rdist, and dpdl */
+            posres_dx(x[ai], forceparams[type].posres.pos0A, forceparams[type].posres.pos0B,
+                      comA_sc, comB_sc, lambda, pbc, refcoord_scaling, npbcdim, dx, rdist, dpdl);
+
+            real v    = 0;
+            real dvdl = 0;
+            for (m = 0; (m < DIM); m++)
             {
-                comA_sc[m] += comA[d] * pbc->box[d][m];
-                comB_sc[m] += comB[d] * pbc->box[d][m];
+                kk = L1 * pr->posres.fcA[m] + lambda * pr->posres.fcB[m];
+                fm = -kk * dx[m];
+                v += 0.5 * kk * dx[m] * dx[m];
+                dvdl += 0.5 * (pr->posres.fcB[m] - pr->posres.fcA[m]) * dx[m] * dx[m]
+                        + fm * dpdl[m];
+
+                /* Here we correct for the pbc_dx which included rdist */
+                if (l == 0)
+                {
+                    f[ai][m] += fm;
+                    virial[m] -= 0.5 * (dx[m] + rdist[m]) * fm;
+                }
             }
+            output->energy[l] += v;
+            output->dvdlambda[l] += dvdl;
         }
     }
 
-    const real L1 = 1.0 - lambda;
+    rvec_inc(output->virial, virial);
+}
+
+#if GMX_SIMD_HAVE_REAL
+
+//! Returns whether the SIMD position restraint kernel can be used with \p pbc
+bool canUsePosresSimd(const t_pbc* pbc)
+{
+    /* The SIMD PBC correction only gives the shortest distance for rectangular boxes */
+    return (pbc == nullptr || (pbc->pbcType != PbcType::Screw && !TRICLINIC(pbc->box)));
+}
+
+/*! \brief Computes position restraints using SIMD intrinsics
+ *
+ * As plain-C posres(), but computes GMX_SIMD_REAL_WIDTH restraints at once.
+ * Can only be used with rectangular boxes, see canUsePosresSimd().
+ */
+void posresSimd(int                       begin,
+                int                       end,
+                const t_iatom             forceatoms[],
+                const t_iparams           forceparams[],
+                const rvec                x[],
+                rvec                      f[],
+                const struct t_pbc*       pbc,
+                gmx::ArrayRef<const real> lambdas,
+                int                       refcoord_scaling,
+                int                       npbcdim,
+                const rvec                comA_sc,
+                const rvec                comB_sc,
+                PosresOutput*             output)
+{
+    using namespace gmx;
+
+    constexpr int c_width = GMX_SIMD_REAL_WIDTH;
+    /* The parameter buffer stores pos0A, fcA, pos0B and fcB */
+    constexpr int c_pos0A = 0;
+    constexpr int c_fcA   = DIM * c_width;
+    constexpr int c_pos0B = 2 * DIM * c_width;
+    constexpr int c_fcB   = 3 * DIM * c_width;
 
-    rvec* f;
-    if (computeForce)
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t ai[c_width];
+    alignas(GMX_SIMD_ALIGNMENT) real         param[4 * DIM * c_width];
+    alignas(GMX_SIMD_ALIGNMENT) real         fm[DIM * c_width];
+    alignas(GMX_SIMD_ALIGNMENT) real         pbc_simd[9 * c_width];
+
+    set_pbc_simd(pbc, pbc_simd);
+
+    /* Set up the dimension dependent reference position treatment of posres_dx().
+     * The reference position is com + pos, where pos is scaled with the box
+     * with erscALL. The part pos is stored in rdist, unless it is part of ref.
+     */
+    real posScale[DIM];
+    bool posIsInRef[DIM];
+    for (int m = 0; m < DIM; m++)
     {
-        GMX_ASSERT(forceWithVirial != nullptr, "When forces are requested we need a force object");
-        f = as_rvec_array(forceWithVirial->force_.data());
+        if (m < npbcdim)
+        {
+            posScale[m]   = (refcoord_scaling == erscALL ? pbc->box[m][m] : 1);
+            posIsInRef[m] = (refcoord_scaling == erscALL);
+        }
+        else
+        {
+            posScale[m]   = 1;
+            posIsInRef[m] = true;
+        }
     }
-    real vtot = 0.0;
-    /* Use intermediate virial buffer to reduce reduction rounding errors */
-    rvec virial = { 0 };
-    for (i = 0; (i < nbonds);)
+
+    const SimdReal half(0.5);
+
+    SimdReal virial_S[DIM] = { setZero(), setZero(), setZero() };
+
+    for (int i = begin; i < end; i += c_width * c_posresStride)
     {
-        type = forceatoms[i++];
-        ai   = forceatoms[i++];
-        pr   = &forceparams[type];
+        /* Collect the atoms and parameters for c_width restraints.
+         * iu indexes into forceatoms, we should not let iu go beyond end.
+         */
+        int iu = i;
+        for (int s = 0; s < c_width; s++)
+        {
+            const int type = forceatoms[iu];
+            ai[s]          = forceatoms[iu + 1];
 
-        /* return dx, rdist, and dpdl */
-        posres_dx(x[ai], forceparams[type].posres.pos0A, forceparams[type].posres.pos0B, comA_sc,
-                  comB_sc, lambda, pbc, refcoord_scaling, npbcdim, dx, rdist, dpdl);
+            /* At the end fill the arrays with the last atom and 0 params */
+            const bool isValid = (i + s * c_posresStride < end);
+            for (int m = 0; m < DIM; m++)
+            {
+                const t_iparams& pr              = forceparams[type];
+                param[c_pos0A + m * c_width + s] = isValid ? pr.posres.pos0A[m] * posScale[m] : 0;
+                param[c_fcA + m * c_width + s]   = isValid ? pr.posres.fcA[m] : 0;
+                param[c_pos0B + m * c_width + s] = isValid ? pr.posres.pos0B[m] * posScale[m] : 0;
+                param[c_fcB + m * c_width + s]   = isValid ? pr.posres.fcB[m] : 0;
+            }
+            if (iu + c_posresStride < end)
+            {
+                iu += c_posresStride;
+            }
+        }
 
-        for (m = 0; (m < DIM); m++)
+        SimdReal x_S[DIM];
+        gatherLoadUTranspose<3>(reinterpret_cast<const real*>(x), ai, &x_S[XX], &x_S[YY], &x_S[ZZ]);
+
+        for (gmx::index l = 0; l < lambdas.ssize(); l++)
         {
-            kk = L1 * pr->posres.fcA[m] + lambda * pr->posres.fcB[m];
-            fm = -kk * dx[m];
-            vtot += 0.5 * kk * dx[m] * dx[m];
-            *dvdlambda += 0.5 * (pr->posres.fcB[m] - pr->posres.fcA[m]) * dx[m] * dx[m] + fm * dpdl[m];
+            const real     lambda = lambdas[l];
+            const real     L1     = 1.0 - lambda;
+            const SimdReal lambda_S(lambda);
+            const SimdReal L1_S(L1);
+
+            SimdReal dx_S[DIM];
+            SimdReal rdist_S[DIM];
+            SimdReal dpdl_S[DIM];
+            for (int m = 0; m < DIM; m++)
+            {
+                const SimdReal posA_S = load<SimdReal>(param + c_pos0A + m * c_width);
+                const SimdReal posB_S = load<SimdReal>(param + c_pos0B + m * c_width);
+                const SimdReal pos_S  = L1_S * posA_S + lambda_S * posB_S;
 
-            /* Here we correct for the pbc_dx which included rdist */
-            if (computeForce)
+                dx_S[m]    = x_S[m] - SimdReal(L1 * comA_sc[m] + lambda * comB_sc[m]) - pos_S;
+                rdist_S[m] = (posIsInRef[m] ? setZero() : pos_S);
+                dpdl_S[m]  = SimdReal(comB_sc[m] - comA_sc[m]) + posB_S - posA_S;
+            }
+
+            pbc_correct_dx_simd(&dx_S[XX], &dx_S[YY], &dx_S[ZZ], pbc_simd);
+
+            SimdReal v_S    = setZero();
+            SimdReal dvdl_S = setZero();
+            for (int m = 0; m < DIM; m++)
             {
-                f[ai][m] += fm;
-                virial[m] -= 0.5 * (dx[m] + rdist[m]) * fm;
+                const SimdReal fcA_S = load<SimdReal>(param + c_fcA + m * c_width);
+                const SimdReal fcB_S = load<SimdReal>(param + c_fcB + m * c_width);
+                const SimdReal kk_S  = L1_S * fcA_S + lambda_S * fcB_S;
+                const SimdReal fm_S  = -kk_S * dx_S[m];
+                const SimdReal dx2_S = dx_S[m] * dx_S[m];
+
+                v_S    = v_S + half * kk_S * dx2_S;
+                dvdl_S = dvdl_S + half * (fcB_S - fcA_S) * dx2_S + fm_S * dpdl_S[m];
+
+                if (l == 0)
+                {
+                    /* Here we correct for the pbc_dx which included rdist */
+                    virial_S[m] = virial_S[m] - half * (dx_S[m] + rdist_S[m]) * fm_S;
+                    store(fm + m * c_width, fm_S);
+                }
+            }
+            output->energy[l] += reduce(v_S);
+            output->dvdlambda[l] += reduce(dvdl_S);
+        }
+
+        /* Scatter the forces lane by lane, so we never touch atoms
+         * beyond the end of the list and duplicate atoms are handled.
+         */
+        for (int s = 0; s < c_width && i + s * c_posresStride < end; s++)
+        {
+            for (int m = 0; m < DIM; m++)
+            {
+                f[ai[s]][m] += fm[m * c_width + s];
             }
         }
     }
 
-    if (computeForce)
+    for (int m = 0; m < DIM; m++)
     {
-        forceWithVirial->addVirialContribution(virial);
+        output->virial[m] += reduce(virial_S[m]);
     }
-
-    return vtot;
 }
 
+#endif // GMX_SIMD_HAVE_REAL
+
 } // namespace
 
 void posres_wrapper(t_nrnb*                       nrnb,
@@ -407,49 +627,74 @@ void posres_wrapper(t_nrnb*                       nrnb,
                     const rvec*                   x,
                     gmx_enerdata_t*               enerd,
                     const real*                   lambda,
+                    const t_lambda*               fepvals,
                     const t_forcerec*             fr,
+                    int                           numThreads,
+                    std::vector<PosresOutput>*    threadOutput,
                     gmx::ForceWithVirial*         forceWithVirial)
 {
-    real v, dvdl;
-
-    dvdl = 0;
-    v    = posres<true>(idef.il[F_POSRES].size(), idef.il[F_POSRES].iatoms.data(),
-                     idef.iparams_posres.data(), x, forceWithVirial,
-                     fr->pbcType == PbcType::No ? nullptr : pbc, lambda[efptRESTRAINT], &dvdl,
-                     fr->rc_scaling, fr->pbcType, fr->posres_com, fr->posres_comB);
-    enerd->term[F_POSRES] += v;
+    GMX_ASSERT(forceWithVirial != nullptr, "When forces are requested we need a force object");
+
+    const InteractionList& il = idef.il[F_POSRES];
+
+    /* The first lambda value is the current one, which we compute forces for,
+     * the foreign values follow, if requested.
+     */
+    auto&             foreignTerms = enerd->foreignLambdaTerms;
+    std::vector<real> lambdas      = { lambda[efptRESTRAINT] };
+    if (fepvals != nullptr)
+    {
+        for (int i = 0; i < foreignTerms.numLambdas(); i++)
+        {
+            lambdas.push_back(fepvals->all_lambda[efptRESTRAINT][i]);
+        }
+    }
+
+    const t_pbc* pbcPtr  = (fr->pbcType == PbcType::No ? nullptr : pbc);
+    const int    npbcdim = numPbcDimensions(fr->pbcType);
+    GMX_ASSERT((fr->pbcType == PbcType::No) == (npbcdim == 0), "");
+    rvec comA_sc, comB_sc;
+    scaledReferenceCom(pbcPtr, fr->rc_scaling, npbcdim, fr->posres_com, comA_sc);
+    scaledReferenceCom(pbcPtr, fr->rc_scaling, npbcdim, fr->posres_comB, comB_sc);
+
+    rvec* f = as_rvec_array(forceWithVirial->force_.data());
+
+    bool useSimd = false;
+#if GMX_SIMD_HAVE_REAL
+    useSimd = (fr->use_simd_kernels && canUsePosresSimd(pbcPtr));
+#endif
+
+    const PosresOutput& output = runOverThreads(
+            il, numThreads, gmx::ssize(lambdas), threadOutput,
+            [&](int begin, int end, PosresOutput* threadOut) {
+#if GMX_SIMD_HAVE_REAL
+                if (useSimd)
+                {
+                    posresSimd(begin, end, il.iatoms.data(), idef.iparams_posres.data(), x, f,
+                               pbcPtr, lambdas, fr->rc_scaling, npbcdim, comA_sc, comB_sc,
+                               threadOut);
+                    return;
+                }
+#endif
+                posres(begin, end, il.iatoms.data(), idef.iparams_posres.data(), x, f, pbcPtr,
+                       lambdas, fr->rc_scaling, npbcdim, comA_sc, comB_sc, threadOut);
+            });
+
+    enerd->term[F_POSRES] += output.energy[0];
     /* If just the force constant changes, the FEP term is linear,
      * but if k changes, it is not.
      */
-    enerd->dvdl_nonlin[efptRESTRAINT] += dvdl;
-    inc_nrnb(nrnb, eNR_POSRES, gmx::exactDiv(idef.il[F_POSRES].size(), 2));
-}
-
-void posres_wrapper_lambda(struct gmx_wallcycle*         wcycle,
-                           const t_lambda*               fepvals,
-                           const InteractionDefinitions& idef,
-                           const struct t_pbc*           pbc,
-                           const rvec                    x[],
-                           gmx_enerdata_t*               enerd,
-                           const real*                   lambda,
-                           const t_forcerec*             fr)
-{
-    wallcycle_sub_start_nocount(wcycle, ewcsRESTRAINTS);
+    enerd->dvdl_nonlin[efptRESTRAINT] += output.dvdlambda[0];
+    forceWithVirial->addVirialContribution(output.virial);
+    inc_nrnb(nrnb, eNR_POSRES, gmx::exactDiv(il.size(), 2));
 
-    auto& foreignTerms = enerd->foreignLambdaTerms;
-    for (int i = 0; i < 1 + foreignTerms.numLambdas(); i++)
+    if (fepvals != nullptr)
     {
-        real dvdl = 0;
-
-        const real lambda_dum =
-                (i == 0 ? lambda[efptRESTRAINT] : fepvals->all_lambda[efptRESTRAINT][i - 1]);
-        const real v = posres<false>(idef.il[F_POSRES].size(), idef.il[F_POSRES].iatoms.data(),
-                                     idef.iparams_posres.data(), x, nullptr,
-                                     fr->pbcType == PbcType::No ? nullptr : pbc, lambda_dum, &dvdl,
-                                     fr->rc_scaling, fr->pbcType, fr->posres_com, fr->posres_comB);
-        foreignTerms.accumulate(i, v, dvdl);
+        for (gmx::index i = 0; i < gmx::ssize(lambdas); i++)
+        {
+            foreignTerms.accumulate(i, output.energy[i], output.dvdlambda[i]);
+        }
     }
-    wallcycle_sub_stop(wcycle, ewcsRESTRAINTS);
 }
 
 /*! \brief Helper function that wraps calls to fbposres for
@@ -460,13 +705,27 @@ void fbposres_wrapper(t_nrnb*                       nrnb,
                       const rvec*                   x,
                       gmx_enerdata_t*               enerd,
                       const t_forcerec*             fr,
+                      int                           numThreads,
+                      std::vector<PosresOutput>*    threadOutput,
                       gmx::ForceWithVirial*         forceWithVirial)
 {
-    real v;
+    const InteractionList& il = idef.il[F_FBPOSRES];
+
+    const t_pbc* pbcPtr  = (fr->pbcType == PbcType::No ? nullptr : pbc);
+    const int    npbcdim = numPbcDimensions(fr->pbcType);
+    GMX_ASSERT((fr->pbcType == PbcType::No) == (npbcdim == 0), "");
+    rvec com_sc;
+    scaledReferenceCom(pbcPtr, fr->rc_scaling, npbcdim, fr->posres_com, com_sc);
+
+    rvec* f = as_rvec_array(forceWithVirial->force_.data());
+
+    const PosresOutput& output = runOverThreads(
+            il, numThreads, 1, threadOutput, [&](int begin, int end, PosresOutput* threadOut) {
+                fbposres(begin, end, il.iatoms.data(), idef.iparams_fbposres.data(), x, f,
+                         pbcPtr, fr->rc_scaling, npbcdim, com_sc, threadOut);
+            });
 
-    v = fbposres(idef.il[F_FBPOSRES].size(), idef.il[F_FBPOSRES].iatoms.data(),
-                 idef.iparams_fbposres.data(), x, forceWithVirial,
-                 fr->pbcType == PbcType::No ? nullptr : pbc, fr->rc_scaling, fr->pbcType, fr->posres_com);
-    enerd->term[F_FBPOSRES] += v;
-    inc_nrnb(nrnb, eNR_FBPOSRES, gmx::exactDiv(idef.il[F_FBPOSRES].size(), 2));
+    enerd->term[F_FBPOSRES] += output.energy[0];
+    forceWithVirial->addVirialContribution(output.virial);
+    inc_nrnb(nrnb, eNR_FBPOSRES, gmx::exactDiv(il.size(), 2));
 }
@@ -50,11 +50,12 @@
 
 #include <stdio.h>
 
+#include <vector>
+
 #include "gromacs/math/vectypes.h"
 #include "gromacs/utility/real.h"
 
 struct gmx_enerdata_t;
-struct gmx_wallcycle;
 struct t_forcerec;
 class InteractionDefinitions;
 struct t_lambda;
@@ -66,35 +67,58 @@ namespace gmx
 class ForceWithVirial;
 }
 
-/*! \brief Helper function that wraps calls to posres */
+/*! \libinternal \brief Energies, dV/dlambda and virial accumulated by a thread
+ * over its range of (flat-bottomed) position restraints */
+struct PosresOutput
+{
+    //! Clears the accumulation buffers and sets them up for \p numLambdas lambda values
+    void reset(int numLambdas);
+
+    //! The potential energy for each lambda value
+    std::vector<real> energy;
+    //! dV/dlambda for each lambda value
+    std::vector<real> dvdlambda;
+    //! The diagonal virial contribution, for the first lambda value only
+    rvec virial;
+};
+
+/*! \brief Helper function that wraps calls to posres
+ *
+ * The restraints are divided over \p numThreads OpenMP threads, which
+ * write directly to the force buffer, so \p numThreads should be 1
+ * when an atom can be restrained more than once.
+ * When \p fepvals is not nullptr, the energies and dV/dlambda for
+ * all foreign lambda values are computed in the same pass over
+ * the restraints and accumulated in the foreign lambda terms of \p enerd.
+ * The per-thread output is accumulated in \p threadOutput, which is
+ * kept by the caller so it is not reallocated every step.
+ */
 void posres_wrapper(t_nrnb*                       nrnb,
                     const InteractionDefinitions& idef,
                     const struct t_pbc*           pbc,
                     const rvec*                   x,
                     gmx_enerdata_t*               enerd,
                     const real*                   lambda,
+                    const t_lambda*               fepvals,
                     const t_forcerec*             fr,
+                    int                           numThreads,
+                    std::vector<PosresOutput>*    threadOutput,
                     gmx::ForceWithVirial*         forceWithVirial);
 
-/*! \brief Helper function that wraps calls to posres for free-energy
-    pertubation */
-void posres_wrapper_lambda(struct gmx_wallcycle*         wcycle,
-                           const t_lambda*               fepvals,
-                           const InteractionDefinitions& idef,
-                           const struct t_pbc*           pbc,
-                           const rvec                    x[],
-                           gmx_enerdata_t*               enerd,
-                           const real*                   lambda,
-                           const t_forcerec*             fr);
-
-/*! \brief Helper function that wraps calls to fbposres for
-    free-energy perturbation */
+/*! \brief Helper function that wraps calls to fbposres
+ *
+ * The restraints are divided over \p numThreads OpenMP threads,
+ * with the same restriction and use of \p threadOutput as for
+ * posres_wrapper().
+ */
 void fbposres_wrapper(t_nrnb*                       nrnb,
                       const InteractionDefinitions& idef,
                       const struct t_pbc*           pbc,
                       const rvec*                   x,
                       gmx_enerdata_t*               enerd,
                       const t_forcerec*             fr,
+                      int                           numThreads,
+                      std::vector<PosresOutput>*    threadOutput,
                       gmx::ForceWithVirial*         forceWithVirial);
 
 #endif
@@ -580,12 +580,19 @@ protected:
          * kernel flavor and the potentially optimized, with SIMD and less output,
          * force only kernels. Note that we also run the optimized kernel for free-energy
          * input when lambda=0, as the force output should match the non free-energy case.
+         * The optimized kernels with energy and virial output do not compute dV/dlambda,
+         * so these are only run without free-energy input.
          */
         std::vector<BondedKernelFlavor> flavors = { BondedKernelFlavor::ForcesAndVirialAndEnergy };
         if (!input_.fep || lambda == 0)
         {
             flavors.push_back(BondedKernelFlavor::ForcesSimdWhenAvailable);
         }
+        if (!input_.fep)
+        {
+            flavors.push_back(BondedKernelFlavor::ForcesAndVirialAndEnergySimdWhenAvailable);
+            flavors.push_back(BondedKernelFlavor::ForcesAndEnergySimdWhenAvailable);
+        }
         for (const auto flavor : flavors)
         {
             SCOPED_TRACE("Testing bonded kernel flavor: " + c_bondedKernelFlavorStrings[flavor]);
@@ -0,0 +1,372 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the listed pair interaction kernels.
+ *
+ * The SIMD and plain-C analytical kernels are compared against the
+ * tabulated general kernel, which is used for all pairs when the
+ * whole pair list is marked as perturbed.
+ *
+ * \ingroup module_listed_forces
+ */
+#include "gmxpre.h"
+
+#include "gromacs/listed_forces/pairs.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/paddedvector.h"
+#include "gromacs/math/units.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdtypes/enerdata.h"
+#include "gromacs/mdtypes/forcerec.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/interaction_const.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/mdtypes/mdatom.h"
+#include "gromacs/mdtypes/nblist.h"
+#include "gromacs/mdtypes/simulation_workload.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+#include "gromacs/tables/forcetable.h"
+#include "gromacs/topology/idef.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+/*! \brief The number of atoms in the chain
+ *
+ * Pairs are formed between atoms three apart, which gives a number of
+ * pairs that is not a multiple of any SIMD width.
+ */
+constexpr int c_numAtoms = 16;
+
+//! The number of pairs with perturbed parameters at the end of the F_LJ14 list
+constexpr int c_numPerturbedPairs = 3;
+
+//! The quantities computed in a force call, as set in \c StepWorkload
+enum class ComputeFlags
+{
+    Forces,
+    ForcesAndEnergy,
+    ForcesAndVirialAndEnergy
+};
+
+//! The output of a call to do_pairs()
+struct PairsOutput
+{
+    //! The forces, stored as rvec4
+    std::vector<real> f = std::vector<real>(4 * c_numAtoms, 0);
+    //! The shift forces
+    std::vector<RVec> fshift = std::vector<RVec>(SHIFTS, { 0, 0, 0 });
+    //! dV/dlambda for all lambda components
+    real dvdl[efptNR] = { 0 };
+};
+
+/*! \brief Test fixture with a periodic chain of atoms with pair interactions
+ *
+ * The chain crosses the periodic boundaries, so there are non-zero shift
+ * forces. Every other atom is in the second energy group, when two groups
+ * are used. When perturbed, every fifth atom has a perturbed charge and
+ * for F_LJ14 the last pairs have perturbed parameters. The parameters are
+ * the pair interaction type, the quantities to compute, the number of
+ * energy groups and whether there are perturbed atoms and pairs.
+ */
+class PairsTest : public ::testing::TestWithParam<std::tuple<int, ComputeFlags, int, bool>>
+{
+public:
+    PairsTest() :
+        ftype_(std::get<0>(GetParam())),
+        computeFlags_(std::get<1>(GetParam())),
+        numEnergyGroups_(std::get<2>(GetParam())),
+        havePerturbed_(std::get<3>(GetParam()))
+    {
+        DefaultRandomEngine           rng(2215);
+        UniformRealDistribution<real> stepDist(-0.06, 0.06);
+        UniformRealDistribution<real> chargeDist(-0.8, 0.8);
+        UniformRealDistribution<real> c6Dist(0.5e-3, 2e-3);
+        UniformRealDistribution<real> c12Dist(0.5e-6, 2e-6);
+
+        set_pbc(&pbc_, PbcType::Xyz, box_);
+
+        /* Walk along x with random sideways steps, starting close to the box edge */
+        x_.resizeWithPadding(c_numAtoms);
+        rvec xUnwrapped = { 1.2, 0.1, 1.4 };
+        for (int i = 0; i < c_numAtoms; i++)
+        {
+            copy_rvec(xUnwrapped, x_[i]);
+            put_atoms_in_box(PbcType::Xyz, box_, arrayRefFromArray(&x_[i], 1));
+            const rvec step = { 0.12, stepDist(rng), stepDist(rng) };
+            rvec_inc(xUnwrapped, step);
+
+            chargeA_.push_back(chargeDist(rng));
+            const bool isPerturbed = (havePerturbed_ && i % 5 == 2);
+            chargeB_.push_back(isPerturbed ? chargeDist(rng) : chargeA_.back());
+            perturbed_[i] = isPerturbed;
+            energyGroup_.push_back(i % numEnergyGroups_);
+        }
+
+        const int numPairs = c_numAtoms - 3;
+        for (int p = 0; p < numPairs; p++)
+        {
+            t_iparams params;
+            switch (ftype_)
+            {
+                case F_LJ14:
+                    params.lj14.c6A  = c6Dist(rng);
+                    params.lj14.c12A = c12Dist(rng);
+                    if (havePerturbed_ && p >= numPairs - c_numPerturbedPairs)
+                    {
+                        params.lj14.c6B  = c6Dist(rng);
+                        params.lj14.c12B = c12Dist(rng);
+                    }
+                    else
+                    {
+                        params.lj14.c6B  = params.lj14.c6A;
+                        params.lj14.c12B = params.lj14.c12A;
+                    }
+                    break;
+                case F_LJC14_Q:
+                    params.ljc14.fqq = 0.8;
+                    params.ljc14.qi  = chargeDist(rng);
+                    params.ljc14.qj  = chargeDist(rng);
+                    params.ljc14.c6  = c6Dist(rng);
+                    params.ljc14.c12 = c12Dist(rng);
+                    break;
+                case F_LJC_PAIRS_NB:
+                    params.ljcnb.qi  = chargeDist(rng);
+                    params.ljcnb.qj  = chargeDist(rng);
+                    params.ljcnb.c6  = c6Dist(rng);
+                    params.ljcnb.c12 = c12Dist(rng);
+                    break;
+                default: GMX_RELEASE_ASSERT(false, "Unsupported pair type");
+            }
+            iparams_.push_back(params);
+            iatoms_.insert(iatoms_.end(), { p, p, p + 3 });
+        }
+        numNonperturbed_ = (ftype_ == F_LJ14 && havePerturbed_)
+                                   ? 3 * (numPairs - c_numPerturbedPairs)
+                                   : gmx::ssize(iatoms_);
+
+        md_.nr         = c_numAtoms;
+        md_.homenr     = c_numAtoms;
+        md_.nenergrp   = numEnergyGroups_;
+        md_.chargeA    = chargeA_.data();
+        md_.chargeB    = chargeB_.data();
+        md_.bPerturbed = perturbed_.data();
+        md_.nPerturbed = std::count(perturbed_.begin(), perturbed_.end(), TRUE);
+        md_.cENER      = energyGroup_.data();
+
+        fepvals_.sc_alpha     = 0.5;
+        fepvals_.sc_power     = 1;
+        fepvals_.sc_r_power   = 6;
+        fepvals_.sc_sigma     = 0.3;
+        fepvals_.sc_sigma_min = 0.3;
+        fepvals_.bScCoul      = TRUE;
+
+        interactionConst_.epsfac = ONE_4PI_EPS0;
+        interactionConst_.softCoreParameters =
+                std::make_unique<interaction_const_t::SoftCoreParameters>(fepvals_);
+        pairsTable_.reset(
+                make_tables(nullptr, &interactionConst_, nullptr, 1.0, GMX_MAKETABLES_14ONLY));
+
+        for (int j = 0; j < efptNR; j++)
+        {
+            lambda_[j] = (j == efptVDW ? 0.6 : 0.4);
+        }
+
+        stepWork_.computeForces = true;
+        stepWork_.computeEnergy = (computeFlags_ != ComputeFlags::Forces);
+        stepWork_.computeVirial = (computeFlags_ == ComputeFlags::ForcesAndVirialAndEnergy);
+    }
+
+    /*! \brief Computes the pair interactions
+     *
+     * With \p useGeneralKernel all pairs are passed as perturbed, so they
+     * are computed by the tabulated general kernel.
+     */
+    PairsOutput computePairs(bool useSimd, bool useGeneralKernel, gmx_grppairener_t* grppener)
+    {
+        t_forcerec fr;
+        fr.ic               = &interactionConst_;
+        fr.pairsTable       = pairsTable_.get();
+        fr.fudgeQQ          = 0.5;
+        fr.efep             = (havePerturbed_ ? efepYES : efepNO);
+        fr.bMolPBC          = TRUE;
+        fr.use_simd_kernels = useSimd;
+
+        PairsOutput output;
+        do_pairs(ftype_, iatoms_.size(), iatoms_.data(), iparams_.data(), as_rvec_array(x_.data()),
+                 reinterpret_cast<rvec4*>(output.f.data()), as_rvec_array(output.fshift.data()),
+                 &pbc_, lambda_, output.dvdl, &md_, &fr, useGeneralKernel ? 0 : numNonperturbed_,
+                 stepWork_, grppener, nullptr);
+
+        return output;
+    }
+
+    //! Checks that \p result and \p resultEnergies match the reference values
+    void compareOutput(const PairsOutput&       reference,
+                       const gmx_grppairener_t& referenceEnergies,
+                       const PairsOutput&       result,
+                       const gmx_grppairener_t& resultEnergies) const
+    {
+        /* The table interpolation has a relative error of about 1e-6 */
+        const auto tolerance = relativeToleranceAsPrecisionDependentFloatingPoint(1000, 1e-5, 1e-6);
+
+        for (int i = 0; i < c_numAtoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_REAL_EQ_TOL(reference.f[4 * i + d], result.f[4 * i + d], tolerance)
+                        << formatString("Force mismatch for atom %d dimension %d", i, d);
+            }
+        }
+        for (int s = 0; s < SHIFTS; s++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_REAL_EQ_TOL(reference.fshift[s][d], result.fshift[s][d], tolerance)
+                        << formatString("Shift force mismatch for shift %d dimension %d", s, d);
+            }
+        }
+        if (stepWork_.computeEnergy)
+        {
+            for (int group = 0; group < egNR; group++)
+            {
+                for (int pair = 0; pair < referenceEnergies.nener; pair++)
+                {
+                    EXPECT_REAL_EQ_TOL(referenceEnergies.ener[group][pair],
+                                       resultEnergies.ener[group][pair], tolerance)
+                            << formatString(
+                                       "Energy mismatch for term %d group pair %d", group, pair);
+                }
+            }
+        }
+        EXPECT_REAL_EQ_TOL(reference.dvdl[efptCOUL], result.dvdl[efptCOUL], tolerance);
+        EXPECT_REAL_EQ_TOL(reference.dvdl[efptVDW], result.dvdl[efptVDW], tolerance);
+    }
+
+    //! The pair interaction type
+    const int ftype_;
+    //! The quantities to compute
+    const ComputeFlags computeFlags_;
+    //! The number of energy groups
+    const int numEnergyGroups_;
+    //! Whether there are perturbed atoms and pairs
+    const bool havePerturbed_;
+    //! The box
+    const matrix box_ = { { 1.5, 0, 0 }, { 0, 1.5, 0 }, { 0, 0, 1.5 } };
+    //! The PBC setup
+    t_pbc pbc_;
+    //! The coordinates
+    PaddedVector<RVec> x_;
+    //! The A-state charges
+    std::vector<real> chargeA_;
+    //! The B-state charges
+    std::vector<real> chargeB_;
+    //! Whether each atom is perturbed
+    std::array<gmx_bool, c_numAtoms> perturbed_;
+    //! The energy group of each atom
+    std::vector<unsigned short> energyGroup_;
+    //! The pair parameters, one type per pair
+    std::vector<t_iparams> iparams_;
+    //! The pair list
+    std::vector<t_iatom> iatoms_;
+    //! The number of entries in \p iatoms_ of pairs without perturbed parameters
+    int numNonperturbed_;
+    //! The atom data
+    t_mdatoms md_ = {};
+    //! The free-energy parameters, only the soft-core parameters are set
+    t_lambda fepvals_ = {};
+    //! The interaction constants
+    interaction_const_t interactionConst_;
+    //! The table used by the general kernel
+    std::unique_ptr<t_forcetable> pairsTable_;
+    //! The lambda values
+    real lambda_[efptNR];
+    //! The quantities to compute
+    StepWorkload stepWork_;
+};
+
+TEST_P(PairsTest, MatchesGeneralKernel)
+{
+    gmx_grppairener_t  referenceEnergies(numEnergyGroups_);
+    const PairsOutput reference = computePairs(false, true, &referenceEnergies);
+
+    for (const bool useSimd : { false, true })
+    {
+        SCOPED_TRACE(useSimd ? "SIMD kernel" : "Plain-C kernel");
+        gmx_grppairener_t energies(numEnergyGroups_);
+        const PairsOutput result = computePairs(useSimd, false, &energies);
+        compareOutput(reference, referenceEnergies, result, energies);
+    }
+}
+
+//! All combinations of quantities to compute
+const std::vector<ComputeFlags> c_computeFlags = { ComputeFlags::Forces,
+                                                   ComputeFlags::ForcesAndEnergy,
+                                                   ComputeFlags::ForcesAndVirialAndEnergy };
+
+INSTANTIATE_TEST_CASE_P(AllPairTypes,
+                        PairsTest,
+                        ::testing::Combine(::testing::Values(F_LJ14, F_LJC14_Q, F_LJC_PAIRS_NB),
+                                           ::testing::ValuesIn(c_computeFlags),
+                                           ::testing::Values(1, 2),
+                                           ::testing::Values(false, true)));
+
+} // namespace
+
+} // namespace test
+
+} // namespace gmx
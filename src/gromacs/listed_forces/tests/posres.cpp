@@ -0,0 +1,372 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the (flat-bottomed) position restraint kernels.
+ *
+ * The SIMD kernel and runs with several OpenMP threads are compared
+ * against the plain-C kernel run on a single thread.
+ *
+ * \ingroup module_listed_forces
+ */
+#include "gmxpre.h"
+
+#include "gromacs/listed_forces/position_restraints.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/paddedvector.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdtypes/enerdata.h"
+#include "gromacs/mdtypes/forceoutput.h"
+#include "gromacs/mdtypes/forcerec.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+#include "gromacs/topology/forcefieldparameters.h"
+#include "gromacs/topology/idef.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+/*! \brief The number of restrained atoms
+ *
+ * This is not a multiple of any SIMD width, so the SIMD kernel also
+ * processes a partially filled SIMD register.
+ */
+constexpr int c_numAtoms = 37;
+
+//! The number of threads to compare with the single-threaded run
+constexpr int c_numThreads = 4;
+
+//! The foreign restraint lambda values, the current value is 0.3
+const std::vector<double> c_foreignLambdas = { 0, 0.5, 1 };
+
+//! The flat-bottomed geometries, all used with normal and inverted restraints
+const std::vector<int> c_fbposresGeometries = { efbposresSPHERE,    efbposresCYLINDER,
+                                                efbposresX,         efbposresY,
+                                                efbposresZ,         efbposresCYLINDERX,
+                                                efbposresCYLINDERY, efbposresCYLINDERZ };
+
+//! The output of the position restraint wrappers
+struct PosresResult
+{
+    //! The forces
+    PaddedVector<RVec> f;
+    //! The virial
+    matrix virial;
+    //! The restraint energy
+    real energy;
+    //! dV/dlambda
+    real dvdlambda;
+    //! Foreign minus current energies
+    std::vector<double> foreignDeltaH;
+    //! Foreign dV/dlambda values
+    std::vector<double> foreignDhdl;
+};
+
+/*! \brief Test fixture with \c c_numAtoms atoms in a rectangular box, each with a
+ * position and a flat-bottomed position restraint
+ *
+ * The reference positions are close to the atoms, but can be across a periodic
+ * boundary. Every other position restraint is perturbed. The parameters are
+ * the refcoord-scaling type and the PBC type.
+ */
+class PositionRestraintsTest : public ::testing::TestWithParam<std::tuple<int, PbcType>>
+{
+public:
+    PositionRestraintsTest() :
+        refcoordScaling_(std::get<0>(GetParam())),
+        pbcType_(std::get<1>(GetParam())),
+        idef_(ffparams_)
+    {
+        const int npbcdim = numPbcDimensions(pbcType_);
+
+        DefaultRandomEngine           rng(1027);
+        UniformRealDistribution<real> coordinateDist(0, box_[XX][XX]);
+        UniformRealDistribution<real> displacementDist(-0.3, 0.3);
+        UniformRealDistribution<real> forceConstantDist(500, 1500);
+
+        x_.resizeWithPadding(c_numAtoms);
+        for (int i = 0; i < c_numAtoms; i++)
+        {
+            t_iparams posres;
+            t_iparams fbposres;
+            for (int d = 0; d < DIM; d++)
+            {
+                x_[i][d] = coordinateDist(rng);
+
+                /* Store the reference positions as mdrun does for each scaling type */
+                real pos0A = x_[i][d] + displacementDist(rng);
+                real pos0B = pos0A + (i % 2 == 1 ? displacementDist(rng) : 0);
+                if (d < npbcdim && refcoordScaling_ == erscALL)
+                {
+                    pos0A /= box_[d][d];
+                    pos0B /= box_[d][d];
+                }
+                else if (d < npbcdim && refcoordScaling_ == erscCOM)
+                {
+                    pos0A -= comA_[d] * box_[d][d];
+                    pos0B -= comB_[d] * box_[d][d];
+                }
+                posres.posres.pos0A[d] = pos0A;
+                posres.posres.pos0B[d] = pos0B;
+                posres.posres.fcA[d]   = forceConstantDist(rng);
+                posres.posres.fcB[d] = (i % 2 == 1 ? forceConstantDist(rng) : posres.posres.fcA[d]);
+                fbposres.fbposres.pos0[d] = pos0A;
+            }
+            const int numGeometries = c_fbposresGeometries.size();
+            fbposres.fbposres.geom  = c_fbposresGeometries[i % numGeometries];
+            fbposres.fbposres.r     = ((i / numGeometries) % 2 == 0 ? 0.1 : -0.2);
+            fbposres.fbposres.k     = forceConstantDist(rng);
+
+            idef_.iparams_posres.push_back(posres);
+            idef_.il[F_POSRES].push_back(i, std::array<int, 1>{ i });
+            idef_.iparams_fbposres.push_back(fbposres);
+            idef_.il[F_FBPOSRES].push_back(i, std::array<int, 1>{ i });
+        }
+
+        for (int j = 0; j < efptNR; j++)
+        {
+            lambda_[j] = 0.3;
+            allLambdas_[j].assign(c_foreignLambdas.begin(), c_foreignLambdas.end());
+            allLambdaPointers_[j] = allLambdas_[j].data();
+        }
+        fepvals_.n_lambda   = c_foreignLambdas.size();
+        fepvals_.all_lambda = allLambdaPointers_.data();
+    }
+
+    //! Returns a force record set up for the restraints, using SIMD kernels when \p useSimd
+    std::unique_ptr<t_forcerec> makeForcerec(bool useSimd) const
+    {
+        auto fr              = std::make_unique<t_forcerec>();
+        fr->pbcType          = pbcType_;
+        fr->rc_scaling       = refcoordScaling_;
+        fr->use_simd_kernels = useSimd;
+        copy_rvec(comA_, fr->posres_com);
+        copy_rvec(comB_, fr->posres_comB);
+
+        return fr;
+    }
+
+    /*! \brief Computes the position restraints with \p numThreads threads
+     *
+     * \p threadOutput is passed on to posres_wrapper() and can be reused between calls.
+     */
+    PosresResult computePosres(bool                       useSimd,
+                               int                        numThreads,
+                               std::vector<PosresOutput>* threadOutput)
+    {
+        const auto fr = makeForcerec(useSimd);
+        t_pbc      pbc;
+        set_pbc(&pbc, pbcType_, box_);
+        gmx_enerdata_t enerd(1, c_foreignLambdas.size());
+
+        PosresResult result;
+        result.f.resizeWithPadding(c_numAtoms);
+        std::fill(result.f.begin(), result.f.end(), RVec{ 0, 0, 0 });
+        ForceWithVirial forceWithVirial(result.f.arrayRefWithPadding().unpaddedArrayRef(), true);
+        posres_wrapper(&nrnb_, idef_, &pbc, as_rvec_array(x_.data()), &enerd, lambda_, &fepvals_,
+                       fr.get(), numThreads, threadOutput, &forceWithVirial);
+
+        copy_mat(forceWithVirial.getVirial(), result.virial);
+        result.energy    = enerd.term[F_POSRES];
+        result.dvdlambda = enerd.dvdl_nonlin[efptRESTRAINT];
+        const std::array<double, efptNR> dvdlLinear = { 0 };
+        enerd.foreignLambdaTerms.finalizePotentialContributions(dvdlLinear, lambda_, fepvals_);
+        std::tie(result.foreignDeltaH, result.foreignDhdl) =
+                enerd.foreignLambdaTerms.getTerms(nullptr);
+
+        return result;
+    }
+
+    //! Computes the flat-bottomed position restraints with \p numThreads threads
+    PosresResult computeFbposres(int numThreads, std::vector<PosresOutput>* threadOutput)
+    {
+        const auto fr = makeForcerec(false);
+        t_pbc      pbc;
+        set_pbc(&pbc, pbcType_, box_);
+        gmx_enerdata_t enerd(1, 0);
+
+        PosresResult result;
+        result.f.resizeWithPadding(c_numAtoms);
+        std::fill(result.f.begin(), result.f.end(), RVec{ 0, 0, 0 });
+        ForceWithVirial forceWithVirial(result.f.arrayRefWithPadding().unpaddedArrayRef(), true);
+        fbposres_wrapper(&nrnb_, idef_, &pbc, as_rvec_array(x_.data()), &enerd, fr.get(),
+                         numThreads, threadOutput, &forceWithVirial);
+
+        copy_mat(forceWithVirial.getVirial(), result.virial);
+        result.energy    = enerd.term[F_FBPOSRES];
+        result.dvdlambda = 0;
+
+        return result;
+    }
+
+    //! Checks that \p result matches \p reference to within the precision of the kernels
+    static void compareResults(const PosresResult& reference, const PosresResult& result)
+    {
+        /* The forces and energies are sums of a force constant times displacements
+         * of up to twice the maximum displacement, we use that as the magnitude.
+         */
+        const auto forceTolerance =
+                relativeToleranceAsPrecisionDependentFloatingPoint(1000, 1e-5, 1e-10);
+        const auto energyTolerance =
+                relativeToleranceAsPrecisionDependentFloatingPoint(1000 * c_numAtoms, 1e-5, 1e-10);
+
+        for (int i = 0; i < c_numAtoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_REAL_EQ_TOL(reference.f[i][d], result.f[i][d], forceTolerance)
+                        << formatString("Force mismatch for atom %d dimension %d", i, d);
+            }
+        }
+        for (int d1 = 0; d1 < DIM; d1++)
+        {
+            for (int d2 = 0; d2 < DIM; d2++)
+            {
+                EXPECT_REAL_EQ_TOL(reference.virial[d1][d2], result.virial[d1][d2], energyTolerance)
+                        << formatString("Virial mismatch for element %d %d", d1, d2);
+            }
+        }
+        EXPECT_REAL_EQ_TOL(reference.energy, result.energy, energyTolerance);
+        EXPECT_REAL_EQ_TOL(reference.dvdlambda, result.dvdlambda, energyTolerance);
+        ASSERT_EQ(reference.foreignDeltaH.size(), result.foreignDeltaH.size());
+        for (size_t l = 0; l < reference.foreignDeltaH.size(); l++)
+        {
+            EXPECT_REAL_EQ_TOL(reference.foreignDeltaH[l], result.foreignDeltaH[l], energyTolerance)
+                    << formatString("Energy mismatch for foreign lambda %zu", l);
+            EXPECT_REAL_EQ_TOL(reference.foreignDhdl[l], result.foreignDhdl[l], energyTolerance)
+                    << formatString("dV/dlambda mismatch for foreign lambda %zu", l);
+        }
+    }
+
+    //! The refcoord-scaling type
+    const int refcoordScaling_;
+    //! The PBC type
+    const PbcType pbcType_;
+    //! The box
+    const matrix box_ = { { 3, 0, 0 }, { 0, 3, 0 }, { 0, 0, 3 } };
+    //! The reference COM for the A state, in units of the box
+    const rvec comA_ = { 0.4, 0.5, 0.6 };
+    //! The reference COM for the B state, in units of the box
+    const rvec comB_ = { 0.5, 0.4, 0.6 };
+    //! Empty force-field parameters, the restraint parameters are stored in \p idef_
+    gmx_ffparams_t ffparams_;
+    //! The restraint interactions and parameters
+    InteractionDefinitions idef_;
+    //! The coordinates
+    PaddedVector<RVec> x_;
+    //! The current lambda values
+    real lambda_[efptNR];
+    //! The foreign lambda values for each lambda component
+    std::array<std::vector<double>, efptNR> allLambdas_;
+    //! Pointers to \p allLambdas_
+    std::array<double*, efptNR> allLambdaPointers_;
+    //! The free-energy parameters, only the foreign lambda values are set
+    t_lambda fepvals_ = {};
+    //! Flop counters, not checked
+    t_nrnb nrnb_;
+};
+
+TEST_P(PositionRestraintsTest, SimdAndThreadsMatchPlainC)
+{
+    std::vector<PosresOutput> threadOutput;
+    const PosresResult        reference = computePosres(false, 1, &threadOutput);
+    EXPECT_NE(0, reference.energy);
+    EXPECT_NE(0, reference.dvdlambda);
+
+    {
+        SCOPED_TRACE("Plain-C kernel with several threads");
+        compareResults(reference, computePosres(false, c_numThreads, &threadOutput));
+    }
+    {
+        SCOPED_TRACE("SIMD kernel with a single thread");
+        compareResults(reference, computePosres(true, 1, &threadOutput));
+    }
+    {
+        SCOPED_TRACE("SIMD kernel with several threads");
+        compareResults(reference, computePosres(true, c_numThreads, &threadOutput));
+    }
+    {
+        SCOPED_TRACE("SIMD kernel with several threads, reusing the thread output");
+        compareResults(reference, computePosres(true, c_numThreads, &threadOutput));
+    }
+}
+
+TEST_P(PositionRestraintsTest, FlatBottomedThreadsMatchSingleThread)
+{
+    std::vector<PosresOutput> threadOutput;
+    const PosresResult        reference = computeFbposres(1, &threadOutput);
+    EXPECT_NE(0, reference.energy);
+
+    {
+        SCOPED_TRACE("Several threads");
+        compareResults(reference, computeFbposres(c_numThreads, &threadOutput));
+    }
+    {
+        SCOPED_TRACE("Several threads, reusing the thread output");
+        compareResults(reference, computeFbposres(c_numThreads, &threadOutput));
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(WithRefcoordScaling,
+                        PositionRestraintsTest,
+                        ::testing::Combine(::testing::Values(erscNO, erscALL, erscCOM),
+                                           ::testing::Values(PbcType::Xyz, PbcType::XY)));
+
+} // namespace
+
+} // namespace test
+
+} // namespace gmx
@@ -0,0 +1,182 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Defines the AsyncTrajectoryWriter class.
+ *
+ * The standard library threading primitives are only used in this
+ * translation unit, so the header does not expose them.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "asynctrajectorywriter.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "gromacs/utility/gmxassert.h"
+
+namespace gmx
+{
+
+/*! \internal
+ * \brief Implementation of AsyncTrajectoryWriter
+ */
+class AsyncTrajectoryWriter::Impl
+{
+public:
+    explicit Impl(int maxQueuedTasks);
+    ~Impl();
+
+    void enqueue(std::function<void()> task);
+    void waitUntilIdle();
+
+private:
+    //! The loop executed by the writer thread
+    void run();
+
+    //! The maximum number of queued tasks, including the one being executed
+    const size_t maxQueuedTasks_;
+    //! Protects all members below
+    std::mutex mutex_;
+    //! Signals the writer thread that a task was queued or that it should stop
+    std::condition_variable taskQueued_;
+    //! Signals waiting callers that a task was completed
+    std::condition_variable taskCompleted_;
+    //! The queued tasks, the front one is removed only after it completed
+    std::deque<std::function<void()>> tasks_;
+    //! The first exception thrown by a task
+    std::exception_ptr error_;
+    //! Whether the writer thread should stop once the queue is empty
+    bool stop_ = false;
+    //! The writer thread
+    std::thread thread_;
+};
+
+AsyncTrajectoryWriter::Impl::Impl(int maxQueuedTasks) : maxQueuedTasks_(maxQueuedTasks)
+{
+    GMX_RELEASE_ASSERT(maxQueuedTasks > 0, "Need room for at least one queued task");
+
+    thread_ = std::thread([this]() { run(); });
+}
+
+AsyncTrajectoryWriter::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    taskQueued_.notify_one();
+    thread_.join();
+}
+
+void AsyncTrajectoryWriter::Impl::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        taskQueued_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty())
+        {
+            return;
+        }
+
+        std::function<void()> task = std::move(tasks_.front());
+        if (!error_)
+        {
+            lock.unlock();
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                lock.lock();
+                error_ = std::current_exception();
+                lock.unlock();
+            }
+            lock.lock();
+        }
+        tasks_.pop_front();
+        taskCompleted_.notify_all();
+    }
+}
+
+void AsyncTrajectoryWriter::Impl::enqueue(std::function<void()> task)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        taskCompleted_.wait(lock, [this]() { return error_ || tasks_.size() < maxQueuedTasks_; });
+        if (error_)
+        {
+            std::rethrow_exception(error_);
+        }
+        tasks_.push_back(std::move(task));
+    }
+    taskQueued_.notify_one();
+}
+
+void AsyncTrajectoryWriter::Impl::waitUntilIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    taskCompleted_.wait(lock, [this]() { return tasks_.empty(); });
+    if (error_)
+    {
+        std::rethrow_exception(error_);
+    }
+}
+
+AsyncTrajectoryWriter::AsyncTrajectoryWriter(int maxQueuedTasks) :
+    impl_(new Impl(maxQueuedTasks))
+{
+}
+
+AsyncTrajectoryWriter::~AsyncTrajectoryWriter() = default;
+
+void AsyncTrajectoryWriter::enqueue(std::function<void()> task)
+{
+    impl_->enqueue(std::move(task));
+}
+
+void AsyncTrajectoryWriter::waitUntilIdle()
+{
+    impl_->waitUntilIdle();
+}
+
+} // namespace gmx
@@ -0,0 +1,98 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief Declares the AsyncTrajectoryWriter class.
+ *
+ * \inlibraryapi
+ * \ingroup module_mdlib
+ */
+#ifndef GMX_MDLIB_ASYNCTRAJECTORYWRITER_H
+#define GMX_MDLIB_ASYNCTRAJECTORYWRITER_H
+
+#include <functional>
+
+#include "gromacs/utility/classhelpers.h"
+
+namespace gmx
+{
+
+/*! \libinternal
+ * \brief Executes output tasks, such as compressing and writing trajectory
+ * frames, in order on a dedicated background thread.
+ *
+ * Tasks are kept in a bounded queue. When the queue is full, enqueue()
+ * blocks until the writer thread has completed a task, so a simulation
+ * that produces output faster than it can be written is slowed down
+ * instead of accumulating frames in memory.
+ *
+ * Exceptions thrown by a task are caught on the writer thread and
+ * rethrown on the calling thread by the next call to enqueue() or
+ * waitUntilIdle(). Tasks enqueued after a failing task are discarded.
+ */
+class AsyncTrajectoryWriter
+{
+public:
+    /*! \brief Starts the writer thread
+     *
+     * \param[in] maxQueuedTasks  The number of tasks that can be queued before enqueue() blocks
+     */
+    explicit AsyncTrajectoryWriter(int maxQueuedTasks);
+    /*! \brief Completes all queued tasks and stops the writer thread
+     *
+     * Errors that were not yet reported by waitUntilIdle() are ignored.
+     */
+    ~AsyncTrajectoryWriter();
+
+    /*! \brief Adds a task to the queue, blocks while the queue is full
+     *
+     * \throws any exception thrown by an earlier task.
+     */
+    void enqueue(std::function<void()> task);
+
+    /*! \brief Blocks until all queued tasks have been completed
+     *
+     * \throws any exception thrown by an earlier task.
+     */
+    void waitUntilIdle();
+
+private:
+    class Impl;
+
+    PrivateImplPointer<Impl> impl_;
+};
+
+} // namespace gmx
+
+#endif
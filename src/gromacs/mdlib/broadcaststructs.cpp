@@ -105,6 +105,9 @@ static void bc_tpxheader(MPI_Comm communicator, TpxFileHeader* tpx)
     block_bc(communicator, tpx->lambda);
     block_bc(communicator, tpx->fep_state);
     block_bc(communicator, tpx->sizeOfTprBody);
+    block_bc(communicator, tpx->topologyOffset);
+    block_bc(communicator, tpx->coordinatesOffset);
+    block_bc(communicator, tpx->parametersOffset);
     block_bc(communicator, tpx->fileVersion);
     block_bc(communicator, tpx->fileGeneration);
     block_bc(communicator, tpx->isDouble);
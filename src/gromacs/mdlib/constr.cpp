@@ -51,6 +51,7 @@
 #include <cstdlib>
 
 #include <algorithm>
+#include <functional>
 
 #include "gromacs/domdec/domdec.h"
 #include "gromacs/domdec/domdec_struct.h"
@@ -78,6 +79,7 @@
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/listoflists.h"
 #include "gromacs/utility/pleasecite.h"
 #include "gromacs/utility/txtdump.h"
@@ -117,21 +119,23 @@ public:
                         bool            hasMassPerturbedAtoms,
                         real            lambda,
                         unsigned short* cFREEZE);
-    bool apply(bool                      bLog,
-               bool                      bEner,
-               int64_t                   step,
-               int                       delta_step,
-               real                      step_scaling,
-               ArrayRefWithPadding<RVec> x,
-               ArrayRefWithPadding<RVec> xprime,
-               ArrayRef<RVec>            min_proj,
-               const matrix              box,
-               real                      lambda,
-               real*                     dvdlambda,
-               ArrayRefWithPadding<RVec> v,
-               bool                      computeVirial,
-               tensor                    constraintsVirial,
-               ConstraintVariable        econq);
+    bool apply(bool                            bLog,
+               bool                            bEner,
+               int64_t                         step,
+               int                             delta_step,
+               real                            step_scaling,
+               ArrayRefWithPadding<RVec>       x,
+               ArrayRefWithPadding<RVec>       xprime,
+               ArrayRef<RVec>                  min_proj,
+               const matrix                    box,
+               real                            lambda,
+               real*                           dvdlambda,
+               ArrayRefWithPadding<RVec>       v,
+               bool                            computeVirial,
+               tensor                          constraintsVirial,
+               ConstraintVariable              econq,
+               const std::function<void(int)>& updateThreadWork,
+               const std::function<void(int)>& finishThreadWork);
     //! The total number of constraints.
     int ncon_tot = 0;
     //! The number of flexible constraints.
@@ -357,24 +361,49 @@ bool Constraints::apply(bool                      bLog,
 {
     return impl_->apply(bLog, bEner, step, delta_step, step_scaling, std::move(x),
                         std::move(xprime), min_proj, box, lambda, dvdlambda, std::move(v),
-                        computeVirial, constraintsVirial, econq);
+                        computeVirial, constraintsVirial, econq, {}, {});
 }
 
-bool Constraints::Impl::apply(bool                      bLog,
-                              bool                      bEner,
-                              int64_t                   step,
-                              int                       delta_step,
-                              real                      step_scaling,
-                              ArrayRefWithPadding<RVec> x,
-                              ArrayRefWithPadding<RVec> xprime,
-                              ArrayRef<RVec>            min_proj,
-                              const matrix              box,
-                              real                      lambda,
-                              real*                     dvdlambda,
-                              ArrayRefWithPadding<RVec> v,
-                              bool                      computeVirial,
-                              tensor                    constraintsVirial,
-                              ConstraintVariable        econq)
+bool Constraints::applyWithUpdate(bool                            bLog,
+                                  bool                            bEner,
+                                  int64_t                         step,
+                                  ArrayRefWithPadding<RVec>       x,
+                                  ArrayRefWithPadding<RVec>       xprime,
+                                  const matrix                    box,
+                                  real                            lambda,
+                                  real*                           dvdlambda,
+                                  ArrayRefWithPadding<RVec>       v,
+                                  bool                            computeVirial,
+                                  tensor                          constraintsVirial,
+                                  const std::function<void(int)>& updateThreadWork,
+                                  const std::function<void(int)>& finishThreadWork)
+{
+    GMX_RELEASE_ASSERT(updateThreadWork && finishThreadWork,
+                       "applyWithUpdate() requires both update and finish work");
+
+    return impl_->apply(bLog, bEner, step, 1, 1.0, std::move(x), std::move(xprime),
+                        ArrayRef<RVec>(), box, lambda, dvdlambda, std::move(v), computeVirial,
+                        constraintsVirial, ConstraintVariable::Positions, updateThreadWork,
+                        finishThreadWork);
+}
+
+bool Constraints::Impl::apply(bool                            bLog,
+                              bool                            bEner,
+                              int64_t                         step,
+                              int                             delta_step,
+                              real                            step_scaling,
+                              ArrayRefWithPadding<RVec>       x,
+                              ArrayRefWithPadding<RVec>       xprime,
+                              ArrayRef<RVec>                  min_proj,
+                              const matrix                    box,
+                              real                            lambda,
+                              real*                           dvdlambda,
+                              ArrayRefWithPadding<RVec>       v,
+                              bool                            computeVirial,
+                              tensor                          constraintsVirial,
+                              ConstraintVariable              econq,
+                              const std::function<void(int)>& updateThreadWork,
+                              const std::function<void(int)>& finishThreadWork)
 {
     bool  bOK, bDump;
     int   start;
@@ -456,6 +485,45 @@ bool Constraints::Impl::apply(bool                      bLog,
         pbc_null = nullptr;
     }
 
+    /* When the caller provides the update, we run it in the same parallel
+     * region as SETTLE, unless the updated coordinates need to be communicated
+     * before constraining or SETTLE uses a different number of threads.
+     * When nothing modifies the coordinates or velocities after SETTLE,
+     * the finishing work is also done in this region. LINCS and SHAKE are
+     * then applied as separate passes after the region.
+     */
+    const bool haveUpdateWork   = static_cast<bool>(updateThreadWork);
+    const int  numUpdateThreads = haveUpdateWork ? gmx_omp_nthreads_get(emntUpdate) : 0;
+
+    const bool needConstraintComm = (cr->dd != nullptr && cr->dd->constraint_comm != nullptr);
+    const bool fuseUpdate =
+            (haveUpdateWork && !needConstraintComm && (nsettle == 0 || nth == numUpdateThreads));
+    const bool fuseSettle = (fuseUpdate && nsettle > 0);
+
+    const bool modifiedAfterConstraining = ((ir.bPull && pull_have_constraint(*pull_work))
+                                            || ed != nullptr || cFREEZE_ != nullptr);
+    const bool fuseFinish =
+            (fuseUpdate && lincsd == nullptr && shaked == nullptr && !modifiedAfterConstraining);
+
+    if (haveUpdateWork && !fuseUpdate)
+    {
+        wallcycle_stop(wcycle, ewcCONSTR);
+        wallcycle_start_nocount(wcycle, ewcUPDATE);
+
+#pragma omp parallel for num_threads(numUpdateThreads) schedule(static)
+        for (int th = 0; th < numUpdateThreads; th++)
+        {
+            try
+            {
+                updateThreadWork(th);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
+
+        wallcycle_stop(wcycle, ewcUPDATE);
+        wallcycle_start_nocount(wcycle, ewcCONSTR);
+    }
+
     /* Communicate the coordinates required for the non-local constraints
      * for LINCS and/or SETTLE.
      */
@@ -474,12 +542,115 @@ bool Constraints::Impl::apply(bool                      bLog,
         }
     }
 
+    /* The work for SETTLE thread th, which is independent of LINCS and SHAKE */
+    bool                           bSettleErrorHasOccurred0 = false;
+    const std::function<void(int)> settleThreadWork         = [&](int th) {
+        if (th > 0)
+        {
+            clear_mat(threadConstraintsVirial[th]);
+        }
+
+        switch (econq)
+        {
+            case ConstraintVariable::Positions:
+                csettle(*settled, nth, th, pbc_null, x, xprime, invdt, v, computeVirial,
+                        th == 0 ? constraintsVirial : threadConstraintsVirial[th],
+                        th == 0 ? &bSettleErrorHasOccurred0 : &bSettleErrorHasOccurred[th]);
+                break;
+            case ConstraintVariable::Velocities:
+            case ConstraintVariable::Derivative:
+            case ConstraintVariable::Force:
+            case ConstraintVariable::ForceDispl:
+            {
+                int calcvir_atom_end;
+
+                if (!computeVirial)
+                {
+                    calcvir_atom_end = 0;
+                }
+                else
+                {
+                    calcvir_atom_end = numHomeAtoms_;
+                }
+
+                int start_th = (nsettle * th) / nth;
+                int end_th   = (nsettle * (th + 1)) / nth;
+
+                if (start_th >= 0 && end_th - start_th > 0)
+                {
+                    settle_proj(*settled, econq, end_th - start_th,
+                                settle.iatoms.data() + start_th * (1 + NRAL(F_SETTLE)), pbc_null,
+                                x.unpaddedArrayRef(), xprime.unpaddedArrayRef(), min_proj,
+                                calcvir_atom_end,
+                                th == 0 ? constraintsVirial : threadConstraintsVirial[th]);
+                }
+                break;
+            }
+            case ConstraintVariable::Deriv_FlexCon:
+                /* Nothing to do, since the are no flexible constraints in settles */
+                break;
+            default: gmx_incons("Unknown constraint quantity for settle");
+        }
+    };
+
+    if (fuseUpdate)
+    {
+        /* SETTLE can not be timed separately in the fused region,
+         * so we count the whole region as update time.
+         */
+        wallcycle_stop(wcycle, ewcCONSTR);
+        wallcycle_start_nocount(wcycle, ewcUPDATE);
+
+#pragma omp parallel num_threads(numUpdateThreads)
+        {
+            try
+            {
+                int th = gmx_omp_get_thread_num();
+
+                updateThreadWork(th);
+
+                if (fuseSettle)
+                {
+                    /* SETTLE needs coordinates updated by other threads */
+#pragma omp barrier
+                    settleThreadWork(th);
+
+                    /* SETTLE of other threads might still use our
+                     * reference coordinates, which finishing overwrites.
+                     */
+                    if (fuseFinish)
+                    {
+#pragma omp barrier
+                    }
+                }
+
+                if (fuseFinish)
+                {
+                    finishThreadWork(th);
+                }
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
+
+        wallcycle_stop(wcycle, ewcUPDATE);
+        wallcycle_start_nocount(wcycle, ewcCONSTR);
+    }
+
+    /* When LINCS and SETTLE use the same number of threads, we let each
+     * thread do its SETTLE work directly after its LINCS work, in the same
+     * parallel region. This avoids a fork/join and lets threads that finish
+     * LINCS early start on SETTLE.
+     */
+    const bool runSettleWithLincs =
+            (lincsd != nullptr && nsettle > 0 && !fuseSettle && lincs_ntask(lincsd) == nth);
+
     if (lincsd != nullptr)
     {
         bOK = constrain_lincs(bLog || bEner, ir, step, lincsd, inverseMasses_, cr, ms, x, xprime,
                               min_proj, box, pbc_null, hasMassPerturbedAtoms_, lambda, dvdlambda,
                               invdt, v.unpaddedArrayRef(), computeVirial, constraintsVirial, econq,
-                              nrnb, maxwarn, &warncount_lincs);
+                              nrnb, maxwarn, &warncount_lincs,
+                              runSettleWithLincs ? settleThreadWork : std::function<void(int)>());
         if (!bOK && maxwarn < INT_MAX)
         {
             if (log != nullptr)
@@ -511,27 +682,22 @@ bool Constraints::Impl::apply(bool                      bLog,
 
     if (nsettle > 0)
     {
-        bool bSettleErrorHasOccurred0 = false;
-
-        switch (econq)
+        if (!runSettleWithLincs && !fuseSettle)
         {
-            case ConstraintVariable::Positions:
 #pragma omp parallel for num_threads(nth) schedule(static)
-                for (int th = 0; th < nth; th++)
+            for (int th = 0; th < nth; th++)
+            {
+                try
                 {
-                    try
-                    {
-                        if (th > 0)
-                        {
-                            clear_mat(threadConstraintsVirial[th]);
-                        }
-
-                        csettle(*settled, nth, th, pbc_null, x, xprime, invdt, v, computeVirial,
-                                th == 0 ? constraintsVirial : threadConstraintsVirial[th],
-                                th == 0 ? &bSettleErrorHasOccurred0 : &bSettleErrorHasOccurred[th]);
-                    }
-                    GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+                    settleThreadWork(th);
                 }
+                GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+            }
+        }
+
+        switch (econq)
+        {
+            case ConstraintVariable::Positions:
                 inc_nrnb(nrnb, eNR_SETTLE, nsettle);
                 if (!v.empty())
                 {
@@ -542,52 +708,11 @@ bool Constraints::Impl::apply(bool                      bLog,
                     inc_nrnb(nrnb, eNR_CONSTR_VIR, nsettle * 3);
                 }
                 break;
-            case ConstraintVariable::Velocities:
-            case ConstraintVariable::Derivative:
-            case ConstraintVariable::Force:
-            case ConstraintVariable::ForceDispl:
-#pragma omp parallel for num_threads(nth) schedule(static)
-                for (int th = 0; th < nth; th++)
-                {
-                    try
-                    {
-                        int calcvir_atom_end;
-
-                        if (!computeVirial)
-                        {
-                            calcvir_atom_end = 0;
-                        }
-                        else
-                        {
-                            calcvir_atom_end = numHomeAtoms_;
-                        }
-
-                        if (th > 0)
-                        {
-                            clear_mat(threadConstraintsVirial[th]);
-                        }
-
-                        int start_th = (nsettle * th) / nth;
-                        int end_th   = (nsettle * (th + 1)) / nth;
-
-                        if (start_th >= 0 && end_th - start_th > 0)
-                        {
-                            settle_proj(*settled, econq, end_th - start_th,
-                                        settle.iatoms.data() + start_th * (1 + NRAL(F_SETTLE)),
-                                        pbc_null, x.unpaddedArrayRef(), xprime.unpaddedArrayRef(),
-                                        min_proj, calcvir_atom_end,
-                                        th == 0 ? constraintsVirial : threadConstraintsVirial[th]);
-                        }
-                    }
-                    GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
-                }
+            case ConstraintVariable::Deriv_FlexCon: break;
+            default:
                 /* This is an overestimate */
                 inc_nrnb(nrnb, eNR_SETTLE, nsettle);
                 break;
-            case ConstraintVariable::Deriv_FlexCon:
-                /* Nothing to do, since the are no flexible constraints in settles */
-                break;
-            default: gmx_incons("Unknown constraint quantity for settle");
         }
 
         if (computeVirial)
@@ -719,6 +844,23 @@ bool Constraints::Impl::apply(bool                      bLog,
         }
     }
 
+    if (haveUpdateWork && !fuseFinish)
+    {
+        wallcycle_start_nocount(wcycle, ewcUPDATE);
+
+#pragma omp parallel for num_threads(numUpdateThreads) schedule(static)
+        for (int th = 0; th < numUpdateThreads; th++)
+        {
+            try
+            {
+                finishThreadWork(th);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
+
+        wallcycle_stop(wcycle, ewcUPDATE);
+    }
+
     return bOK;
 } // namespace gmx
 
@@ -1059,8 +1201,9 @@ Constraints::Impl::Impl(const gmx_mtop_t&     mtop_p,
         if (ir.eConstrAlg == econtLINCS)
         {
             lincsd = init_lincs(log, mtop, nflexcon, at2con_mt,
-                                DOMAINDECOMP(cr) && ddHaveSplitConstraints(*cr->dd), ir.nLincsIter,
-                                ir.nProjOrder);
+                                DOMAINDECOMP(cr) && ddHaveSplitConstraints(*cr->dd),
+                                DOMAINDECOMP(cr) && ddUsesLincsExpandedHalo(*cr->dd),
+                                ir.nLincsIter, ir.nProjOrder);
         }
 
         if (ir.eConstrAlg == econtSHAKE)
@@ -1083,7 +1226,8 @@ Constraints::Impl::Impl(const gmx_mtop_t&     mtop_p,
                 please_cite(log, "Barth95a");
             }
 
-            shaked = std::make_unique<shakedata>();
+            shaked             = std::make_unique<shakedata>();
+            shaked->numThreads = gmx_omp_nthreads_get(emntLINCS);
         }
     }
 
@@ -49,6 +49,8 @@
 
 #include <cstdio>
 
+#include <functional>
+
 #include "gromacs/math/vectypes.h"
 #include "gromacs/topology/idef.h"
 #include "gromacs/utility/arrayref.h"
@@ -190,6 +192,35 @@ public:
                bool                      computeVirial,
                tensor                    constraintsVirial,
                ConstraintVariable        econq);
+    /*! \brief Applies constraints to coordinates produced by an update
+     * that is performed by the caller-provided thread work functions.
+     *
+     * Does the same as apply() with delta_step=1, step_scaling=1 and
+     * econq=ConstraintVariable::Positions, but calls \p updateThreadWork
+     * for every update thread before constraining and
+     * \p finishThreadWork for every update thread afterwards.
+     * When possible, the update, SETTLE and the finishing work are run
+     * in one OpenMP parallel region, so each thread processes its
+     * part of the system while it still resides in cache. Only LINCS
+     * and SHAKE, which couple atoms over thread boundaries, are then
+     * applied as separate passes.
+     *
+     * Both functions are called with the thread index, for thread
+     * counts set by gmx_omp_nthreads_get(emntUpdate).
+     */
+    bool applyWithUpdate(bool                            bLog,
+                         bool                            bEner,
+                         int64_t                         step,
+                         ArrayRefWithPadding<RVec>       x,
+                         ArrayRefWithPadding<RVec>       xprime,
+                         const matrix                    box,
+                         real                            lambda,
+                         real*                           dvdlambda,
+                         ArrayRefWithPadding<RVec>       v,
+                         bool                            computeVirial,
+                         tensor                          constraintsVirial,
+                         const std::function<void(int)>& updateThreadWork,
+                         const std::function<void(int)>& finishThreadWork);
     //! Links the essentialdynamics and constraint code.
     void saveEdsamPointer(gmx_edsam* ed);
     //! Getter for use by domain decomposition.
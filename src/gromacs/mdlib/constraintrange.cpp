@@ -46,6 +46,7 @@
 
 #include "gromacs/mdlib/constr.h"
 #include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
 #include "gromacs/topology/mtop_util.h"
 #include "gromacs/utility/basedefinitions.h"
 #include "gromacs/utility/fatalerror.h"
@@ -157,7 +158,8 @@ static void constr_recur(const ListOfLists<int>&        at2con,
 //! Find the interaction radius needed for constraints for this molecule type.
 static real constr_r_max_moltype(const gmx_moltype_t*           molt,
                                  gmx::ArrayRef<const t_iparams> iparams,
-                                 const t_inputrec*              ir)
+                                 const t_inputrec*              ir,
+                                 const bool                     useLincsExpandedHalo)
 {
     int natoms, at, count;
 
@@ -172,8 +174,9 @@ static real constr_r_max_moltype(const gmx_moltype_t*           molt,
 
     const ListOfLists<int> at2con =
             make_at2con(*molt, iparams, flexibleConstraintTreatment(EI_DYNAMICS(ir->eI)));
-    std::vector<int> path(1 + ir->nProjOrder);
-    for (at = 0; at < 1 + ir->nProjOrder; at++)
+    const int        numConstraintsInPath = 1 + lincsConstraintHaloDepth(*ir, useLincsExpandedHalo);
+    std::vector<int> path(numConstraintsInPath);
+    for (at = 0; at < numConstraintsInPath; at++)
     {
         path[at] = -1;
     }
@@ -185,7 +188,7 @@ static real constr_r_max_moltype(const gmx_moltype_t*           molt,
         r1 = 0;
 
         count = 0;
-        constr_recur(at2con, molt->ilist, iparams, FALSE, at, 0, 1 + ir->nProjOrder, path, r0, r1,
+        constr_recur(at2con, molt->ilist, iparams, FALSE, at, 0, numConstraintsInPath, path, r0, r1,
                      &r2maxA, &count);
     }
     if (ir->efep == efepNO)
@@ -200,7 +203,7 @@ static real constr_r_max_moltype(const gmx_moltype_t*           molt,
             r0    = 0;
             r1    = 0;
             count = 0;
-            constr_recur(at2con, molt->ilist, iparams, TRUE, at, 0, 1 + ir->nProjOrder, path, r0,
+            constr_recur(at2con, molt->ilist, iparams, TRUE, at, 0, numConstraintsInPath, path, r0,
                          r1, &r2maxB, &count);
         }
         lam0 = ir->fepvals->init_lambda;
@@ -219,20 +222,40 @@ static real constr_r_max_moltype(const gmx_moltype_t*           molt,
     return rmax;
 }
 
-real constr_r_max(const MDLogger& mdlog, const gmx_mtop_t* mtop, const t_inputrec* ir)
+real constr_r_max(const MDLogger&   mdlog,
+                  const gmx_mtop_t* mtop,
+                  const t_inputrec* ir,
+                  const bool        useLincsExpandedHalo)
 {
     real rmax = 0;
     for (const gmx_moltype_t& molt : mtop->moltype)
     {
-        rmax = std::max(rmax, constr_r_max_moltype(&molt, mtop->ffparams.iparams, ir));
+        const real rmaxMoltype =
+                constr_r_max_moltype(&molt, mtop->ffparams.iparams, ir, useLincsExpandedHalo);
+        rmax = std::max(rmax, rmaxMoltype);
     }
 
     GMX_LOG(mdlog.info)
             .appendTextFormatted(
                     "Maximum distance for %d constraints, at 120 deg. angles, all-trans: %.3f nm",
-                    1 + ir->nProjOrder, rmax);
+                    1 + lincsConstraintHaloDepth(*ir, useLincsExpandedHalo), rmax);
 
     return rmax;
 }
 
+int lincsConstraintHaloDepth(const t_inputrec& ir, const bool useExpandedHalo)
+{
+    if (ir.eConstrAlg == econtLINCS && useExpandedHalo)
+    {
+        /* Each iteration couples over one constraint to update the right-hand side
+         * and over nProjOrder constraints in the matrix expansion.
+         */
+        return ir.nProjOrder + ir.nLincsIter * (1 + ir.nProjOrder);
+    }
+    else
+    {
+        return ir.nProjOrder;
+    }
+}
+
 } // namespace gmx
@@ -47,8 +47,30 @@ namespace gmx
 class MDLogger;
 
 /*! \brief Returns an estimate of the maximum distance between atoms
- * required for LINCS. */
-real constr_r_max(const MDLogger& mdlog, const gmx_mtop_t* mtop, const t_inputrec* ir);
+ * required for LINCS.
+ *
+ * \p useLincsExpandedHalo selects the range for the expanded halo,
+ * see lincsConstraintHaloDepth(). */
+real constr_r_max(const MDLogger&   mdlog,
+                  const gmx_mtop_t* mtop,
+                  const t_inputrec* ir,
+                  bool              useLincsExpandedHalo);
+
+/*! \brief Returns the number of constraints to walk out from the home atoms
+ * to collect the non-local constraints needed by LINCS
+ *
+ * This is the LINCS expansion order, or, with the expanded halo,
+ * the order plus one order and one coupling step per LINCS iteration.
+ *
+ * With domain decomposition and long chains of coupled constraints,
+ * LINCS by default communicates the non-local coordinates before every
+ * iteration. With \p useExpandedHalo, which is set through
+ * GMX_LINCS_EXPANDED_HALO, the constraint halo is instead made deep
+ * enough that all LINCS iterations can be computed redundantly on the
+ * non-local constraints, so only a single communication step is needed
+ * before LINCS.
+ */
+int lincsConstraintHaloDepth(const t_inputrec& ir, bool useExpandedHalo);
 
 } // namespace gmx
 
@@ -237,6 +237,11 @@ real lincs_rmsd(const Lincs* lincsd)
     }
 }
 
+int lincs_ntask(const Lincs* lincsd)
+{
+    return lincsd->ntask;
+}
+
 /*! \brief Do a set of nrec LINCS matrix multiplications.
  *
  * This function will return with up to date thread-local
@@ -1433,6 +1438,7 @@ Lincs* init_lincs(FILE*                            fplog,
                   int                              nflexcon_global,
                   ArrayRef<const ListOfLists<int>> atomToConstraintsPerMolType,
                   bool                             bPLINCS,
+                  bool                             useExpandedHalo,
                   int                              nIter,
                   int                              nProjOrder)
 {
@@ -1484,8 +1490,10 @@ Lincs* init_lincs(FILE*                            fplog,
      * useful for the common case of H-bond only constraints.
      * With more effort we could also make it useful for small
      * molecules with nr. sequential constraints <= nOrder-1.
+     * With the expanded halo, domain decomposition provides enough
+     * non-local constraints to compute all iterations redundantly.
      */
-    li->bCommIter = (bPLINCS && (li->nOrder < 1 || bMoreThanTwoSeq));
+    li->bCommIter = (bPLINCS && (li->nOrder < 1 || bMoreThanTwoSeq) && !useExpandedHalo);
 
     if (debug && bPLINCS)
     {
@@ -2278,7 +2286,8 @@ bool constrain_lincs(bool                            computeRmsd,
                      ConstraintVariable              econq,
                      t_nrnb*                         nrnb,
                      int                             maxwarn,
-                     int*                            warncount)
+                     int*                            warncount,
+                     const std::function<void(int)>& overlappingWork)
 {
     bool bOK = TRUE;
 
@@ -2295,6 +2304,18 @@ bool constrain_lincs(bool                            computeRmsd,
             lincsd->rmsdData = { { 0 } };
         }
 
+        if (overlappingWork)
+        {
+#pragma omp parallel num_threads(lincsd->ntask)
+            {
+                try
+                {
+                    overlappingWork(gmx_omp_get_thread_num());
+                }
+                GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+            }
+        }
+
         return bOK;
     }
 
@@ -2377,6 +2398,11 @@ bool constrain_lincs(bool                            computeRmsd,
                 do_lincs(xPadded, xprimePadded, box, pbc, lincsd, th, invmass, cr, bCalcDHDL,
                          ir.LincsWarnAngle, &bWarn, invdt, v, bCalcVir,
                          th == 0 ? vir_r_m_dr : lincsd->task[th].vir_r_m_dr);
+
+                if (overlappingWork)
+                {
+                    overlappingWork(th);
+                }
             }
             GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
         }
@@ -2455,6 +2481,11 @@ bool constrain_lincs(bool                            computeRmsd,
 
                 do_lincsp(xPadded, xprimePadded, min_proj, pbc, lincsd, th, invmass, econq,
                           bCalcDHDL, bCalcVir, th == 0 ? vir_r_m_dr : lincsd->task[th].vir_r_m_dr);
+
+                if (overlappingWork)
+                {
+                    overlappingWork(th);
+                }
             }
             GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
         }
@@ -46,6 +46,8 @@
 
 #include <cstdio>
 
+#include <functional>
+
 #include "gromacs/math/vectypes.h"
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/basedefinitions.h"
@@ -76,12 +78,20 @@ ArrayRef<real> lincs_rmsdData(Lincs* lincsd);
 /*! \brief Return the RMSD of the constraint. */
 real lincs_rmsd(const Lincs* lincsd);
 
-/*! \brief Initializes and returns the lincs data struct. */
+/*! \brief Return the number of OpenMP threads used by LINCS. */
+int lincs_ntask(const Lincs* lincsd);
+
+/*! \brief Initializes and returns the lincs data struct.
+ *
+ * \p useExpandedHalo tells that domain decomposition provides
+ * the non-local constraints for all iterations, see lincsConstraintHaloDepth().
+ */
 Lincs* init_lincs(FILE*                            fplog,
                   const gmx_mtop_t&                mtop,
                   int                              nflexcon_global,
                   ArrayRef<const ListOfLists<int>> atomsToConstraintsPerMolType,
                   bool                             bPLINCS,
+                  bool                             useExpandedHalo,
                   int                              nIter,
                   int                              nProjOrder);
 
@@ -98,6 +108,12 @@ void set_lincs(const InteractionDefinitions& idef,
                Lincs*                        li);
 
 /*! \brief Applies LINCS constraints.
+ *
+ * When \p overlappingWork is set, it is called once by each of the
+ * lincs_ntask() threads, with the thread index, after the LINCS work of
+ * that thread within the same OpenMP parallel region. This allows running
+ * independent constraint work, such as SETTLE, without an extra fork/join
+ * and while other threads are still working on LINCS.
  *
  * \returns true if the constraining succeeded. */
 bool constrain_lincs(bool                            computeRmsd,
@@ -122,7 +138,8 @@ bool constrain_lincs(bool                            computeRmsd,
                      ConstraintVariable              econq,
                      t_nrnb*                         nrnb,
                      int                             maxwarn,
-                     int*                            warncount);
+                     int*                            warncount,
+                     const std::function<void(int)>& overlappingWork = {});
 
 } // namespace gmx
 
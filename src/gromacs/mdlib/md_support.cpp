@@ -80,16 +80,19 @@
 #include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/snprintf.h"
 
-static void calc_ke_part_normal(gmx::ArrayRef<const gmx::RVec> v,
-                                const t_grpopts*               opts,
-                                const t_mdatoms*               md,
-                                gmx_ekindata_t*                ekind,
-                                t_nrnb*                        nrnb,
-                                gmx_bool                       bEkinAveVel)
+/*! \brief Sums the kinetic energy work buffers of all threads into the group ekin
+ *
+ * Also stores the current half-step values as the old ones, as these
+ * are now replaced by the sum of the newly accumulated contributions.
+ */
+static void sum_ekin_work(const t_grpopts* opts,
+                          const t_mdatoms* md,
+                          gmx_ekindata_t*  ekind,
+                          t_nrnb*          nrnb,
+                          gmx_bool         bEkinAveVel)
 {
     int                         g;
-    gmx::ArrayRef<t_grp_tcstat> tcstat  = ekind->tcstat;
-    gmx::ArrayRef<t_grp_acc>    grpstat = ekind->grpstat;
+    gmx::ArrayRef<t_grp_tcstat> tcstat = ekind->tcstat;
 
     /* three main: VV with AveVel, vv with AveEkin, leap with AveEkin.  Leap with AveVel is also
        an option, but not supported now.
@@ -114,66 +117,8 @@ static void calc_ke_part_normal(gmx::ArrayRef<const gmx::RVec> v,
         }
     }
     ekind->dekindl_old = ekind->dekindl;
-    int nthread        = gmx_omp_nthreads_get(emntUpdate);
-
-#pragma omp parallel for num_threads(nthread) schedule(static)
-    for (int thread = 0; thread < nthread; thread++)
-    {
-        // This OpenMP only loops over arrays and does not call any functions
-        // or memory allocation. It should not be able to throw, so for now
-        // we do not need a try/catch wrapper.
-        int     start_t, end_t, n;
-        int     ga, gt;
-        rvec    v_corrt;
-        real    hm;
-        int     d, m;
-        matrix* ekin_sum;
-        real*   dekindl_sum;
 
-        start_t = ((thread + 0) * md->homenr) / nthread;
-        end_t   = ((thread + 1) * md->homenr) / nthread;
-
-        ekin_sum    = ekind->ekin_work[thread];
-        dekindl_sum = ekind->dekindl_work[thread];
-
-        for (gt = 0; gt < opts->ngtc; gt++)
-        {
-            clear_mat(ekin_sum[gt]);
-        }
-        *dekindl_sum = 0.0;
-
-        ga = 0;
-        gt = 0;
-        for (n = start_t; n < end_t; n++)
-        {
-            if (md->cACC)
-            {
-                ga = md->cACC[n];
-            }
-            if (md->cTC)
-            {
-                gt = md->cTC[n];
-            }
-            hm = 0.5 * md->massT[n];
-
-            for (d = 0; (d < DIM); d++)
-            {
-                v_corrt[d] = v[n][d] - grpstat[ga].u[d];
-            }
-            for (d = 0; (d < DIM); d++)
-            {
-                for (m = 0; (m < DIM); m++)
-                {
-                    /* if we're computing a full step velocity, v_corrt[d] has v(t).  Otherwise, v(t+dt/2) */
-                    ekin_sum[gt][m][d] += hm * v_corrt[m] * v_corrt[d];
-                }
-            }
-            if (md->nMassPerturbed && md->bPerturbed[n])
-            {
-                *dekindl_sum += 0.5 * (md->massB[n] - md->massA[n]) * iprod(v_corrt, v_corrt);
-            }
-        }
-    }
+    int nthread = gmx_omp_nthreads_get(emntUpdate);
 
     ekind->dekindl = 0;
     for (int thread = 0; thread < nthread; thread++)
@@ -196,6 +141,30 @@ static void calc_ke_part_normal(gmx::ArrayRef<const gmx::RVec> v,
     inc_nrnb(nrnb, eNR_EKIN, md->homenr);
 }
 
+static void calc_ke_part_normal(gmx::ArrayRef<const gmx::RVec> v,
+                                const t_grpopts*               opts,
+                                const t_mdatoms*               md,
+                                gmx_ekindata_t*                ekind,
+                                t_nrnb*                        nrnb,
+                                gmx_bool                       bEkinAveVel)
+{
+    int nthread = gmx_omp_nthreads_get(emntUpdate);
+
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (int thread = 0; thread < nthread; thread++)
+    {
+        // This OpenMP only loops over arrays and does not do any memory
+        // allocation. It should not be able to throw, so for now
+        // we do not need a try/catch wrapper.
+        int start_t = ((thread + 0) * md->homenr) / nthread;
+        int end_t   = ((thread + 1) * md->homenr) / nthread;
+
+        accumulate_ekin_work(start_t, end_t, as_rvec_array(v.data()), md, ekind, thread);
+    }
+
+    sum_ekin_work(opts, md, ekind, nrnb, bEkinAveVel);
+}
+
 static void calc_ke_part_visc(const matrix                   box,
                               gmx::ArrayRef<const gmx::RVec> x,
                               gmx::ArrayRef<const gmx::RVec> v,
@@ -319,7 +288,7 @@ void compute_globals(gmx_global_stat*               gstat,
                      const int                      flags)
 {
     gmx_bool bEner, bPres, bTemp;
-    gmx_bool bStopCM, bGStat, bReadEkin, bEkinAveVel, bScaleEkin, bConstrain;
+    gmx_bool bStopCM, bGStat, bReadEkin, bEkinWork, bEkinAveVel, bScaleEkin, bConstrain;
     gmx_bool bCheckNumberOfBondedInteractions;
     real     dvdl_ekin;
 
@@ -327,6 +296,7 @@ void compute_globals(gmx_global_stat*               gstat,
     bStopCM                          = ((flags & CGLO_STOPCM) != 0);
     bGStat                           = ((flags & CGLO_GSTAT) != 0);
     bReadEkin                        = ((flags & CGLO_READEKIN) != 0);
+    bEkinWork                        = ((flags & CGLO_EKINWORK) != 0);
     bScaleEkin                       = ((flags & CGLO_SCALEEKIN) != 0);
     bEner                            = ((flags & CGLO_ENERGY) != 0);
     bTemp                            = ((flags & CGLO_TEMPERATURE) != 0);
@@ -354,7 +324,15 @@ void compute_globals(gmx_global_stat*               gstat,
         {
             accumulate_u(cr, &(ir->opts), ekind);
         }
-        if (!bReadEkin)
+        if (bEkinWork)
+        {
+            GMX_ASSERT(!bReadEkin && ekind->cosacc.cos_accel == 0,
+                       "The kinetic energy can only be accumulated during the update "
+                       "without reading ekin and without cosine acceleration");
+
+            sum_ekin_work(&(ir->opts), mdatoms, ekind, nrnb, bEkinAveVel);
+        }
+        else if (!bReadEkin)
         {
             calc_ke_part(x, v, box, &(ir->opts), mdatoms, ekind, nrnb, bEkinAveVel);
         }
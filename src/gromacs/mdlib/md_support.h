@@ -89,6 +89,9 @@ class SimulationSignaller;
  * global reduction of the total number of bonded interactions that
  * will be computed, to check none are missing. */
 #define CGLO_CHECK_NUMBER_OF_BONDED_INTERACTIONS (1u << 12u)
+/* The thread kinetic energy work buffers have already been filled
+ * during the update, so only their sum needs to be taken. */
+#define CGLO_EKINWORK (1u << 13u)
 
 
 /*! \brief Return the number of steps that will take place between
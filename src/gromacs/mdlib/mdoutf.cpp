@@ -39,16 +39,24 @@
 
 #include "config.h"
 
+#include <cstdlib>
+
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "gromacs/commandline/filenm.h"
 #include "gromacs/domdec/collect.h"
 #include "gromacs/domdec/domdec_struct.h"
 #include "gromacs/fileio/checkpoint.h"
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/tngio.h"
+#include "gromacs/fileio/trajectoryframeindex.h"
 #include "gromacs/fileio/trrio.h"
 #include "gromacs/fileio/xtcio.h"
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/asynctrajectorywriter.h"
 #include "gromacs/mdlib/trajectory_writing.h"
 #include "gromacs/mdrunutility/handlerestart.h"
 #include "gromacs/mdrunutility/multisim.h"
@@ -67,6 +75,7 @@
 #include "gromacs/timing/wallcycle.h"
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/baseversion.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/pleasecite.h"
 #include "gromacs/utility/programcontext.h"
@@ -97,8 +106,67 @@ struct gmx_mdoutf
     const gmx::MdModulesNotifier* mdModulesNotifier;
     bool                          simulationsShareState;
     MPI_Comm                      mastersComm;
+    /* Writes XTC and TRR frames and/or syncs and renames checkpoint files
+     * in the background, only set on master when requested */
+    std::unique_ptr<gmx::AsyncTrajectoryWriter> asyncWriter;
+    /* Whether XTC and TRR frames are written by asyncWriter */
+    bool asyncFrameOutput = false;
+    /* Compress and write the frame sets of the TNG files in the background, one thread
+     * per file, only set on master when requested */
+    std::unique_ptr<gmx::AsyncTrajectoryWriter> tngWriter;
+    std::unique_ptr<gmx::AsyncTrajectoryWriter> tngLowPrecWriter;
+    /* Whether checkpoint files are synced and renamed by asyncWriter */
+    bool asyncCheckpointFinish = false;
+    /* Write the frame indices of the XTC and TRR files, only set on master when requested */
+    std::unique_ptr<gmx::TrajectoryFrameIndexWriter> xtcFrameIndex;
+    std::unique_ptr<gmx::TrajectoryFrameIndexWriter> trrFrameIndex;
 };
 
+/*! \brief Returns the number of frames that can be queued for asynchronous writing
+ *
+ * Returns zero when asynchronous trajectory output was not requested.
+ */
+static int asyncTrajectoryOutputQueueSize()
+{
+    const char* env = getenv("GMX_ASYNC_TRAJECTORY_OUTPUT");
+    if (env == nullptr)
+    {
+        return 0;
+    }
+    /* Two frames let the writer work on one frame while the next is produced */
+    const int defaultQueueSize = 2;
+    const int queueSize        = std::atoi(env);
+
+    return queueSize > 0 ? queueSize : defaultQueueSize;
+}
+
+/*! \brief Returns a frame index writer for \p filename, or nullptr when not requested
+ *
+ * When appending and the existing frame index can not be continued,
+ * this is noted in \p fplog and nullptr is returned.
+ */
+static std::unique_ptr<gmx::TrajectoryFrameIndexWriter>
+makeFrameIndexWriter(FILE* fplog, const char* filename, bool restartWithAppending)
+{
+    if (getenv("GMX_TRAJECTORY_FRAME_INDEX") == nullptr)
+    {
+        return nullptr;
+    }
+    auto writer = std::make_unique<gmx::TrajectoryFrameIndexWriter>(filename, restartWithAppending);
+    if (!writer->isWriting())
+    {
+        if (fplog)
+        {
+            fprintf(fplog,
+                    "The frame index file of %s does not match the frames in it, not writing "
+                    "a frame index\n\n",
+                    filename);
+        }
+        return nullptr;
+    }
+    return writer;
+}
+
 
 gmx_mdoutf_t init_mdoutf(FILE*                         fplog,
                          int                           nfile,
@@ -121,7 +189,7 @@ gmx_mdoutf_t init_mdoutf(FILE*                         fplog,
     int          i;
     bool restartWithAppending = (startingBehavior == gmx::StartingBehavior::RestartWithAppending);
 
-    snew(of, 1);
+    of = new gmx_mdoutf();
 
     of->fp_trn       = nullptr;
     of->fp_ene       = nullptr;
@@ -159,7 +227,10 @@ gmx_mdoutf_t init_mdoutf(FILE*                         fplog,
             filename = ftp2fn(efCOMPRESSED, nfile, fnm);
             switch (fn2ftp(filename))
             {
-                case efXTC: of->fp_xtc = open_xtc(filename, filemode); break;
+                case efXTC:
+                    of->fp_xtc        = open_xtc(filename, filemode);
+                    of->xtcFrameIndex = makeFrameIndexWriter(fplog, filename, restartWithAppending);
+                    break;
                 case efTNG:
                     gmx_tng_open(filename, filemode[0], &of->tng_low_prec);
                     if (filemode[0] == 'w')
@@ -187,6 +258,8 @@ gmx_mdoutf_t init_mdoutf(FILE*                         fplog,
                     if (ir->nstxout != 0 || ir->nstxout_compressed == 0 || !of->tng_low_prec)
                     {
                         of->fp_trn = gmx_trr_open(filename, filemode);
+                        of->trrFrameIndex =
+                                makeFrameIndexWriter(fplog, filename, restartWithAppending);
                     }
                     break;
                 case efTNG:
@@ -203,6 +276,10 @@ gmx_mdoutf_t init_mdoutf(FILE*                         fplog,
         if (EI_DYNAMICS(ir->eI) || EI_ENERGY_MINIMIZATION(ir->eI))
         {
             of->fp_ene = open_enx(ftp2fn(efEDR, nfile, fnm), filemode);
+            if (getenv("GMX_ENERGY_COLUMNS") != nullptr)
+            {
+                enx_enable_columns(of->fp_ene, restartWithAppending);
+            }
         }
         of->fn_cpt = opt2fn("-cpo", nfile, fnm);
 
@@ -241,6 +318,61 @@ gmx_mdoutf_t init_mdoutf(FILE*                         fplog,
         {
             snew(of->f_global, top_global->natoms);
         }
+
+        const int asyncQueueSize = asyncTrajectoryOutputQueueSize();
+        of->asyncFrameOutput =
+                ((of->fp_xtc != nullptr || of->fp_trn != nullptr) && asyncQueueSize > 0);
+        if (of->asyncFrameOutput)
+        {
+            of->asyncWriter = std::make_unique<gmx::AsyncTrajectoryWriter>(asyncQueueSize);
+            if (fplog)
+            {
+                fprintf(fplog,
+                        "Writing XTC and TRR frames on a separate thread, using a queue size "
+                        "of %d frames\n\n",
+                        asyncQueueSize);
+            }
+        }
+
+        if ((of->tng != nullptr || of->tng_low_prec != nullptr) && asyncQueueSize > 0)
+        {
+            if (of->tng)
+            {
+                of->tngWriter = std::make_unique<gmx::AsyncTrajectoryWriter>(asyncQueueSize);
+            }
+            if (of->tng_low_prec)
+            {
+                of->tngLowPrecWriter = std::make_unique<gmx::AsyncTrajectoryWriter>(asyncQueueSize);
+            }
+            if (fplog)
+            {
+                fprintf(fplog,
+                        "Compressing and writing TNG frames on a separate thread per file, "
+                        "using a queue size of %d frames\n\n",
+                        asyncQueueSize);
+            }
+        }
+
+        /* The MPI barrier before renaming checkpoints with shared state
+         * needs to be called on the main thread.
+         */
+        of->asyncCheckpointFinish = (getenv("GMX_ASYNC_CHECKPOINT") != nullptr
+                                     && !simulationsShareState && !GMX_FAHCORE);
+        if (of->asyncCheckpointFinish)
+        {
+            /* A checkpoint is finished while the simulation continues,
+             * at the latest before the next checkpoint is written.
+             * This reuses the thread that writes XTC and TRR frames.
+             */
+            if (!of->asyncWriter)
+            {
+                of->asyncWriter = std::make_unique<gmx::AsyncTrajectoryWriter>(1);
+            }
+            if (fplog)
+            {
+                fprintf(fplog, "Syncing and renaming checkpoint files on a separate thread\n\n");
+            }
+        }
     }
 
     if (bCiteTng)
@@ -278,10 +410,106 @@ static void mpiBarrierBeforeRename(const bool applyMpiBarrierBeforeRename, MPI_C
 #endif
     }
 }
+/*! \brief Makes the checkpoint written to \p fp durable and moves it into place
+ *
+ * Syncs the checkpoint and all output files it refers to to disk,
+ * closes the checkpoint and renames the temporary checkpoint file
+ * \p fntemp to \p fn, keeping the previous checkpoint with suffix
+ * _prev.cpt unless \p bNumberAndKeep. This can be called on a
+ * separate thread, when \p applyMpiBarrierBeforeRename is false.
+ */
+static void finish_checkpoint(t_fileio*   fp,
+                              const char* fn,
+                              const char* fntemp,
+                              gmx_bool    bNumberAndKeep,
+                              bool        applyMpiBarrierBeforeRename,
+                              MPI_Comm    mpiBarrierCommunicator)
+{
+    t_fileio* ret;
+
+    /* we really, REALLY, want to make sure to physically write the checkpoint,
+       and all the files it depends on, out to disk. Because we've
+       opened the checkpoint with gmx_fio_open(), it's in our list
+       of open files.  */
+    ret = gmx_fio_all_output_fsync();
+
+    if (ret)
+    {
+        char buf[STRLEN];
+        sprintf(buf, "Cannot fsync '%s'; maybe you are out of disk space?", gmx_fio_getname(ret));
+
+        if (getenv(GMX_IGNORE_FSYNC_FAILURE_ENV) == nullptr)
+        {
+            gmx_file(buf);
+        }
+        else
+        {
+            gmx_warning("%s", buf);
+        }
+    }
+
+    if (gmx_fio_close(fp) != 0)
+    {
+        gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
+    }
+
+    /* we don't move the checkpoint if the user specified they didn't want it,
+       or if the fsyncs failed */
+#if !GMX_NO_RENAME
+    if (!bNumberAndKeep && !ret)
+    {
+        if (gmx_fexist(fn))
+        {
+            /* Rename the previous checkpoint file */
+            mpiBarrierBeforeRename(applyMpiBarrierBeforeRename, mpiBarrierCommunicator);
+
+            char buf[1024];
+            std::strcpy(buf, fn);
+            buf[std::strlen(fn) - std::strlen(ftp2ext(fn2ftp(fn))) - 1] = '\0';
+            std::strcat(buf, "_prev");
+            std::strcat(buf, fn + std::strlen(fn) - std::strlen(ftp2ext(fn2ftp(fn))) - 1);
+            if (!GMX_FAHCORE)
+            {
+                /* we copy here so that if something goes wrong between now and
+                 * the rename below, there's always a state.cpt.
+                 * If renames are atomic (such as in POSIX systems),
+                 * this copying should be unneccesary.
+                 */
+                gmx_file_copy(fn, buf, FALSE);
+                /* We don't really care if this fails:
+                 * there's already a new checkpoint.
+                 */
+            }
+            else
+            {
+                gmx_file_rename(fn, buf);
+            }
+        }
+
+        /* Rename the checkpoint file from the temporary to the final name */
+        mpiBarrierBeforeRename(applyMpiBarrierBeforeRename, mpiBarrierCommunicator);
+
+        if (gmx_file_rename(fntemp, fn) != 0)
+        {
+            gmx_file("Cannot rename checkpoint file; maybe you are out of disk space?");
+        }
+    }
+#else
+    GMX_UNUSED_VALUE(fn);
+    GMX_UNUSED_VALUE(fntemp);
+    GMX_UNUSED_VALUE(bNumberAndKeep);
+    GMX_UNUSED_VALUE(applyMpiBarrierBeforeRename);
+    GMX_UNUSED_VALUE(mpiBarrierCommunicator);
+#endif /* GMX_NO_RENAME */
+}
+
 /*! \brief Write a checkpoint to the filename
  *
  * Appends the _step<step>.cpt with bNumberAndKeep, otherwise moves
  * the previous checkpoint filename with suffix _prev.cpt.
+ * With \p checkpointFinisher, syncing and renaming the checkpoint
+ * is done in the background. Collecting and writing the checkpoint
+ * data is always done on the calling thread.
  */
 static void write_checkpoint(const char*                     fn,
                              gmx_bool                        bNumberAndKeep,
@@ -300,13 +528,13 @@ static void write_checkpoint(const char*                     fn,
                              const gmx::MdModulesNotifier&   mdModulesNotifier,
                              gmx::WriteCheckpointDataHolder* modularSimulatorCheckpointData,
                              bool                            applyMpiBarrierBeforeRename,
-                             MPI_Comm                        mpiBarrierCommunicator)
+                             MPI_Comm                        mpiBarrierCommunicator,
+                             gmx::AsyncTrajectoryWriter*     checkpointFinisher)
 {
     t_fileio* fp;
     char*     fntemp; /* the temporary checkpoint file name */
     int       npmenodes;
     char      buf[1024], suffix[5 + STEPSTRSIZE], sbuf[STEPSTRSIZE];
-    t_fileio* ret;
 
     if (DOMAINDECOMP(cr))
     {
@@ -397,73 +625,22 @@ static void write_checkpoint(const char*                     fn,
     write_checkpoint_data(fp, headerContents, bExpanded, elamstats, state, observablesHistory,
                           mdModulesNotifier, &outputfiles, modularSimulatorCheckpointData);
 
-    /* we really, REALLY, want to make sure to physically write the checkpoint,
-       and all the files it depends on, out to disk. Because we've
-       opened the checkpoint with gmx_fio_open(), it's in our list
-       of open files.  */
-    ret = gmx_fio_all_output_fsync();
-
-    if (ret)
-    {
-        char buf[STRLEN];
-        sprintf(buf, "Cannot fsync '%s'; maybe you are out of disk space?", gmx_fio_getname(ret));
-
-        if (getenv(GMX_IGNORE_FSYNC_FAILURE_ENV) == nullptr)
-        {
-            gmx_file(buf);
-        }
-        else
-        {
-            gmx_warning("%s", buf);
-        }
-    }
-
-    if (gmx_fio_close(fp) != 0)
+    /* The checkpoint file is closed and renamed by finish_checkpoint */
+    const std::string checkpointFilename = fn;
+    const std::string temporaryFilename  = fntemp;
+    auto finish = [fp, checkpointFilename, temporaryFilename, bNumberAndKeep,
+                   applyMpiBarrierBeforeRename, mpiBarrierCommunicator]() {
+        finish_checkpoint(fp, checkpointFilename.c_str(), temporaryFilename.c_str(),
+                          bNumberAndKeep, applyMpiBarrierBeforeRename, mpiBarrierCommunicator);
+    };
+    if (checkpointFinisher)
     {
-        gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
+        checkpointFinisher->enqueue(finish);
     }
-
-    /* we don't move the checkpoint if the user specified they didn't want it,
-       or if the fsyncs failed */
-#if !GMX_NO_RENAME
-    if (!bNumberAndKeep && !ret)
+    else
     {
-        if (gmx_fexist(fn))
-        {
-            /* Rename the previous checkpoint file */
-            mpiBarrierBeforeRename(applyMpiBarrierBeforeRename, mpiBarrierCommunicator);
-
-            std::strcpy(buf, fn);
-            buf[std::strlen(fn) - std::strlen(ftp2ext(fn2ftp(fn))) - 1] = '\0';
-            std::strcat(buf, "_prev");
-            std::strcat(buf, fn + std::strlen(fn) - std::strlen(ftp2ext(fn2ftp(fn))) - 1);
-            if (!GMX_FAHCORE)
-            {
-                /* we copy here so that if something goes wrong between now and
-                 * the rename below, there's always a state.cpt.
-                 * If renames are atomic (such as in POSIX systems),
-                 * this copying should be unneccesary.
-                 */
-                gmx_file_copy(fn, buf, FALSE);
-                /* We don't really care if this fails:
-                 * there's already a new checkpoint.
-                 */
-            }
-            else
-            {
-                gmx_file_rename(fn, buf);
-            }
-        }
-
-        /* Rename the checkpoint file from the temporary to the final name */
-        mpiBarrierBeforeRename(applyMpiBarrierBeforeRename, mpiBarrierCommunicator);
-
-        if (gmx_file_rename(fntemp, fn) != 0)
-        {
-            gmx_file("Cannot rename checkpoint file; maybe you are out of disk space?");
-        }
+        finish();
     }
-#endif /* GMX_NO_RENAME */
 
     sfree(fntemp);
 
@@ -478,6 +655,19 @@ static void write_checkpoint(const char*                     fn,
 #endif /* end GMX_FAHCORE block */
 }
 
+//! Waits until the queued TNG frames have been written
+static void waitForTngWriters(gmx_mdoutf_t of)
+{
+    if (of->tngWriter)
+    {
+        of->tngWriter->waitUntilIdle();
+    }
+    if (of->tngLowPrecWriter)
+    {
+        of->tngLowPrecWriter->waitUntilIdle();
+    }
+}
+
 void mdoutf_write_checkpoint(gmx_mdoutf_t                    of,
                              FILE*                           fplog,
                              const t_commrec*                cr,
@@ -487,6 +677,16 @@ void mdoutf_write_checkpoint(gmx_mdoutf_t                    of,
                              ObservablesHistory*             observablesHistory,
                              gmx::WriteCheckpointDataHolder* modularSimulatorCheckpointData)
 {
+    /* The checkpoint stores the output file positions, so all frames
+     * queued before the checkpoint should be written first. This also
+     * ensures that the previous checkpoint is in place before it is
+     * moved to _prev.
+     */
+    if (of->asyncWriter)
+    {
+        of->asyncWriter->waitUntilIdle();
+    }
+    waitForTngWriters(of);
     fflush_tng(of->tng);
     fflush_tng(of->tng_low_prec);
     /* Write the checkpoint file.
@@ -500,7 +700,160 @@ void mdoutf_write_checkpoint(gmx_mdoutf_t                    of,
                      DOMAINDECOMP(cr) ? cr->dd->nnodes : cr->nnodes, of->eIntegrator,
                      of->simulation_part, of->bExpanded, of->elamstats, step, t, state_global,
                      observablesHistory, *(of->mdModulesNotifier), modularSimulatorCheckpointData,
-                     of->simulationsShareState, of->mastersComm);
+                     of->simulationsShareState, of->mastersComm,
+                     of->asyncCheckpointFinish ? of->asyncWriter.get() : nullptr);
+}
+
+//! Returns a copy of \p numAtoms vectors, or an empty vector when \p source is nullptr
+static std::vector<gmx::RVec> copyFrameVectors(const rvec* source, int numAtoms)
+{
+    std::vector<gmx::RVec> copy;
+    if (source != nullptr)
+    {
+        copy.resize(numAtoms);
+        rvec* dest = as_rvec_array(copy.data());
+        for (int i = 0; i < numAtoms; i++)
+        {
+            copy_rvec(source[i], dest[i]);
+        }
+    }
+    return copy;
+}
+
+//! Returns a pointer to the vectors, or nullptr when there are none
+static const rvec* frameVectorsOrNull(const std::vector<gmx::RVec>& vectors)
+{
+    return vectors.empty() ? nullptr : as_rvec_array(vectors.data());
+}
+
+/*! \brief Queues a TRR frame for writing by the asynchronous writer
+ *
+ * All frame data is copied, so the caller can continue to modify it.
+ */
+static void enqueueTrrFrame(gmx_mdoutf_t of,
+                            int64_t      step,
+                            double       t,
+                            real         lambda,
+                            const rvec*  box,
+                            int          natoms,
+                            const rvec*  x,
+                            const rvec*  v,
+                            const rvec*  f)
+{
+    t_fileio*                        fp_trn     = of->fp_trn;
+    gmx::TrajectoryFrameIndexWriter* frameIndex = of->trrFrameIndex.get();
+    matrix                           boxCopy;
+    copy_mat(box, boxCopy);
+
+    of->asyncWriter->enqueue([fp_trn, frameIndex, step, t, lambda, boxCopy, natoms,
+                              xCopy = copyFrameVectors(x, natoms),
+                              vCopy = copyFrameVectors(v, natoms),
+                              fCopy = copyFrameVectors(f, natoms)]() {
+        gmx_trr_write_frame(fp_trn, step, t, lambda, boxCopy, natoms, frameVectorsOrNull(xCopy),
+                            frameVectorsOrNull(vCopy), frameVectorsOrNull(fCopy));
+        if (gmx_fio_flush(fp_trn) != 0)
+        {
+            GMX_THROW(gmx::FileIOError(
+                    "Cannot write trajectory; maybe you are out of disk space?"));
+        }
+        if (frameIndex)
+        {
+            frameIndex->addFrame(gmx_fio_ftell(fp_trn), step, t);
+        }
+    });
+}
+
+/*! \brief Queues an XTC frame for writing by the asynchronous writer
+ *
+ * The positions of the atoms in the compressed output group are copied,
+ * so the caller can continue to modify the state.
+ */
+static void enqueueXtcFrame(gmx_mdoutf_t                   of,
+                            int64_t                        step,
+                            double                         t,
+                            const rvec*                    box,
+                            gmx::ArrayRef<const gmx::RVec> x)
+{
+    std::vector<gmx::RVec> xCopy;
+    if (of->natoms_x_compressed == of->natoms_global)
+    {
+        xCopy.assign(x.begin(), x.begin() + of->natoms_global);
+    }
+    else
+    {
+        xCopy.reserve(of->natoms_x_compressed);
+        for (int i = 0; i < of->natoms_global; i++)
+        {
+            if (getGroupType(*of->groups, SimulationAtomGroupType::CompressedPositionOutput, i)
+                == 0)
+            {
+                xCopy.push_back(x[i]);
+            }
+        }
+    }
+
+    t_fileio*                        fp_xtc     = of->fp_xtc;
+    gmx::TrajectoryFrameIndexWriter* frameIndex = of->xtcFrameIndex.get();
+    const int                        precision  = of->x_compression_precision;
+    matrix                           boxCopy;
+    copy_mat(box, boxCopy);
+
+    of->asyncWriter->enqueue([fp_xtc, frameIndex, step, t, boxCopy, precision,
+                              xCopy = std::move(xCopy)]() {
+        const int natoms = xCopy.size();
+        if (write_xtc(fp_xtc, natoms, step, t, boxCopy, as_rvec_array(xCopy.data()), precision)
+            == 0)
+        {
+            GMX_THROW(gmx::FileIOError(
+                    "XTC error. This indicates you are out of disk space, or a "
+                    "simulation with major instabilities resulting in coordinates "
+                    "that are NaN or too large to be represented in the XTC format."));
+        }
+        if (frameIndex)
+        {
+            frameIndex->addFrame(gmx_fio_ftell(fp_xtc), step, t);
+        }
+    });
+}
+
+/*! \brief Writes a TNG frame, by the asynchronous \p writer when it is not nullptr
+ *
+ * With a writer, all frame data is copied, so the caller can continue
+ * to modify it. Filling the frame set, and compressing and writing it
+ * when it is full, then happens on the writer thread.
+ */
+static void writeTngFrame(gmx::AsyncTrajectoryWriter* writer,
+                          gmx_tng_trajectory_t        tng,
+                          gmx_bool                    bUseLossyCompression,
+                          int64_t                     step,
+                          double                      t,
+                          real                        lambda,
+                          const rvec*                 box,
+                          int                         natoms,
+                          const rvec*                 x,
+                          const rvec*                 v,
+                          const rvec*                 f)
+{
+    if (writer == nullptr)
+    {
+        gmx_fwrite_tng(tng, bUseLossyCompression, step, t, lambda, box, natoms, x, v, f);
+        return;
+    }
+
+    const bool haveBox = (box != nullptr);
+    matrix     boxCopy = { { 0 } };
+    if (haveBox)
+    {
+        copy_mat(box, boxCopy);
+    }
+
+    writer->enqueue([tng, bUseLossyCompression, step, t, lambda, haveBox, boxCopy, natoms,
+                     xCopy = copyFrameVectors(x, natoms), vCopy = copyFrameVectors(v, natoms),
+                     fCopy = copyFrameVectors(f, natoms)]() {
+        gmx_fwrite_tng(tng, bUseLossyCompression, step, t, lambda, haveBox ? boxCopy : nullptr,
+                       natoms, frameVectorsOrNull(xCopy), frameVectorsOrNull(vCopy),
+                       frameVectorsOrNull(fCopy));
+    });
 }
 
 void mdoutf_write_to_trajectory_files(FILE*                           fplog,
@@ -569,7 +922,12 @@ void mdoutf_write_to_trajectory_files(FILE*                           fplog,
             const rvec* v = (mdof_flags & MDOF_V) ? state_global->v.rvec_array() : nullptr;
             const rvec* f = (mdof_flags & MDOF_F) ? f_global : nullptr;
 
-            if (of->fp_trn)
+            if (of->fp_trn && of->asyncFrameOutput)
+            {
+                enqueueTrrFrame(of, step, t, state_local->lambda[efptFEP], state_local->box,
+                                natoms, x, v, f);
+            }
+            else if (of->fp_trn)
             {
                 gmx_trr_write_frame(of->fp_trn, step, t, state_local->lambda[efptFEP],
                                     state_local->box, natoms, x, v, f);
@@ -577,24 +935,32 @@ void mdoutf_write_to_trajectory_files(FILE*                           fplog,
                 {
                     gmx_file("Cannot write trajectory; maybe you are out of disk space?");
                 }
+                if (of->trrFrameIndex)
+                {
+                    of->trrFrameIndex->addFrame(gmx_fio_ftell(of->fp_trn), step, t);
+                }
             }
 
             /* If a TNG file is open for uncompressed coordinate output also write
                velocities and forces to it. */
             else if (of->tng)
             {
-                gmx_fwrite_tng(of->tng, FALSE, step, t, state_local->lambda[efptFEP],
-                               state_local->box, natoms, x, v, f);
+                writeTngFrame(of->tngWriter.get(), of->tng, FALSE, step, t,
+                              state_local->lambda[efptFEP], state_local->box, natoms, x, v, f);
             }
             /* If only a TNG file is open for compressed coordinate output (no uncompressed
                coordinate output) also write forces and velocities to it. */
             else if (of->tng_low_prec)
             {
-                gmx_fwrite_tng(of->tng_low_prec, FALSE, step, t, state_local->lambda[efptFEP],
-                               state_local->box, natoms, x, v, f);
+                writeTngFrame(of->tngLowPrecWriter.get(), of->tng_low_prec, FALSE, step, t,
+                              state_local->lambda[efptFEP], state_local->box, natoms, x, v, f);
             }
         }
-        if (mdof_flags & MDOF_X_COMPRESSED)
+        if ((mdof_flags & MDOF_X_COMPRESSED) && of->fp_xtc && of->asyncFrameOutput)
+        {
+            enqueueXtcFrame(of, step, t, state_local->box, state_global->x);
+        }
+        else if (mdof_flags & MDOF_X_COMPRESSED)
         {
             rvec* xxtc = nullptr;
 
@@ -630,8 +996,16 @@ void mdoutf_write_to_trajectory_files(FILE*                           fplog,
                           "simulation with major instabilities resulting in coordinates "
                           "that are NaN or too large to be represented in the XTC format.\n");
             }
-            gmx_fwrite_tng(of->tng_low_prec, TRUE, step, t, state_local->lambda[efptFEP],
-                           state_local->box, of->natoms_x_compressed, xxtc, nullptr, nullptr);
+            if (of->xtcFrameIndex)
+            {
+                of->xtcFrameIndex->addFrame(gmx_fio_ftell(of->fp_xtc), step, t);
+            }
+            if (of->tng_low_prec)
+            {
+                writeTngFrame(of->tngLowPrecWriter.get(), of->tng_low_prec, TRUE, step, t,
+                              state_local->lambda[efptFEP], state_local->box,
+                              of->natoms_x_compressed, xxtc, nullptr, nullptr);
+            }
             if (of->natoms_x_compressed != of->natoms_global)
             {
                 sfree(xxtc);
@@ -651,7 +1025,8 @@ void mdoutf_write_to_trajectory_files(FILE*                           fplog,
                 {
                     lambda = state_local->lambda[efptFEP];
                 }
-                gmx_fwrite_tng(of->tng, FALSE, step, t, lambda, box, natoms, nullptr, nullptr, nullptr);
+                writeTngFrame(of->tngWriter.get(), of->tng, FALSE, step, t, lambda, box, natoms,
+                              nullptr, nullptr, nullptr);
             }
         }
         if (mdof_flags & (MDOF_BOX_COMPRESSED | MDOF_LAMBDA_COMPRESSED)
@@ -669,8 +1044,8 @@ void mdoutf_write_to_trajectory_files(FILE*                           fplog,
                 {
                     lambda = state_local->lambda[efptFEP];
                 }
-                gmx_fwrite_tng(of->tng_low_prec, FALSE, step, t, lambda, box, natoms, nullptr,
-                               nullptr, nullptr);
+                writeTngFrame(of->tngLowPrecWriter.get(), of->tng_low_prec, FALSE, step, t, lambda,
+                              box, natoms, nullptr, nullptr, nullptr);
             }
         }
 
@@ -690,6 +1065,9 @@ void mdoutf_tng_close(gmx_mdoutf_t of)
     if (of->tng || of->tng_low_prec)
     {
         wallcycle_start(of->wcycle, ewcTRAJ);
+        waitForTngWriters(of);
+        of->tngWriter.reset();
+        of->tngLowPrecWriter.reset();
         gmx_tng_close(&of->tng);
         gmx_tng_close(&of->tng_low_prec);
         wallcycle_stop(of->wcycle, ewcTRAJ);
@@ -698,6 +1076,14 @@ void mdoutf_tng_close(gmx_mdoutf_t of)
 
 void done_mdoutf(gmx_mdoutf_t of)
 {
+    if (of->asyncWriter)
+    {
+        of->asyncWriter->waitUntilIdle();
+        of->asyncWriter.reset();
+    }
+    waitForTngWriters(of);
+    of->tngWriter.reset();
+    of->tngLowPrecWriter.reset();
     if (of->fp_ene != nullptr)
     {
         done_ener_file(of->fp_ene);
@@ -710,6 +1096,8 @@ void done_mdoutf(gmx_mdoutf_t of)
     {
         gmx_trr_close(of->fp_trn);
     }
+    of->xtcFrameIndex.reset();
+    of->trrFrameIndex.reset();
     if (of->fp_dhdl != nullptr)
     {
         gmx_fio_fclose(of->fp_dhdl);
@@ -723,7 +1111,7 @@ void done_mdoutf(gmx_mdoutf_t of)
     gmx_tng_close(&of->tng);
     gmx_tng_close(&of->tng_low_prec);
 
-    sfree(of);
+    delete of;
 }
 
 int mdoutf_get_tng_box_output_interval(gmx_mdoutf_t of)
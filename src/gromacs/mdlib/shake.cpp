@@ -51,6 +51,7 @@
 #include <cstdlib>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/gmxlib/nrnb.h"
 #include "gromacs/math/functions.h"
@@ -61,6 +62,7 @@
 #include "gromacs/mdtypes/md_enums.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/topology/invblock.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
@@ -122,6 +124,67 @@ static void resizeLagrangianData(shakedata* shaked, int ncons)
     shaked->scaled_lagrange_multiplier.resize(ncons);
 }
 
+/*! \brief Assigns the SHAKE blocks to colors for parallel constraining
+ *
+ * Each block gets a color one higher than the highest color of the earlier
+ * blocks it shares atoms with. Thus blocks with the same color are independent
+ * and blocks sharing atoms are constrained in the same order as in serial,
+ * which makes the results independent of the number of threads.
+ * Without domain decomposition the blocks are independent and all get color 0.
+ */
+static void colorShakeBlocks(shakedata* shaked, const int* iatoms)
+{
+    const int numBlocks = shaked->numShakeBlocks();
+
+    int maxAtom = -1;
+    for (int i = 0; i < shaked->sblock[numBlocks]; i += 3)
+    {
+        maxAtom = std::max(maxAtom, std::max(iatoms[i + 1], iatoms[i + 2]));
+    }
+
+    std::vector<int> atomColor(maxAtom + 1, -1);
+    std::vector<int> blockColor(numBlocks);
+    int              numColors = 0;
+    for (int b = 0; b < numBlocks; b++)
+    {
+        int color = 0;
+        for (int i = shaked->sblock[b]; i < shaked->sblock[b + 1]; i += 3)
+        {
+            color = std::max(color, 1 + atomColor[iatoms[i + 1]]);
+            color = std::max(color, 1 + atomColor[iatoms[i + 2]]);
+        }
+        for (int i = shaked->sblock[b]; i < shaked->sblock[b + 1]; i += 3)
+        {
+            atomColor[iatoms[i + 1]] = color;
+            atomColor[iatoms[i + 2]] = color;
+        }
+        blockColor[b] = color;
+        numColors     = std::max(numColors, color + 1);
+    }
+
+    /* Sort the blocks on color, keeping the block order within each color */
+    shaked->colorIndex.assign(numColors + 1, 0);
+    for (int b = 0; b < numBlocks; b++)
+    {
+        shaked->colorIndex[blockColor[b] + 1]++;
+    }
+    for (int c = 0; c < numColors; c++)
+    {
+        shaked->colorIndex[c + 1] += shaked->colorIndex[c];
+    }
+    std::vector<int> colorCount(shaked->colorIndex.begin(), shaked->colorIndex.end() - 1);
+    shaked->colorBlocks.resize(numBlocks);
+    for (int b = 0; b < numBlocks; b++)
+    {
+        shaked->colorBlocks[colorCount[blockColor[b]]++] = b;
+    }
+
+    if (debug)
+    {
+        fprintf(debug, "SHAKE: %d blocks in %d colors\n", numBlocks, numColors);
+    }
+}
+
 void make_shake_sblock_serial(shakedata* shaked, InteractionDefinitions* idef, const int numAtoms)
 {
     int          i, m, ncons;
@@ -208,6 +271,7 @@ void make_shake_sblock_serial(shakedata* shaked, InteractionDefinitions* idef, c
     sfree(sb);
     sfree(inv_sblock);
     resizeLagrangianData(shaked, ncons);
+    colorShakeBlocks(shaked, idef->il[F_CONSTR].iatoms.data());
 }
 
 void make_shake_sblock_dd(shakedata* shaked, const InteractionList& ilcon)
@@ -232,6 +296,7 @@ void make_shake_sblock_dd(shakedata* shaked, const InteractionList& ilcon)
     }
     shaked->sblock.push_back(3 * ncons);
     resizeLagrangianData(shaked, ncons);
+    colorShakeBlocks(shaked, ilcon.iatoms.data());
 }
 
 /*! \brief Inner kernel for SHAKE constraints
@@ -432,10 +497,15 @@ static void crattle(const int            iatom[],
     *nerror = error;
 }
 
-//! Applies SHAKE
+/*! \brief Applies SHAKE to the \p ncon constraints starting at constraint \p firstCon
+ *
+ * The working data in \p shaked is only accessed for these constraints,
+ * so blocks of constraints without shared atoms can be handled in parallel.
+ */
 static int vec_shakef(FILE*                     fplog,
                       shakedata*                shaked,
                       const real                invmass[],
+                      int                       firstCon,
                       int                       ncon,
                       ArrayRef<const t_iparams> ip,
                       const int*                iatom,
@@ -459,15 +529,13 @@ static int vec_shakef(FILE*                     fplog,
     int  error = 0;
     real constraint_distance;
 
-    shaked->rij.resize(ncon);
-    shaked->half_of_reduced_mass.resize(ncon);
-    shaked->distance_squared_tolerance.resize(ncon);
-    shaked->constraint_distance_squared.resize(ncon);
-
-    ArrayRef<RVec> rij                         = shaked->rij;
-    ArrayRef<real> half_of_reduced_mass        = shaked->half_of_reduced_mass;
-    ArrayRef<real> distance_squared_tolerance  = shaked->distance_squared_tolerance;
-    ArrayRef<real> constraint_distance_squared = shaked->constraint_distance_squared;
+    ArrayRef<RVec> rij = makeArrayRef(shaked->rij).subArray(firstCon, ncon);
+    ArrayRef<real> half_of_reduced_mass =
+            makeArrayRef(shaked->half_of_reduced_mass).subArray(firstCon, ncon);
+    ArrayRef<real> distance_squared_tolerance =
+            makeArrayRef(shaked->distance_squared_tolerance).subArray(firstCon, ncon);
+    ArrayRef<real> constraint_distance_squared =
+            makeArrayRef(shaked->constraint_distance_squared).subArray(firstCon, ncon);
 
     L1            = 1.0_real - lambda;
     const int* ia = iatom;
@@ -651,6 +719,19 @@ static void check_cons(FILE*                     log,
     }
 }
 
+//! Output of SHAKE for the blocks handled by one thread
+struct ShakeThreadData
+{
+    //! The number of iterations times the number of constraints
+    int numIterations = 0;
+    //! The number of constraints
+    int numConstraints = 0;
+    //! The index of the first block that failed, -1 when none failed
+    int failedBlock = -1;
+    //! The constraint virial contribution
+    tensor vir_r_m_dr = { { 0 } };
+};
+
 //! Applies SHAKE.
 static bool bshakef(FILE*                         log,
                     shakedata*                    shaked,
@@ -671,7 +752,7 @@ static bool bshakef(FILE*                         log,
                     ConstraintVariable            econq)
 {
     real dt_2, dvdl;
-    int  i, n0, ncon, blen, type, ll;
+    int  ncon, type, ll;
     int  tnit = 0, trij = 0;
 
     ncon = idef.il[F_CONSTR].size() / 3;
@@ -681,34 +762,89 @@ static bool bshakef(FILE*                         log,
         shaked->scaled_lagrange_multiplier[ll] = 0;
     }
 
-    // TODO Rewrite this block so that it is obvious that i, iatoms
-    // and lam are all iteration variables. Is this easier if the
-    // sblock data structure is organized differently?
-    const int*     iatoms = &(idef.il[F_CONSTR].iatoms[shaked->sblock[0]]);
+    shaked->rij.resize(ncon);
+    shaked->half_of_reduced_mass.resize(ncon);
+    shaked->distance_squared_tolerance.resize(ncon);
+    shaked->constraint_distance_squared.resize(ncon);
+
+    const int numThreads = std::max(1, std::min(shaked->numThreads, shaked->numShakeBlocks()));
+    std::vector<ShakeThreadData> threadData(numThreads);
+
+    const int*     iatoms = idef.il[F_CONSTR].iatoms.data();
     ArrayRef<real> lam    = shaked->scaled_lagrange_multiplier;
-    for (i = 0; (i < shaked->numShakeBlocks());)
+
+    /* Blocks with the same color share no atoms, so we can constrain them
+     * in parallel. Each thread stops at its first failure.
+     */
+    for (int color = 0; color < shaked->numColors(); color++)
     {
-        blen = (shaked->sblock[i + 1] - shaked->sblock[i]);
-        blen /= 3;
-        n0 = vec_shakef(log, shaked, invmass, blen, idef.iparams, iatoms, ir.shake_tol, x_s, prime,
-                        pbc, shaked->omega, ir.efep != efepNO, lambda, lam, invdt, v, bCalcVir,
-                        vir_r_m_dr, econq);
+        const int colorStart = shaked->colorIndex[color];
+        const int numBlocks  = shaked->colorIndex[color + 1] - colorStart;
 
-        if (n0 == 0)
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+        for (int th = 0; th < numThreads; th++)
         {
-            if (bDumpOnError && log)
+            try
             {
+                ShakeThreadData& td = threadData[th];
+
+                const int bStart = colorStart + (numBlocks * th) / numThreads;
+                const int bEnd   = colorStart + (numBlocks * (th + 1)) / numThreads;
+                for (int b = bStart; b < bEnd && td.failedBlock < 0; b++)
                 {
-                    check_cons(log, blen, x_s, prime, v, pbc, idef.iparams, iatoms, invmass, econq);
+                    const int block    = shaked->colorBlocks[b];
+                    const int firstCon = shaked->sblock[block] / 3;
+                    const int blen     = shaked->sblock[block + 1] / 3 - firstCon;
+
+                    const int n0 = vec_shakef(log, shaked, invmass, firstCon, blen, idef.iparams,
+                                              iatoms + 3 * firstCon, ir.shake_tol, x_s, prime, pbc,
+                                              shaked->omega, ir.efep != efepNO, lambda,
+                                              lam.subArray(firstCon, blen), invdt, v, bCalcVir,
+                                              td.vir_r_m_dr, econq);
+
+                    if (n0 == 0)
+                    {
+                        td.failedBlock = block;
+                    }
+                    else
+                    {
+                        td.numIterations += n0 * blen;
+                        td.numConstraints += blen;
+                    }
                 }
             }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
+
+        int failedBlock = -1;
+        for (const ShakeThreadData& td : threadData)
+        {
+            if (td.failedBlock >= 0 && (failedBlock < 0 || td.failedBlock < failedBlock))
+            {
+                failedBlock = td.failedBlock;
+            }
+        }
+        if (failedBlock >= 0)
+        {
+            if (bDumpOnError && log)
+            {
+                const int firstCon = shaked->sblock[failedBlock] / 3;
+                const int blen     = shaked->sblock[failedBlock + 1] / 3 - firstCon;
+                check_cons(log, blen, x_s, prime, v, pbc, idef.iparams, iatoms + 3 * firstCon,
+                           invmass, econq);
+            }
             return FALSE;
         }
-        tnit += n0 * blen;
-        trij += blen;
-        iatoms += 3 * blen; /* Increment pointer! */
-        lam = lam.subArray(blen, lam.ssize() - blen);
-        i++;
+    }
+
+    for (const ShakeThreadData& td : threadData)
+    {
+        tnit += td.numIterations;
+        trij += td.numConstraints;
+        if (bCalcVir)
+        {
+            m_add(vir_r_m_dr, td.vir_r_m_dr, vir_r_m_dr);
+        }
     }
     /* only for position part? */
     if (econq == ConstraintVariable::Positions)
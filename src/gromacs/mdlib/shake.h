@@ -45,6 +45,8 @@
 #ifndef GMX_MDLIB_SHAKE_H
 #define GMX_MDLIB_SHAKE_H
 
+#include <vector>
+
 #include "gromacs/math/vec.h"
 #include "gromacs/topology/block.h"
 #include "gromacs/utility/real.h"
@@ -69,6 +71,8 @@ struct shakedata
 {
     //! Returns the number of SHAKE blocks */
     int numShakeBlocks() const { return sblock.size() - 1; }
+    //! Returns the number of colors of SHAKE blocks that can be constrained in parallel
+    int numColors() const { return colorIndex.size() - 1; }
 
     //! The reference constraint vectors
     std::vector<RVec> rij;
@@ -87,6 +91,17 @@ struct shakedata
     real gamma = 1000000;
     //! The SHAKE blocks, block i contains constraints sblock[i]/3 to sblock[i+1]/3 */
     std::vector<int> sblock = { 0 };
+    /*! \brief The SHAKE block indices ordered on color
+     *
+     * Blocks with the same color share no atoms and can be constrained
+     * in parallel. Blocks sharing atoms are constrained in the order of
+     * sblock, as colors are processed in increasing order.
+     */
+    std::vector<int> colorBlocks;
+    //! Start index in colorBlocks for each color, size numColors() + 1
+    std::vector<int> colorIndex = { 0 };
+    //! The number of OpenMP threads to use
+    int numThreads = 1;
     /*! \brief Scaled Lagrange multiplier for each constraint.
      *
      * Value is -2 * eta from p. 336 of the paper, divided by the
@@ -300,7 +300,7 @@ static void postProcessForceWithShiftForces(t_nrnb*                   nrnb,
     {
         using VirialHandling = gmx::VirtualSitesHandler::VirialHandling;
 
-        auto                 f      = forceWithShiftForces.force();
+        auto                 f      = forceWithShiftForces.forceWithPadding();
         auto                 fshift = forceWithShiftForces.shiftForces();
         const VirialHandling virialHandling =
                 (stepWork.computeVirial ? VirialHandling::Pbc : VirialHandling::None);
@@ -354,7 +354,18 @@ static void postProcessForces(const t_commrec*          cr,
                     (stepWork.computeVirial ? gmx::VirtualSitesHandler::VirialHandling::NonLinear
                                             : gmx::VirtualSitesHandler::VirialHandling::None);
             matrix virial = { { 0 } };
-            vsite->spreadForces(x, forceWithVirial.force_, virialHandling, {}, virial, nrnb, box, wcycle);
+            if (forceWithVirial.force_.data() == f.data())
+            {
+                // Without a separate buffer we can use the padded force buffer with SIMD
+                vsite->spreadForces(x, forceOutputs->forceWithShiftForces().forceWithPadding(),
+                                    virialHandling, {}, virial, nrnb, box, wcycle);
+            }
+            else
+            {
+                // The separate buffer for direct virial contributions has no padding
+                vsite->spreadForces(x, forceWithVirial.force_, virialHandling, {}, virial, nrnb,
+                                    box, wcycle);
+            }
             forceWithVirial.addVirialContribution(virial);
         }
 
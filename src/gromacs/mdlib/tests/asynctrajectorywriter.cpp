@@ -0,0 +1,130 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Tests for the AsyncTrajectoryWriter class
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "gromacs/mdlib/asynctrajectorywriter.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/utility/exceptions.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+
+namespace
+{
+
+TEST(AsyncTrajectoryWriter, ExecutesTasksInOrder)
+{
+    std::vector<int> executed;
+    {
+        AsyncTrajectoryWriter writer(3);
+        for (int i = 0; i < 20; i++)
+        {
+            writer.enqueue([&executed, i]() { executed.push_back(i); });
+        }
+        writer.waitUntilIdle();
+        ASSERT_EQ(executed.size(), 20U);
+        for (int i = 0; i < 20; i++)
+        {
+            EXPECT_EQ(executed[i], i);
+        }
+    }
+}
+
+TEST(AsyncTrajectoryWriter, DestructorCompletesQueuedTasks)
+{
+    std::vector<int> executed;
+    {
+        AsyncTrajectoryWriter writer(2);
+        for (int i = 0; i < 5; i++)
+        {
+            writer.enqueue([&executed, i]() { executed.push_back(i); });
+        }
+    }
+    EXPECT_EQ(executed.size(), 5U);
+}
+
+TEST(AsyncTrajectoryWriter, EnqueueBlocksWhenQueueIsFull)
+{
+    AsyncTrajectoryWriter writer(1);
+
+    std::promise<void> release;
+    std::future<void>  released = release.get_future();
+    writer.enqueue([&released]() { released.wait(); });
+
+    std::atomic<bool> secondTaskQueued(false);
+    std::thread       producer([&writer, &secondTaskQueued]() {
+        writer.enqueue([]() {});
+        secondTaskQueued = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(secondTaskQueued);
+
+    release.set_value();
+    producer.join();
+    EXPECT_TRUE(secondTaskQueued);
+    writer.waitUntilIdle();
+}
+
+TEST(AsyncTrajectoryWriter, RethrowsTaskExceptions)
+{
+    AsyncTrajectoryWriter writer(2);
+    bool                  executedAfterError = false;
+
+    writer.enqueue([]() { GMX_THROW(FileIOError("Cannot write")); });
+    EXPECT_THROW_GMX(writer.waitUntilIdle(), FileIOError);
+    EXPECT_THROW_GMX(writer.enqueue([&executedAfterError]() { executedAfterError = true; }),
+                     FileIOError);
+    EXPECT_FALSE(executedAfterError);
+}
+
+} // namespace
+
+} // namespace gmx
@@ -284,6 +284,7 @@ public:
         std::vector<std::unique_ptr<IConstraintsTestRunner>> runners;
         // Add runners for CPU versions of SHAKE and LINCS
         runners.emplace_back(std::make_unique<ShakeConstraintsRunner>());
+        runners.emplace_back(std::make_unique<ShakeConstraintsRunner>(4));
         runners.emplace_back(std::make_unique<LincsConstraintsRunner>());
         // If using CUDA, add runners for the GPU version of LINCS for each available GPU
         if (GMX_GPU_CUDA)
@@ -0,0 +1,155 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the constraint communication range.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "gromacs/mdlib/constraintrange.h"
+
+#include <array>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/logger.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of constraints in the test chain, longer than any path walked
+constexpr int c_numConstraintsInChain = 20;
+
+//! Test fixture with a single linear chain of constraints of length 0.1 nm
+class ConstraintRangeTest : public ::testing::Test
+{
+public:
+    ConstraintRangeTest()
+    {
+        t_iparams constraintParams;
+        constraintParams.constr.dA = 0.1;
+        constraintParams.constr.dB = 0.1;
+        mtop_.ffparams.iparams.push_back(constraintParams);
+        mtop_.ffparams.functype.push_back(F_CONSTR);
+
+        gmx_moltype_t moltype;
+        moltype.atoms.nr = c_numConstraintsInChain + 1;
+        for (int c = 0; c < c_numConstraintsInChain; c++)
+        {
+            const std::array<int, 2> atoms = { c, c + 1 };
+            moltype.ilist[F_CONSTR].push_back(0, atoms);
+        }
+        mtop_.moltype.push_back(moltype);
+
+        gmx_molblock_t molblock;
+        molblock.type = 0;
+        molblock.nmol = 1;
+        mtop_.molblock.push_back(molblock);
+        mtop_.natoms = c_numConstraintsInChain + 1;
+    }
+
+    //! Sets up \p ir for LINCS dynamics with the given expansion order and iteration count
+    static void setLincsInput(t_inputrec* ir, int nProjOrder, int nLincsIter)
+    {
+        ir->eI         = eiMD;
+        ir->efep       = efepNO;
+        ir->eConstrAlg = econtLINCS;
+        ir->nProjOrder = nProjOrder;
+        ir->nLincsIter = nLincsIter;
+    }
+
+    //! The topology
+    gmx_mtop_t mtop_;
+    //! A logger that does not write anything
+    const MDLogger nullLogger_;
+};
+
+TEST_F(ConstraintRangeTest, ExpandedHaloCoversAllLincsIterations)
+{
+    t_inputrec ir;
+
+    setLincsInput(&ir, 4, 1);
+    EXPECT_EQ(4, lincsConstraintHaloDepth(ir, false));
+    EXPECT_EQ(4 + 5, lincsConstraintHaloDepth(ir, true));
+    setLincsInput(&ir, 4, 2);
+    EXPECT_EQ(4 + 2 * 5, lincsConstraintHaloDepth(ir, true));
+    setLincsInput(&ir, 6, 2);
+    EXPECT_EQ(6 + 2 * 7, lincsConstraintHaloDepth(ir, true));
+}
+
+TEST_F(ConstraintRangeTest, ExpandedHaloRangeMatchesDeeperExpansion)
+{
+    t_inputrec ir;
+    setLincsInput(&ir, 4, 1);
+    const real defaultRange  = constr_r_max(nullLogger_, &mtop_, &ir, false);
+    const real expandedRange = constr_r_max(nullLogger_, &mtop_, &ir, true);
+
+    /* The expanded halo should cover the same path length as a plain
+     * expansion of the order of the expanded halo depth.
+     */
+    t_inputrec irDeep;
+    setLincsInput(&irDeep, lincsConstraintHaloDepth(ir, true), 1);
+    const real deepRange = constr_r_max(nullLogger_, &mtop_, &irDeep, false);
+
+    EXPECT_GT(expandedRange, defaultRange);
+    EXPECT_REAL_EQ_TOL(deepRange, expandedRange, defaultRealTolerance());
+}
+
+TEST_F(ConstraintRangeTest, ShakeIgnoresExpandedHalo)
+{
+    t_inputrec ir;
+    setLincsInput(&ir, 4, 1);
+    ir.eConstrAlg = econtSHAKE;
+
+    EXPECT_EQ(lincsConstraintHaloDepth(ir, false), lincsConstraintHaloDepth(ir, true));
+    EXPECT_REAL_EQ_TOL(constr_r_max(nullLogger_, &mtop_, &ir, false),
+                       constr_r_max(nullLogger_, &mtop_, &ir, true), defaultRealTolerance());
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
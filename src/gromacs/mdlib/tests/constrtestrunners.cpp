@@ -83,6 +83,7 @@ namespace test
 void ShakeConstraintsRunner::applyConstraints(ConstraintsTestData* testData, t_pbc /* pbc */)
 {
     shakedata shaked;
+    shaked.numThreads = numThreads_;
     make_shake_sblock_serial(&shaked, testData->idef_.get(), testData->numAtoms_);
     bool success = constrain_shake(
             nullptr, &shaked, testData->invmass_.data(), *testData->idef_, testData->ir_, testData->x_,
@@ -119,7 +120,7 @@ void LincsConstraintsRunner::applyConstraints(ConstraintsTestData* testData, t_p
     }
     // Initialize LINCS
     lincsd = init_lincs(nullptr, testData->mtop_, testData->nflexcon_, at2con_mt, false,
-                        testData->ir_.nLincsIter, testData->ir_.nProjOrder);
+                        false, testData->ir_.nLincsIter, testData->ir_.nProjOrder);
     set_lincs(*testData->idef_, testData->numAtoms_, testData->invmass_.data(), testData->lambda_,
               EI_DYNAMICS(testData->ir_.eI), &cr, lincsd);
 
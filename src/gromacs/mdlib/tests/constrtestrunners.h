@@ -47,6 +47,8 @@
 #ifndef GMX_MDLIB_TESTS_CONSTRTESTRUNNERS_H
 #define GMX_MDLIB_TESTS_CONSTRTESTRUNNERS_H
 
+#include <string>
+
 #include <gtest/gtest.h>
 
 #include "testutils/test_device.h"
@@ -87,8 +89,11 @@ public:
 class ShakeConstraintsRunner : public IConstraintsTestRunner
 {
 public:
-    //! Default constructor.
-    ShakeConstraintsRunner() {}
+    /*! \brief Constructor.
+     *
+     * \param[in] numThreads           The number of OpenMP threads to use.
+     */
+    explicit ShakeConstraintsRunner(int numThreads = 1) : numThreads_(numThreads) {}
     /*! \brief Apply SHAKE constraints to the test data.
      *
      * \param[in] testData             Test data structure.
@@ -97,9 +102,17 @@ public:
     void applyConstraints(ConstraintsTestData* testData, t_pbc pbc) override;
     /*! \brief Get the name of the implementation.
      *
-     * \return "SHAKE" string;
+     * \return "SHAKE" string, with the number of threads when using more than one;
      */
-    std::string name() override { return "SHAKE on CPU"; }
+    std::string name() override
+    {
+        return numThreads_ == 1 ? "SHAKE on CPU"
+                                : "SHAKE on CPU with " + std::to_string(numThreads_) + " threads";
+    }
+
+private:
+    //! The number of OpenMP threads to use
+    int numThreads_;
 };
 
 // Runner for the CPU implementation of LINCS constraints algorithm.
@@ -0,0 +1,327 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the fused leap-frog update, SETTLE and kinetic energy accumulation.
+ *
+ * One leap-frog step of a box of SETTLE water is performed with
+ * Update::update_leapfrog_fused() and with the separate update,
+ * constraint and finish passes. The coordinates, velocities,
+ * constraint virial and half-step kinetic energy should agree.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "config.h"
+
+#include <cmath>
+
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/paddedvector.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdlib/constr.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdlib/makeconstraints.h"
+#include "gromacs/mdlib/tgroup.h"
+#include "gromacs/mdlib/update.h"
+#include "gromacs/mdtypes/commrec.h"
+#include "gromacs/mdtypes/fcdata.h"
+#include "gromacs/mdtypes/group.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/mdtypes/mdatom.h"
+#include "gromacs/mdtypes/state.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/setenv.h"
+#include "testutils/testasserts.h"
+
+#include "settletestdata.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of water molecules, 17 waters give 51 atoms, not a multiple of any SIMD width
+constexpr int c_numWaters = 17;
+
+//! The results of a single MD step
+struct StepResult
+{
+    //! The coordinates after the step
+    std::vector<RVec> x;
+    //! The velocities after the step
+    std::vector<RVec> v;
+    //! The half-step kinetic energy tensor
+    tensor ekinh = { { 0 } };
+    //! The constraint virial
+    tensor virial = { { 0 } };
+};
+
+/*! \brief Test fixture for comparing the fused leap-frog update with the separate passes
+ *
+ * The parameters are the number of update threads and the number of SETTLE threads.
+ * When these differ, the update is not fused with SETTLE.
+ */
+class FusedUpdateTest : public ::testing::TestWithParam<std::tuple<int, int>>
+{
+public:
+    FusedUpdateTest() : water_(c_numWaters)
+    {
+        gmx_mtop_t& mtop         = water_.mtop_;
+        mtop.moltype[0].atoms.nr = water_.numAtoms_;
+        mtop.molblock[0].nmol    = 1;
+        mtop.natoms              = water_.numAtoms_;
+        mtop.ffparams.functype.push_back(F_SETTLE);
+
+        ir_.eI      = eiMD;
+        ir_.delta_t = 0.002;
+        ir_.etc     = etcNO;
+        ir_.epc     = epcNO;
+
+        ir_.opts.ngtc  = 1;
+        ir_.opts.ngacc = 1;
+        snew(ir_.opts.acc, ir_.opts.ngacc);
+        snew(ir_.opts.nFreeze, 1);
+        // This is to keep done_inputrec happy
+        snew(ir_.opts.anneal_time, ir_.opts.ngtc);
+        snew(ir_.opts.anneal_temp, ir_.opts.ngtc);
+
+        cr_.nnodes = 1;
+        cr_.dd     = nullptr;
+
+        invMass_.resizeWithPadding(water_.numAtoms_);
+        invMassPerDim_.resize(water_.numAtoms_);
+        f_.resizeWithPadding(water_.numAtoms_);
+        v_.resize(water_.numAtoms_);
+        for (int i = 0; i < water_.numAtoms_; i++)
+        {
+            invMass_[i]       = water_.inverseMasses_[i];
+            invMassPerDim_[i] = { water_.inverseMasses_[i], water_.inverseMasses_[i],
+                                  water_.inverseMasses_[i] };
+            // Forces of a few hundred kJ/mol/nm and velocities of ~1 nm/ps,
+            // so SETTLE has a significant correction to make
+            for (int d = 0; d < DIM; d++)
+            {
+                f_[i][d] = 300.0 * std::sin(1.3 * i + 2.1 * d);
+                v_[i][d] = std::cos(0.7 * i + 1.9 * d);
+            }
+        }
+    }
+
+    //! Performs one MD step, using the fused update when \p useFusedUpdate is true
+    StepResult doStep(bool useFusedUpdate)
+    {
+        const int numAtoms = water_.numAtoms_;
+
+        gmx_omp_nthreads_set(emntUpdate, std::get<0>(GetParam()));
+        gmx_omp_nthreads_set(emntSETTLE, std::get<1>(GetParam()));
+
+        gmx_ekindata_t ekind;
+        init_ekindata(nullptr, &water_.mtop_, &ir_.opts, &ekind, ir_.cos_accel);
+
+        t_state state;
+        state.flags = (1 << estX) | (1 << estV);
+        state.x.resizeWithPadding(numAtoms);
+        state.v.resizeWithPadding(numAtoms);
+        for (int i = 0; i < numAtoms; i++)
+        {
+            state.x[i] = water_.x_[i];
+            state.v[i] = v_[i];
+        }
+        clear_mat(state.box);
+        for (int d = 0; d < DIM; d++)
+        {
+            state.box[d][d] = 3.0;
+        }
+
+        t_mdatoms md                = {};
+        md.nr                       = numAtoms;
+        md.homenr                   = numAtoms;
+        md.massT                    = water_.masses_.data();
+        md.invmass                  = invMass_.data();
+        md.invMassPerDim            = as_rvec_array(invMassPerDim_.data());
+        md.haveVsites               = false;
+        md.havePartiallyFrozenAtoms = false;
+
+        Update update(ir_, nullptr);
+        update.setNumAtoms(numAtoms);
+
+        auto constr = makeConstraints(water_.mtop_, ir_, nullptr, false, nullptr, &cr_, nullptr,
+                                      &nrnb_, nullptr, false);
+        gmx_localtop_t top(water_.mtop_.ffparams);
+        top.idef.il[F_SETTLE] = water_.mtop_.moltype[0].ilist[F_SETTLE];
+        constr->setConstraints(&top, numAtoms, numAtoms, water_.masses_.data(),
+                               water_.inverseMasses_.data(), false, 0, nullptr);
+
+        const int64_t step       = 0;
+        const matrix  M          = { { 0 } };
+        t_fcdata      fcdata;
+        real          dvdlConstr = 0;
+        StepResult    result;
+
+        if (useFusedUpdate)
+        {
+            update.update_leapfrog_fused(ir_, step, &md, &state, f_.constArrayRefWithPadding(),
+                                         fcdata, &ekind, M, constr.get(), false, false,
+                                         &dvdlConstr, true, result.virial, true, nullptr);
+
+            for (int th = 0; th < ekind.nthreads; th++)
+            {
+                m_add(result.ekinh, ekind.ekin_work[th][0], result.ekinh);
+            }
+        }
+        else
+        {
+            update.update_coords(ir_, step, &md, &state, f_.constArrayRefWithPadding(), fcdata,
+                                 &ekind, M, etrtPOSITION, &cr_, true);
+            constr->apply(false, false, step, 1, 1.0, state.x.arrayRefWithPadding(),
+                          update.xp()->arrayRefWithPadding(), {}, state.box, 0, &dvdlConstr,
+                          state.v.arrayRefWithPadding(), true, result.virial,
+                          ConstraintVariable::Positions);
+            update.finish_update(ir_, &md, &state, nullptr, true);
+
+            for (int i = 0; i < numAtoms; i++)
+            {
+                for (int m = 0; m < DIM; m++)
+                {
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        result.ekinh[m][d] += 0.5 * md.massT[i] * state.v[i][m] * state.v[i][d];
+                    }
+                }
+            }
+        }
+
+        result.x.assign(state.x.begin(), state.x.begin() + numAtoms);
+        result.v.assign(state.v.begin(), state.v.begin() + numAtoms);
+
+        return result;
+    }
+
+    //! The water system with SETTLE
+    SettleTestData water_;
+    //! The input record
+    t_inputrec ir_;
+    //! Communication record, for a single rank
+    t_commrec cr_;
+    //! Flop counters, not checked
+    t_nrnb nrnb_;
+    //! Inverse masses, aligned and padded for the SIMD update
+    PaddedVector<real> invMass_;
+    //! Inverse masses per dimension
+    std::vector<RVec> invMassPerDim_;
+    //! The forces
+    PaddedVector<RVec> f_;
+    //! The initial velocities
+    std::vector<RVec> v_;
+};
+
+TEST_P(FusedUpdateTest, MatchesSeparatePasses)
+{
+    const StepResult reference = doStep(false);
+    const StepResult fused     = doStep(true);
+
+    const auto tolerance = relativeToleranceAsPrecisionDependentUlp(10.0, 64, 512);
+
+    for (int i = 0; i < water_.numAtoms_; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(reference.x[i][d], fused.x[i][d], tolerance)
+                    << formatString("x mismatch for atom %d dimension %d", i, d);
+            EXPECT_REAL_EQ_TOL(reference.v[i][d], fused.v[i][d], tolerance)
+                    << formatString("v mismatch for atom %d dimension %d", i, d);
+        }
+    }
+    for (int m = 0; m < DIM; m++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(reference.ekinh[m][d], fused.ekinh[m][d], tolerance)
+                    << formatString("ekinh mismatch for element %d %d", m, d);
+            EXPECT_REAL_EQ_TOL(reference.virial[m][d], fused.virial[m][d], tolerance)
+                    << formatString("virial mismatch for element %d %d", m, d);
+        }
+    }
+}
+
+TEST(FusedUpdateSelectionTest, CanBeDisabledPerUpdateObject)
+{
+    t_inputrec ir;
+    ir.eI = eiMD;
+    gmx_ekindata_t ekind;
+    ekind.bNEMD = FALSE;
+
+    gmxUnsetenv("GMX_DISABLE_FUSED_UPDATE");
+    const Update update(ir, nullptr);
+    gmxSetenv("GMX_DISABLE_FUSED_UPDATE", "1", 1);
+    const Update updateWithoutFusion(ir, nullptr);
+    gmxUnsetenv("GMX_DISABLE_FUSED_UPDATE");
+
+    EXPECT_TRUE(update.useFusedLeapfrogUpdate(ir, ekind));
+    EXPECT_FALSE(updateWithoutFusion.useFusedLeapfrogUpdate(ir, ekind));
+    ir.eI = eiSD1;
+    EXPECT_FALSE(update.useFusedLeapfrogUpdate(ir, ekind));
+}
+
+#if GMX_OPENMP
+// With different update and SETTLE thread counts, SETTLE is not fused with the update
+INSTANTIATE_TEST_CASE_P(WithThreads,
+                        FusedUpdateTest,
+                        ::testing::Values(std::make_tuple(1, 1),
+                                          std::make_tuple(2, 2),
+                                          std::make_tuple(3, 2),
+                                          std::make_tuple(2, 3)));
+#else
+INSTANTIATE_TEST_CASE_P(WithThreads, FusedUpdateTest, ::testing::Values(std::make_tuple(1, 1)));
+#endif
+
+} // namespace
+} // namespace test
+} // namespace gmx
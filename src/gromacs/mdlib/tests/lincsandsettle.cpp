@@ -0,0 +1,336 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for LINCS and SETTLE running with multiple OpenMP threads.
+ *
+ * A box of SETTLE water and a chain molecule with LINCS constraints
+ * are constrained with different numbers of LINCS and SETTLE threads.
+ * When the thread counts are equal, SETTLE runs in the LINCS parallel
+ * region. The results should agree with those obtained using a single
+ * thread, for both constraining coordinates and projecting out the
+ * constraint components of derivatives and force displacements.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "config.h"
+
+#include <cmath>
+
+#include <array>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/paddedvector.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdlib/constr.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdlib/makeconstraints.h"
+#include "gromacs/mdtypes/commrec.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testasserts.h"
+
+#include "settletestdata.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of water molecules
+constexpr int c_numWaters = 17;
+//! The number of atoms in the chain molecule, gives several constraints per LINCS thread
+constexpr int c_numChainAtoms = 40;
+//! The constraint length in the chain molecule
+constexpr real c_chainBondLength = 0.15;
+//! The scaling of the displacement when constraining coordinates
+constexpr real c_positionDisplacement = 0.01;
+
+//! The results of constraining
+struct ConstraintResult
+{
+    //! The constrained coordinates or the projected derivatives
+    std::vector<RVec> xprime;
+    //! The velocities, only changed when constraining coordinates
+    std::vector<RVec> v;
+    //! The constraint virial
+    tensor virial = { { 0 } };
+};
+
+/*! \brief Test fixture for comparing multi-threaded LINCS and SETTLE with a single thread
+ *
+ * The parameters are the number of LINCS threads, the number of SETTLE
+ * threads and the constraint variable. When the thread counts are equal,
+ * SETTLE runs in the LINCS parallel region.
+ */
+class LincsAndSettleTest :
+    public ::testing::TestWithParam<std::tuple<int, int, ConstraintVariable>>
+{
+public:
+    LincsAndSettleTest() : water_(c_numWaters)
+    {
+        numAtoms_ = water_.numAtoms_ + c_numChainAtoms;
+
+        // The moltypes can not be copied, so we set up a new topology
+        // with the water from water_ and a chain molecule with constraints
+        // between consecutive atoms. The chain has more than two sequential
+        // constraints, so the LINCS tasks depend on each other.
+        mtop_.ffparams.iparams = water_.mtop_.ffparams.iparams;
+        mtop_.ffparams.functype.push_back(F_SETTLE);
+        t_iparams constraintParameters;
+        constraintParameters.constr.dA = c_chainBondLength;
+        constraintParameters.constr.dB = c_chainBondLength;
+        const int constraintType       = mtop_.ffparams.iparams.size();
+        mtop_.ffparams.iparams.push_back(constraintParameters);
+        mtop_.ffparams.functype.push_back(F_CONSTR);
+
+        mtop_.moltype.resize(2);
+        gmx_moltype_t& water  = mtop_.moltype[0];
+        water.atoms.nr        = water_.numAtoms_;
+        water.ilist[F_SETTLE] = water_.mtop_.moltype[0].ilist[F_SETTLE];
+        gmx_moltype_t& chain  = mtop_.moltype[1];
+        chain.atoms.nr        = c_numChainAtoms;
+        snew(water.atoms.atom, water.atoms.nr);
+        snew(chain.atoms.atom, chain.atoms.nr);
+        for (int i = 0; i + 1 < c_numChainAtoms; i++)
+        {
+            chain.ilist[F_CONSTR].push_back(constraintType, std::array<int, 2>{ { i, i + 1 } });
+        }
+        mtop_.molblock.resize(2);
+        mtop_.molblock[0].type = 0;
+        mtop_.molblock[0].nmol = 1;
+        mtop_.molblock[1].type = 1;
+        mtop_.molblock[1].nmol = 1;
+        mtop_.natoms           = numAtoms_;
+
+        x_.resizeWithPadding(numAtoms_);
+        masses_.resize(numAtoms_);
+        inverseMasses_.resize(numAtoms_);
+        for (int i = 0; i < water_.numAtoms_; i++)
+        {
+            x_[i]                 = water_.x_[i];
+            masses_[i]            = water_.masses_[i];
+            inverseMasses_[i]     = water_.inverseMasses_[i];
+            water.atoms.atom[i].m = masses_[i];
+        }
+        for (int i = 0; i < c_numChainAtoms; i++)
+        {
+            // A zig-zag chain with all bond lengths equal to c_chainBondLength
+            const int a = water_.numAtoms_ + i;
+            x_[a]       = RVec(i * 0.12, (i % 2) * 0.09, 1.5);
+            // Alternate masses, so the mass weighting matters
+            masses_[a]            = (i % 2 == 0) ? 12.011 : 1.008;
+            inverseMasses_[a]     = 1.0 / masses_[a];
+            chain.atoms.atom[i].m = masses_[a];
+        }
+
+        // The derivative to project, which is scaled by c_positionDisplacement
+        // for displacing the coordinates by a few percent of the bond lengths
+        displacement_.resize(numAtoms_);
+        for (int i = 0; i < numAtoms_; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                displacement_[i][d] = std::sin(1.3 * i + 2.1 * d);
+            }
+        }
+
+        ir_.eConstrAlg = econtLINCS;
+        ir_.nProjOrder = 4;
+        ir_.nLincsIter = 1;
+        ir_.delta_t    = 0.002;
+        // Avoid LINCS warnings about the rotation of constraints
+        ir_.LincsWarnAngle = 90;
+
+        cr_.nnodes = 1;
+        cr_.dd     = nullptr;
+    }
+
+    //! Constrains with \p numLincsThreads and \p numSettleThreads threads
+    ConstraintResult constrain(int numLincsThreads, int numSettleThreads)
+    {
+        const ConstraintVariable econq = std::get<2>(GetParam());
+
+        // Projecting out force displacements is only allowed with energy minimization
+        ir_.eI = (econq == ConstraintVariable::ForceDispl ? eiSteep : eiMD);
+
+        gmx_omp_nthreads_set(emntLINCS, numLincsThreads);
+        gmx_omp_nthreads_set(emntSETTLE, numSettleThreads);
+
+        auto constr = makeConstraints(mtop_, ir_, nullptr, false, nullptr, &cr_, nullptr, &nrnb_,
+                                      nullptr, false);
+        gmx_localtop_t top(mtop_.ffparams);
+        top.idef.il[F_SETTLE] = mtop_.moltype[0].ilist[F_SETTLE];
+        const InteractionList& chainConstraints = mtop_.moltype[1].ilist[F_CONSTR];
+        for (int i = 0; i < chainConstraints.size(); i += 1 + NRAL(F_CONSTR))
+        {
+            const std::array<int, 2> atoms = {
+                { water_.numAtoms_ + chainConstraints.iatoms[i + 1],
+                  water_.numAtoms_ + chainConstraints.iatoms[i + 2] }
+            };
+            top.idef.il[F_CONSTR].push_back(chainConstraints.iatoms[i], atoms);
+        }
+        constr->setConstraints(&top, numAtoms_, numAtoms_, masses_.data(), inverseMasses_.data(),
+                               false, 0, nullptr);
+
+        PaddedVector<RVec> x(x_);
+        PaddedVector<RVec> xprime;
+        PaddedVector<RVec> v;
+        xprime.resizeWithPadding(numAtoms_);
+        v.resizeWithPadding(numAtoms_);
+        for (int i = 0; i < numAtoms_; i++)
+        {
+            if (econq == ConstraintVariable::Positions)
+            {
+                xprime[i] = x_[i] + c_positionDisplacement * displacement_[i];
+            }
+            else
+            {
+                xprime[i] = displacement_[i];
+            }
+            v[i] = { 0, 0, 0 };
+        }
+
+        ConstraintResult result;
+        real             dvdlambda = 0;
+        // Note that the virial is not supported for projecting out derivatives
+        const bool computeVirial = (econq != ConstraintVariable::Derivative);
+        if (econq == ConstraintVariable::Positions)
+        {
+            constr->apply(false, false, 0, 1, 1.0, x.arrayRefWithPadding(),
+                          xprime.arrayRefWithPadding(), {}, box_, 0, &dvdlambda,
+                          v.arrayRefWithPadding(), computeVirial, result.virial, econq);
+        }
+        else
+        {
+            // As in energy minimization, the projection is done in place
+            constr->apply(false, false, 0, 0, 1.0, x.arrayRefWithPadding(),
+                          xprime.arrayRefWithPadding(), xprime, box_, 0, &dvdlambda, {},
+                          computeVirial, result.virial, econq);
+        }
+
+        result.xprime.assign(xprime.begin(), xprime.begin() + numAtoms_);
+        result.v.assign(v.begin(), v.begin() + numAtoms_);
+
+        return result;
+    }
+
+    //! The water system with SETTLE
+    SettleTestData water_;
+    //! The topology with the water and the chain molecule
+    gmx_mtop_t mtop_;
+    //! The total number of atoms
+    int numAtoms_;
+    //! The reference coordinates
+    PaddedVector<RVec> x_;
+    //! The masses
+    std::vector<real> masses_;
+    //! The inverse masses
+    std::vector<real> inverseMasses_;
+    //! The displacement of the coordinates or the derivative to project
+    std::vector<RVec> displacement_;
+    //! The box, not used since there is no PBC handling
+    matrix box_ = { { 3, 0, 0 }, { 0, 3, 0 }, { 0, 0, 3 } };
+    //! The input record
+    t_inputrec ir_;
+    //! Communication record, for a single rank
+    t_commrec cr_;
+    //! Flop counters, not checked
+    t_nrnb nrnb_;
+};
+
+TEST_P(LincsAndSettleTest, ThreadsMatchSingleThread)
+{
+    const ConstraintResult reference = constrain(1, 1);
+    const ConstraintResult threaded  = constrain(std::get<0>(GetParam()), std::get<1>(GetParam()));
+
+    const auto tolerance = relativeToleranceAsPrecisionDependentUlp(10.0, 64, 512);
+
+    for (int i = 0; i < numAtoms_; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(reference.xprime[i][d], threaded.xprime[i][d], tolerance)
+                    << formatString("xprime mismatch for atom %d dimension %d", i, d);
+            EXPECT_REAL_EQ_TOL(reference.v[i][d], threaded.v[i][d], tolerance)
+                    << formatString("v mismatch for atom %d dimension %d", i, d);
+        }
+    }
+    for (int m = 0; m < DIM; m++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(reference.virial[m][d], threaded.virial[m][d], tolerance)
+                    << formatString("virial mismatch for element %d %d", m, d);
+        }
+    }
+}
+
+#if GMX_OPENMP
+// With equal LINCS and SETTLE thread counts, SETTLE runs in the LINCS parallel region
+INSTANTIATE_TEST_CASE_P(WithThreads,
+                        LincsAndSettleTest,
+                        ::testing::Combine(::testing::Values(1, 2, 3),
+                                           ::testing::Values(1, 2, 3),
+                                           ::testing::Values(ConstraintVariable::Positions,
+                                                             ConstraintVariable::Derivative,
+                                                             ConstraintVariable::ForceDispl)));
+#else
+INSTANTIATE_TEST_CASE_P(WithThreads,
+                        LincsAndSettleTest,
+                        ::testing::Combine(::testing::Values(1),
+                                           ::testing::Values(1),
+                                           ::testing::Values(ConstraintVariable::Positions,
+                                                             ConstraintVariable::Derivative,
+                                                             ConstraintVariable::ForceDispl)));
+#endif
+
+} // namespace
+} // namespace test
+} // namespace gmx
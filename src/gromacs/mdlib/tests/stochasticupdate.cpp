@@ -0,0 +1,339 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the SIMD stochastic and Brownian dynamics updates.
+ *
+ * One step of a box of SETTLE water is performed with the SD and BD
+ * integrators, once with the SIMD update and once with the plain-C
+ * update, selected by setting GMX_DISABLE_SIMD_KERNELS before creating
+ * the Update object. The number of atoms is not a multiple of the SIMD
+ * width, and there are virtual sites, shells, partially and fully frozen
+ * atoms, acceleration groups and temperature coupling groups.
+ * Both updates use the same random numbers, so the coordinates and
+ * velocities should agree within rounding.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/paddedvector.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdlib/constr.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdlib/makeconstraints.h"
+#include "gromacs/mdlib/update.h"
+#include "gromacs/mdtypes/commrec.h"
+#include "gromacs/mdtypes/fcdata.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/mdtypes/mdatom.h"
+#include "gromacs/mdtypes/state.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/setenv.h"
+#include "testutils/testasserts.h"
+
+#include "settletestdata.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of water molecules, 13 waters give 39 atoms, not a multiple of any SIMD width
+constexpr int c_numWaters = 13;
+
+//! The stochastic integration schemes to test
+enum class StochasticScheme : int
+{
+    //! SD without constraints, with the combined update
+    SD,
+    //! SD with constraints, with separate force and friction plus noise updates
+    SDConstrained,
+    //! BD with a friction coefficient
+    BDFriction,
+    //! BD with the friction coefficient derived from the masses
+    BDMass
+};
+
+//! Returns the name of \p scheme
+const char* schemeName(StochasticScheme scheme)
+{
+    switch (scheme)
+    {
+        case StochasticScheme::SD: return "SD";
+        case StochasticScheme::SDConstrained: return "SDConstrained";
+        case StochasticScheme::BDFriction: return "BDFriction";
+        case StochasticScheme::BDMass: return "BDMass";
+    }
+    return "";
+}
+
+//! The results of a single step
+struct StepResult
+{
+    //! The coordinates after the step
+    std::vector<RVec> x;
+    //! The velocities after the step
+    std::vector<RVec> v;
+};
+
+//! Test fixture for comparing the SIMD and plain-C stochastic updates
+class StochasticUpdateTest : public ::testing::TestWithParam<StochasticScheme>
+{
+public:
+    StochasticUpdateTest() : water_(c_numWaters)
+    {
+        const int numAtoms = water_.numAtoms_;
+
+        gmx_mtop_t& mtop         = water_.mtop_;
+        mtop.moltype[0].atoms.nr = numAtoms;
+        mtop.molblock[0].nmol    = 1;
+        mtop.natoms              = numAtoms;
+        mtop.ffparams.functype.push_back(F_SETTLE);
+
+        const StochasticScheme scheme = GetParam();
+        const bool             isSD =
+                (scheme == StochasticScheme::SD || scheme == StochasticScheme::SDConstrained);
+
+        ir_.eI      = isSD ? eiSD1 : eiBD;
+        ir_.delta_t = 0.002;
+        ir_.etc     = etcNO;
+        ir_.epc     = epcNO;
+        ir_.ld_seed = 1993;
+        ir_.bd_fric = (scheme == StochasticScheme::BDFriction ? 500.0 : 0.0);
+
+        ir_.opts.ngtc  = 2;
+        ir_.opts.ngacc = 2;
+        snew(ir_.opts.tau_t, ir_.opts.ngtc);
+        snew(ir_.opts.ref_t, ir_.opts.ngtc);
+        ir_.opts.tau_t[0] = 0.1;
+        ir_.opts.tau_t[1] = 0.5;
+        ir_.opts.ref_t[0] = 300;
+        ir_.opts.ref_t[1] = 250;
+        snew(ir_.opts.acc, ir_.opts.ngacc);
+        ir_.opts.acc[1][XX] = 0.1;
+        ir_.opts.acc[1][YY] = -0.2;
+        ir_.opts.acc[1][ZZ] = 0.3;
+        // Group 1 is frozen along y only, group 2 along all dimensions
+        snew(ir_.opts.nFreeze, 3);
+        ir_.opts.nFreeze[1][YY] = 1;
+        for (int d = 0; d < DIM; d++)
+        {
+            ir_.opts.nFreeze[2][d] = 1;
+        }
+        // This is to keep done_inputrec happy
+        snew(ir_.opts.anneal_time, ir_.opts.ngtc);
+        snew(ir_.opts.anneal_temp, ir_.opts.ngtc);
+
+        cr_.nnodes = 1;
+        cr_.dd     = nullptr;
+
+        invMass_.resizeWithPadding(numAtoms);
+        invMassPerDim_.resize(numAtoms);
+        ptype_.resize(numAtoms);
+        cTC_.resize(numAtoms);
+        cACC_.resize(numAtoms);
+        cFREEZE_.resize(numAtoms);
+        f_.resizeWithPadding(numAtoms);
+        v_.resize(numAtoms);
+        for (int i = 0; i < numAtoms; i++)
+        {
+            invMass_[i]       = water_.inverseMasses_[i];
+            invMassPerDim_[i] = { water_.inverseMasses_[i], water_.inverseMasses_[i],
+                                  water_.inverseMasses_[i] };
+            ptype_[i]         = (i % 11 == 4 ? eptVSite : (i % 13 == 6 ? eptShell : eptAtom));
+            cTC_[i]           = i % 2;
+            cACC_[i]          = (i % 3 == 0 ? 1 : 0);
+            cFREEZE_[i]       = (i % 5 == 1 ? 1 : (i % 7 == 2 ? 2 : 0));
+            for (int d = 0; d < DIM; d++)
+            {
+                f_[i][d] = 300.0 * std::sin(1.3 * i + 2.1 * d);
+                v_[i][d] = std::cos(0.7 * i + 1.9 * d);
+            }
+        }
+    }
+
+    //! Performs one step, using the SIMD update when \p useSimd is true
+    StepResult doStep(bool useSimd)
+    {
+        const int  numAtoms        = water_.numAtoms_;
+        const bool haveConstraints = (GetParam() == StochasticScheme::SDConstrained);
+
+        gmx_omp_nthreads_set(emntUpdate, 1);
+        gmx_omp_nthreads_set(emntSETTLE, 1);
+
+        t_state state;
+        state.flags = (1 << estX) | (1 << estV);
+        state.x.resizeWithPadding(numAtoms);
+        state.v.resizeWithPadding(numAtoms);
+        for (int i = 0; i < numAtoms; i++)
+        {
+            state.x[i] = water_.x_[i];
+            state.v[i] = v_[i];
+        }
+        clear_mat(state.box);
+        for (int d = 0; d < DIM; d++)
+        {
+            state.box[d][d] = 3.0;
+        }
+
+        t_mdatoms md                = {};
+        md.nr                       = numAtoms;
+        md.homenr                   = numAtoms;
+        md.massT                    = water_.masses_.data();
+        md.invmass                  = invMass_.data();
+        md.invMassPerDim            = as_rvec_array(invMassPerDim_.data());
+        md.ptype                    = ptype_.data();
+        md.cTC                      = cTC_.data();
+        md.cACC                     = cACC_.data();
+        md.cFREEZE                  = cFREEZE_.data();
+        md.haveVsites               = true;
+        md.havePartiallyFrozenAtoms = true;
+
+        if (!useSimd)
+        {
+            gmxSetenv("GMX_DISABLE_SIMD_KERNELS", "1", 1);
+        }
+        Update update(ir_, nullptr);
+        if (!useSimd)
+        {
+            gmxUnsetenv("GMX_DISABLE_SIMD_KERNELS");
+        }
+        update.setNumAtoms(numAtoms);
+
+        const int64_t step = 18;
+        const matrix  M    = { { 0 } };
+        t_fcdata      fcdata;
+
+        update.update_coords(ir_, step, &md, &state, f_.constArrayRefWithPadding(), fcdata,
+                             nullptr, M, etrtPOSITION, &cr_, haveConstraints);
+        if (haveConstraints)
+        {
+            auto constr = makeConstraints(water_.mtop_, ir_, nullptr, false, nullptr, &cr_, nullptr,
+                                          &nrnb_, nullptr, false);
+            gmx_localtop_t top(water_.mtop_.ffparams);
+            top.idef.il[F_SETTLE] = water_.mtop_.moltype[0].ilist[F_SETTLE];
+            constr->setConstraints(&top, numAtoms, numAtoms, water_.masses_.data(),
+                                   water_.inverseMasses_.data(), false, 0, nullptr);
+
+            real dvdlConstr = 0;
+            constr->apply(false, false, step, 1, 1.0, state.x.arrayRefWithPadding(),
+                          update.xp()->arrayRefWithPadding(), {}, state.box, 0, &dvdlConstr,
+                          state.v.arrayRefWithPadding(), false, nullptr,
+                          ConstraintVariable::Positions);
+            update.update_sd_second_half(ir_, step, &dvdlConstr, &md, &state, &cr_, &nrnb_,
+                                         nullptr, constr.get(), false, false);
+        }
+        update.finish_update(ir_, &md, &state, nullptr, haveConstraints);
+
+        StepResult result;
+        result.x.assign(state.x.begin(), state.x.begin() + numAtoms);
+        result.v.assign(state.v.begin(), state.v.begin() + numAtoms);
+
+        return result;
+    }
+
+    //! The water system with SETTLE
+    SettleTestData water_;
+    //! The input record
+    t_inputrec ir_;
+    //! Communication record, for a single rank
+    t_commrec cr_;
+    //! Flop counters, not checked
+    t_nrnb nrnb_;
+    //! Inverse masses, aligned and padded for the SIMD update
+    PaddedVector<real> invMass_;
+    //! Inverse masses per dimension
+    std::vector<RVec> invMassPerDim_;
+    //! Particle types
+    std::vector<unsigned short> ptype_;
+    //! Temperature coupling groups
+    std::vector<unsigned short> cTC_;
+    //! Acceleration groups
+    std::vector<unsigned short> cACC_;
+    //! Freeze groups
+    std::vector<unsigned short> cFREEZE_;
+    //! The forces
+    PaddedVector<RVec> f_;
+    //! The initial velocities
+    std::vector<RVec> v_;
+};
+
+TEST_P(StochasticUpdateTest, SimdMatchesPlainC)
+{
+    const StepResult reference = doStep(false);
+    const StepResult simd      = doStep(true);
+
+    const auto tolerance = relativeToleranceAsPrecisionDependentUlp(10.0, 64, 512);
+
+    for (int i = 0; i < water_.numAtoms_; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(reference.x[i][d], simd.x[i][d], tolerance)
+                    << formatString("%s x mismatch for atom %d dimension %d",
+                                    schemeName(GetParam()), i, d);
+            EXPECT_REAL_EQ_TOL(reference.v[i][d], simd.v[i][d], tolerance)
+                    << formatString("%s v mismatch for atom %d dimension %d",
+                                    schemeName(GetParam()), i, d);
+        }
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(WithSchemes,
+                        StochasticUpdateTest,
+                        ::testing::Values(StochasticScheme::SD,
+                                          StochasticScheme::SDConstrained,
+                                          StochasticScheme::BDFriction,
+                                          StochasticScheme::BDMass));
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,317 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the SIMD virtual site construction and force spreading kernels.
+ *
+ * The SIMD kernels are compared against the plain-C kernels, which are
+ * selected by setting GMX_DISABLE_SIMD_KERNELS before creating the handler.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "gromacs/mdlib/vsite.h"
+
+#include "config.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/paddedvector.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/mdtypes/mdatom.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/setenv.h"
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+/*! \brief The number of virtual sites per type
+ *
+ * This is not a multiple of any SIMD width, so the kernels also
+ * process a partially filled SIMD register.
+ */
+constexpr int c_numVsitesPerType = 13;
+
+//! A vsite type together with its construction parameters
+struct VsiteTypeAndParameters
+{
+    //! The interaction function type
+    int ftype;
+    //! The construction parameters
+    real a, b, c;
+};
+
+//! All vsite types that have SIMD kernels, with parameters that give sensible geometries
+const std::vector<VsiteTypeAndParameters> c_vsiteTypes = {
+    { F_VSITE2, 0.3, 0, 0 },        { F_VSITE2FD, 0.05, 0, 0 },
+    { F_VSITE3, 0.3, 0.2, 0 },      { F_VSITE3FD, 0.4, 0.04, 0 },
+    { F_VSITE3FAD, 0.03, 0.04, 0 }, { F_VSITE3OUT, 0.3, 0.3, 2.0 },
+    { F_VSITE4FD, 0.3, 0.3, 0.05 }, { F_VSITE4FDN, 0.5, 0.5, 0.05 }
+};
+
+/*! \brief Test fixture with a single molecule containing all SIMD vsite types
+ *
+ * Each virtual site is constructed from its own constructing atoms,
+ * which are placed at random around the center of the molecule.
+ * The parameter is the number of OpenMP threads to use.
+ */
+class VirtualSitesSimdTest : public ::testing::TestWithParam<int>
+{
+public:
+    VirtualSitesSimdTest()
+    {
+        gmx_moltype_t moltype;
+        int           numAtoms = 0;
+        for (const auto& vsiteType : c_vsiteTypes)
+        {
+            t_iparams params;
+            params.vsite.a = vsiteType.a;
+            params.vsite.b = vsiteType.b;
+            params.vsite.c = vsiteType.c;
+            const int type = mtop_.ffparams.numTypes();
+            mtop_.ffparams.iparams.push_back(params);
+            mtop_.ffparams.functype.push_back(vsiteType.ftype);
+
+            const int nral = NRAL(vsiteType.ftype);
+            for (int v = 0; v < c_numVsitesPerType; v++)
+            {
+                std::vector<int> atoms(nral);
+                for (int a = 0; a < nral; a++)
+                {
+                    atoms[a] = numAtoms + a;
+                }
+                moltype.ilist[vsiteType.ftype].push_back(type, nral, atoms.data());
+                ptype_.push_back(eptVSite);
+                ptype_.resize(numAtoms + nral, eptAtom);
+                numAtoms += nral;
+            }
+        }
+        moltype.atoms.nr = numAtoms;
+        mtop_.moltype.push_back(moltype);
+
+        gmx_molblock_t molblock;
+        molblock.type = 0;
+        molblock.nmol = 1;
+        mtop_.molblock.push_back(molblock);
+        mtop_.natoms = numAtoms;
+
+        ilists_ = mtop_.moltype[0].ilist;
+
+        mdatoms_.nr     = numAtoms;
+        mdatoms_.homenr = numAtoms;
+        mdatoms_.ptype  = ptype_.data();
+
+        DefaultRandomEngine           rng(1893);
+        UniformRealDistribution<real> coordinateDist(-0.2, 0.2);
+        UniformRealDistribution<real> forceDist(-1.0, 1.0);
+        x_.resizeWithPadding(numAtoms);
+        f_.resizeWithPadding(numAtoms);
+        for (int i = 0; i < numAtoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                x_[i][d] = 1.0 + coordinateDist(rng);
+                f_[i][d] = forceDist(rng);
+            }
+        }
+
+        gmx_omp_nthreads_set(emntVSITE, GetParam());
+    }
+
+    //! Returns a vsite handler, using only the plain-C kernels when \p disableSimd is true
+    std::unique_ptr<VirtualSitesHandler> makeHandler(bool disableSimd) const
+    {
+        if (disableSimd)
+        {
+            gmxSetenv("GMX_DISABLE_SIMD_KERNELS", "1", 1);
+        }
+        auto vsite = std::make_unique<VirtualSitesHandler>(mtop_, nullptr, PbcType::No);
+        if (disableSimd)
+        {
+            gmxUnsetenv("GMX_DISABLE_SIMD_KERNELS");
+        }
+        vsite->setVirtualSites(ilists_, mdatoms_);
+
+        return vsite;
+    }
+
+    /*! \brief Checks that \p result matches \p reference to within the precision of the kernels
+     *
+     * \p magnitude is the magnitude of the values relative to the rounding errors,
+     * which is 1 except for velocities which are a displacement divided by the time step.
+     */
+    static void compareVectors(ArrayRef<const RVec> reference,
+                               ArrayRef<const RVec> result,
+                               const char*          name,
+                               real                 magnitude = 1)
+    {
+        const auto tolerance =
+                relativeToleranceAsPrecisionDependentFloatingPoint(magnitude, 1e-5, 1e-12);
+        ASSERT_EQ(reference.size(), result.size());
+        for (size_t i = 0; i < reference.size(); i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_REAL_EQ_TOL(reference[i][d], result[i][d], tolerance)
+                        << formatString("%s mismatch for atom %zu dimension %d", name, i, d);
+            }
+        }
+    }
+
+    //! The topology
+    gmx_mtop_t mtop_;
+    //! The vsite interaction lists of the molecule
+    InteractionLists ilists_;
+    //! The particle types
+    std::vector<unsigned short> ptype_;
+    //! The atom data, only the number of atoms and ptype are set
+    t_mdatoms mdatoms_ = {};
+    //! Initial coordinates
+    PaddedVector<RVec> x_;
+    //! Forces to spread
+    PaddedVector<RVec> f_;
+    //! Flop counters, not checked
+    t_nrnb nrnb_;
+    //! The box, not used as we do not use PBC
+    const matrix box_ = { { 3, 0, 0 }, { 0, 3, 0 }, { 0, 0, 3 } };
+};
+
+TEST_P(VirtualSitesSimdTest, ConstructionMatchesPlainC)
+{
+    const real dt = 0.002;
+
+    PaddedVector<RVec> xReference = x_;
+    PaddedVector<RVec> vReference(x_.size(), { 0, 0, 0 });
+    makeHandler(true)->construct(xReference.arrayRefWithPadding().unpaddedArrayRef(), dt,
+                                 vReference.arrayRefWithPadding().unpaddedArrayRef(), box_);
+
+    PaddedVector<RVec> xSimd = x_;
+    PaddedVector<RVec> vSimd(x_.size(), { 0, 0, 0 });
+    makeHandler(false)->construct(xSimd.arrayRefWithPadding().unpaddedArrayRef(), dt,
+                                  vSimd.arrayRefWithPadding().unpaddedArrayRef(), box_);
+
+    compareVectors(xReference.arrayRefWithPadding().unpaddedArrayRef(),
+                   xSimd.arrayRefWithPadding().unpaddedArrayRef(), "x");
+    compareVectors(vReference.arrayRefWithPadding().unpaddedArrayRef(),
+                   vSimd.arrayRefWithPadding().unpaddedArrayRef(), "v", 1 / dt);
+
+    // The free function uses the plain-C kernels only
+    PaddedVector<RVec> xGlobal = x_;
+    constructVirtualSites(xGlobal.arrayRefWithPadding().unpaddedArrayRef(),
+                          mtop_.ffparams.iparams, ilists_);
+    compareVectors(xReference.arrayRefWithPadding().unpaddedArrayRef(),
+                   xGlobal.arrayRefWithPadding().unpaddedArrayRef(), "x global");
+}
+
+TEST_P(VirtualSitesSimdTest, SpreadingMatchesPlainC)
+{
+    using VirialHandling = VirtualSitesHandler::VirialHandling;
+
+    PaddedVector<RVec> x = x_;
+    constructVirtualSites(x.arrayRefWithPadding().unpaddedArrayRef(), mtop_.ffparams.iparams,
+                          ilists_);
+    ArrayRef<const RVec> xRef = x.arrayRefWithPadding().unpaddedArrayRef();
+
+    auto vsiteReference = makeHandler(true);
+    auto vsiteSimd      = makeHandler(false);
+
+    for (const auto virialHandling :
+         { VirialHandling::None, VirialHandling::Pbc, VirialHandling::NonLinear })
+    {
+        SCOPED_TRACE(formatString("With virial handling %d", static_cast<int>(virialHandling)));
+
+        PaddedVector<RVec> fReference = f_;
+        std::vector<RVec>  fshiftReference(SHIFTS, { 0, 0, 0 });
+        matrix             virialReference = { { 0 } };
+        vsiteReference->spreadForces(xRef, fReference.arrayRefWithPadding(), virialHandling,
+                                     fshiftReference, virialReference, &nrnb_, box_, nullptr);
+
+        PaddedVector<RVec> fSimd = f_;
+        std::vector<RVec>  fshiftSimd(SHIFTS, { 0, 0, 0 });
+        matrix             virialSimd = { { 0 } };
+        vsiteSimd->spreadForces(xRef, fSimd.arrayRefWithPadding(), virialHandling, fshiftSimd,
+                                virialSimd, &nrnb_, box_, nullptr);
+
+        compareVectors(fReference.arrayRefWithPadding().unpaddedArrayRef(),
+                       fSimd.arrayRefWithPadding().unpaddedArrayRef(), "f");
+        compareVectors(fshiftReference, fshiftSimd, "fshift");
+        compareVectors(arrayRefFromArray(reinterpret_cast<RVec*>(virialReference), DIM),
+                       arrayRefFromArray(reinterpret_cast<RVec*>(virialSimd), DIM), "virial");
+
+        /* A force buffer without padding, as used for the direct virial
+         * contributions, should give the same result using the plain-C kernels.
+         */
+        std::vector<RVec> fUnpadded(f_.begin(), f_.end());
+        std::vector<RVec> fshiftUnpadded(SHIFTS, { 0, 0, 0 });
+        matrix            virialUnpadded = { { 0 } };
+        vsiteSimd->spreadForces(xRef, fUnpadded, virialHandling, fshiftUnpadded, virialUnpadded,
+                                &nrnb_, box_, nullptr);
+
+        compareVectors(fReference.arrayRefWithPadding().unpaddedArrayRef(), fUnpadded,
+                       "f unpadded");
+        compareVectors(arrayRefFromArray(reinterpret_cast<RVec*>(virialReference), DIM),
+                       arrayRefFromArray(reinterpret_cast<RVec*>(virialUnpadded), DIM),
+                       "virial unpadded");
+    }
+}
+
+#if GMX_OPENMP
+INSTANTIATE_TEST_CASE_P(WithThreads, VirtualSitesSimdTest, ::testing::Values(1, 2));
+#else
+INSTANTIATE_TEST_CASE_P(WithThreads, VirtualSitesSimdTest, ::testing::Values(1));
+#endif
+
+} // namespace
+} // namespace test
+} // namespace gmx
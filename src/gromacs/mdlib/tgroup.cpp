@@ -212,6 +212,57 @@ void update_ekindata(int              start,
     }
 }
 
+void accumulate_ekin_work(int              start,
+                          int              end,
+                          const rvec       v[],
+                          const t_mdatoms* md,
+                          gmx_ekindata_t*  ekind,
+                          int              thread)
+{
+    matrix* ekin_sum    = ekind->ekin_work[thread];
+    real*   dekindl_sum = ekind->dekindl_work[thread];
+
+    for (int gt = 0; gt < ekind->ngtc; gt++)
+    {
+        clear_mat(ekin_sum[gt]);
+    }
+    *dekindl_sum = 0.0;
+
+    int ga = 0;
+    int gt = 0;
+    for (int n = start; n < end; n++)
+    {
+        if (md->cACC)
+        {
+            ga = md->cACC[n];
+        }
+        if (md->cTC)
+        {
+            gt = md->cTC[n];
+        }
+        real hm = 0.5 * md->massT[n];
+
+        rvec v_corrt;
+        for (int d = 0; (d < DIM); d++)
+        {
+            v_corrt[d] = v[n][d] - ekind->grpstat[ga].u[d];
+        }
+        for (int d = 0; (d < DIM); d++)
+        {
+            for (int m = 0; (m < DIM); m++)
+            {
+                /* if we're computing a full step velocity, v_corrt[d] has v(t).
+                 * Otherwise, v(t+dt/2) */
+                ekin_sum[gt][m][d] += hm * v_corrt[m] * v_corrt[d];
+            }
+        }
+        if (md->nMassPerturbed && md->bPerturbed[n])
+        {
+            *dekindl_sum += 0.5 * (md->massB[n] - md->massA[n]) * iprod(v_corrt, v_corrt);
+        }
+    }
+}
+
 real sum_ekin(const t_grpopts* opts, gmx_ekindata_t* ekind, real* dekindlambda, gmx_bool bEkinAveVel, gmx_bool bScaleEkin)
 {
     int           i, j, m, ngtc;
@@ -77,4 +77,16 @@ void update_ekindata(int              start,
  * (partial) group ekin.
  */
 
+void accumulate_ekin_work(int              start,
+                          int              end,
+                          const rvec       v[],
+                          const t_mdatoms* md,
+                          gmx_ekindata_t*  ekind,
+                          int              thread);
+/* Clear the kinetic energy work buffers of thread and accumulate
+ * the kinetic energy tensors and dEkin/dlambda of atoms start
+ * to end-1 into them. The buffers of all threads are summed into
+ * the group ekin by compute_globals.
+ */
+
 #endif
@@ -41,8 +41,10 @@
 
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 
 #include <algorithm>
+#include <array>
 #include <memory>
 
 #include "gromacs/domdec/domdec_struct.h"
@@ -138,6 +140,23 @@ public:
                        gmx_wallcycle_t   wcycle,
                        bool              haveConstraints);
 
+    void update_leapfrog_fused(const t_inputrec&                      inputRecord,
+                               int64_t                                step,
+                               const t_mdatoms*                       md,
+                               t_state*                               state,
+                               const ArrayRefWithPadding<const RVec>& f,
+                               const t_fcdata&                        fcdata,
+                               gmx_ekindata_t*                        ekind,
+                               const matrix                           M,
+                               Constraints*                           constr,
+                               bool                                   do_log,
+                               bool                                   do_ene,
+                               real*                                  dvdlambda,
+                               bool                                   computeVirial,
+                               tensor                                 constraintsVirial,
+                               bool                                   computeEkinh,
+                               gmx_wallcycle_t                        wcycle);
+
     void update_sd_second_half(const t_inputrec& inputRecord,
                                int64_t           step,
                                real*             dvdlambda,
@@ -166,6 +185,8 @@ public:
 
     BoxDeformation* deform() const { return deform_; }
 
+    bool useFusedLeapfrogUpdate(const t_inputrec& inputRecord, const gmx_ekindata_t& ekind) const;
+
 private:
     //! stochastic dynamics struct
     gmx_stochd_t sd_;
@@ -173,6 +194,10 @@ private:
     PaddedVector<RVec> xp_;
     //! Box deformation handler (or nullptr if inactive).
     BoxDeformation* deform_ = nullptr;
+    //! Whether the SD and BD integrators can use SIMD
+    bool useSimd_;
+    //! Whether the fused leap-frog update is disabled by the user
+    bool disableFusedUpdate_;
 };
 
 Update::Update(const t_inputrec& inputRecord, BoxDeformation* boxDeformation) :
@@ -200,6 +225,12 @@ BoxDeformation* Update::deform() const
     return impl_->deform();
 }
 
+bool Update::useFusedLeapfrogUpdate(const t_inputrec&     inputRecord,
+                                    const gmx_ekindata_t& ekind) const
+{
+    return impl_->useFusedLeapfrogUpdate(inputRecord, ekind);
+}
+
 void Update::update_coords(const t_inputrec&                                inputRecord,
                            int64_t                                          step,
                            const t_mdatoms*                                 md,
@@ -225,6 +256,28 @@ void Update::finish_update(const t_inputrec& inputRecord,
     return impl_->finish_update(inputRecord, md, state, wcycle, haveConstraints);
 }
 
+void Update::update_leapfrog_fused(const t_inputrec&                      inputRecord,
+                                   int64_t                                step,
+                                   const t_mdatoms*                       md,
+                                   t_state*                               state,
+                                   const ArrayRefWithPadding<const RVec>& f,
+                                   const t_fcdata&                        fcdata,
+                                   gmx_ekindata_t*                        ekind,
+                                   const matrix                           M,
+                                   Constraints*                           constr,
+                                   bool                                   do_log,
+                                   bool                                   do_ene,
+                                   real*                                  dvdlambda,
+                                   bool                                   computeVirial,
+                                   tensor                                 constraintsVirial,
+                                   bool                                   computeEkinh,
+                                   gmx_wallcycle_t                        wcycle)
+{
+    return impl_->update_leapfrog_fused(inputRecord, step, md, state, f, fcdata, ekind, M, constr,
+                                        do_log, do_ene, dvdlambda, computeVirial,
+                                        constraintsVirial, computeEkinh, wcycle);
+}
+
 void Update::update_sd_second_half(const t_inputrec& inputRecord,
                                    int64_t           step,
                                    real*             dvdlambda,
@@ -1002,7 +1055,9 @@ void Update::Impl::update_temperature_constants(const t_inputrec& inputRecord)
 
 Update::Impl::Impl(const t_inputrec& inputRecord, BoxDeformation* boxDeformation) :
     sd_(inputRecord),
-    deform_(boxDeformation)
+    deform_(boxDeformation),
+    useSimd_(getenv("GMX_DISABLE_SIMD_KERNELS") == nullptr),
+    disableFusedUpdate_(getenv("GMX_DISABLE_FUSED_UPDATE") != nullptr)
 {
     update_temperature_constants(inputRecord);
     xp_.resizeWithPadding(0);
@@ -1022,6 +1077,326 @@ enum class SDUpdate : int
     Combined
 };
 
+#if GMX_HAVE_SIMD_UPDATE
+
+/*! \brief Returns whether the SIMD stochastic integrators can update a SIMD block of atoms
+ *
+ * \param[in] start   Index of first atom to update
+ * \param[in] nrend   Last atom to update: \p nrend - 1
+ * \param[in] x       Coordinates
+ * \param[in] xprime  Updated coordinates
+ * \param[in] v       Velocities
+ * \param[in] f       Forces, can be nullptr
+ */
+static bool haveSimdStochasticUpdate(int                      start,
+                                     int                      nrend,
+                                     const rvec*              x,
+                                     const rvec*              xprime,
+                                     const rvec*              v,
+                                     const rvec* gmx_restrict f)
+{
+    return (nrend - start >= GMX_SIMD_REAL_WIDTH && isSimdAligned(x[start])
+            && isSimdAligned(xprime[start]) && isSimdAligned(v[start])
+            && (f == nullptr || isSimdAligned(f[start])));
+}
+
+/*! \brief Sets the update mask and draws normal random numbers for GMX_SIMD_REAL_WIDTH atoms
+ *
+ * For the atoms \p a to \p a + GMX_SIMD_REAL_WIDTH - 1, stores for each
+ * element whether it is updated in \p updateMask and, when \p normal is not
+ * nullptr, a normal random number for each updated element in \p normal.
+ * Both use the interleaved layout of simdLoadRvecs().
+ *
+ * The numbers are the same as those drawn by the plain-C stochastic
+ * integrators: the k-th updated dimension of an atom gets the k-th value
+ * from a normal distribution that is reset for the stream with counter
+ * (step, global atom index). The first random value of these streams is
+ * generated for all atoms at once, after which the tabulated normal
+ * distribution is applied directly to its bits.
+ */
+static void simdStochasticUpdateMaskAndNormals(const gmx::ThreeFry2x64<0>& rng,
+                                               int64_t                     step,
+                                               int                         a,
+                                               const ivec                  nFreeze[],
+                                               const unsigned short        ptype[],
+                                               const unsigned short        cFREEZE[],
+                                               const int*                  gatindex,
+                                               real*                       updateMask,
+                                               real*                       normal)
+{
+    constexpr unsigned int tableBits = 14;
+    constexpr uint64_t     tableMask = (1ULL << tableBits) - 1;
+
+    const auto& normalTable = gmx::TabulatedNormalDistribution<real, tableBits>::table();
+
+    std::array<uint64_t, GMX_SIMD_REAL_WIDTH> counter;
+    std::array<uint64_t, GMX_SIMD_REAL_WIDTH> randomBits;
+    if (normal != nullptr)
+    {
+        for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            counter[s] = gatindex ? gatindex[a + s] : a + s;
+        }
+        rng.generateFirstValues<GMX_SIMD_REAL_WIDTH>(step, counter.data(), randomBits.data());
+    }
+
+    for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        const int  n           = a + s;
+        const int  freezeGroup = cFREEZE ? cFREEZE[n] : 0;
+        const bool isParticle  = (ptype[n] != eptVSite && ptype[n] != eptShell);
+
+        unsigned int numDrawn = 0;
+        for (int d = 0; d < DIM; d++)
+        {
+            const int  e        = s * DIM + d;
+            const bool doUpdate = (isParticle && !nFreeze[freezeGroup][d]);
+
+            updateMask[e] = doUpdate ? 1 : 0;
+            if (normal != nullptr)
+            {
+                normal[e] = 0;
+                if (doUpdate)
+                {
+                    normal[e] = normalTable[(randomBits[s] >> (numDrawn * tableBits)) & tableMask];
+                    numDrawn++;
+                }
+            }
+        }
+    }
+}
+
+/*! \brief SD integrator update using SIMD
+ *
+ * Updates as many atoms as possible, starting at \p start, in blocks of
+ * GMX_SIMD_REAL_WIDTH atoms. The arguments and results are as for
+ * doSDUpdateGeneral(), with the same random numbers.
+ *
+ * \returns The index of the first atom that was not updated.
+ */
+template<SDUpdate updateType>
+static int doSDUpdateSimd(const gmx_stochd_t&  sd,
+                          int                  start,
+                          int                  nrend,
+                          real                 dt,
+                          const rvec           accel[],
+                          const ivec           nFreeze[],
+                          const real           invmass[],
+                          const unsigned short ptype[],
+                          const unsigned short cFREEZE[],
+                          const unsigned short cACC[],
+                          const unsigned short cTC[],
+                          const rvec           x[],
+                          rvec                 xprime[],
+                          rvec                 v[],
+                          const rvec           f[],
+                          int64_t              step,
+                          int                  seed,
+                          const int*           gatindex)
+{
+    if (!haveSimdStochasticUpdate(start, nrend, x, xprime, v, f))
+    {
+        return start;
+    }
+
+    constexpr bool haveForces = (updateType != SDUpdate::FrictionAndNoiseOnly);
+    constexpr bool haveNoise  = (updateType != SDUpdate::ForcesOnly);
+
+    gmx::ThreeFry2x64<0> rng(seed, gmx::RandomDomain::UpdateCoordinates);
+
+    alignas(GMX_SIMD_ALIGNMENT) real updateMask[DIM * GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real invMass[DIM * GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real acceleration[DIM * GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real friction[DIM * GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real noiseScale[DIM * GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real normal[DIM * GMX_SIMD_REAL_WIDTH];
+
+    const SimdReal timestep(dt);
+    const SimdReal half(0.5);
+
+    int a = start;
+    for (; a + GMX_SIMD_REAL_WIDTH <= nrend; a += GMX_SIMD_REAL_WIDTH)
+    {
+        simdStochasticUpdateMaskAndNormals(rng, step, a, nFreeze, ptype, cFREEZE, gatindex,
+                                           updateMask, haveNoise ? normal : nullptr);
+
+        for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            const int n                 = a + s;
+            const int accelerationGroup = cACC ? cACC[n] : 0;
+            const int temperatureGroup  = cTC ? cTC[n] : 0;
+
+            for (int d = 0; d < DIM; d++)
+            {
+                const int e = s * DIM + d;
+                if (haveForces)
+                {
+                    invMass[e]      = invmass[n];
+                    acceleration[e] = accel[accelerationGroup][d];
+                }
+                if (haveNoise)
+                {
+                    friction[e]   = sd.sdc[temperatureGroup].em;
+                    noiseScale[e] = std::sqrt(invmass[n]) * sd.sdsig[temperatureGroup].V;
+                }
+            }
+        }
+
+        SimdReal xS[DIM], xprimeS[DIM], vS[DIM], fS[DIM];
+        simdLoadRvecs(v, a, &vS[XX], &vS[YY], &vS[ZZ]);
+        if (haveForces)
+        {
+            simdLoadRvecs(x, a, &xS[XX], &xS[YY], &xS[ZZ]);
+            simdLoadRvecs(f, a, &fS[XX], &fS[YY], &fS[ZZ]);
+        }
+        else
+        {
+            simdLoadRvecs(xprime, a, &xprimeS[XX], &xprimeS[YY], &xprimeS[ZZ]);
+        }
+
+        for (int i = 0; i < DIM; i++)
+        {
+            const int      offset   = i * GMX_SIMD_REAL_WIDTH;
+            const SimdBool doUpdate = (load<SimdReal>(updateMask + offset) != setZero());
+
+            SimdReal vn = vS[i];
+            if (haveForces)
+            {
+                vn = fma(fma(load<SimdReal>(invMass + offset), fS[i],
+                             load<SimdReal>(acceleration + offset)),
+                         timestep, vn);
+                // Non-updated elements get zero velocity in this phase
+                vn = selectByMask(vn, doUpdate);
+            }
+
+            if (updateType == SDUpdate::ForcesOnly)
+            {
+                vS[i]      = vn;
+                xprimeS[i] = fma(vn, timestep, xS[i]);
+            }
+            else
+            {
+                const SimdReal noise =
+                        load<SimdReal>(noiseScale + offset) * load<SimdReal>(normal + offset);
+                SimdReal vNew = fma(vn, load<SimdReal>(friction + offset), noise);
+                if (updateType == SDUpdate::FrictionAndNoiseOnly)
+                {
+                    // Non-updated elements are left unchanged in this phase
+                    vNew = blend(vn, vNew, doUpdate);
+                    // Half of the full v*dt term from the first phase is removed
+                    xprimeS[i] = fma(half * (vNew - vn), timestep, xprimeS[i]);
+                }
+                else
+                {
+                    xprimeS[i] = fma(half * (vn + vNew), timestep, xS[i]);
+                }
+                vS[i] = vNew;
+            }
+        }
+
+        simdStoreRvecs(v, a, vS[XX], vS[YY], vS[ZZ]);
+        simdStoreRvecs(xprime, a, xprimeS[XX], xprimeS[YY], xprimeS[ZZ]);
+    }
+
+    return a;
+}
+
+/*! \brief BD integrator update using SIMD
+ *
+ * Updates as many atoms as possible, starting at \p start, in blocks of
+ * GMX_SIMD_REAL_WIDTH atoms. The arguments and results are as for
+ * do_update_bd(), with the same random numbers.
+ *
+ * \returns The index of the first atom that was not updated.
+ */
+static int doBDUpdateSimd(int         start,
+                          int         nrend,
+                          real        dt,
+                          int64_t     step,
+                          const rvec* gmx_restrict x,
+                          rvec* gmx_restrict xprime,
+                          rvec* gmx_restrict v,
+                          const rvec* gmx_restrict f,
+                          const ivec               nFreeze[],
+                          const real               invmass[],
+                          const unsigned short     ptype[],
+                          const unsigned short     cFREEZE[],
+                          const unsigned short     cTC[],
+                          real                     friction_coefficient,
+                          const real*              rf,
+                          int                      seed,
+                          const int*               gatindex)
+{
+    if (!haveSimdStochasticUpdate(start, nrend, x, xprime, v, f))
+    {
+        return start;
+    }
+
+    gmx::ThreeFry2x64<0> rng(seed, gmx::RandomDomain::UpdateCoordinates);
+
+    alignas(GMX_SIMD_ALIGNMENT) real updateMask[DIM * GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real forceScale[DIM * GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real noiseScale[DIM * GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real normal[DIM * GMX_SIMD_REAL_WIDTH];
+
+    const real     invfr = (friction_coefficient != 0 ? 1.0 / friction_coefficient : 0);
+    const SimdReal timestep(dt);
+
+    int a = start;
+    for (; a + GMX_SIMD_REAL_WIDTH <= nrend; a += GMX_SIMD_REAL_WIDTH)
+    {
+        simdStochasticUpdateMaskAndNormals(rng, step, a, nFreeze, ptype, cFREEZE, gatindex,
+                                           updateMask, normal);
+
+        for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            const int n                = a + s;
+            const int temperatureGroup = cTC ? cTC[n] : 0;
+
+            real atomForceScale, atomNoiseScale;
+            if (friction_coefficient != 0)
+            {
+                atomForceScale = invfr;
+                atomNoiseScale = rf[temperatureGroup];
+            }
+            else
+            {
+                /* NOTE: invmass = 2/(mass*friction_constant*dt) */
+                atomForceScale = 0.5 * invmass[n] * dt;
+                atomNoiseScale = std::sqrt(0.5 * invmass[n]) * rf[temperatureGroup];
+            }
+            for (int d = 0; d < DIM; d++)
+            {
+                forceScale[s * DIM + d] = atomForceScale;
+                noiseScale[s * DIM + d] = atomNoiseScale;
+            }
+        }
+
+        SimdReal xS[DIM], xprimeS[DIM], vS[DIM], fS[DIM];
+        simdLoadRvecs(x, a, &xS[XX], &xS[YY], &xS[ZZ]);
+        simdLoadRvecs(f, a, &fS[XX], &fS[YY], &fS[ZZ]);
+
+        for (int i = 0; i < DIM; i++)
+        {
+            const int      offset   = i * GMX_SIMD_REAL_WIDTH;
+            const SimdBool doUpdate = (load<SimdReal>(updateMask + offset) != setZero());
+
+            const SimdReal noise =
+                    load<SimdReal>(noiseScale + offset) * load<SimdReal>(normal + offset);
+            const SimdReal vn = fma(load<SimdReal>(forceScale + offset), fS[i], noise);
+            vS[i]      = selectByMask(vn, doUpdate);
+            xprimeS[i] = fma(vS[i], timestep, xS[i]);
+        }
+
+        simdStoreRvecs(v, a, vS[XX], vS[YY], vS[ZZ]);
+        simdStoreRvecs(xprime, a, xprimeS[XX], xprimeS[YY], xprimeS[ZZ]);
+    }
+
+    return a;
+}
+
+#endif // GMX_HAVE_SIMD_UPDATE
+
 /*! \brief SD integrator update
  *
  * Two phases are required in the general case of a constrained
@@ -1034,7 +1409,10 @@ enum class SDUpdate : int
  * efficiency.
  *
  * Thus three instantiations of this templated function will be made,
- * two with only one contribution, and one with both contributions. */
+ * two with only one contribution, and one with both contributions.
+ *
+ * With \p useSimd, complete SIMD blocks of atoms are updated with
+ * doSDUpdateSimd(), which gives the same results within rounding. */
 template<SDUpdate updateType>
 static void doSDUpdateGeneral(const gmx_stochd_t&  sd,
                               int                  start,
@@ -1053,7 +1431,8 @@ static void doSDUpdateGeneral(const gmx_stochd_t&  sd,
                               const rvec           f[],
                               int64_t              step,
                               int                  seed,
-                              const int*           gatindex)
+                              const int*           gatindex,
+                              bool                 useSimd)
 {
     // cTC, cACC and cFREEZE can be nullptr any time, but various
     // instantiations do not make sense with particular pointer
@@ -1073,6 +1452,18 @@ static void doSDUpdateGeneral(const gmx_stochd_t&  sd,
         GMX_ASSERT(f != nullptr, "SD update with forces and noise requires forces");
     }
 
+#if GMX_HAVE_SIMD_UPDATE
+    if (useSimd)
+    {
+        // Update all complete SIMD blocks of atoms, the remainder below
+        start = doSDUpdateSimd<updateType>(sd, start, nrend, dt, accel, nFreeze, invmass, ptype,
+                                           cFREEZE, cACC, cTC, x, xprime, v, f, step, seed,
+                                           gatindex);
+    }
+#else
+    GMX_UNUSED_VALUE(useSimd);
+#endif
+
     // Even 0 bits internal counter gives 2x64 ints (more than enough for three table lookups)
     gmx::ThreeFry2x64<0>                       rng(seed, gmx::RandomDomain::UpdateCoordinates);
     gmx::TabulatedNormalDistribution<real, 14> dist;
@@ -1155,20 +1546,22 @@ static void do_update_sd(int         start,
                          int                      seed,
                          const t_commrec*         cr,
                          const gmx_stochd_t&      sd,
-                         bool                     haveConstraints)
+                         bool                     haveConstraints,
+                         bool                     useSimd)
 {
     if (haveConstraints)
     {
         // With constraints, the SD update is done in 2 parts
         doSDUpdateGeneral<SDUpdate::ForcesOnly>(sd, start, nrend, dt, accel, nFreeze, invmass,
                                                 ptype, cFREEZE, cACC, nullptr, x, xprime, v, f,
-                                                step, seed, nullptr);
+                                                step, seed, nullptr, useSimd);
     }
     else
     {
         doSDUpdateGeneral<SDUpdate::Combined>(
                 sd, start, nrend, dt, accel, nFreeze, invmass, ptype, cFREEZE, cACC, cTC, x, xprime,
-                v, f, step, seed, DOMAINDECOMP(cr) ? cr->dd->globalAtomIndices.data() : nullptr);
+                v, f, step, seed, DOMAINDECOMP(cr) ? cr->dd->globalAtomIndices.data() : nullptr,
+                useSimd);
     }
 }
 
@@ -1188,7 +1581,8 @@ static void do_update_bd(int         start,
                          real                     friction_coefficient,
                          const real*              rf,
                          int                      seed,
-                         const int*               gatindex)
+                         const int*               gatindex,
+                         bool                     useSimd)
 {
     /* note -- these appear to be full step velocities . . .  */
     int  gf = 0, gt = 0;
@@ -1205,6 +1599,17 @@ static void do_update_bd(int         start,
         invfr = 1.0 / friction_coefficient;
     }
 
+#if GMX_HAVE_SIMD_UPDATE
+    if (useSimd)
+    {
+        // Update all complete SIMD blocks of atoms, the remainder below
+        start = doBDUpdateSimd(start, nrend, dt, step, x, xprime, v, f, nFreeze, invmass, ptype,
+                               cFREEZE, cTC, friction_coefficient, rf, seed, gatindex);
+    }
+#else
+    GMX_UNUSED_VALUE(useSimd);
+#endif
+
     for (n = start; (n < nrend); n++)
     {
         int ng = gatindex ? gatindex[n] : n;
@@ -1346,6 +1751,13 @@ void getThreadAtomRange(int numThreads, int threadIndex, int numAtoms, int* star
     }
 }
 
+bool Update::Impl::useFusedLeapfrogUpdate(const t_inputrec&     inputRecord,
+                                          const gmx_ekindata_t& ekind) const
+{
+    return (inputRecord.eI == eiMD && ekind.cosacc.cos_accel == 0 && !ekind.bNEMD
+            && !disableFusedUpdate_);
+}
+
 void Update::Impl::update_sd_second_half(const t_inputrec& inputRecord,
                                          int64_t           step,
                                          real*             dvdlambda,
@@ -1391,7 +1803,7 @@ void Update::Impl::update_sd_second_half(const t_inputrec& inputRecord,
                         sd_, start_th, end_th, dt, inputRecord.opts.acc, inputRecord.opts.nFreeze,
                         md->invmass, md->ptype, md->cFREEZE, nullptr, md->cTC, state->x.rvec_array(),
                         xp_.rvec_array(), state->v.rvec_array(), nullptr, step, inputRecord.ld_seed,
-                        DOMAINDECOMP(cr) ? cr->dd->globalAtomIndices.data() : nullptr);
+                        DOMAINDECOMP(cr) ? cr->dd->globalAtomIndices.data() : nullptr, useSimd_);
             }
             GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
         }
@@ -1461,6 +1873,19 @@ void Update::Impl::finish_update(const t_inputrec& inputRecord,
     wallcycle_stop(wcycle, ewcUPDATE);
 }
 
+/*! \brief Updates the NMR restraint history when time averaging is used */
+static void updateRestraintHistory(const t_fcdata& fcdata, t_state* state)
+{
+    if (state->flags & (1 << estDISRE_RM3TAV))
+    {
+        update_disres_history(*fcdata.disres, &state->hist);
+    }
+    if (state->flags & (1 << estORIRE_DTAV))
+    {
+        update_orires_history(*fcdata.orires, &state->hist);
+    }
+}
+
 void Update::Impl::update_coords(const t_inputrec&                                inputRecord,
                                  int64_t                                          step,
                                  const t_mdatoms*                                 md,
@@ -1484,15 +1909,7 @@ void Update::Impl::update_coords(const t_inputrec&
     /* Cast to real for faster code, no loss in precision (see comment above) */
     real dt = inputRecord.delta_t;
 
-    /* We need to update the NMR restraint history when time averaging is used */
-    if (state->flags & (1 << estDISRE_RM3TAV))
-    {
-        update_disres_history(*fcdata.disres, &state->hist);
-    }
-    if (state->flags & (1 << estORIRE_DTAV))
-    {
-        update_orires_history(*fcdata.orires, &state->hist);
-    }
+    updateRestraintHistory(fcdata, state);
 
     /* ############# START The update of velocities and positions ######### */
     int nth = gmx_omp_nthreads_get(emntUpdate);
@@ -1522,13 +1939,14 @@ void Update::Impl::update_coords(const t_inputrec&
                     do_update_sd(start_th, end_th, dt, step, x_rvec, xp_rvec, v_rvec, f_rvec,
                                  inputRecord.opts.acc, inputRecord.opts.nFreeze, md->invmass,
                                  md->ptype, md->cFREEZE, md->cACC, md->cTC, inputRecord.ld_seed, cr,
-                                 sd_, haveConstraints);
+                                 sd_, haveConstraints, useSimd_);
                     break;
                 case (eiBD):
                     do_update_bd(start_th, end_th, dt, step, x_rvec, xp_rvec, v_rvec, f_rvec,
                                  inputRecord.opts.nFreeze, md->invmass, md->ptype, md->cFREEZE,
                                  md->cTC, inputRecord.bd_fric, sd_.bd_rf.data(), inputRecord.ld_seed,
-                                 DOMAINDECOMP(cr) ? cr->dd->globalAtomIndices.data() : nullptr);
+                                 DOMAINDECOMP(cr) ? cr->dd->globalAtomIndices.data() : nullptr,
+                                 useSimd_);
                     break;
                 case (eiVV):
                 case (eiVVAK):
@@ -1561,6 +1979,109 @@ void Update::Impl::update_coords(const t_inputrec&
     }
 }
 
+void Update::Impl::update_leapfrog_fused(const t_inputrec&                      inputRecord,
+                                         int64_t                                step,
+                                         const t_mdatoms*                       md,
+                                         t_state*                               state,
+                                         const ArrayRefWithPadding<const RVec>& f,
+                                         const t_fcdata&                        fcdata,
+                                         gmx_ekindata_t*                        ekind,
+                                         const matrix                           M,
+                                         Constraints*                           constr,
+                                         bool                                   do_log,
+                                         bool                                   do_ene,
+                                         real*                                  dvdlambda,
+                                         bool                                   computeVirial,
+                                         tensor                                 constraintsVirial,
+                                         bool                                   computeEkinh,
+                                         gmx_wallcycle_t                        wcycle)
+{
+    GMX_ASSERT(inputRecord.eI == eiMD, "Only leap-frog is supported here");
+
+    updateRestraintHistory(fcdata, state);
+
+    const int homenr = md->homenr;
+
+    /* Cast to real for faster code, no loss in precision */
+    const real dt = inputRecord.delta_t;
+
+    const int nth = gmx_omp_nthreads_get(emntUpdate);
+
+    const rvec* f_rvec = as_rvec_array(f.unpaddedConstArrayRef().data());
+
+    const auto updateThreadWork = [&](int th) {
+        int start_th, end_th;
+        getThreadAtomRange(nth, th, homenr, &start_th, &end_th);
+
+        do_update_md(start_th, end_th, dt, step, state->x.rvec_array(), xp_.rvec_array(),
+                     state->v.rvec_array(), f_rvec, inputRecord.opts.acc, inputRecord.etc,
+                     inputRecord.epc, inputRecord.nsttcouple, inputRecord.nstpcouple, md, ekind,
+                     state->box, state->nosehoover_vxi.data(), M);
+    };
+
+    /* See finish_update() for the treatment of partially frozen atoms */
+    const bool  copyOnlyUnfrozen = (md->havePartiallyFrozenAtoms && constr != nullptr);
+    const ivec* nFreeze          = inputRecord.opts.nFreeze;
+
+    const auto finishThreadWork = [&](int th) {
+        int start_th, end_th;
+        getThreadAtomRange(nth, th, homenr, &start_th, &end_th);
+
+        rvec*       x  = state->x.rvec_array();
+        const rvec* xp = xp_.rvec_array();
+        for (int i = start_th; i < end_th; i++)
+        {
+            if (copyOnlyUnfrozen)
+            {
+                const int g = md->cFREEZE[i];
+
+                for (int d = 0; d < DIM; d++)
+                {
+                    if (nFreeze[g][d] == 0)
+                    {
+                        x[i][d] = xp[i][d];
+                    }
+                }
+            }
+            else
+            {
+                copy_rvec(xp[i], x[i]);
+            }
+        }
+
+        if (computeEkinh)
+        {
+            accumulate_ekin_work(start_th, end_th, state->v.rvec_array(), md, ekind, th);
+        }
+    };
+
+    if (constr != nullptr)
+    {
+        constr->applyWithUpdate(do_log, do_ene, step, state->x.arrayRefWithPadding(),
+                                xp_.arrayRefWithPadding(), state->box,
+                                state->lambda[efptBONDED], dvdlambda,
+                                state->v.arrayRefWithPadding(), computeVirial, constraintsVirial,
+                                updateThreadWork, finishThreadWork);
+    }
+    else
+    {
+        wallcycle_start_nocount(wcycle, ewcUPDATE);
+
+#pragma omp parallel for num_threads(nth) schedule(static)
+        for (int th = 0; th < nth; th++)
+        {
+            try
+            {
+                updateThreadWork(th);
+                finishThreadWork(th);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
+
+        wallcycle_stop(wcycle, ewcUPDATE);
+    }
+}
+
 void Update::Impl::update_for_constraint_virial(const t_inputrec& inputRecord,
                                                 const t_mdatoms&  md,
                                                 const t_state&    state,
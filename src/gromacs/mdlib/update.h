@@ -142,6 +142,62 @@ public:
                        gmx_wallcycle_t   wcycle,
                        bool              haveConstraints);
 
+    /*! \brief Performs a leap-frog step with the update, constraining and finishing fused.
+     *
+     * Does the same as update_coords(...) for the positions, followed by
+     * constraining the coordinates and finish_update(...), but processes
+     * the system per thread in as few passes as possible, see
+     * Constraints::applyWithUpdate(). When \p computeEkinh is
+     * true, also accumulates the half-step kinetic energy of the updated
+     * velocities into the thread work buffers of \p ekind. These should
+     * then be summed by passing CGLO_EKINWORK to compute_globals().
+     * Only the leap-frog MD integrator is supported.
+     *
+     * \param[in]  inputRecord      Input record.
+     * \param[in]  step             Current timestep.
+     * \param[in]  md               MD atoms data.
+     * \param[in]  state            System state object.
+     * \param[in]  f                Buffer with atomic forces for home particles.
+     * \param[in]  fcdata           Data to update distance and orientation restraints.
+     * \param[in]  ekind            Kinetic energy data.
+     * \param[in]  M                Parrinello-Rahman velocity scaling matrix.
+     * \param[in]  constr           Constraints object, can be nullptr.
+     * \param[in]  do_log           If this is logging step.
+     * \param[in]  do_ene           If this is an energy evaluation step.
+     * \param[in]  dvdlambda        Free energy derivative, the constraint contribution is added.
+     * \param[in]  computeVirial    Whether to compute the constraint virial.
+     * \param[out] constraintsVirial  The constraint virial, when computed.
+     * \param[in]  computeEkinh     Whether to accumulate the half-step kinetic energy.
+     * \param[in]  wcycle           Wall-clock cycle counter.
+     */
+    void update_leapfrog_fused(const t_inputrec&                      inputRecord,
+                               int64_t                                step,
+                               const t_mdatoms*                       md,
+                               t_state*                               state,
+                               const ArrayRefWithPadding<const RVec>& f,
+                               const t_fcdata&                        fcdata,
+                               gmx_ekindata_t*                        ekind,
+                               const matrix                           M,
+                               Constraints*                           constr,
+                               bool                                   do_log,
+                               bool                                   do_ene,
+                               real*                                  dvdlambda,
+                               bool                                   computeVirial,
+                               tensor                                 constraintsVirial,
+                               bool                                   computeEkinh,
+                               gmx_wallcycle_t                        wcycle);
+
+    /*! \brief Returns whether update_leapfrog_fused() can be used for this simulation
+     *
+     * This is the case for the leap-frog MD integrator without cosine
+     * acceleration and acceleration groups, unless the environment variable
+     * GMX_DISABLE_FUSED_UPDATE was set when this object was constructed.
+     *
+     * \param[in]  inputRecord  Input record.
+     * \param[in]  ekind        Kinetic energy data.
+     */
+    bool useFusedLeapfrogUpdate(const t_inputrec& inputRecord, const gmx_ekindata_t& ekind) const;
+
     /*! \brief Secong part of the SD integrator.
      *
      * The first part of integration is performed in the update_coords(...) method.
@@ -48,7 +48,11 @@
 
 #include <cstdio>
 
+#include <cstdint>
+#include <cstdlib>
+
 #include <algorithm>
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -56,6 +60,7 @@
 #include "gromacs/domdec/domdec_struct.h"
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/arrayrefwithpadding.h"
 #include "gromacs/math/functions.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/mdlib/gmx_omp_nthreads.h"
@@ -63,6 +68,9 @@
 #include "gromacs/mdtypes/mdatom.h"
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
 #include "gromacs/timing/wallcycle.h"
 #include "gromacs/topology/ifunc.h"
 #include "gromacs/topology/mtop_util.h"
@@ -226,6 +234,9 @@ private:
     std::vector<int> taskIndex_;
 };
 
+//! Flags per vsite type, indexed by ftype - c_ftypeVsiteStart, whether the SIMD kernels can be used
+using VsiteSimdTypes = std::array<bool, c_ftypeVsiteEnd - c_ftypeVsiteStart>;
+
 /*! \brief Impl class for VirtualSitesHandler
  */
 class VirtualSitesHandler::Impl
@@ -258,9 +269,11 @@ public:
      * This non-linear correction is required when the virial is not calculated
      * afterwards from the particle position and forces, but in a different way,
      * as for instance for the PME mesh contribution.
+     * The SIMD kernels are only used when \p forceIsPadded is true.
      */
     void spreadForces(ArrayRef<const RVec> x,
                       ArrayRef<RVec>       f,
+                      bool                 forceIsPadded,
                       VirialHandling       virialHandling,
                       ArrayRef<RVec>       fshift,
                       matrix               virial,
@@ -279,6 +292,8 @@ private:
     ArrayRef<const InteractionList> ilists_;
     //! Information for handling vsite threading
     ThreadingInfo threadingInfo_;
+    //! The vsite types for which the SIMD kernels are used
+    const VsiteSimdTypes simdTypes_;
 };
 
 VirtualSitesHandler::~VirtualSitesHandler() = default;
@@ -320,7 +335,7 @@ static int pbc_rvec_sub(const t_pbc* pbc, const rvec xi, const rvec xj, rvec dx)
 //! Returns the 1/norm(x)
 static inline real inverseNorm(const rvec x)
 {
-    return gmx::invsqrt(iprod(x, x));
+    return gmx::invsqrt(::iprod(x, x));
 }
 
 #ifndef DOXYGEN
@@ -436,7 +451,7 @@ static void constr_vsite3FAD(const rvec xi, const rvec xj, const rvec xk, rvec x
     /* 6 flops */
 
     invdij = inverseNorm(xij);
-    c1     = invdij * invdij * iprod(xij, xjk);
+    c1     = invdij * invdij * ::iprod(xij, xjk);
     xp[XX] = xjk[XX] - c1 * xij[XX];
     xp[YY] = xjk[YY] - c1 * xij[YY];
     xp[ZZ] = xjk[ZZ] - c1 * xij[ZZ];
@@ -459,7 +474,7 @@ constr_vsite3OUT(const rvec xi, const rvec xj, const rvec xk, rvec x, real a, re
 
     pbc_rvec_sub(pbc, xj, xi, xij);
     pbc_rvec_sub(pbc, xk, xi, xik);
-    cprod(xij, xik, temp);
+    ::cprod(xij, xik, temp);
     /* 15 Flops */
 
     x[XX] = xi[XX] + a * xij[XX] + b * xik[XX] + c * temp[XX];
@@ -537,7 +552,7 @@ static void constr_vsite4FDN(const rvec   xi,
     rvec_sub(rb, xij, rjb);
     /* 6 flops */
 
-    cprod(rja, rjb, rm);
+    ::cprod(rja, rjb, rm);
     /* 9 flops */
 
     d = c * inverseNorm(rm);
@@ -613,6 +628,728 @@ static PbcMode getPbcMode(const t_pbc* pbcPtr)
     }
 }
 
+#if GMX_SIMD_HAVE_REAL
+
+/* SIMD vsite construction and force spreading routines
+ *
+ * These process GMX_SIMD_REAL_WIDTH vsites of the same type at once.
+ * They are only used without PBC, i.e. when all vsites are constructed
+ * within update groups, and for vsite types for which no vsite is
+ * constructed from another vsite of the same type, since the vsites
+ * within a batch are processed simultaneously.
+ */
+
+//! Returns the number of atoms, including the vsite itself, for fixed-size vsite types
+static constexpr int numVsiteAtoms(int ftype)
+{
+    return (ftype == F_VSITE2 || ftype == F_VSITE2FD)
+                   ? 3
+                   : ((ftype == F_VSITE4FD || ftype == F_VSITE4FDN) ? 5 : 4);
+}
+
+//! Returns whether the vsite position is a linear combination of the constructing atom positions
+static constexpr bool vsiteTypeIsLinear(int ftype)
+{
+    return ftype == F_VSITE2 || ftype == F_VSITE3;
+}
+
+/*! \brief Atom indices and parameters for a batch of GMX_SIMD_REAL_WIDTH vsites of one type
+ *
+ * When the list ends within a batch, the remaining lanes repeat the last vsite
+ * and have filter value zero.
+ */
+template<int numAtoms>
+struct VsiteSimdBatch
+{
+    //! The vsite index followed by the constructing atom indices, per lane
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t atoms[numAtoms][GMX_SIMD_REAL_WIDTH];
+    //! The a, b and c vsite parameters, per lane
+    alignas(GMX_SIMD_ALIGNMENT) real params[3][GMX_SIMD_REAL_WIDTH];
+    //! 1 for lanes with a vsite, 0 for padding lanes
+    alignas(GMX_SIMD_ALIGNMENT) real filter[GMX_SIMD_REAL_WIDTH];
+};
+
+//! Fills \p batch with the vsites starting at \p batchStart in \p iatoms
+template<int numAtoms>
+static void fillVsiteSimdBatch(const t_iatom*            iatoms,
+                               const int                 batchStart,
+                               const int                 numVsites,
+                               ArrayRef<const t_iparams> ip,
+                               VsiteSimdBatch<numAtoms>* batch)
+{
+    for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        const t_iatom* ia = iatoms + std::min(batchStart + s, numVsites - 1) * (1 + numAtoms);
+        for (int a = 0; a < numAtoms; a++)
+        {
+            batch->atoms[a][s] = ia[1 + a];
+        }
+        batch->params[0][s] = ip[ia[0]].vsite.a;
+        batch->params[1][s] = ip[ia[0]].vsite.b;
+        batch->params[2][s] = ip[ia[0]].vsite.c;
+        batch->filter[s]    = (batchStart + s < numVsites ? 1.0_real : 0.0_real);
+    }
+}
+
+//! Returns \p x minus \p y in \p d
+static inline void gmx_simdcall simdSub(const SimdReal x[DIM],
+                                        const SimdReal y[DIM],
+                                        SimdReal       d[DIM])
+{
+    for (int m = 0; m < DIM; m++)
+    {
+        d[m] = x[m] - y[m];
+    }
+}
+
+/*! \brief Computes the vsite positions \p xv of a batch of vsites of type \p ftype
+ *
+ * \param[in]  xc  The positions of the constructing atoms
+ * \param[in]  p   The a, b and c vsite parameters
+ * \param[out] xv  The vsite positions
+ */
+template<int ftype>
+static inline void gmx_simdcall constructVsiteBatch(const SimdReal xc[][DIM],
+                                                    const SimdReal p[3],
+                                                    SimdReal       xv[DIM]);
+
+template<>
+inline void gmx_simdcall constructVsiteBatch<F_VSITE2>(const SimdReal xc[][DIM],
+                                                       const SimdReal p[3],
+                                                       SimdReal       xv[DIM])
+{
+    const SimdReal b = SimdReal(1.0_real) - p[0];
+    for (int m = 0; m < DIM; m++)
+    {
+        xv[m] = fma(p[0], xc[1][m], b * xc[0][m]);
+    }
+}
+
+template<>
+inline void gmx_simdcall constructVsiteBatch<F_VSITE2FD>(const SimdReal xc[][DIM],
+                                                         const SimdReal p[3],
+                                                         SimdReal       xv[DIM])
+{
+    SimdReal xij[DIM];
+    simdSub(xc[1], xc[0], xij);
+
+    const SimdReal b = p[0] * invsqrt(norm2(xij[XX], xij[YY], xij[ZZ]));
+    for (int m = 0; m < DIM; m++)
+    {
+        xv[m] = fma(b, xij[m], xc[0][m]);
+    }
+}
+
+template<>
+inline void gmx_simdcall constructVsiteBatch<F_VSITE3>(const SimdReal xc[][DIM],
+                                                       const SimdReal p[3],
+                                                       SimdReal       xv[DIM])
+{
+    const SimdReal c = SimdReal(1.0_real) - p[0] - p[1];
+    for (int m = 0; m < DIM; m++)
+    {
+        xv[m] = fma(p[1], xc[2][m], fma(p[0], xc[1][m], c * xc[0][m]));
+    }
+}
+
+template<>
+inline void gmx_simdcall constructVsiteBatch<F_VSITE3FD>(const SimdReal xc[][DIM],
+                                                         const SimdReal p[3],
+                                                         SimdReal       xv[DIM])
+{
+    SimdReal xij[DIM], xjk[DIM], temp[DIM];
+    simdSub(xc[1], xc[0], xij);
+    simdSub(xc[2], xc[1], xjk);
+    for (int m = 0; m < DIM; m++)
+    {
+        temp[m] = fma(p[0], xjk[m], xij[m]);
+    }
+
+    const SimdReal c = p[1] * invsqrt(norm2(temp[XX], temp[YY], temp[ZZ]));
+    for (int m = 0; m < DIM; m++)
+    {
+        xv[m] = fma(c, temp[m], xc[0][m]);
+    }
+}
+
+template<>
+inline void gmx_simdcall constructVsiteBatch<F_VSITE3FAD>(const SimdReal xc[][DIM],
+                                                          const SimdReal p[3],
+                                                          SimdReal       xv[DIM])
+{
+    SimdReal xij[DIM], xjk[DIM], xp[DIM];
+    simdSub(xc[1], xc[0], xij);
+    simdSub(xc[2], xc[1], xjk);
+
+    const SimdReal invdij = invsqrt(norm2(xij[XX], xij[YY], xij[ZZ]));
+    const SimdReal c1 =
+            invdij * invdij * iprod(xij[XX], xij[YY], xij[ZZ], xjk[XX], xjk[YY], xjk[ZZ]);
+    for (int m = 0; m < DIM; m++)
+    {
+        xp[m] = fnma(c1, xij[m], xjk[m]);
+    }
+    const SimdReal a1 = p[0] * invdij;
+    const SimdReal b1 = p[1] * invsqrt(norm2(xp[XX], xp[YY], xp[ZZ]));
+    for (int m = 0; m < DIM; m++)
+    {
+        xv[m] = fma(b1, xp[m], fma(a1, xij[m], xc[0][m]));
+    }
+}
+
+template<>
+inline void gmx_simdcall constructVsiteBatch<F_VSITE3OUT>(const SimdReal xc[][DIM],
+                                                          const SimdReal p[3],
+                                                          SimdReal       xv[DIM])
+{
+    SimdReal xij[DIM], xik[DIM], temp[DIM];
+    simdSub(xc[1], xc[0], xij);
+    simdSub(xc[2], xc[0], xik);
+    cprod(xij[XX], xij[YY], xij[ZZ], xik[XX], xik[YY], xik[ZZ], &temp[XX], &temp[YY], &temp[ZZ]);
+    for (int m = 0; m < DIM; m++)
+    {
+        xv[m] = fma(p[2], temp[m], fma(p[1], xik[m], fma(p[0], xij[m], xc[0][m])));
+    }
+}
+
+template<>
+inline void gmx_simdcall constructVsiteBatch<F_VSITE4FD>(const SimdReal xc[][DIM],
+                                                         const SimdReal p[3],
+                                                         SimdReal       xv[DIM])
+{
+    SimdReal xij[DIM], xjk[DIM], xjl[DIM], temp[DIM];
+    simdSub(xc[1], xc[0], xij);
+    simdSub(xc[2], xc[1], xjk);
+    simdSub(xc[3], xc[1], xjl);
+    for (int m = 0; m < DIM; m++)
+    {
+        temp[m] = fma(p[1], xjl[m], fma(p[0], xjk[m], xij[m]));
+    }
+
+    const SimdReal d = p[2] * invsqrt(norm2(temp[XX], temp[YY], temp[ZZ]));
+    for (int m = 0; m < DIM; m++)
+    {
+        xv[m] = fma(d, temp[m], xc[0][m]);
+    }
+}
+
+template<>
+inline void gmx_simdcall constructVsiteBatch<F_VSITE4FDN>(const SimdReal xc[][DIM],
+                                                          const SimdReal p[3],
+                                                          SimdReal       xv[DIM])
+{
+    SimdReal xij[DIM], xik[DIM], xil[DIM], rja[DIM], rjb[DIM], rm[DIM];
+    simdSub(xc[1], xc[0], xij);
+    simdSub(xc[2], xc[0], xik);
+    simdSub(xc[3], xc[0], xil);
+    for (int m = 0; m < DIM; m++)
+    {
+        rja[m] = fms(p[0], xik[m], xij[m]);
+        rjb[m] = fms(p[1], xil[m], xij[m]);
+    }
+    cprod(rja[XX], rja[YY], rja[ZZ], rjb[XX], rjb[YY], rjb[ZZ], &rm[XX], &rm[YY], &rm[ZZ]);
+
+    const SimdReal d = p[2] * invsqrt(norm2(rm[XX], rm[YY], rm[ZZ]));
+    for (int m = 0; m < DIM; m++)
+    {
+        xv[m] = fma(d, rm[m], xc[0][m]);
+    }
+}
+
+//! Constructs the vsites of type \p ftype in \p ilist using SIMD, sets v when not empty
+template<int ftype>
+static void constructVsitesSimd(ArrayRef<RVec>            x,
+                                ArrayRef<RVec>            v,
+                                const real                inv_dt,
+                                ArrayRef<const t_iparams> ip,
+                                const InteractionList&    ilist)
+{
+    constexpr int numAtoms = numVsiteAtoms(ftype);
+    GMX_ASSERT(numAtoms == NRAL(ftype), "numVsiteAtoms should match the interaction definition");
+
+    const int numVsites = ilist.size() / (1 + numAtoms);
+    real*     xPtr      = as_rvec_array(x.data())[0];
+    real*     vPtr      = v.empty() ? nullptr : as_rvec_array(v.data())[0];
+
+    VsiteSimdBatch<numAtoms> batch;
+
+    for (int batchStart = 0; batchStart < numVsites; batchStart += GMX_SIMD_REAL_WIDTH)
+    {
+        fillVsiteSimdBatch(ilist.iatoms.data(), batchStart, numVsites, ip, &batch);
+
+        SimdReal xc[numAtoms - 1][DIM];
+        for (int a = 0; a < numAtoms - 1; a++)
+        {
+            gatherLoadUTranspose<3>(xPtr, batch.atoms[1 + a], &xc[a][XX], &xc[a][YY], &xc[a][ZZ]);
+        }
+        const SimdReal p[3] = { load<SimdReal>(batch.params[0]), load<SimdReal>(batch.params[1]),
+                                load<SimdReal>(batch.params[2]) };
+
+        SimdReal xv[DIM];
+        constructVsiteBatch<ftype>(xc, p, xv);
+
+        if (vPtr)
+        {
+            /* Calculate velocity of vsite from the displacement */
+            SimdReal xvOld[DIM], vv[DIM];
+            gatherLoadUTranspose<3>(xPtr, batch.atoms[0], &xvOld[XX], &xvOld[YY], &xvOld[ZZ]);
+            for (int m = 0; m < DIM; m++)
+            {
+                vv[m] = (xv[m] - xvOld[m]) * SimdReal(inv_dt);
+            }
+            transposeScatterStoreU<3>(vPtr, batch.atoms[0], vv[XX], vv[YY], vv[ZZ]);
+        }
+        transposeScatterStoreU<3>(xPtr, batch.atoms[0], xv[XX], xv[YY], xv[ZZ]);
+    }
+}
+
+/*! \brief Computes the forces \p fc on the constructing atoms of a batch of vsites of type \p ftype
+ *
+ * \param[in]  xc  The positions of the constructing atoms, not set for linear vsite types
+ * \param[in]  p   The a, b and c vsite parameters
+ * \param[in]  fv  The forces on the vsites
+ * \param[out] fc  The forces to add to the constructing atoms
+ */
+template<int ftype>
+static inline void gmx_simdcall spreadVsiteBatch(const SimdReal xc[][DIM],
+                                                 const SimdReal p[3],
+                                                 const SimdReal fv[DIM],
+                                                 SimdReal       fc[][DIM]);
+
+template<>
+inline void gmx_simdcall spreadVsiteBatch<F_VSITE2>(const SimdReal gmx_unused xc[][DIM],
+                                                    const SimdReal            p[3],
+                                                    const SimdReal            fv[DIM],
+                                                    SimdReal                  fc[][DIM])
+{
+    for (int m = 0; m < DIM; m++)
+    {
+        fc[1][m] = p[0] * fv[m];
+        fc[0][m] = fv[m] - fc[1][m];
+    }
+}
+
+template<>
+inline void gmx_simdcall spreadVsiteBatch<F_VSITE2FD>(const SimdReal xc[][DIM],
+                                                      const SimdReal p[3],
+                                                      const SimdReal fv[DIM],
+                                                      SimdReal       fc[][DIM])
+{
+    SimdReal xij[DIM];
+    simdSub(xc[1], xc[0], xij);
+
+    const SimdReal invDistance = invsqrt(norm2(xij[XX], xij[YY], xij[ZZ]));
+    const SimdReal b           = p[0] * invDistance;
+    const SimdReal fproj =
+            iprod(xij[XX], xij[YY], xij[ZZ], fv[XX], fv[YY], fv[ZZ]) * invDistance * invDistance;
+    for (int m = 0; m < DIM; m++)
+    {
+        fc[1][m] = b * fnma(fproj, xij[m], fv[m]);
+        fc[0][m] = fv[m] - fc[1][m];
+    }
+}
+
+template<>
+inline void gmx_simdcall spreadVsiteBatch<F_VSITE3>(const SimdReal gmx_unused xc[][DIM],
+                                                    const SimdReal            p[3],
+                                                    const SimdReal            fv[DIM],
+                                                    SimdReal                  fc[][DIM])
+{
+    for (int m = 0; m < DIM; m++)
+    {
+        fc[1][m] = p[0] * fv[m];
+        fc[2][m] = p[1] * fv[m];
+        fc[0][m] = fv[m] - fc[1][m] - fc[2][m];
+    }
+}
+
+template<>
+inline void gmx_simdcall spreadVsiteBatch<F_VSITE3FD>(const SimdReal xc[][DIM],
+                                                      const SimdReal p[3],
+                                                      const SimdReal fv[DIM],
+                                                      SimdReal       fc[][DIM])
+{
+    SimdReal xij[DIM], xjk[DIM], xix[DIM];
+    simdSub(xc[1], xc[0], xij);
+    simdSub(xc[2], xc[1], xjk);
+    /* xix goes from i to point x on the line jk */
+    for (int m = 0; m < DIM; m++)
+    {
+        xix[m] = fma(p[0], xjk[m], xij[m]);
+    }
+
+    const SimdReal invDistance = invsqrt(norm2(xix[XX], xix[YY], xix[ZZ]));
+    const SimdReal c           = p[1] * invDistance;
+    const SimdReal fproj =
+            iprod(xix[XX], xix[YY], xix[ZZ], fv[XX], fv[YY], fv[ZZ]) * invDistance * invDistance;
+    for (int m = 0; m < DIM; m++)
+    {
+        const SimdReal temp = c * fnma(fproj, xix[m], fv[m]);
+
+        fc[0][m] = fv[m] - temp;
+        fc[2][m] = p[0] * temp;
+        fc[1][m] = temp - fc[2][m];
+    }
+}
+
+template<>
+inline void gmx_simdcall spreadVsiteBatch<F_VSITE3FAD>(const SimdReal xc[][DIM],
+                                                       const SimdReal p[3],
+                                                       const SimdReal fv[DIM],
+                                                       SimdReal       fc[][DIM])
+{
+    SimdReal xij[DIM], xjk[DIM], xperp[DIM];
+    simdSub(xc[1], xc[0], xij);
+    simdSub(xc[2], xc[1], xjk);
+
+    const SimdReal invdij  = invsqrt(norm2(xij[XX], xij[YY], xij[ZZ]));
+    const SimdReal invdij2 = invdij * invdij;
+    const SimdReal c1 = iprod(xij[XX], xij[YY], xij[ZZ], xjk[XX], xjk[YY], xjk[ZZ]) * invdij2;
+    /* xperp in plane ijk, perp. to ij */
+    for (int m = 0; m < DIM; m++)
+    {
+        xperp[m] = fnma(c1, xij[m], xjk[m]);
+    }
+    const SimdReal invdp = invsqrt(norm2(xperp[XX], xperp[YY], xperp[ZZ]));
+    const SimdReal a1    = p[0] * invdij;
+    const SimdReal b1    = p[1] * invdp;
+
+    const SimdReal fproj = iprod(xij[XX], xij[YY], xij[ZZ], fv[XX], fv[YY], fv[ZZ]) * invdij2;
+    const SimdReal fprojPerp =
+            iprod(xperp[XX], xperp[YY], xperp[ZZ], fv[XX], fv[YY], fv[ZZ]) * invdp * invdp;
+    const SimdReal c2 = SimdReal(1.0_real) + c1;
+    for (int m = 0; m < DIM; m++)
+    {
+        const SimdReal f1 = fnma(fproj, xij[m], fv[m]);
+        const SimdReal f2 = b1 * fnma(fprojPerp, xperp[m], f1);
+        const SimdReal f3 = b1 * fproj * xperp[m];
+
+        fc[0][m] = fv[m] - a1 * f1 + fma(c1, f2, f3);
+        fc[1][m] = a1 * f1 - fma(c2, f2, f3);
+        fc[2][m] = f2;
+    }
+}
+
+template<>
+inline void gmx_simdcall spreadVsiteBatch<F_VSITE3OUT>(const SimdReal xc[][DIM],
+                                                       const SimdReal p[3],
+                                                       const SimdReal fv[DIM],
+                                                       SimdReal       fc[][DIM])
+{
+    SimdReal xij[DIM], xik[DIM], cf[DIM], xijcf[DIM], xikcf[DIM];
+    simdSub(xc[1], xc[0], xij);
+    simdSub(xc[2], xc[0], xik);
+    for (int m = 0; m < DIM; m++)
+    {
+        cf[m] = p[2] * fv[m];
+    }
+    cprod(xij[XX], xij[YY], xij[ZZ], cf[XX], cf[YY], cf[ZZ], &xijcf[XX], &xijcf[YY], &xijcf[ZZ]);
+    cprod(xik[XX], xik[YY], xik[ZZ], cf[XX], cf[YY], cf[ZZ], &xikcf[XX], &xikcf[YY], &xikcf[ZZ]);
+    for (int m = 0; m < DIM; m++)
+    {
+        fc[1][m] = fma(p[0], fv[m], xikcf[m]);
+        fc[2][m] = fms(p[1], fv[m], xijcf[m]);
+        fc[0][m] = fv[m] - fc[1][m] - fc[2][m];
+    }
+}
+
+template<>
+inline void gmx_simdcall spreadVsiteBatch<F_VSITE4FD>(const SimdReal xc[][DIM],
+                                                      const SimdReal p[3],
+                                                      const SimdReal fv[DIM],
+                                                      SimdReal       fc[][DIM])
+{
+    SimdReal xij[DIM], xjk[DIM], xjl[DIM], xix[DIM];
+    simdSub(xc[1], xc[0], xij);
+    simdSub(xc[2], xc[1], xjk);
+    simdSub(xc[3], xc[1], xjl);
+    /* xix goes from i to point x on the plane jkl */
+    for (int m = 0; m < DIM; m++)
+    {
+        xix[m] = fma(p[1], xjl[m], fma(p[0], xjk[m], xij[m]));
+    }
+
+    const SimdReal invDistance = invsqrt(norm2(xix[XX], xix[YY], xix[ZZ]));
+    const SimdReal d           = p[2] * invDistance;
+    const SimdReal fproj =
+            iprod(xix[XX], xix[YY], xix[ZZ], fv[XX], fv[YY], fv[ZZ]) * invDistance * invDistance;
+    for (int m = 0; m < DIM; m++)
+    {
+        const SimdReal temp = d * fnma(fproj, xix[m], fv[m]);
+
+        fc[0][m] = fv[m] - temp;
+        fc[2][m] = p[0] * temp;
+        fc[3][m] = p[1] * temp;
+        fc[1][m] = temp - fc[2][m] - fc[3][m];
+    }
+}
+
+template<>
+inline void gmx_simdcall spreadVsiteBatch<F_VSITE4FDN>(const SimdReal xc[][DIM],
+                                                       const SimdReal p[3],
+                                                       const SimdReal fv[DIM],
+                                                       SimdReal       fc[][DIM])
+{
+    SimdReal xij[DIM], xik[DIM], xil[DIM], rja[DIM], rjb[DIM], rab[DIM], rm[DIM];
+    simdSub(xc[1], xc[0], xij);
+    simdSub(xc[2], xc[0], xik);
+    simdSub(xc[3], xc[0], xil);
+    for (int m = 0; m < DIM; m++)
+    {
+        rja[m] = fms(p[0], xik[m], xij[m]);
+        rjb[m] = fms(p[1], xil[m], xij[m]);
+        rab[m] = rjb[m] - rja[m];
+    }
+    cprod(rja[XX], rja[YY], rja[ZZ], rjb[XX], rjb[YY], rjb[ZZ], &rm[XX], &rm[YY], &rm[ZZ]);
+
+    const SimdReal invrm = invsqrt(norm2(rm[XX], rm[YY], rm[ZZ]));
+    const SimdReal denom = invrm * invrm;
+
+    SimdReal cf[DIM];
+    for (int m = 0; m < DIM; m++)
+    {
+        cf[m] = p[2] * invrm * fv[m];
+    }
+    const SimdReal rmcf = iprod(rm[XX], rm[YY], rm[ZZ], cf[XX], cf[YY], cf[ZZ]);
+
+    /* With rt the derivative of the unit vector along rm, each force is
+     * -rt (rm . cf) plus a cross product with cf.
+     */
+    SimdReal rt[DIM], cross[DIM];
+
+    cprod(rm[XX], rm[YY], rm[ZZ], rab[XX], rab[YY], rab[ZZ], &rt[XX], &rt[YY], &rt[ZZ]);
+    cprod(cf[XX], cf[YY], cf[ZZ], rab[XX], rab[YY], rab[ZZ], &cross[XX], &cross[YY], &cross[ZZ]);
+    for (int m = 0; m < DIM; m++)
+    {
+        fc[1][m] = fnma(rt[m] * denom, rmcf, cross[m]);
+    }
+
+    cprod(rjb[XX], rjb[YY], rjb[ZZ], rm[XX], rm[YY], rm[ZZ], &rt[XX], &rt[YY], &rt[ZZ]);
+    cprod(rjb[XX], rjb[YY], rjb[ZZ], cf[XX], cf[YY], cf[ZZ], &cross[XX], &cross[YY], &cross[ZZ]);
+    for (int m = 0; m < DIM; m++)
+    {
+        fc[2][m] = p[0] * fnma(rt[m] * denom, rmcf, cross[m]);
+    }
+
+    cprod(rm[XX], rm[YY], rm[ZZ], rja[XX], rja[YY], rja[ZZ], &rt[XX], &rt[YY], &rt[ZZ]);
+    cprod(cf[XX], cf[YY], cf[ZZ], rja[XX], rja[YY], rja[ZZ], &cross[XX], &cross[YY], &cross[ZZ]);
+    for (int m = 0; m < DIM; m++)
+    {
+        fc[3][m] = p[1] * fnma(rt[m] * denom, rmcf, cross[m]);
+    }
+
+    for (int m = 0; m < DIM; m++)
+    {
+        fc[0][m] = fv[m] - fc[1][m] - fc[2][m] - fc[3][m];
+    }
+}
+
+/*! \brief Spreads the forces of all vsites of type \p ftype in \p ilist using SIMD
+ *
+ * Without PBC there are no shift force contributions. With NonLinear virial
+ * handling, the contribution of non-linear constructions is added to \p dxdf
+ * using the first constructing atom as reference position, as for the plain C
+ * routines.
+ */
+template<int ftype, VirialHandling virialHandling>
+static void spreadVsitesSimd(ArrayRef<const RVec>      x,
+                             ArrayRef<RVec>            f,
+                             matrix                    dxdf,
+                             ArrayRef<const t_iparams> ip,
+                             const InteractionList&    ilist)
+{
+    constexpr int  numAtoms    = numVsiteAtoms(ftype);
+    constexpr bool needX       = !vsiteTypeIsLinear(ftype);
+    constexpr bool computeDxdf = (needX && virialHandling == VirialHandling::NonLinear);
+    GMX_ASSERT(numAtoms == NRAL(ftype), "numVsiteAtoms should match the interaction definition");
+
+    const int   numVsites = ilist.size() / (1 + numAtoms);
+    const real* xPtr      = as_rvec_array(x.data())[0];
+    real*       fPtr      = as_rvec_array(f.data())[0];
+
+    const SimdReal zero = setZero();
+    SimdReal       dxdfSum[DIM][DIM];
+    for (int i = 0; i < DIM; i++)
+    {
+        for (int j = 0; j < DIM; j++)
+        {
+            dxdfSum[i][j] = zero;
+        }
+    }
+
+    VsiteSimdBatch<numAtoms> batch;
+
+    for (int batchStart = 0; batchStart < numVsites; batchStart += GMX_SIMD_REAL_WIDTH)
+    {
+        fillVsiteSimdBatch(ilist.iatoms.data(), batchStart, numVsites, ip, &batch);
+
+        /* Padding lanes repeat the last vsite, so we zero their force */
+        const SimdReal filter = load<SimdReal>(batch.filter);
+        SimdReal       fv[DIM];
+        gatherLoadUTranspose<3>(fPtr, batch.atoms[0], &fv[XX], &fv[YY], &fv[ZZ]);
+        for (int m = 0; m < DIM; m++)
+        {
+            fv[m] = fv[m] * filter;
+        }
+
+        SimdReal xc[numAtoms - 1][DIM];
+        if (needX)
+        {
+            for (int a = 0; a < numAtoms - 1; a++)
+            {
+                gatherLoadUTranspose<3>(
+                        xPtr, batch.atoms[1 + a], &xc[a][XX], &xc[a][YY], &xc[a][ZZ]);
+            }
+        }
+        const SimdReal p[3] = { load<SimdReal>(batch.params[0]), load<SimdReal>(batch.params[1]),
+                                load<SimdReal>(batch.params[2]) };
+
+        SimdReal fc[numAtoms - 1][DIM];
+        spreadVsiteBatch<ftype>(xc, p, fv, fc);
+
+        for (int a = 0; a < numAtoms - 1; a++)
+        {
+            transposeScatterIncrU<3>(fPtr, batch.atoms[1 + a], fc[a][XX], fc[a][YY], fc[a][ZZ]);
+        }
+        transposeScatterStoreU<3>(fPtr, batch.atoms[0], zero, zero, zero);
+
+        if (computeDxdf)
+        {
+            /* Subtract (xv-xi)*fv and add (xj-xi)*fj + (xk-xi)*fk + ... */
+            SimdReal xv[DIM], dx[DIM];
+            gatherLoadUTranspose<3>(xPtr, batch.atoms[0], &xv[XX], &xv[YY], &xv[ZZ]);
+            simdSub(xv, xc[0], dx);
+            for (int i = 0; i < DIM; i++)
+            {
+                for (int j = 0; j < DIM; j++)
+                {
+                    dxdfSum[i][j] = fnma(dx[i], fv[j], dxdfSum[i][j]);
+                }
+            }
+            for (int a = 1; a < numAtoms - 1; a++)
+            {
+                simdSub(xc[a], xc[0], dx);
+                for (int i = 0; i < DIM; i++)
+                {
+                    for (int j = 0; j < DIM; j++)
+                    {
+                        dxdfSum[i][j] = fma(dx[i], fc[a][j], dxdfSum[i][j]);
+                    }
+                }
+            }
+        }
+    }
+
+    if (computeDxdf)
+    {
+        for (int i = 0; i < DIM; i++)
+        {
+            for (int j = 0; j < DIM; j++)
+            {
+                dxdf[i][j] += reduce(dxdfSum[i][j]);
+            }
+        }
+    }
+}
+
+//! Constructs the vsites of type \p ftype in \p ilist using the SIMD kernels
+static void constructVsitesOfTypeSimd(const int                 ftype,
+                                      ArrayRef<RVec>            x,
+                                      ArrayRef<RVec>            v,
+                                      const real                inv_dt,
+                                      ArrayRef<const t_iparams> ip,
+                                      const InteractionList&    ilist)
+{
+    switch (ftype)
+    {
+        case F_VSITE2: constructVsitesSimd<F_VSITE2>(x, v, inv_dt, ip, ilist); break;
+        case F_VSITE2FD: constructVsitesSimd<F_VSITE2FD>(x, v, inv_dt, ip, ilist); break;
+        case F_VSITE3: constructVsitesSimd<F_VSITE3>(x, v, inv_dt, ip, ilist); break;
+        case F_VSITE3FD: constructVsitesSimd<F_VSITE3FD>(x, v, inv_dt, ip, ilist); break;
+        case F_VSITE3FAD: constructVsitesSimd<F_VSITE3FAD>(x, v, inv_dt, ip, ilist); break;
+        case F_VSITE3OUT: constructVsitesSimd<F_VSITE3OUT>(x, v, inv_dt, ip, ilist); break;
+        case F_VSITE4FD: constructVsitesSimd<F_VSITE4FD>(x, v, inv_dt, ip, ilist); break;
+        case F_VSITE4FDN: constructVsitesSimd<F_VSITE4FDN>(x, v, inv_dt, ip, ilist); break;
+        default: gmx_incons("No SIMD kernel for this vsite type");
+    }
+}
+
+//! Spreads the forces of the vsites of type \p ftype in \p ilist using the SIMD kernels
+template<VirialHandling virialHandling>
+static void spreadVsitesOfTypeSimd(const int                 ftype,
+                                   ArrayRef<const RVec>      x,
+                                   ArrayRef<RVec>            f,
+                                   matrix                    dxdf,
+                                   ArrayRef<const t_iparams> ip,
+                                   const InteractionList&    ilist)
+{
+    switch (ftype)
+    {
+        case F_VSITE2: spreadVsitesSimd<F_VSITE2, virialHandling>(x, f, dxdf, ip, ilist); break;
+        case F_VSITE2FD: spreadVsitesSimd<F_VSITE2FD, virialHandling>(x, f, dxdf, ip, ilist); break;
+        case F_VSITE3: spreadVsitesSimd<F_VSITE3, virialHandling>(x, f, dxdf, ip, ilist); break;
+        case F_VSITE3FD: spreadVsitesSimd<F_VSITE3FD, virialHandling>(x, f, dxdf, ip, ilist); break;
+        case F_VSITE3FAD:
+            spreadVsitesSimd<F_VSITE3FAD, virialHandling>(x, f, dxdf, ip, ilist);
+            break;
+        case F_VSITE3OUT:
+            spreadVsitesSimd<F_VSITE3OUT, virialHandling>(x, f, dxdf, ip, ilist);
+            break;
+        case F_VSITE4FD: spreadVsitesSimd<F_VSITE4FD, virialHandling>(x, f, dxdf, ip, ilist); break;
+        case F_VSITE4FDN:
+            spreadVsitesSimd<F_VSITE4FDN, virialHandling>(x, f, dxdf, ip, ilist);
+            break;
+        default: gmx_incons("No SIMD kernel for this vsite type");
+    }
+}
+
+#endif // GMX_SIMD_HAVE_REAL
+
+/*! \brief Returns for each vsite type whether the SIMD kernels can be used for \p mtop
+ *
+ * This is the case when the type has a SIMD kernel and no vsite is
+ * constructed from another vsite of the same type.
+ */
+static VsiteSimdTypes getVsiteSimdTypes(const gmx_mtop_t& mtop)
+{
+    VsiteSimdTypes useSimd = {};
+
+#if GMX_SIMD_HAVE_REAL
+    if (getenv("GMX_DISABLE_SIMD_KERNELS") != nullptr)
+    {
+        return useSimd;
+    }
+
+    for (int ftype : { F_VSITE2, F_VSITE2FD, F_VSITE3, F_VSITE3FD, F_VSITE3FAD, F_VSITE3OUT,
+                       F_VSITE4FD, F_VSITE4FDN })
+    {
+        const int nral = NRAL(ftype);
+
+        bool builtFromSameType = false;
+        for (const gmx_moltype_t& molt : mtop.moltype)
+        {
+            ArrayRef<const int> iatoms = molt.ilist[ftype].iatoms;
+            std::vector<bool>   isVsite(molt.atoms.nr, false);
+            for (int i = 0; i < iatoms.ssize(); i += 1 + nral)
+            {
+                isVsite[iatoms[i + 1]] = true;
+            }
+            for (int i = 0; i < iatoms.ssize(); i += 1 + nral)
+            {
+                for (int a = 2; a < 1 + nral; a++)
+                {
+                    builtFromSameType = builtFromSameType || isVsite[iatoms[i + a]];
+                }
+            }
+        }
+        useSimd[ftype - c_ftypeVsiteStart] = !builtFromSameType;
+    }
+#else
+    GMX_UNUSED_VALUE(mtop);
+#endif
+
+    return useSimd;
+}
+
 /*! \brief Executes the vsite construction task for a single thread
  *
  * \param[in,out] x   Coordinates to construct vsites for
@@ -621,13 +1358,15 @@ static PbcMode getPbcMode(const t_pbc* pbcPtr)
  * \param[in]     ip  Interaction parameters for all interaction, only vsite parameters are used
  * \param[in]     ilist  The interaction lists, only vsites are usesd
  * \param[in]     pbc_null  PBC struct, used for PBC distance calculations when !=nullptr
+ * \param[in]     simdTypes  The vsite types to use SIMD kernels for when pbc_null=nullptr
  */
 static void construct_vsites_thread(ArrayRef<RVec>                  x,
                                     const real                      dt,
                                     ArrayRef<RVec>                  v,
                                     ArrayRef<const t_iparams>       ip,
                                     ArrayRef<const InteractionList> ilist,
-                                    const t_pbc*                    pbc_null)
+                                    const t_pbc*                    pbc_null,
+                                    const VsiteSimdTypes&           simdTypes)
 {
     real inv_dt;
     if (!v.empty())
@@ -650,6 +1389,16 @@ static void construct_vsites_thread(ArrayRef<RVec>                  x,
             continue;
         }
 
+#if GMX_SIMD_HAVE_REAL
+        if (pbcMode == PbcMode::none && simdTypes[ftype - c_ftypeVsiteStart])
+        {
+            constructVsitesOfTypeSimd(ftype, x, v, inv_dt, ip, ilist[ftype]);
+            continue;
+        }
+#else
+        GMX_UNUSED_VALUE(simdTypes);
+#endif
+
         { // TODO remove me
             int nra = interaction_function[ftype].nratoms;
             int inc = 1 + nra;
@@ -765,6 +1514,7 @@ static void construct_vsites_thread(ArrayRef<RVec>                  x,
  * \param[in]     ilist  The interaction lists, only vsites are usesd
  * \param[in]     domainInfo  Information about PBC and DD
  * \param[in]     box  Used for PBC when PBC is set in domainInfo
+ * \param[in]     simdTypes  The vsite types to use SIMD kernels for, requires padded \p x and \p v
  */
 static void construct_vsites(const ThreadingInfo*            threadingInfo,
                              ArrayRef<RVec>                  x,
@@ -773,7 +1523,8 @@ static void construct_vsites(const ThreadingInfo*            threadingInfo,
                              ArrayRef<const t_iparams>       ip,
                              ArrayRef<const InteractionList> ilist,
                              const DomainInfo&               domainInfo,
-                             const matrix                    box)
+                             const matrix                    box,
+                             const VsiteSimdTypes&           simdTypes)
 {
     const bool useDomdec = domainInfo.useDomdec();
 
@@ -806,7 +1557,7 @@ static void construct_vsites(const ThreadingInfo*            threadingInfo,
 
     if (threadingInfo == nullptr || threadingInfo->numThreads() == 1)
     {
-        construct_vsites_thread(x, dt, v, ip, ilist, pbc_null);
+        construct_vsites_thread(x, dt, v, ip, ilist, pbc_null, simdTypes);
     }
     else
     {
@@ -819,26 +1570,27 @@ static void construct_vsites(const ThreadingInfo*            threadingInfo,
                 GMX_ASSERT(tData.rangeStart >= 0,
                            "The thread data should be initialized before calling construct_vsites");
 
-                construct_vsites_thread(x, dt, v, ip, tData.ilist, pbc_null);
+                construct_vsites_thread(x, dt, v, ip, tData.ilist, pbc_null, simdTypes);
                 if (tData.useInterdependentTask)
                 {
                     /* Here we don't need a barrier (unlike the spreading),
                      * since both tasks only construct vsites from particles,
                      * or local vsites, not from non-local vsites.
                      */
-                    construct_vsites_thread(x, dt, v, ip, tData.idTask.ilist, pbc_null);
+                    construct_vsites_thread(x, dt, v, ip, tData.idTask.ilist, pbc_null, simdTypes);
                 }
             }
             GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
         }
         /* Now we can construct the vsites that might depend on other vsites */
-        construct_vsites_thread(x, dt, v, ip, threadingInfo->threadDataNonLocalDependent().ilist, pbc_null);
+        construct_vsites_thread(x, dt, v, ip, threadingInfo->threadDataNonLocalDependent().ilist,
+                                pbc_null, simdTypes);
     }
 }
 
 void VirtualSitesHandler::Impl::construct(ArrayRef<RVec> x, real dt, ArrayRef<RVec> v, const matrix box) const
 {
-    construct_vsites(&threadingInfo_, x, dt, v, iparams_, ilists_, domainInfo_, box);
+    construct_vsites(&threadingInfo_, x, dt, v, iparams_, ilists_, domainInfo_, box, simdTypes_);
 }
 
 void VirtualSitesHandler::construct(ArrayRef<RVec> x, real dt, ArrayRef<RVec> v, const matrix box) const
@@ -851,7 +1603,8 @@ void constructVirtualSites(ArrayRef<RVec> x, ArrayRef<const t_iparams> ip, Array
 {
     // No PBC, no DD
     const DomainInfo domainInfo;
-    construct_vsites(nullptr, x, 0, {}, ip, ilist, domainInfo, nullptr);
+    // No SIMD, as x might not be padded
+    construct_vsites(nullptr, x, 0, {}, ip, ilist, domainInfo, nullptr, VsiteSimdTypes{});
 }
 
 #ifndef DOXYGEN
@@ -960,7 +1713,7 @@ static void spread_vsite2FD(const t_iatom        ia[],
     const real b           = a * invDistance;
     /* 4 + ?10? flops */
 
-    const real fproj = iprod(xij, fv) * invDistance * invDistance;
+    const real fproj = ::iprod(xij, fv) * invDistance * invDistance;
 
     rvec fj;
     fj[XX] = b * (fv[XX] - fproj * xij[XX]);
@@ -1123,7 +1876,7 @@ static void spread_vsite3FD(const t_iatom        ia[],
     const real c           = b * invDistance;
     /* 4 + ?10? flops */
 
-    fproj = iprod(xix, fv) * invDistance * invDistance; /* = (xix . f)/(xix . xix) */
+    fproj = ::iprod(xix, fv) * invDistance * invDistance; /* = (xix . f)/(xix . xix) */
 
     temp[XX] = c * (fv[XX] - fproj * xix[XX]);
     temp[YY] = c * (fv[YY] - fproj * xix[YY]);
@@ -1226,7 +1979,7 @@ static void spread_vsite3FAD(const t_iatom        ia[],
 
     invdij    = inverseNorm(xij);
     invdij2   = invdij * invdij;
-    c1        = iprod(xij, xjk) * invdij2;
+    c1        = ::iprod(xij, xjk) * invdij2;
     xperp[XX] = xjk[XX] - c1 * xij[XX];
     xperp[YY] = xjk[YY] - c1 * xij[YY];
     xperp[ZZ] = xjk[ZZ] - c1 * xij[ZZ];
@@ -1239,9 +1992,9 @@ static void spread_vsite3FAD(const t_iatom        ia[],
     /* a1, b1 and c1 are already calculated in constr_vsite3FAD
        storing them somewhere will save 45 flops!     */
 
-    fproj = iprod(xij, fv) * invdij2;
+    fproj = ::iprod(xij, fv) * invdij2;
     svmul(fproj, xij, Fpij);                              /* proj. f on xij */
-    svmul(iprod(xperp, fv) * invdp * invdp, xperp, Fppp); /* proj. f on xperp */
+    svmul(::iprod(xperp, fv) * invdp * invdp, xperp, Fppp); /* proj. f on xperp */
     svmul(b1 * fproj, xperp, f3);
     /* 23 flops */
 
@@ -1442,7 +2195,7 @@ static void spread_vsite4FD(const t_iatom        ia[],
 
     copy_rvec(f[av], fv);
 
-    fproj = iprod(xix, fv) * invDistance * invDistance; /* = (xix . f)/(xix . xix) */
+    fproj = ::iprod(xix, fv) * invDistance * invDistance; /* = (xix . f)/(xix . xix) */
 
     for (m = 0; m < DIM; m++)
     {
@@ -1554,7 +2307,7 @@ static void spread_vsite4FDN(const t_iatom        ia[],
     rvec_sub(rb, ra, rab);
     /* 9 flops */
 
-    cprod(rja, rjb, rm);
+    ::cprod(rja, rjb, rm);
     /* 9 flops */
 
     invrm = inverseNorm(rm);
@@ -1566,7 +2319,7 @@ static void spread_vsite4FDN(const t_iatom        ia[],
     cfz = c * invrm * fv[ZZ];
     /* 6 Flops */
 
-    cprod(rm, rab, rt);
+    ::cprod(rm, rab, rt);
     /* 9 flops */
 
     rt[XX] *= denom;
@@ -1582,7 +2335,7 @@ static void spread_vsite4FDN(const t_iatom        ia[],
              + (-rm[ZZ] * rt[ZZ]) * cfz;
     /* 30 flops */
 
-    cprod(rjb, rm, rt);
+    ::cprod(rjb, rm, rt);
     /* 9 flops */
 
     rt[XX] *= denom * a;
@@ -1598,7 +2351,7 @@ static void spread_vsite4FDN(const t_iatom        ia[],
              + (-rm[ZZ] * rt[ZZ]) * cfz;
     /* 36 flops */
 
-    cprod(rm, rja, rt);
+    ::cprod(rm, rja, rt);
     /* 9 flops */
 
     rt[XX] *= denom * b;
@@ -1731,7 +2484,8 @@ static void spreadForceForThread(ArrayRef<const RVec>            x,
                                  matrix                          dxdf,
                                  ArrayRef<const t_iparams>       ip,
                                  ArrayRef<const InteractionList> ilist,
-                                 const t_pbc*                    pbc_null)
+                                 const t_pbc*                    pbc_null,
+                                 const VsiteSimdTypes&           simdTypes)
 {
     const PbcMode pbcMode = getPbcMode(pbc_null);
     /* We need another pbc pointer, as with charge groups we switch per vsite */
@@ -1747,6 +2501,16 @@ static void spreadForceForThread(ArrayRef<const RVec>            x,
             continue;
         }
 
+#if GMX_SIMD_HAVE_REAL
+        if (pbcMode == PbcMode::none && simdTypes[ftype - c_ftypeVsiteStart])
+        {
+            spreadVsitesOfTypeSimd<virialHandling>(ftype, x, f, dxdf, ip, ilist[ftype]);
+            continue;
+        }
+#else
+        GMX_UNUSED_VALUE(simdTypes);
+#endif
+
         { // TODO remove me
             int nra = interaction_function[ftype].nratoms;
             int inc = 1 + nra;
@@ -1828,7 +2592,8 @@ static void spreadForceWrapper(ArrayRef<const RVec>            x,
                                const bool                      clearDxdf,
                                ArrayRef<const t_iparams>       ip,
                                ArrayRef<const InteractionList> ilist,
-                               const t_pbc*                    pbc_null)
+                               const t_pbc*                    pbc_null,
+                               const VsiteSimdTypes&           simdTypes)
 {
     if (virialHandling == VirialHandling::NonLinear && clearDxdf)
     {
@@ -1838,13 +2603,16 @@ static void spreadForceWrapper(ArrayRef<const RVec>            x,
     switch (virialHandling)
     {
         case VirialHandling::None:
-            spreadForceForThread<VirialHandling::None>(x, f, fshift, dxdf, ip, ilist, pbc_null);
+            spreadForceForThread<VirialHandling::None>(x, f, fshift, dxdf, ip, ilist, pbc_null,
+                                                       simdTypes);
             break;
         case VirialHandling::Pbc:
-            spreadForceForThread<VirialHandling::Pbc>(x, f, fshift, dxdf, ip, ilist, pbc_null);
+            spreadForceForThread<VirialHandling::Pbc>(x, f, fshift, dxdf, ip, ilist, pbc_null,
+                                                      simdTypes);
             break;
         case VirialHandling::NonLinear:
-            spreadForceForThread<VirialHandling::NonLinear>(x, f, fshift, dxdf, ip, ilist, pbc_null);
+            spreadForceForThread<VirialHandling::NonLinear>(x, f, fshift, dxdf, ip, ilist, pbc_null,
+                                                            simdTypes);
             break;
     }
 }
@@ -1867,6 +2635,7 @@ static void clearTaskForceBufferUsedElements(InterdependentTask* idTask)
 
 void VirtualSitesHandler::Impl::spreadForces(ArrayRef<const RVec> x,
                                              ArrayRef<RVec>       f,
+                                             const bool           forceIsPadded,
                                              const VirialHandling virialHandling,
                                              ArrayRef<RVec>       fshift,
                                              matrix               virial,
@@ -1898,12 +2667,16 @@ void VirtualSitesHandler::Impl::spreadForces(ArrayRef<const RVec> x,
         dd_clear_f_vsites(*domainInfo_.domdec_, f);
     }
 
+    /* The SIMD kernels access whole SIMD registers per atom, which needs padding */
+    const VsiteSimdTypes simdTypes = (forceIsPadded ? simdTypes_ : VsiteSimdTypes{});
+
     const int numThreads = threadingInfo_.numThreads();
 
     if (numThreads == 1)
     {
         matrix dxdf;
-        spreadForceWrapper(x, f, virialHandling, fshift, dxdf, true, iparams_, ilists_, pbc_null);
+        spreadForceWrapper(x, f, virialHandling, fshift, dxdf, true, iparams_, ilists_, pbc_null,
+                           simdTypes);
 
         if (virialHandling == VirialHandling::NonLinear)
         {
@@ -1921,7 +2694,7 @@ void VirtualSitesHandler::Impl::spreadForces(ArrayRef<const RVec> x,
         /* First spread the vsites that might depend on non-local vsites */
         auto& nlDependentVSites = threadingInfo_.threadDataNonLocalDependent();
         spreadForceWrapper(x, f, virialHandling, fshift, nlDependentVSites.dxdf, true, iparams_,
-                           nlDependentVSites.ilist, pbc_null);
+                           nlDependentVSites.ilist, pbc_null, simdTypes);
 
 #pragma omp parallel num_threads(numThreads)
         {
@@ -1966,8 +2739,9 @@ void VirtualSitesHandler::Impl::spreadForces(ArrayRef<const RVec> x,
                     {
                         copy_rvec(f[idTask->vsite[i]], idTask->force[idTask->vsite[i]]);
                     }
+                    // No SIMD, as the task force buffer is not padded
                     spreadForceWrapper(x, idTask->force, virialHandling, fshift_t, tData.dxdf, true,
-                                       iparams_, tData.idTask.ilist, pbc_null);
+                                       iparams_, tData.idTask.ilist, pbc_null, VsiteSimdTypes{});
 
                     /* We need a barrier before reducing forces below
                      * that have been produced by a different thread above.
@@ -2004,7 +2778,7 @@ void VirtualSitesHandler::Impl::spreadForces(ArrayRef<const RVec> x,
 
                 /* Spread the vsites that spread locally only */
                 spreadForceWrapper(x, f, virialHandling, fshift_t, tData.dxdf, false, iparams_,
-                                   tData.ilist, pbc_null);
+                                   tData.ilist, pbc_null, simdTypes);
             }
             GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
         }
@@ -2094,6 +2868,22 @@ int countNonlinearVsites(const gmx_mtop_t& mtop)
     return numNonlinearVsites;
 }
 
+void VirtualSitesHandler::spreadForces(ArrayRef<const RVec>      x,
+                                       ArrayRefWithPadding<RVec> f,
+                                       const VirialHandling      virialHandling,
+                                       ArrayRef<RVec>            fshift,
+                                       matrix                    virial,
+                                       t_nrnb*                   nrnb,
+                                       const matrix              box,
+                                       gmx_wallcycle*            wcycle)
+{
+    ArrayRef<RVec> force = f.unpaddedArrayRef();
+    GMX_ASSERT(force.empty() || f.paddedArrayRef().ssize() > force.ssize(),
+               "The SIMD vsite kernels need at least one element of padding");
+
+    impl_->spreadForces(x, force, true, virialHandling, fshift, virial, nrnb, box, wcycle);
+}
+
 void VirtualSitesHandler::spreadForces(ArrayRef<const RVec> x,
                                        ArrayRef<RVec>       f,
                                        const VirialHandling virialHandling,
@@ -2103,7 +2893,7 @@ void VirtualSitesHandler::spreadForces(ArrayRef<const RVec> x,
                                        const matrix         box,
                                        gmx_wallcycle*       wcycle)
 {
-    impl_->spreadForces(x, f, virialHandling, fshift, virial, nrnb, box, wcycle);
+    impl_->spreadForces(x, f, false, virialHandling, fshift, virial, nrnb, box, wcycle);
 }
 
 int countInterUpdategroupVsites(const gmx_mtop_t&                           mtop,
@@ -2224,7 +3014,8 @@ static int getNumInterUpdategroupVsites(const gmx_mtop_t& mtop, const gmx_domdec
 VirtualSitesHandler::Impl::Impl(const gmx_mtop_t& mtop, gmx_domdec_t* domdec, const PbcType pbcType) :
     numInterUpdategroupVirtualSites_(getNumInterUpdategroupVsites(mtop, domdec)),
     domainInfo_({ pbcType, pbcType != PbcType::No && numInterUpdategroupVirtualSites_ > 0, domdec }),
-    iparams_(mtop.ffparams.iparams)
+    iparams_(mtop.ffparams.iparams),
+    simdTypes_(getVsiteSimdTypes(mtop))
 {
 }
 
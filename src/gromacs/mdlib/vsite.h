@@ -66,6 +66,8 @@ enum class PbcType : int;
 
 namespace gmx
 {
+template<typename>
+class ArrayRefWithPadding;
 class RangePartitioning;
 
 /*! \brief The start value of the vsite indices in the ftype enum
@@ -124,7 +126,20 @@ public:
      * This non-linear correction is required when the virial is not calculated
      * afterwards from the particle position and forces, but in a different way,
      * as for instance for the PME mesh contribution.
+     *
+     * The SIMD kernels load and store whole SIMD registers per atom and are
+     * therefore only used with this overload, which takes a padded force buffer.
      */
+    void spreadForces(ArrayRef<const RVec>      x,
+                      ArrayRefWithPadding<RVec> f,
+                      VirialHandling            virialHandling,
+                      ArrayRef<RVec>            fshift,
+                      matrix                    virial,
+                      t_nrnb*                   nrnb,
+                      const matrix              box,
+                      gmx_wallcycle*            wcycle);
+
+    //! As spreadForces() above, for a force buffer without padding, does not use SIMD
     void spreadForces(ArrayRef<const RVec> x,
                       ArrayRef<RVec>       f,
                       VirialHandling       virialHandling,
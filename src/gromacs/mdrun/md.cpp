@@ -1103,6 +1103,16 @@ void gmx::LegacySimulator::do_md()
         const bool doParrinelloRahman = (ir->epc == epcPARRINELLORAHMAN
                                          && do_per_step(step + ir->nstpcouple - 1, ir->nstpcouple));
 
+        // Organize to do inter-simulation signalling on steps if
+        // and when algorithms require it.
+        const bool doInterSimSignal = (simulationsShareState && do_per_step(step, nstSignalComm));
+
+        // With leap-frog on the CPU, the update, constraints and the half-step
+        // kinetic energy can be computed in a single pass per thread over the atoms.
+        const bool useFusedUpdate = (!useGpuForUpdate && upd.useFusedLeapfrogUpdate(*ir, *ekind));
+        const bool accumulateKineticEnergyInUpdate =
+                (useFusedUpdate && (bGStat || needHalfStepKineticEnergy || doInterSimSignal));
+
         if (EI_VV(ir->eI))
         {
             GMX_ASSERT(!useGpuForUpdate, "GPU update is not supported with VVAK integrator.");
@@ -1183,18 +1193,30 @@ void gmx::LegacySimulator::do_md()
                         (fr->useMts && step % ir->mtsLevels[1].stepFactor == 0)
                                 ? f.view().forceMtsCombinedWithPadding()
                                 : f.view().forceWithPadding();
-                upd.update_coords(*ir, step, mdatoms, state, forceCombined, fcdata, ekind, M,
-                                  etrtPOSITION, cr, constr != nullptr);
+                if (useFusedUpdate)
+                {
+                    wallcycle_stop(wcycle, ewcUPDATE);
 
-                wallcycle_stop(wcycle, ewcUPDATE);
+                    upd.update_leapfrog_fused(*ir, step, mdatoms, state, forceCombined, fcdata,
+                                              ekind, M, constr, do_log, do_ene, &dvdl_constr,
+                                              bCalcVir && !fr->useMts, shake_vir,
+                                              accumulateKineticEnergyInUpdate, wcycle);
+                }
+                else
+                {
+                    upd.update_coords(*ir, step, mdatoms, state, forceCombined, fcdata, ekind, M,
+                                      etrtPOSITION, cr, constr != nullptr);
+
+                    wallcycle_stop(wcycle, ewcUPDATE);
 
-                constrain_coordinates(constr, do_log, do_ene, step, state,
-                                      upd.xp()->arrayRefWithPadding(), &dvdl_constr,
-                                      bCalcVir && !fr->useMts, shake_vir);
+                    constrain_coordinates(constr, do_log, do_ene, step, state,
+                                          upd.xp()->arrayRefWithPadding(), &dvdl_constr,
+                                          bCalcVir && !fr->useMts, shake_vir);
 
-                upd.update_sd_second_half(*ir, step, &dvdl_constr, mdatoms, state, cr, nrnb, wcycle,
-                                          constr, do_log, do_ene);
-                upd.finish_update(*ir, mdatoms, state, wcycle, constr != nullptr);
+                    upd.update_sd_second_half(*ir, step, &dvdl_constr, mdatoms, state, cr, nrnb,
+                                              wcycle, constr, do_log, do_ene);
+                    upd.finish_update(*ir, mdatoms, state, wcycle, constr != nullptr);
+                }
             }
 
             if (ir->bPull && ir->pull->bSetPbcRefToPrevStepCOM)
@@ -1218,10 +1240,6 @@ void gmx::LegacySimulator::do_md()
          * the kinetic energy one step before communication.
          */
         {
-            // Organize to do inter-simulation signalling on steps if
-            // and when algorithms require it.
-            const bool doInterSimSignal = (simulationsShareState && do_per_step(step, nstSignalComm));
-
             if (bGStat || needHalfStepKineticEnergy || doInterSimSignal)
             {
                 // Copy coordinates when needed to stop the CM motion.
@@ -1248,6 +1266,7 @@ void gmx::LegacySimulator::do_md()
                                         | (!EI_VV(ir->eI) && bStopCM ? CGLO_STOPCM : 0)
                                         | (!EI_VV(ir->eI) ? CGLO_TEMPERATURE : 0)
                                         | (!EI_VV(ir->eI) ? CGLO_PRESSURE : 0) | CGLO_CONSTRAINT
+                                        | (accumulateKineticEnergyInUpdate ? CGLO_EKINWORK : 0)
                                         | (shouldCheckNumberOfBondedInteractions ? CGLO_CHECK_NUMBER_OF_BONDED_INTERACTIONS
                                                                                  : 0));
                 checkNumberOfBondedInteractions(mdlog, cr, totalNumberOfBondedInteractions,
@@ -93,6 +93,9 @@ public:
     //! Returns a const arrayref to the force buffer without padding
     gmx::ArrayRef<const gmx::RVec> force() const { return force_.unpaddedConstArrayRef(); }
 
+    //! Returns the force buffer with padding, for use with SIMD kernels
+    gmx::ArrayRefWithPadding<gmx::RVec> forceWithPadding() { return force_; }
+
     //! Returns whether the virial needs to be computed
     bool computeVirial() const { return computeVirial_; }
 
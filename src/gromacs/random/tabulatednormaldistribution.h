@@ -265,6 +265,17 @@ public:
     /*! \brief Clear all internal saved random bits from the random engine */
     void reset() { savedRandomBitsLeft_ = 0; }
 
+    /*! \brief Return the table of standard normal distribution values
+     *
+     * After reset(), with the standard parameters and a 64-bit engine, the
+     * k-th value returned by operator(), for k < 64/tableBits, is the table
+     * entry indexed by bits k*tableBits to (k+1)*tableBits-1 of the first
+     * random value drawn from the engine.
+     * This allows the transformation of many random values at once,
+     * e.g. for all atoms in a SIMD register.
+     */
+    static const std::array<RealType, 1 << tableBits>& table() { return c_table_; }
+
     /*! \brief Return normal distribution value specified by internal parameters.
      *
      * \tparam Rng   Random engine type used to provide uniform random bits.
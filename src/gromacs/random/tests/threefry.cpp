@@ -42,6 +42,8 @@
 
 #include "gromacs/random/threefry.h"
 
+#include <array>
+
 #include <gtest/gtest.h>
 
 #include "gromacs/utility/exceptions.h"
@@ -238,6 +240,39 @@ TEST_F(ThreeFry2x64Test, ExhaustInternalCounter)
     EXPECT_THROW_GMX(rngA(), gmx::InternalError);
 }
 
+TEST_F(ThreeFry2x64Test, FirstValuesOfBatch)
+{
+    const std::array<uint64_t, 5> counters = { { 0, 1, 7, 123456789, 0x3FFFFFFFFFFFFFFF } };
+    std::array<uint64_t, 5>       result;
+
+    gmx::ThreeFry2x64<0> rngA(123456, gmx::RandomDomain::UpdateCoordinates);
+    rngA.generateFirstValues<5>(314, counters.data(), result.data());
+    for (std::size_t i = 0; i < counters.size(); i++)
+    {
+        rngA.restart(314, counters[i]);
+        EXPECT_EQ(rngA(), result[i]);
+    }
+
+    gmx::ThreeFry2x64Fast<2> rngB(123456, gmx::RandomDomain::Other);
+    rngB.generateFirstValues<5>(0xFFFFFFFFFFFFFFFF, counters.data(), result.data());
+    for (std::size_t i = 0; i < counters.size(); i++)
+    {
+        rngB.restart(0xFFFFFFFFFFFFFFFF, counters[i]);
+        EXPECT_EQ(rngB(), result[i]);
+    }
+}
+
+TEST_F(ThreeFry2x64Test, FirstValuesOfBatchWithInvalidCounter)
+{
+    gmx::ThreeFry2x64<10> rngA(123456, gmx::RandomDomain::Other);
+
+    // Highest 10 bits of counter reserved for the internal counter.
+    const std::array<uint64_t, 2> counters = { { 0, 0xFFFFFFFFFFFFFFFF } };
+    std::array<uint64_t, 2>       result;
+    EXPECT_THROW_GMX(rngA.generateFirstValues<2>(0, counters.data(), result.data()),
+                     gmx::InternalError);
+}
+
 } // namespace
 
 } // namespace gmx
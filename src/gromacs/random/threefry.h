@@ -685,6 +685,72 @@ public:
         return block_[index_++];
     }
 
+    /*! \brief Generate the first random number for several counters at once
+     *
+     *  For each of the \p batchSize counters {\p ctr0, \p ctr1[i]} this returns
+     *  the value that operator()() would return first after calling
+     *  restart(\p ctr0, \p ctr1[i]). The state of the engine is not changed.
+     *  The encryption rounds are executed in lock-step over the batch, so the
+     *  compiler can vectorize them over the counters, e.g. when generating
+     *  random numbers for the atoms in a SIMD register.
+     *
+     *  \tparam batchSize  Number of counters to generate values for.
+     *  \param  ctr0       First word of the counters, shared by the batch.
+     *  \param  ctr1       Second words of the \p batchSize counters.
+     *  \param  result     Array of \p batchSize values for the output.
+     *
+     * \throws InternalError if any of the highest bits that are reserved
+     *         for the internal part of the counter are set.
+     */
+    template<std::size_t batchSize>
+    void generateFirstValues(uint64_t ctr0, const uint64_t* ctr1, result_type* result) const
+    {
+        const unsigned int rotations[] = { 16, 42, 12, 31, 16, 32, 24, 21 };
+        const unsigned int digits      = std::numeric_limits<result_type>::digits;
+        const result_type  ks[3] = { key_[0], key_[1], 0x1bd11bdaa9fc1a22 ^ key_[0] ^ key_[1] };
+
+        result_type x0[batchSize];
+        result_type x1[batchSize];
+
+        for (std::size_t i = 0; i < batchSize; i++)
+        {
+            counter_type ctr = { { ctr0, ctr1[i] } };
+            if (!internal::highBitCounter::checkAndClear<result_type, 2, internalCounterBits>(&ctr))
+            {
+                GMX_THROW(InternalError(
+                        "High bits of counter are reserved for the internal stream counter."));
+            }
+            x0[i] = ctr[0] + ks[0];
+            x1[i] = ctr[1] + ks[1];
+        }
+
+        // This is the loop at the end of generateBlock(), applied to all rounds
+        for (unsigned int r = 0; r < rounds; r++)
+        {
+            const unsigned int bits = rotations[r % 8];
+            for (std::size_t i = 0; i < batchSize; i++)
+            {
+                x0[i] += x1[i];
+                x1[i] = (x1[i] << bits) | (x1[i] >> (digits - bits));
+                x1[i] ^= x0[i];
+            }
+            if (((r + 1) & 3) == 0)
+            {
+                const unsigned int r4 = (r + 1) >> 2;
+                for (std::size_t i = 0; i < batchSize; i++)
+                {
+                    x0[i] += ks[r4 % 3];
+                    x1[i] += ks[(r4 + 1) % 3] + r4;
+                }
+            }
+        }
+
+        for (std::size_t i = 0; i < batchSize; i++)
+        {
+            result[i] = x0[i];
+        }
+    }
+
     /*! \brief Skip next n random numbers
      *
      *  Moves the internal random stream for the give key/counter value
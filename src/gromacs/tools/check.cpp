@@ -340,6 +340,10 @@ static void chk_trj(const gmx_output_env_t* oenv, const char* fn, const char* tp
         if (j == 0)
         {
             fprintf(stderr, "\n# Atoms  %d\n", fr.natoms);
+            if (trx_get_num_frames(status) >= 0)
+            {
+                fprintf(stderr, "# Frames %d (from the frame index)\n", trx_get_num_frames(status));
+            }
             if (fr.bPrec)
             {
                 fprintf(stderr, "Precision %g (nm)\n", 1 / fr.prec);
@@ -0,0 +1,339 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "estimate_dd.h"
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gromacs/commandline/cmdlineoptionsmodule.h"
+#include "gromacs/domdec/domdec.h"
+#include "gromacs/domdec/domdec_setup.h"
+#include "gromacs/fileio/filetypes.h"
+#include "gromacs/fileio/tpxio.h"
+#include "gromacs/mdlib/constraintrange.h"
+#include "gromacs/mdlib/perf_est.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/mdtypes/state.h"
+#include "gromacs/options/basicoptions.h"
+#include "gromacs/options/filenameoption.h"
+#include "gromacs/options/ioptionscontainer.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/topology/mtop_util.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/arrayref.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/filestream.h"
+#include "gromacs/utility/logger.h"
+#include "gromacs/utility/stringutil.h"
+#include "gromacs/utility/textwriter.h"
+
+namespace gmx
+{
+
+namespace
+{
+
+//! The DD setup quantities of the system as a whole
+struct SystemEstimate
+{
+    //! The number of atoms
+    int numAtoms = 0;
+    //! The pair-list cut-off
+    real cutoff = 0;
+    //! The maximum distance of two-body bonded interactions
+    real twoBodyDistance = 0;
+    //! The maximum distance of multi-body bonded interactions
+    real multiBodyDistance = 0;
+    //! The minimum cell size, including the DLB margin
+    real cellSizeLimit = 0;
+    //! Whether the system uses PME
+    bool havePme = false;
+    //! The PME load relative to the total load
+    float pmeLoad = 0;
+};
+
+//! Writes the estimates for \p system and the grids for each of \p numRanks to \p writer
+void writeEstimates(TextWriter*                        writer,
+                    const SystemEstimate&              system,
+                    ArrayRef<const int>                numRanks,
+                    ArrayRef<const DDGridCostEstimate> estimates)
+{
+    writer->writeLineFormatted("System: %d atoms, pair-list cut-off %.3f nm", system.numAtoms,
+                               system.cutoff);
+    writer->writeLineFormatted("Maximum bonded distances: two-body %.3f nm, multi-body %.3f nm",
+                               system.twoBodyDistance, system.multiBodyDistance);
+    writer->writeLineFormatted("Minimum DD cell size, including DLB margin: %.3f nm",
+                               system.cellSizeLimit);
+    if (system.havePme)
+    {
+        writer->writeLineFormatted("Estimated relative PME load: %.2f", system.pmeLoad);
+    }
+    writer->ensureEmptyLine();
+
+    writer->writeLine(
+            "  ranks   PP  PME      DD grid    cell size (nm)     halo/domain  halo atoms/rank  "
+            "halo MB/step  comm cost");
+    for (size_t i = 0; i < numRanks.size(); i++)
+    {
+        const DDGridCostEstimate& estimate   = estimates[i];
+        const int                 numPPRanks = numRanks[i] - estimate.numPmeOnlyRanks;
+        if (estimate.numDomains[XX] == 0)
+        {
+            writer->writeLineFormatted("%7d %4d %4d  %11s", numRanks[i], numPPRanks,
+                                       estimate.numPmeOnlyRanks, "none");
+            continue;
+        }
+        writer->writeLineFormatted(
+                "%7d %4d %4d  %3d x%3d x%3d  %5.2f %5.2f %5.2f  %11.3f  %15.0f  %12.3f  %9.3f",
+                numRanks[i], numPPRanks, estimate.numPmeOnlyRanks, estimate.numDomains[XX],
+                estimate.numDomains[YY], estimate.numDomains[ZZ], estimate.cellSize[XX],
+                estimate.cellSize[YY], estimate.cellSize[ZZ], estimate.haloVolumeFraction,
+                estimate.numHaloAtomsPerRank, estimate.haloBytesPerStep / 1.0e6,
+                estimate.relativeCommCost);
+    }
+}
+
+class EstimateDD : public ICommandLineOptionsModule
+{
+public:
+    EstimateDD() {}
+
+    // From ICommandLineOptionsModule
+    void init(CommandLineModuleSettings* /*settings*/) override {}
+    void initOptions(IOptionsContainer* options, ICommandLineOptionsModuleSettings* settings) override;
+    void optionsFinished() override;
+    int  run() override;
+
+private:
+    //! File name of the run input file with full topology.
+    std::string inputTopology_;
+    //! File name for writing the estimates, in addition to standard output.
+    std::string outputFile_;
+    //! Whether the estimates should be written to a file.
+    bool writeOutputFile_ = false;
+    //! The total rank counts to evaluate.
+    std::vector<int> numRanks_;
+    //! The number of separate PME ranks, -1 is auto.
+    int numPmeRanks_ = -1;
+    //! Fraction of the minimum cell size that DLB may use, as mdrun -dds.
+    real dlbScaling_ = 0.8;
+    //! User-set minimum distance for bonded communication, as mdrun -rdd.
+    real minimumCommunicationRange_ = 0;
+};
+
+void EstimateDD::initOptions(IOptionsContainer* options, ICommandLineOptionsModuleSettings* settings)
+{
+    const char* const desc[] = {
+        "[THISMODULE] estimates the domain decomposition setup that mdrun would",
+        "choose for the run input file [TT]-s[tt] for each of the total rank",
+        "counts given with [TT]-np[tt], without running any simulation.",
+        "For each rank count the number of separate PME ranks and the DD grid",
+        "are chosen with the same heuristics as mdrun, unless [TT]-npme[tt] is set.",
+        "",
+        "Reported are the halo volume relative to the domain volume, the average",
+        "number of halo atoms per PP rank, the bytes sent per step for the",
+        "coordinate and force halo exchange summed over all PP ranks, and the",
+        "estimated PP plus PME communication cost relative to communicating",
+        "all atoms once. The latter is the measure mdrun minimizes when choosing",
+        "the grid. For the system as a whole, the relative PME load and the",
+        "maximum distances of bonded interactions are reported.",
+        "",
+        "As with mdrun, the minimum cell size is scaled with 1/[TT]-dds[tt]",
+        "to leave room for dynamic load balancing. Rank counts for which no",
+        "valid decomposition exists are listed without a grid, after which",
+        "the tool exits with an error.",
+        "",
+        "The estimates are also written to the file given with [TT]-o[tt]."
+    };
+
+    settings->setHelpText(desc);
+
+    options->addOption(FileNameOption("s")
+                               .filetype(eftTopology)
+                               .inputFile()
+                               .required()
+                               .store(&inputTopology_)
+                               .defaultBasename("topol")
+                               .description("Run input file"));
+    options->addOption(FileNameOption("o")
+                               .legacyType(efOUT)
+                               .outputFile()
+                               .store(&outputFile_)
+                               .storeIsSet(&writeOutputFile_)
+                               .defaultBasename("estimate-dd")
+                               .description("Estimates output to file"));
+    options->addOption(IntegerOption("np").storeVector(&numRanks_).multiValue().required().description(
+            "Total numbers of ranks to evaluate"));
+    options->addOption(IntegerOption("npme").store(&numPmeRanks_).description(
+            "Number of separate PME ranks, -1 is guess"));
+    options->addOption(RealOption("dds").store(&dlbScaling_).description(
+            "Fraction in (0,1) by whose reciprocal the initial DD cell size will be increased in "
+            "order to provide a margin in which dynamic load balancing can act while preserving "
+            "the minimum cell size."));
+    options->addOption(RealOption("rdd").store(&minimumCommunicationRange_).description(
+            "The maximum distance for bonded interactions with DD (nm), 0 is determine from "
+            "the coordinates"));
+}
+
+void EstimateDD::optionsFinished()
+{
+    if (dlbScaling_ <= 0 || dlbScaling_ >= 1)
+    {
+        GMX_THROW(InconsistentInputError("The value for option -dds should be in (0,1)"));
+    }
+    for (int numRanks : numRanks_)
+    {
+        if (numRanks < 1)
+        {
+            GMX_THROW(InconsistentInputError("The rank counts should be positive"));
+        }
+        if (numPmeRanks_ >= numRanks)
+        {
+            GMX_THROW(InconsistentInputError(
+                    "The number of PME ranks should be smaller than each of the rank counts"));
+        }
+    }
+}
+
+int EstimateDD::run()
+{
+    t_state    state;
+    t_inputrec ir;
+    gmx_mtop_t mtop;
+    read_tpx_state(inputTopology_.c_str(), &ir, &state, &mtop);
+
+    if (ir.cutoff_scheme != ecutsVERLET)
+    {
+        GMX_THROW(InconsistentInputError("Only the Verlet cut-off scheme is supported"));
+    }
+
+    /* Determine the cut-off and minimum cell size as mdrun does without update groups */
+    const MDLogger nullLogger;
+    const real     tenPercentMargin = 1.1;
+    const real     cutoff           = ir.rlist;
+    real           cellSizeLimit    = 0;
+    real           r_2b             = 0;
+    real           r_mb             = 0;
+    if (minimumCommunicationRange_ > 0)
+    {
+        cellSizeLimit = minimumCommunicationRange_;
+    }
+    else
+    {
+        dd_bonded_cg_distance(nullLogger, &mtop, &ir, state.x, state.box, TRUE, &r_2b, &r_mb);
+        if (std::max(r_2b, r_mb) > cutoff)
+        {
+            cellSizeLimit = tenPercentMargin * std::max(r_2b, r_mb);
+        }
+        else
+        {
+            cellSizeLimit = std::min(tenPercentMargin * r_mb, cutoff);
+        }
+    }
+    if (gmx_mtop_ftype_count(mtop, F_CONSTR) + gmx_mtop_ftype_count(mtop, F_CONSTRNC) > 0)
+    {
+        /* Assume constraints will be split over domains, which gives an upper bound.
+         * Use the LINCS halo depth mdrun would use in this environment.
+         */
+        const bool useLincsExpandedHalo = (std::getenv("GMX_LINCS_EXPANDED_HALO") != nullptr);
+        cellSizeLimit =
+                std::max(cellSizeLimit, constr_r_max(nullLogger, &mtop, &ir, useLincsExpandedHalo));
+    }
+    cellSizeLimit /= dlbScaling_;
+
+    SystemEstimate system;
+    system.numAtoms          = mtop.natoms;
+    system.cutoff            = cutoff;
+    system.twoBodyDistance   = r_2b;
+    system.multiBodyDistance = r_mb;
+    system.cellSizeLimit     = cellSizeLimit;
+    system.havePme           = EEL_PME(ir.coulombtype);
+    if (system.havePme)
+    {
+        system.pmeLoad = pme_load_estimate(mtop, ir, state.box);
+    }
+
+    std::sort(numRanks_.begin(), numRanks_.end());
+    std::vector<DDGridCostEstimate> estimates;
+    std::vector<int>                numRanksWithoutGrid;
+    for (int numRanks : numRanks_)
+    {
+        estimates.push_back(estimateDDGridCost(mtop, ir, state.box, state.x, numRanks,
+                                               numPmeRanks_, cutoff, cellSizeLimit));
+        if (estimates.back().numDomains[XX] == 0)
+        {
+            numRanksWithoutGrid.push_back(numRanks);
+        }
+    }
+
+    TextWriter writer(&TextOutputFile::standardOutput());
+    writeEstimates(&writer, system, numRanks_, estimates);
+    if (writeOutputFile_)
+    {
+        TextWriter fileWriter(outputFile_);
+        writeEstimates(&fileWriter, system, numRanks_, estimates);
+        fileWriter.close();
+    }
+
+    if (!numRanksWithoutGrid.empty())
+    {
+        const std::string rankCounts =
+                formatAndJoin(numRanksWithoutGrid, ", ", StringFormatter("%d"));
+        GMX_THROW(InconsistentInputError(formatString(
+                "No valid domain decomposition exists for %s ranks, mdrun would fail with "
+                "these rank counts",
+                rankCounts.c_str())));
+    }
+
+    return 0;
+}
+
+} // namespace
+
+const char EstimateDDInfo::name[] = "estimate-dd";
+const char EstimateDDInfo::shortDescription[] =
+        "Estimate domain decomposition grids and their communication for rank counts";
+ICommandLineOptionsModulePointer EstimateDDInfo::create()
+{
+    return ICommandLineOptionsModulePointer(std::make_unique<EstimateDD>());
+}
+
+} // namespace gmx
@@ -0,0 +1,158 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for functionality of the "estimate-dd" tool.
+ */
+#include "gmxpre.h"
+
+#include "gromacs/tools/estimate_dd.h"
+
+#include "gromacs/domdec/domdec_setup.h"
+#include "gromacs/fileio/tpxio.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/mdtypes/state.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/cmdlinetest.h"
+#include "testutils/refdata.h"
+#include "testutils/testasserts.h"
+#include "testutils/testfilemanager.h"
+#include "testutils/tprfilegenerator.h"
+
+namespace gmx
+{
+
+namespace test
+{
+
+class EstimateDDTest : public ::testing::Test
+{
+public:
+    //! Run test case.
+    static void runTest(CommandLine* cmdline);
+
+protected:
+    // TODO this is changed in newer googletest versions
+    //! Prepare shared resources.
+    static void SetUpTestCase() { s_tprFileHandle = new TprAndFileManager("lysozyme"); }
+    //! Clean up shared resources.
+    static void TearDownTestCase()
+    {
+        delete s_tprFileHandle;
+        s_tprFileHandle = nullptr;
+    }
+    //! Storage for opened file handles.
+    static TprAndFileManager* s_tprFileHandle;
+};
+
+TprAndFileManager* EstimateDDTest::s_tprFileHandle = nullptr;
+
+void EstimateDDTest::runTest(CommandLine* cmdline)
+{
+    EXPECT_EQ(0,
+              gmx::test::CommandLineTestHelper::runModuleFactory(&gmx::EstimateDDInfo::create, cmdline));
+}
+
+TEST_F(EstimateDDTest, WorksWithTpr)
+{
+    const char* const command[] = {
+        "estimate-dd", "-s", s_tprFileHandle->tprName().c_str(), "-np", "1", "2", "4", "8"
+    };
+    CommandLine cmdline(command);
+    runTest(&cmdline);
+}
+
+TEST_F(EstimateDDTest, WorksWithPmeRanks)
+{
+    const char* const command[] = {
+        "estimate-dd", "-s", s_tprFileHandle->tprName().c_str(), "-np", "6", "-npme", "2"
+    };
+    CommandLine cmdline(command);
+    runTest(&cmdline);
+}
+
+TEST_F(EstimateDDTest, FailsWithTooManyRanks)
+{
+    const char* const command[] = {
+        "estimate-dd", "-s", s_tprFileHandle->tprName().c_str(), "-np", "2", "1000"
+    };
+    CommandLine cmdline(command);
+    // The grid for 2 ranks is reported, but there is none for 1000 ranks
+    EXPECT_THROW_GMX(CommandLineTestHelper::runModuleFactory(&EstimateDDInfo::create, &cmdline),
+                     InconsistentInputError);
+}
+
+TEST_F(EstimateDDTest, EstimatesGridsAndCellSizes)
+{
+    t_state    state;
+    t_inputrec ir;
+    gmx_mtop_t mtop;
+    read_tpx_state(s_tprFileHandle->tprName().c_str(), &ir, &state, &mtop);
+
+    TestReferenceData    data;
+    TestReferenceChecker checker(data.rootChecker());
+    // As the tool does for a system without long bonded distances, with the default -dds
+    const real cellSizeLimit = ir.rlist / 0.8;
+    for (int numRanks : { 1, 2, 4, 8, 1000 })
+    {
+        const DDGridCostEstimate estimate = estimateDDGridCost(
+                mtop, ir, state.box, state.x, numRanks, -1, ir.rlist, cellSizeLimit);
+        TestReferenceChecker compound(
+                checker.checkCompound("DDGrid", formatString("Ranks%d", numRanks).c_str()));
+        compound.checkInteger(estimate.numPmeOnlyRanks, "NumPmeOnlyRanks");
+        compound.checkVector(estimate.numDomains, "NumDomains");
+        compound.checkVector(estimate.cellSize, "CellSize");
+    }
+
+    // With PME, separate PME ranks can be requested
+    ir.coulombtype                    = eelPME;
+    ir.nkx                            = 48;
+    ir.nky                            = 56;
+    ir.nkz                            = 28;
+    const DDGridCostEstimate estimate = estimateDDGridCost(mtop, ir, state.box, state.x, 6, 2,
+                                                           ir.rlist, cellSizeLimit);
+    TestReferenceChecker     compound(checker.checkCompound("DDGrid", "Ranks6WithPme"));
+    compound.checkInteger(estimate.numPmeOnlyRanks, "NumPmeOnlyRanks");
+    compound.checkVector(estimate.numDomains, "NumDomains");
+    compound.checkVector(estimate.cellSize, "CellSize");
+}
+
+} // namespace test
+
+} // namespace gmx
@@ -351,7 +351,15 @@ int gmx_trjconv(int argc, char* argv[])
         "Option [TT]-drop[tt] reads an [REF].xvg[ref] file with times and values.",
         "When options [TT]-dropunder[tt] and/or [TT]-dropover[tt] are set,",
         "frames with a value below and above the value of the respective options",
-        "will not be written."
+        "will not be written.[PAR]",
+
+        "With [TT]-fidx[tt], a frame index file is written next to [REF].xtc[ref]",
+        "and [REF].trr[ref] output, with [TT].fidx[tt] appended to the file name.",
+        "The index lists the offset, step and time of each frame, so tools",
+        "reading the trajectory can skip frames before [TT]-b[tt] and frames",
+        "excluded by [TT]-dt[tt] without reading them. Trajectories written by",
+        "[gmx-mdrun] get an index when the environment variable",
+        "[TT]GMX_TRAJECTORY_FRAME_INDEX[tt] is set."
     };
 
     int pbc_enum;
@@ -406,7 +414,7 @@ int gmx_trjconv(int argc, char* argv[])
     static rvec     newbox = { 0, 0, 0 }, shift = { 0, 0, 0 }, trans = { 0, 0, 0 };
     static char*    exec_command = nullptr;
     static real     dropunder = 0, dropover = 0;
-    static gmx_bool bRound = FALSE;
+    static gmx_bool bRound = FALSE, bFrameIndex = FALSE;
 
     t_pargs pa[] = {
         { "-skip", FALSE, etINT, { &skip_nr }, "Only write every nr-th frame" },
@@ -469,7 +477,12 @@ int gmx_trjconv(int argc, char* argv[])
           { &bCONECT },
           "Add conect records when writing [REF].pdb[ref] files. Useful "
           "for visualization of non-standard molecules, e.g. "
-          "coarse grained ones" }
+          "coarse grained ones" },
+        { "-fidx",
+          FALSE,
+          etBOOL,
+          { &bFrameIndex },
+          "Write a frame index file for [REF].xtc[ref] and [REF].trr[ref] output" }
     };
 #define NPA asize(pa)
 
@@ -943,6 +956,10 @@ int gmx_trjconv(int argc, char* argv[])
                     if (!bSplit)
                     {
                         trxout = open_trx(out_file, filemode);
+                        if (bFrameIndex)
+                        {
+                            trx_enable_frame_index(trxout);
+                        }
                     }
                     break;
                 case efGRO:
@@ -1337,6 +1354,10 @@ int gmx_trjconv(int argc, char* argv[])
                                         close_trx(trxout);
                                     }
                                     trxout = open_trx(out_file2, filemode);
+                                    if (bFrameIndex)
+                                    {
+                                        trx_enable_frame_index(trxout);
+                                    }
                                 }
                                 write_trxframe(trxout, &frout, gc);
                                 break;
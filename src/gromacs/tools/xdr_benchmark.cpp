@@ -0,0 +1,303 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "xdr_benchmark.h"
+
+#include <cstdio>
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "gromacs/commandline/cmdlineoptionsmodule.h"
+#include "gromacs/fileio/xdrbulk.h"
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/options/basicoptions.h"
+#include "gromacs/options/filenameoption.h"
+#include "gromacs/options/ioptionscontainer.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+#include "gromacs/timing/walltime_accounting.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/filestream.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/textwriter.h"
+
+namespace gmx
+{
+
+namespace
+{
+
+//! Timings for writing and reading back all values with one conversion path.
+struct XdrBenchmarkResult
+{
+    //! Wall time for writing all frames in seconds.
+    double writeTime = 0;
+    //! Wall time for reading all frames in seconds.
+    double readTime = 0;
+};
+
+class XdrBenchmark : public ICommandLineOptionsModule
+{
+public:
+    XdrBenchmark() {}
+
+    // From ICommandLineOptionsModule
+    void init(CommandLineModuleSettings* /*settings*/) override {}
+    void initOptions(IOptionsContainer* options, ICommandLineOptionsModuleSettings* settings) override;
+    void optionsFinished() override;
+    int  run() override;
+
+private:
+    /*! \brief Writes and reads back all frames, in bulk or with one XDR call per value
+     *
+     * The values read are stored in \p valuesRead.
+     */
+    template<typename FileReal>
+    XdrBenchmarkResult writeAndRead(bool bulk, std::vector<real>* valuesRead) const;
+
+    //! Returns the contents of the output file
+    std::vector<char> readOutputFile() const;
+
+    //! Name of the data file to write.
+    std::string outputFile_;
+    //! The number of atoms per frame.
+    int numAtoms_ = 1000000;
+    //! The number of frames to write and read.
+    int numFrames_ = 10;
+    //! Whether to store double precision values in the file.
+    bool fileDouble_ = false;
+    //! The coordinates of all frames, stored consecutively.
+    std::vector<real> values_;
+};
+
+void XdrBenchmark::initOptions(IOptionsContainer* options, ICommandLineOptionsModuleSettings* settings)
+{
+    const char* const desc[] = {
+        "[THISMODULE] measures the throughput of the XDR conversion of",
+        "coordinate arrays, as used for TRR trajectories, energy files and",
+        "checkpoint files. It writes and reads back [TT]-frames[tt] frames of",
+        "[TT]-natoms[tt] random coordinates, once with one XDR call per value",
+        "and once with the bulk conversion that GROMACS uses for arrays.",
+        "With [TT]-double[tt] the values are stored in double precision.",
+        "",
+        "Reported are the wall times and the throughput in MB/s of the data",
+        "in the file. The files written by both paths and the values read back",
+        "are checked to be identical. The data written is left in [TT]-o[tt]."
+    };
+
+    settings->setHelpText(desc);
+
+    options->addOption(FileNameOption("o")
+                               .filetype(eftGenericData)
+                               .outputFile()
+                               .required()
+                               .store(&outputFile_)
+                               .defaultBasename("xdrbench")
+                               .description("XDR data written during the benchmark"));
+    options->addOption(
+            IntegerOption("natoms").store(&numAtoms_).description("Number of atoms per frame"));
+    options->addOption(IntegerOption("frames").store(&numFrames_).description("Number of frames"));
+    options->addOption(BooleanOption("double").store(&fileDouble_).description(
+            "Store the values in double precision"));
+}
+
+void XdrBenchmark::optionsFinished()
+{
+    if (numAtoms_ < 1 || numFrames_ < 1)
+    {
+        GMX_THROW(InconsistentInputError("The atom and frame counts should be positive"));
+    }
+}
+
+template<typename FileReal>
+XdrBenchmarkResult XdrBenchmark::writeAndRead(bool bulk, std::vector<real>* valuesRead) const
+{
+    XdrBenchmarkResult result;
+    const size_t       valuesPerFrame = static_cast<size_t>(numAtoms_) * DIM;
+    const xdrproc_t    xdrProc        = std::is_same<FileReal, float>::value
+                                      ? reinterpret_cast<xdrproc_t>(xdr_float)
+                                      : reinterpret_cast<xdrproc_t>(xdr_double);
+
+    FILE* fp = gmx_ffopen(outputFile_, "wb");
+    XDR   xdr;
+    xdrstdio_create(&xdr, fp, XDR_ENCODE);
+    const double startTime = gmx_gettime();
+    for (int frame = 0; frame < numFrames_; frame++)
+    {
+        const real* x  = values_.data() + frame * valuesPerFrame;
+        bool        ok = true;
+        if (bulk)
+        {
+            ok = xdrBulkValues<FileReal>(&xdr, const_cast<real*>(x), valuesPerFrame);
+        }
+        else
+        {
+            for (size_t i = 0; i < valuesPerFrame && ok; i++)
+            {
+                FileReal value = x[i];
+                ok             = xdrProc(&xdr, &value);
+            }
+        }
+        if (!ok)
+        {
+            GMX_THROW(FileIOError("Could not write frame to " + outputFile_));
+        }
+    }
+    xdr_destroy(&xdr);
+    gmx_ffclose(fp);
+    result.writeTime = gmx_gettime() - startTime;
+
+    valuesRead->resize(values_.size());
+    fp = gmx_ffopen(outputFile_, "rb");
+    xdrstdio_create(&xdr, fp, XDR_DECODE);
+    const double readStartTime = gmx_gettime();
+    for (int frame = 0; frame < numFrames_; frame++)
+    {
+        real* x  = valuesRead->data() + frame * valuesPerFrame;
+        bool  ok = true;
+        if (bulk)
+        {
+            ok = xdrBulkValues<FileReal>(&xdr, x, valuesPerFrame);
+        }
+        else
+        {
+            for (size_t i = 0; i < valuesPerFrame && ok; i++)
+            {
+                FileReal value;
+                ok   = xdrProc(&xdr, &value);
+                x[i] = value;
+            }
+        }
+        if (!ok)
+        {
+            GMX_THROW(FileIOError("Could not read back frame from " + outputFile_));
+        }
+    }
+    result.readTime = gmx_gettime() - readStartTime;
+    xdr_destroy(&xdr);
+    gmx_ffclose(fp);
+
+    return result;
+}
+
+std::vector<char> XdrBenchmark::readOutputFile() const
+{
+    FILE*             fp = gmx_ffopen(outputFile_, "rb");
+    std::vector<char> contents;
+    char              buffer[4096];
+    size_t            numRead;
+    while ((numRead = std::fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    {
+        contents.insert(contents.end(), buffer, buffer + numRead);
+    }
+    gmx_ffclose(fp);
+    return contents;
+}
+
+int XdrBenchmark::run()
+{
+    ThreeFry2x64<64>              rng(123456, RandomDomain::Other);
+    UniformRealDistribution<real> uniform(0, 10);
+    values_.resize(static_cast<size_t>(numFrames_) * numAtoms_ * DIM);
+    for (real& value : values_)
+    {
+        value = uniform(rng);
+    }
+
+    std::vector<real>  perValueRead;
+    std::vector<real>  bulkRead;
+    XdrBenchmarkResult perValue;
+    XdrBenchmarkResult bulk;
+    if (fileDouble_)
+    {
+        perValue = writeAndRead<double>(false, &perValueRead);
+    }
+    else
+    {
+        perValue = writeAndRead<float>(false, &perValueRead);
+    }
+    const std::vector<char> perValueContents = readOutputFile();
+    if (fileDouble_)
+    {
+        bulk = writeAndRead<double>(true, &bulkRead);
+    }
+    else
+    {
+        bulk = writeAndRead<float>(true, &bulkRead);
+    }
+    if (readOutputFile() != perValueContents)
+    {
+        GMX_THROW(InternalError("The files written per value and in bulk differ"));
+    }
+    if (perValueRead != bulkRead)
+    {
+        GMX_THROW(InternalError("The values read per value and in bulk differ"));
+    }
+
+    TextWriter   writer(&TextOutputFile::standardOutput());
+    const size_t bytesPerValue = fileDouble_ ? sizeof(double) : sizeof(float);
+    const double megaBytes     = values_.size() * static_cast<double>(bytesPerValue) / 1.0e6;
+    writer.writeLineFormatted("%d frames of %d atoms, %s precision in the file", numFrames_,
+                              numAtoms_, fileDouble_ ? "double" : "single");
+    writer.ensureEmptyLine();
+    writer.writeLine("      path  write s  write MB/s   read s  read MB/s");
+    auto writeResult = [&writer, megaBytes](const char* path, const XdrBenchmarkResult& result) {
+        writer.writeLineFormatted("%10s  %7.3f  %10.1f  %7.3f  %9.1f", path, result.writeTime,
+                                  megaBytes / result.writeTime, result.readTime,
+                                  megaBytes / result.readTime);
+    };
+    writeResult("per value", perValue);
+    writeResult("bulk", bulk);
+    writer.ensureEmptyLine();
+    writer.writeLine("The files and the values read back from both paths are identical");
+
+    return 0;
+}
+
+} // namespace
+
+const char XdrBenchmarkInfo::name[] = "xdr-benchmark";
+const char XdrBenchmarkInfo::shortDescription[] =
+        "Measure the throughput of per-value and bulk XDR array conversion";
+ICommandLineOptionsModulePointer XdrBenchmarkInfo::create()
+{
+    return ICommandLineOptionsModulePointer(std::make_unique<XdrBenchmark>());
+}
+
+} // namespace gmx
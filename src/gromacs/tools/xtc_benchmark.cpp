@@ -0,0 +1,312 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "xtc_benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "gromacs/commandline/cmdlineoptionsmodule.h"
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/options/basicoptions.h"
+#include "gromacs/options/filenameoption.h"
+#include "gromacs/options/ioptionscontainer.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+#include "gromacs/timing/walltime_accounting.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/filestream.h"
+#include "gromacs/utility/gmxomp.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+#include "gromacs/utility/textwriter.h"
+
+namespace gmx
+{
+
+namespace
+{
+
+//! Timings and sizes for writing and reading back one trajectory.
+struct XtcBenchmarkResult
+{
+    //! Wall time for writing all frames in seconds.
+    double writeTime = 0;
+    //! Wall time for reading all frames in seconds.
+    double readTime = 0;
+    //! Size of the written file in bytes.
+    gmx_off_t fileSize = 0;
+};
+
+class XtcBenchmark : public ICommandLineOptionsModule
+{
+public:
+    XtcBenchmark() {}
+
+    // From ICommandLineOptionsModule
+    void init(CommandLineModuleSettings* /*settings*/) override {}
+    void initOptions(IOptionsContainer* options, ICommandLineOptionsModuleSettings* settings) override;
+    void optionsFinished() override;
+    int  run() override;
+
+private:
+    /*! \brief Writes and reads back all frames with \p atomsPerChunk, 0 is classic
+     *
+     * The coordinates of all frames read are stored consecutively in \p xRead.
+     */
+    XtcBenchmarkResult writeAndRead(int atomsPerChunk, std::vector<RVec>* xRead) const;
+
+    //! Name of the trajectory file to write.
+    std::string outputFile_;
+    //! The number of atoms per frame.
+    int numAtoms_ = 100000;
+    //! The number of frames to write and read.
+    int numFrames_ = 10;
+    //! The minimum number of atoms per chunk.
+    int atomsPerChunk_ = 50000;
+    //! The XTC precision.
+    real precision_ = 1000;
+    //! The number of OpenMP threads, 0 is the default.
+    int numThreads_ = 0;
+    //! The box, shared by all frames.
+    matrix box_ = { { 0 } };
+    //! The coordinates of all frames.
+    std::vector<std::vector<RVec>> frames_;
+};
+
+void XtcBenchmark::initOptions(IOptionsContainer* options, ICommandLineOptionsModuleSettings* settings)
+{
+    const char* const desc[] = {
+        "[THISMODULE] measures the throughput of writing and reading XTC",
+        "trajectories. It generates [TT]-frames[tt] frames of a water-like",
+        "system with [TT]-natoms[tt] atoms and writes and reads them back",
+        "both as classic XTC frames and as chunked frames with at least",
+        "[TT]-chunk[tt] atoms per chunk. The chunks of a frame are compressed",
+        "and decompressed in parallel using [TT]-nt[tt] OpenMP threads.",
+        "",
+        "Reported are the wall times, the throughput in MB/s of uncompressed",
+        "single precision coordinates and the compression ratio. The",
+        "coordinates read from both formats are checked to be identical.",
+        "The chunked trajectory is left in [TT]-o[tt].",
+        "",
+        "Chunked frames are written by mdrun when the environment variable",
+        "[TT]GMX_XTC_CHUNK_SIZE[tt] is set; this tool can be used to choose",
+        "a suitable value."
+    };
+
+    settings->setHelpText(desc);
+
+    options->addOption(FileNameOption("o")
+                               .filetype(eftTrajectory)
+                               .outputFile()
+                               .required()
+                               .store(&outputFile_)
+                               .defaultBasename("xtcbench")
+                               .description("Compressed trajectory written during the benchmark"));
+    options->addOption(
+            IntegerOption("natoms").store(&numAtoms_).description("Number of atoms per frame"));
+    options->addOption(IntegerOption("frames").store(&numFrames_).description("Number of frames"));
+    options->addOption(IntegerOption("chunk").store(&atomsPerChunk_).description(
+            "Minimum number of atoms per chunk for the chunked frames"));
+    options->addOption(
+            RealOption("prec").store(&precision_).description("Precision of the XTC frames"));
+    options->addOption(IntegerOption("nt").store(&numThreads_).description(
+            "Number of OpenMP threads, 0 is the default"));
+}
+
+void XtcBenchmark::optionsFinished()
+{
+    if (!endsWith(outputFile_, ".xtc"))
+    {
+        GMX_THROW(InconsistentInputError("The output file should be an .xtc file"));
+    }
+    if (numAtoms_ < 1 || numFrames_ < 1)
+    {
+        GMX_THROW(InconsistentInputError("The atom and frame counts should be positive"));
+    }
+    if (atomsPerChunk_ < 1)
+    {
+        GMX_THROW(InconsistentInputError("The number of atoms per chunk should be positive"));
+    }
+    if (precision_ <= 0)
+    {
+        GMX_THROW(InconsistentInputError("The precision should be positive"));
+    }
+    if (numThreads_ < 0)
+    {
+        GMX_THROW(InconsistentInputError("The number of threads should not be negative"));
+    }
+}
+
+XtcBenchmarkResult XtcBenchmark::writeAndRead(int atomsPerChunk, std::vector<RVec>* xRead) const
+{
+    XtcBenchmarkResult result;
+
+    t_fileio*    fio       = open_xtc(outputFile_.c_str(), "w");
+    const double startTime = gmx_gettime();
+    for (int frame = 0; frame < numFrames_; frame++)
+    {
+        const rvec* x = as_rvec_array(frames_[frame].data());
+        if (!write_xtc_chunked(fio, numAtoms_, frame, frame, box_, x, precision_, atomsPerChunk))
+        {
+            GMX_THROW(FileIOError("Could not write frame to " + outputFile_));
+        }
+    }
+    gmx_fio_flush(fio);
+    result.writeTime = gmx_gettime() - startTime;
+    result.fileSize  = gmx_fio_ftell(fio);
+    close_xtc(fio);
+
+    xRead->resize(static_cast<size_t>(numFrames_) * numAtoms_);
+    fio                        = open_xtc(outputFile_.c_str(), "r");
+    const double readStartTime = gmx_gettime();
+    int          numAtomsRead  = 0;
+    int64_t      step          = 0;
+    real         time          = 0;
+    real         precision     = 0;
+    matrix       box;
+    rvec*        x   = nullptr;
+    gmx_bool     bOK = TRUE;
+    int          ok  = read_first_xtc(fio, &numAtomsRead, &step, &time, box, &x, &precision, &bOK);
+    for (int frame = 0; frame < numFrames_; frame++)
+    {
+        if (frame > 0)
+        {
+            ok = read_next_xtc(fio, numAtomsRead, &step, &time, box, x, &precision, &bOK);
+        }
+        if (!ok || !bOK || numAtomsRead != numAtoms_)
+        {
+            GMX_THROW(FileIOError("Could not read back frame from " + outputFile_));
+        }
+        std::copy(x, x + numAtoms_, xRead->begin() + static_cast<size_t>(frame) * numAtoms_);
+    }
+    result.readTime = gmx_gettime() - readStartTime;
+    sfree(x);
+    close_xtc(fio);
+
+    return result;
+}
+
+int XtcBenchmark::run()
+{
+    if (numThreads_ > 0)
+    {
+        gmx_omp_set_num_threads(numThreads_);
+    }
+
+    /* Generate water-like triplets on a lattice with some noise, so that
+     * the compression ratio is close to that of a real system.
+     */
+    const int  numMolecules = (numAtoms_ + 2) / 3;
+    const int  latticeSize  = static_cast<int>(std::ceil(std::cbrt(numMolecules)));
+    const real spacing      = 0.31;
+    for (int d = 0; d < DIM; d++)
+    {
+        box_[d][d] = latticeSize * spacing;
+    }
+    ThreeFry2x64<64>              rng(123456, RandomDomain::Other);
+    UniformRealDistribution<real> noise(-0.02, 0.02);
+    frames_.assign(numFrames_, std::vector<RVec>(numAtoms_));
+    for (int frame = 0; frame < numFrames_; frame++)
+    {
+        for (int a = 0; a < numAtoms_; a++)
+        {
+            const int  molecule = a / 3;
+            const RVec oxygen(spacing * (molecule % latticeSize),
+                              spacing * ((molecule / latticeSize) % latticeSize),
+                              spacing * (molecule / (latticeSize * latticeSize)));
+            const RVec offset(a % 3 == 1 ? 0.1 : 0, a % 3 == 2 ? 0.1 : 0, 0);
+            frames_[frame][a] = oxygen + offset;
+            for (int d = 0; d < DIM; d++)
+            {
+                frames_[frame][a][d] += noise(rng);
+            }
+        }
+    }
+
+    std::vector<RVec>        xClassic;
+    std::vector<RVec>        xChunked;
+    const XtcBenchmarkResult classic = writeAndRead(0, &xClassic);
+    const XtcBenchmarkResult chunked = writeAndRead(atomsPerChunk_, &xChunked);
+    for (size_t i = 0; i < xClassic.size(); i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            if (xClassic[i][d] != xChunked[i][d])
+            {
+                GMX_THROW(InternalError("Classic and chunked XTC frames read back differ"));
+            }
+        }
+    }
+
+    TextWriter   writer(&TextOutputFile::standardOutput());
+    const double megaBytes =
+            numFrames_ * static_cast<double>(numAtoms_) * DIM * sizeof(float) / 1.0e6;
+    writer.writeLineFormatted("%d frames of %d atoms, precision %g, %d OpenMP threads", numFrames_,
+                              numAtoms_, precision_, gmx_omp_get_max_threads());
+    writer.writeLineFormatted("Chunked frames use at least %d atoms per chunk", atomsPerChunk_);
+    writer.ensureEmptyLine();
+    writer.writeLine("  format   file MB  ratio  write s  write MB/s   read s  read MB/s");
+    auto writeResult = [&writer, megaBytes](const char* format, const XtcBenchmarkResult& result) {
+        writer.writeLineFormatted("%8s  %8.2f  %5.2f  %7.3f  %10.1f  %7.3f  %9.1f", format,
+                                  result.fileSize / 1.0e6, megaBytes * 1.0e6 / result.fileSize,
+                                  result.writeTime, megaBytes / result.writeTime, result.readTime,
+                                  megaBytes / result.readTime);
+    };
+    writeResult("classic", classic);
+    writeResult("chunked", chunked);
+    writer.ensureEmptyLine();
+    writer.writeLine("The coordinates read back from both formats are identical");
+
+    return 0;
+}
+
+} // namespace
+
+const char XtcBenchmarkInfo::name[] = "xtc-benchmark";
+const char XtcBenchmarkInfo::shortDescription[] =
+        "Measure the throughput of classic and chunked XTC writing and reading";
+ICommandLineOptionsModulePointer XtcBenchmarkInfo::create()
+{
+    return ICommandLineOptionsModulePointer(std::make_unique<XtcBenchmark>());
+}
+
+} // namespace gmx
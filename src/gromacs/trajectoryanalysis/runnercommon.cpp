@@ -44,11 +44,14 @@
 
 #include "runnercommon.h"
 
+#include <cstdlib>
 #include <cstring>
 
 #include <algorithm>
+#include <memory>
 #include <string>
 
+#include "gromacs/fileio/filetypes.h"
 #include "gromacs/fileio/oenv.h"
 #include "gromacs/fileio/timecontrol.h"
 #include "gromacs/fileio/trxio.h"
@@ -73,10 +76,39 @@
 #include "gromacs/utility/stringutil.h"
 
 #include "analysissettings_impl.h"
+#include "trajectoryreadahead.h"
 
 namespace gmx
 {
 
+namespace
+{
+
+/*! \brief
+ * Returns the number of frames of \p trjfile to read ahead on a background thread.
+ *
+ * Only XTC, TRR and TNG files are read ahead; the readers for the other
+ * formats share atom data between frames.
+ */
+int readAheadFrameCount(const std::string& trjfile)
+{
+    const int ftp = fn2ftp(trjfile.c_str());
+    if (ftp != efXTC && ftp != efTRR && ftp != efTNG)
+    {
+        return 0;
+    }
+    const char* env = std::getenv("GMX_TRAJECTORY_READ_AHEAD");
+    if (env == nullptr)
+    {
+        // Two frames let the next frame be read while another one waits for the analysis
+        const int defaultFrameCount = 2;
+        return defaultFrameCount;
+    }
+    return std::max(std::atoi(env), 0);
+}
+
+} // namespace
+
 class TrajectoryAnalysisRunnerCommon::Impl : public ITopologyProvider
 {
 public:
@@ -88,6 +120,7 @@ public:
     void initTopology(bool required);
     void initFirstFrame();
     void initFrameIndexGroup();
+    bool readNextFrame();
     void finishTrajectory();
 
     // From ITopologyProvider
@@ -135,6 +168,13 @@ public:
     //! Used to store the status variable from read_first_frame().
     t_trxstatus*      status_;
     gmx_output_env_t* oenv_;
+    //! Number of frames to read ahead, zero if frames are read when needed.
+    int readAheadFrames_;
+    /*! \brief
+     * Reads frames ahead after the first frame, uses \p status_ and
+     * \p gpbc_ exclusively while it exists.
+     */
+    std::unique_ptr<TrajectoryReadAhead> readAhead_;
 };
 
 
@@ -150,7 +190,8 @@ TrajectoryAnalysisRunnerCommon::Impl::Impl(TrajectoryAnalysisSettings* settings)
     fr(nullptr),
     gpbc_(nullptr),
     status_(nullptr),
-    oenv_(nullptr)
+    oenv_(nullptr),
+    readAheadFrames_(0)
 {
 }
 
@@ -221,7 +262,8 @@ void TrajectoryAnalysisRunnerCommon::Impl::initFirstFrame()
         {
             GMX_THROW(FileIOError("Could not read coordinates from trajectory"));
         }
-        bTrajOpen_ = true;
+        bTrajOpen_       = true;
+        readAheadFrames_ = readAheadFrameCount(trjfile_);
 
         if (topInfo_.hasTopology())
         {
@@ -288,8 +330,26 @@ void TrajectoryAnalysisRunnerCommon::Impl::initFrameIndexGroup()
     std::copy(trajectoryGroup_.atomIndices().begin(), trajectoryGroup_.atomIndices().end(), fr->index);
 }
 
+bool TrajectoryAnalysisRunnerCommon::Impl::readNextFrame()
+{
+    if (readAheadFrames_ == 0)
+    {
+        return read_next_frame(oenv_, status_, fr);
+    }
+    if (readAhead_ == nullptr)
+    {
+        // The current frame has been processed, so the reader thread can
+        // take over the trajectory and the PBC removal.
+        readAhead_ = std::make_unique<TrajectoryReadAhead>(
+                oenv_, status_, gpbc_, *fr, readAheadFrames_);
+    }
+    return readAhead_->readNextFrame(fr);
+}
+
 void TrajectoryAnalysisRunnerCommon::Impl::finishTrajectory()
 {
+    // Stop the reader thread before closing what it uses
+    readAhead_.reset();
     if (bTrajOpen_)
     {
         close_trx(status_);
@@ -441,7 +501,7 @@ bool TrajectoryAnalysisRunnerCommon::readNextFrame()
     bool bContinue = false;
     if (hasTrajectory())
     {
-        bContinue = read_next_frame(impl_->oenv_, impl_->status_, impl_->fr);
+        bContinue = impl_->readNextFrame();
     }
     if (!bContinue)
     {
@@ -453,7 +513,8 @@ bool TrajectoryAnalysisRunnerCommon::readNextFrame()
 
 void TrajectoryAnalysisRunnerCommon::initFrame()
 {
-    if (impl_->gpbc_ != nullptr)
+    // Frames read ahead have already been made whole by the reader thread
+    if (impl_->gpbc_ != nullptr && impl_->readAhead_ == nullptr)
     {
         gmx_rmpbc_trxfr(impl_->gpbc_, impl_->fr);
     }
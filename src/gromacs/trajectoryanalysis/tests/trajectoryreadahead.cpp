@@ -0,0 +1,149 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for gmx::TrajectoryReadAhead.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+#include "gmxpre.h"
+
+#include "gromacs/trajectoryanalysis/trajectoryreadahead.h"
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/oenv.h"
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+
+#include "testutils/testfilemanager.h"
+#include "testutils/trajectoryfilegenerator.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of frames in the test trajectories
+const int c_numFrames = 12;
+
+//! Test fixture, parametrized by the file extension and the number of frames to read ahead
+class TrajectoryReadAheadTest :
+    public TemporaryFileTest<::testing::TestWithParam<std::tuple<const char*, int>>>
+{
+public:
+    TrajectoryReadAheadTest()
+    {
+        filename_ = fileManager_.getTemporaryFilePath(std::string("traj.")
+                                                      + std::get<0>(GetParam()));
+        output_env_init_default(&oenv_);
+        writeTestTrajectoryFrames(filename_, "w", 0, c_numFrames);
+    }
+
+    ~TrajectoryReadAheadTest() override { output_env_done(oenv_); }
+
+    //! Output environment for reading
+    gmx_output_env_t* oenv_;
+};
+
+TEST_P(TrajectoryReadAheadTest, ReadsTheSameFramesAsReadNextFrame)
+{
+    const int    numReadAheadFrames = std::get<1>(GetParam());
+    t_trxstatus* status;
+    t_trxframe   fr;
+    ASSERT_TRUE(read_first_frame(oenv_, &status, filename_.c_str(), &fr, TRX_READ_X | TRX_READ_V));
+    rvec* const x = fr.x;
+
+    int numFrames = 1;
+    {
+        TrajectoryReadAhead readAhead(oenv_, status, nullptr, fr, numReadAheadFrames);
+        while (readAhead.readNextFrame(&fr))
+        {
+            SCOPED_TRACE("Frame " + std::to_string(numFrames));
+            EXPECT_EQ(10 * numFrames, fr.step);
+            EXPECT_FLOAT_EQ(0.5 * numFrames, fr.time);
+            // The coordinates are copied into the array of the frame
+            EXPECT_EQ(x, fr.x);
+            ASSERT_TRUE(fr.bX);
+            const RVec expectedX = testTrajectoryVectors(numFrames, 0).back();
+            EXPECT_FLOAT_EQ(expectedX[XX], fr.x[c_numTestTrajectoryAtoms - 1][XX]);
+            EXPECT_FLOAT_EQ(expectedX[YY], fr.x[c_numTestTrajectoryAtoms - 1][YY]);
+            if (fr.bV)
+            {
+                const RVec expectedV = testTrajectoryVectors(numFrames, 1).back();
+                EXPECT_FLOAT_EQ(expectedV[XX], fr.v[c_numTestTrajectoryAtoms - 1][XX]);
+            }
+            numFrames++;
+        }
+        EXPECT_FALSE(readAhead.readNextFrame(&fr));
+    }
+    EXPECT_EQ(c_numFrames, numFrames);
+    // The last frame is kept after the end of the trajectory
+    EXPECT_FLOAT_EQ(0.5 * (c_numFrames - 1), fr.time);
+
+    close_trx(status);
+    done_frame(&fr);
+}
+
+TEST_P(TrajectoryReadAheadTest, CanStopBeforeTheEnd)
+{
+    const int    numReadAheadFrames = std::get<1>(GetParam());
+    t_trxstatus* status;
+    t_trxframe   fr;
+    ASSERT_TRUE(read_first_frame(oenv_, &status, filename_.c_str(), &fr, TRX_READ_X));
+    {
+        TrajectoryReadAhead readAhead(oenv_, status, nullptr, fr, numReadAheadFrames);
+        ASSERT_TRUE(readAhead.readNextFrame(&fr));
+        EXPECT_EQ(10, fr.step);
+    }
+    close_trx(status);
+    done_frame(&fr);
+}
+
+INSTANTIATE_TEST_CASE_P(WithFileTypes,
+                        TrajectoryReadAheadTest,
+                        ::testing::Combine(::testing::Values("xtc", "trr"),
+                                           ::testing::Values(1, 3)));
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,317 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements gmx::TrajectoryReadAhead.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+#include "gmxpre.h"
+
+#include "trajectoryreadahead.h"
+
+#include <cstring>
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/pbcutil/rmpbc.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace gmx
+{
+
+namespace
+{
+
+/*! \brief
+ * Copies \p from to \p to if \p present, resizing \p to when \p resize is set.
+ */
+void copyFrameVectors(const rvec* from, rvec** to, gmx_bool present, int natoms, bool resize)
+{
+    if (!present)
+    {
+        return;
+    }
+    if (resize || *to == nullptr)
+    {
+        srenew(*to, natoms);
+    }
+    std::memcpy(*to, from, sizeof(*from) * natoms);
+}
+
+/*! \brief
+ * Assigns all fields of \p src to \p dest, except the arrays and index group of \p dest.
+ */
+void assignFrameHeader(const t_trxframe& src, t_trxframe* dest)
+{
+    rvec*          x      = dest->x;
+    rvec*          v      = dest->v;
+    rvec*          f      = dest->f;
+    const gmx_bool bIndex = dest->bIndex;
+    int*           index  = dest->index;
+
+    *dest        = src;
+    dest->x      = x;
+    dest->v      = v;
+    dest->f      = f;
+    dest->bIndex = bIndex;
+    dest->index  = index;
+}
+
+/*! \brief
+ * Copies the frame \p src into \p dest, keeping the arrays and index group of \p dest.
+ */
+void copyFrameContents(const t_trxframe& src, t_trxframe* dest)
+{
+    const bool resize = (src.natoms != dest->natoms);
+
+    assignFrameHeader(src, dest);
+    copyFrameVectors(src.x, &dest->x, src.bX, src.natoms, resize);
+    copyFrameVectors(src.v, &dest->v, src.bV, src.natoms, resize);
+    copyFrameVectors(src.f, &dest->f, src.bF, src.natoms, resize);
+}
+
+} // namespace
+
+/*! \internal
+ * \brief
+ * Private implementation class for TrajectoryReadAhead.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+class TrajectoryReadAhead::Impl
+{
+public:
+    Impl(const gmx_output_env_t* oenv,
+         t_trxstatus*            status,
+         gmx_rmpbc_t             gpbc,
+         const t_trxframe&       currentFrame,
+         int                     numFrames);
+    ~Impl();
+
+    bool readNextFrame(t_trxframe* fr);
+
+private:
+    //! The loop executed by the reader thread.
+    void run();
+
+    const gmx_output_env_t* oenv_;
+    t_trxstatus*            status_;
+    gmx_rmpbc_t             gpbc_;
+    /*! \brief
+     * The fields of the frame read last, without its arrays.
+     *
+     * Only used by the reader thread, as the readers can continue from
+     * the previous frame, e.g., TNG looks for the frame after its step.
+     */
+    t_trxframe previousFrame_;
+    //! The frame buffers, each owning its coordinate, velocity and force arrays.
+    std::vector<t_trxframe> frames_;
+    //! Protects all members below.
+    std::mutex mutex_;
+    //! Signals the caller that a frame was read or that reading finished.
+    std::condition_variable frameReady_;
+    //! Signals the reader thread that a buffer was released or that it should stop.
+    std::condition_variable bufferReleased_;
+    //! Buffers that the reader thread can read the next frame into.
+    std::deque<t_trxframe*> freeFrames_;
+    //! Buffers containing frames that were read, in trajectory order.
+    std::deque<t_trxframe*> readyFrames_;
+    //! The exception thrown while reading, if any.
+    std::exception_ptr error_;
+    //! Whether the reader thread has reached the end of the trajectory or failed.
+    bool finished_ = false;
+    //! Whether the reader thread should stop.
+    bool stop_ = false;
+    //! The reader thread.
+    std::thread thread_;
+};
+
+TrajectoryReadAhead::Impl::Impl(const gmx_output_env_t* oenv,
+                                t_trxstatus*            status,
+                                gmx_rmpbc_t             gpbc,
+                                const t_trxframe&       currentFrame,
+                                int                     numFrames) :
+    oenv_(oenv),
+    status_(status),
+    gpbc_(gpbc),
+    previousFrame_(currentFrame),
+    frames_(numFrames, currentFrame)
+{
+    GMX_RELEASE_ASSERT(numFrames > 0, "Need at least one frame buffer");
+
+    for (t_trxframe& frame : frames_)
+    {
+        // XTC frames are read into the existing coordinate array, so each
+        // buffer gets its own arrays of the current size.
+        frame.x      = nullptr;
+        frame.v      = nullptr;
+        frame.f      = nullptr;
+        frame.bIndex = FALSE;
+        frame.index  = nullptr;
+        if (currentFrame.x != nullptr)
+        {
+            snew(frame.x, currentFrame.natoms);
+        }
+        if (currentFrame.v != nullptr)
+        {
+            snew(frame.v, currentFrame.natoms);
+        }
+        if (currentFrame.f != nullptr)
+        {
+            snew(frame.f, currentFrame.natoms);
+        }
+        freeFrames_.push_back(&frame);
+    }
+    thread_ = std::thread([this]() { run(); });
+}
+
+TrajectoryReadAhead::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    bufferReleased_.notify_one();
+    thread_.join();
+    for (t_trxframe& frame : frames_)
+    {
+        sfree(frame.x);
+        sfree(frame.v);
+        sfree(frame.f);
+    }
+}
+
+void TrajectoryReadAhead::Impl::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        bufferReleased_.wait(lock, [this]() { return stop_ || !freeFrames_.empty(); });
+        if (stop_)
+        {
+            return;
+        }
+        t_trxframe* frame = freeFrames_.front();
+        freeFrames_.pop_front();
+        lock.unlock();
+
+        bool               bRead = false;
+        std::exception_ptr error;
+        try
+        {
+            assignFrameHeader(previousFrame_, frame);
+            bRead          = read_next_frame(oenv_, status_, frame);
+            previousFrame_ = *frame;
+            if (bRead && gpbc_ != nullptr)
+            {
+                gmx_rmpbc_trxfr(gpbc_, frame);
+            }
+        }
+        catch (...)
+        {
+            bRead = false;
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        if (!bRead)
+        {
+            freeFrames_.push_back(frame);
+            error_    = error;
+            finished_ = true;
+            frameReady_.notify_one();
+            return;
+        }
+        readyFrames_.push_back(frame);
+        frameReady_.notify_one();
+    }
+}
+
+bool TrajectoryReadAhead::Impl::readNextFrame(t_trxframe* fr)
+{
+    t_trxframe* frame = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        frameReady_.wait(lock, [this]() { return finished_ || !readyFrames_.empty(); });
+        if (readyFrames_.empty())
+        {
+            if (error_)
+            {
+                std::rethrow_exception(error_);
+            }
+            return false;
+        }
+        frame = readyFrames_.front();
+        readyFrames_.pop_front();
+    }
+    copyFrameContents(*frame, fr);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeFrames_.push_back(frame);
+    }
+    bufferReleased_.notify_one();
+    return true;
+}
+
+/********************************************************************
+ * TrajectoryReadAhead
+ */
+
+TrajectoryReadAhead::TrajectoryReadAhead(const gmx_output_env_t* oenv,
+                                         t_trxstatus*            status,
+                                         gmx_rmpbc_t             gpbc,
+                                         const t_trxframe&       currentFrame,
+                                         int                     numFrames) :
+    impl_(new Impl(oenv, status, gpbc, currentFrame, numFrames))
+{
+}
+
+TrajectoryReadAhead::~TrajectoryReadAhead() = default;
+
+bool TrajectoryReadAhead::readNextFrame(t_trxframe* fr)
+{
+    return impl_->readNextFrame(fr);
+}
+
+} // namespace gmx
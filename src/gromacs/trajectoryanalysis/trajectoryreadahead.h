@@ -0,0 +1,117 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Declares gmx::TrajectoryReadAhead.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+#ifndef GMX_TRAJECTORYANALYSIS_TRAJECTORYREADAHEAD_H
+#define GMX_TRAJECTORYANALYSIS_TRAJECTORYREADAHEAD_H
+
+#include "gromacs/utility/classhelpers.h"
+
+struct gmx_output_env_t;
+typedef struct gmx_rmpbc* gmx_rmpbc_t;
+struct t_trxframe;
+struct t_trxstatus;
+
+namespace gmx
+{
+
+/*! \internal
+ * \brief
+ * Reads trajectory frames ahead of their analysis on a background thread.
+ *
+ * The reader thread decodes the frames following the current one with
+ * read_next_frame() into a ring of frame buffers, and makes molecules
+ * whole with gmx_rmpbc_trxfr() when a PBC removal object is given.
+ * readNextFrame() hands out the frames in order, so reading and
+ * decompressing a frame overlaps with the analysis of the previous ones.
+ *
+ * While an object exists, the trajectory status and the PBC removal
+ * object are only accessed by the reader thread. The reader thread is
+ * stopped by the destructor, after which the caller can close the
+ * trajectory.
+ *
+ * Exceptions thrown while reading are rethrown by readNextFrame() after
+ * all frames read before the error have been returned.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+class TrajectoryReadAhead
+{
+public:
+    /*! \brief
+     * Starts reading frames following \p currentFrame on a background thread.
+     *
+     * \param[in] oenv          Output environment for read_next_frame().
+     * \param[in] status        Trajectory opened with read_first_frame().
+     * \param[in] gpbc          PBC removal object, or nullptr if molecules
+     *     should not be made whole.
+     * \param[in] currentFrame  The last frame read from \p status, used to
+     *     set up the frame buffers.
+     * \param[in] numFrames     Number of frames that can be read ahead.
+     */
+    TrajectoryReadAhead(const gmx_output_env_t* oenv,
+                        t_trxstatus*            status,
+                        gmx_rmpbc_t             gpbc,
+                        const t_trxframe&       currentFrame,
+                        int                     numFrames);
+    //! Stops the reader thread and frees the frame buffers.
+    ~TrajectoryReadAhead();
+
+    /*! \brief
+     * Copies the next frame into \p fr, waiting for it if necessary.
+     *
+     * The coordinate, velocity and force arrays of \p fr are reused and
+     * its index group is kept, so pointers into \p fr stay valid as with
+     * read_next_frame().
+     *
+     * \returns false when there are no more frames, in which case \p fr
+     *     is not changed.
+     * \throws  any exception thrown while reading the frame.
+     */
+    bool readNextFrame(t_trxframe* fr);
+
+private:
+    class Impl;
+
+    PrivateImplPointer<Impl> impl_;
+};
+
+} // namespace gmx
+
+#endif
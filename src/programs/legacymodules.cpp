@@ -61,6 +61,7 @@
 #include "gromacs/tools/convert_tpr.h"
 #include "gromacs/tools/dump.h"
 #include "gromacs/tools/eneconv.h"
+#include "gromacs/tools/estimate_dd.h"
 #include "gromacs/tools/make_ndx.h"
 #include "gromacs/tools/mk_angndx.h"
 #include "gromacs/tools/pme_error.h"
@@ -68,6 +69,8 @@
 #include "gromacs/tools/trjcat.h"
 #include "gromacs/tools/trjconv.h"
 #include "gromacs/tools/tune_pme.h"
+#include "gromacs/tools/xdr_benchmark.h"
+#include "gromacs/tools/xtc_benchmark.h"
 
 #include "mdrun/mdrun_main.h"
 #include "mdrun/nonbonded_bench.h"
@@ -198,6 +201,18 @@ void registerLegacyModules(gmx::CommandLineModuleManager* manager)
                                                           gmx::ReportMethodsInfo::shortDescription,
                                                           &gmx::ReportMethodsInfo::create);
 
+    gmx::ICommandLineOptionsModule::registerModuleFactory(manager, gmx::EstimateDDInfo::name,
+                                                          gmx::EstimateDDInfo::shortDescription,
+                                                          &gmx::EstimateDDInfo::create);
+
+    gmx::ICommandLineOptionsModule::registerModuleFactory(manager, gmx::XdrBenchmarkInfo::name,
+                                                          gmx::XdrBenchmarkInfo::shortDescription,
+                                                          &gmx::XdrBenchmarkInfo::create);
+
+    gmx::ICommandLineOptionsModule::registerModuleFactory(manager, gmx::XtcBenchmarkInfo::name,
+                                                          gmx::XtcBenchmarkInfo::shortDescription,
+                                                          &gmx::XtcBenchmarkInfo::create);
+
     gmx::ICommandLineOptionsModule::registerModuleFactory(manager, gmx::pdb2gmxInfo::name,
                                                           gmx::pdb2gmxInfo::shortDescription,
                                                           &gmx::pdb2gmxInfo::create);
@@ -378,6 +393,9 @@ void registerLegacyModules(gmx::CommandLineModuleManager* manager)
         group.addModule("spatial");
         group.addModule("traj");
         group.addModule("tune_pme");
+        group.addModule("estimate-dd");
+        group.addModule("xdr-benchmark");
+        group.addModule("xtc-benchmark");
         group.addModule("wham");
         group.addModule("check");
         group.addModule("dump");
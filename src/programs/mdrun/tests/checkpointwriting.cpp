@@ -0,0 +1,219 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2016,2017,2018,2019,2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ * \brief
+ * Tests that checkpoints finished in the background match those
+ * written synchronously.
+ *
+ * \ingroup module_mdrun_integration_tests
+ */
+#include "gmxpre.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/checkpoint.h"
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+#include "gromacs/utility/path.h"
+#include "gromacs/utility/stringutil.h"
+#include "gromacs/utility/textreader.h"
+
+#include "testutils/setenv.h"
+#include "testutils/testasserts.h"
+#include "testutils/testfilemanager.h"
+
+#include "moduletest.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Returns the contents of checkpoint \p fileName as a trajectory frame
+t_trxframe readCheckpointFrame(const std::string& fileName)
+{
+    t_trxframe frame;
+    clear_trxframe(&frame, TRUE);
+    t_fileio* fio = gmx_fio_open(fileName.c_str(), "r");
+    read_checkpoint_trxframe(fio, &frame);
+    gmx_fio_close(fio);
+
+    return frame;
+}
+
+//! Checks that checkpoints \p reference and \p test have the same step, time and state
+void compareCheckpoints(const std::string& reference, const std::string& test)
+{
+    SCOPED_TRACE("Comparing checkpoint " + test + " with " + reference);
+    ASSERT_TRUE(File::exists(reference, File::returnFalseOnError)) << reference << " was not found";
+    ASSERT_TRUE(File::exists(test, File::returnFalseOnError)) << test << " was not found";
+
+    t_trxframe referenceFrame = readCheckpointFrame(reference);
+    t_trxframe testFrame      = readCheckpointFrame(test);
+    EXPECT_EQ(referenceFrame.step, testFrame.step);
+    EXPECT_EQ(referenceFrame.time, testFrame.time);
+    ASSERT_EQ(referenceFrame.natoms, testFrame.natoms);
+    ASSERT_TRUE(referenceFrame.bX && testFrame.bX);
+    ASSERT_TRUE(referenceFrame.bV && testFrame.bV);
+    for (int i = 0; i < referenceFrame.natoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_EQ(referenceFrame.x[i][d], testFrame.x[i][d]);
+            EXPECT_EQ(referenceFrame.v[i][d], testFrame.v[i][d]);
+        }
+    }
+    done_frame(&referenceFrame);
+    done_frame(&testFrame);
+}
+
+//! Test fixture for comparing asynchronous with synchronous checkpointing
+class AsyncCheckpointTest : public MdrunTestFixture
+{
+public:
+    /*! \brief Prepares spc2 with trajectory output every \p nstxout steps
+     *
+     * With -cpt 0 and a fixed nstlist, checkpoints are written back to
+     * back at steps 10 and 20, so the first is rotated to _prev.cpt.
+     */
+    void prepare(int nstxout)
+    {
+        runner_.useTopGroAndNdxFromDatabase("spc2");
+        runner_.useStringAsMdpFile(formatString(
+                "nsteps = 20\n"
+                "tcoupl = v-rescale\n"
+                "tc-grps = System\n"
+                "tau-t = 1\n"
+                "ref-t = 298\n"
+                "nstxout = %d\n"
+                "nstxout-compressed = %d\n",
+                nstxout,
+                nstxout));
+        EXPECT_EQ(0, runner_.callGrompp());
+    }
+
+    //! Runs mdrun writing checkpoints to \p checkpoint with the environment \p variables set
+    void runMdrun(const std::string& checkpoint, const std::vector<const char*>& variables)
+    {
+        for (const char* variable : variables)
+        {
+            gmxSetenv(variable, "1", 1);
+        }
+        CommandLine caller;
+        caller.append("mdrun");
+        caller.addOption("-cpo", checkpoint);
+        caller.addOption("-cpt", 0);
+        caller.addOption("-nstlist", 10);
+        caller.append("-reprod");
+        const int result = runner_.callMdrun(caller);
+        for (const char* variable : variables)
+        {
+            gmxUnsetenv(variable);
+        }
+        ASSERT_EQ(0, result);
+    }
+
+    //! Checks that the log of the last run reports asynchronous checkpointing
+    void checkLogReportsAsyncCheckpointing()
+    {
+        EXPECT_NE(std::string::npos,
+                  TextReader::readFileToString(runner_.logFileName_)
+                          .find("Syncing and renaming checkpoint files on a separate thread"))
+                << "asynchronous checkpointing was not used";
+    }
+
+    //! Compares the final and previous checkpoints of \p name with those of the synchronous run
+    void checkAgainstSynchronousCheckpoints(const std::string& name)
+    {
+        const std::string syncCheckpoint = fileManager_.getTemporaryFilePath("sync.cpt");
+        const std::string checkpoint     = fileManager_.getTemporaryFilePath(name + ".cpt");
+        const std::string previousCheckpoint =
+                fileManager_.getTemporaryFilePath(name + "_prev.cpt");
+        compareCheckpoints(syncCheckpoint, checkpoint);
+        compareCheckpoints(fileManager_.getTemporaryFilePath("sync_prev.cpt"), previousCheckpoint);
+
+        // The final checkpoint is the last step and the previous one an earlier step
+        t_trxframe finalFrame    = readCheckpointFrame(checkpoint);
+        t_trxframe previousFrame = readCheckpointFrame(previousCheckpoint);
+        EXPECT_EQ(20, finalFrame.step);
+        EXPECT_LT(previousFrame.step, finalFrame.step);
+        // All temporary checkpoint files have been renamed
+        for (const int64_t step : { previousFrame.step, finalFrame.step })
+        {
+            const std::string temporaryName =
+                    formatString("%s_step%d.cpt", Path::stripExtension(checkpoint).c_str(),
+                                 static_cast<int>(step));
+            EXPECT_FALSE(File::exists(temporaryName, File::returnFalseOnError))
+                    << temporaryName << " should have been renamed";
+        }
+        done_frame(&finalFrame);
+        done_frame(&previousFrame);
+    }
+};
+
+TEST_F(AsyncCheckpointTest, MatchesSynchronousCheckpointing)
+{
+    prepare(0);
+    runMdrun(fileManager_.getTemporaryFilePath("sync.cpt"), {});
+    runMdrun(fileManager_.getTemporaryFilePath("async.cpt"), { "GMX_ASYNC_CHECKPOINT" });
+    checkLogReportsAsyncCheckpointing();
+    checkAgainstSynchronousCheckpoints("async");
+}
+
+TEST_F(AsyncCheckpointTest, MatchesSynchronousCheckpointingWithAsyncTrajectoryOutput)
+{
+    // The checkpoints are finished on the thread that writes the trajectory frames
+    prepare(5);
+    runMdrun(fileManager_.getTemporaryFilePath("sync.cpt"), {});
+    runMdrun(fileManager_.getTemporaryFilePath("async.cpt"),
+             { "GMX_ASYNC_CHECKPOINT", "GMX_ASYNC_TRAJECTORY_OUTPUT" });
+    checkLogReportsAsyncCheckpointing();
+    EXPECT_NE(std::string::npos,
+              TextReader::readFileToString(runner_.logFileName_)
+                      .find("Writing XTC and TRR frames on a separate thread"))
+            << "asynchronous trajectory output was not used";
+    checkAgainstSynchronousCheckpoints("async");
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -42,19 +42,33 @@
  */
 #include "gmxpre.h"
 
+#include <cstdio>
+
+#include <initializer_list>
 #include <string>
 
 #include <gtest/gtest.h>
 
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/utility/stringutil.h"
+#include "gromacs/utility/textreader.h"
+
 #include "testutils/cmdlinetest.h"
+#include "testutils/mpitest.h"
+#include "testutils/setenv.h"
 
 #include "moduletest.h"
+#include "simulatorcomparison.h"
 
+namespace gmx
+{
+namespace test
+{
 namespace
 {
 
 //! Test fixture for domain decomposition special cases
-class DomainDecompositionSpecialCasesTest : public gmx::test::MdrunTestFixture
+class DomainDecompositionSpecialCasesTest : public MdrunTestFixture
 {
 };
 
@@ -74,4 +88,199 @@ TEST_F(DomainDecompositionSpecialCasesTest, AnEmptyDomainWorks)
     ASSERT_EQ(0, runner_.callMdrun());
 }
 
+/*! \brief Test fixture for domain decomposition modes enabled by environment variables
+ *
+ * Runs a simulation of a protein in vacuum, which makes for an
+ * inhomogeneous system with constraints and bondeds that cross the
+ * domain boundary, with and without the mode enabled and compares
+ * the results.
+ */
+class DomainDecompositionModeTest : public MdrunTestFixture
+{
+public:
+    DomainDecompositionModeTest() { runner_.useTopG96AndNdxFromDatabase("villin"); }
+
+    /*! \brief Runs with the mode set by \p environmentVariable off and on and compares
+     *
+     * The forces at step 0 and the energies in \p energyTermsToCompare
+     * at all energy steps should match within rounding.
+     *
+     * \param[in] environmentVariable   The variable that enables the mode
+     * \param[in] constraints           The constraints mdp option
+     * \param[in] energyTermsToCompare  The energy terms to compare
+     */
+    void runWithAndWithoutMode(const char*                 environmentVariable,
+                               const char*                 constraints,
+                               const EnergyTermsToCompare& energyTermsToCompare)
+    {
+        const int numSteps = 20;
+        runner_.useStringAsMdpFile(formatString(
+                "integrator    = md\n"
+                "dt            = 0.002\n"
+                "nsteps        = %d\n"
+                "cutoff-scheme = Verlet\n"
+                "coulombtype   = reaction-field\n"
+                "rcoulomb      = 0.9\n"
+                "rvdw          = 0.9\n"
+                "constraints   = %s\n"
+                "lincs-iter    = 2\n"
+                "gen-vel       = yes\n"
+                "gen-temp      = 300\n"
+                "gen-seed      = 1993\n"
+                "nstcalcenergy = 10\n"
+                "nstenergy     = 10\n"
+                "nstxout       = 0\n"
+                "nstvout       = 0\n"
+                "nstfout       = %d\n",
+                numSteps, constraints, numSteps));
+        runGrompp(&runner_);
+
+        const std::string defaultTrrFileName = fileManager_.getTemporaryFilePath("default.trr");
+        const std::string defaultEdrFileName = fileManager_.getTemporaryFilePath("default.edr");
+        const std::string modeTrrFileName    = fileManager_.getTemporaryFilePath("mode.trr");
+        const std::string modeEdrFileName    = fileManager_.getTemporaryFilePath("mode.edr");
+        defaultLogFileName_ = fileManager_.getTemporaryFilePath("default.log");
+        modeLogFileName_    = fileManager_.getTemporaryFilePath("mode.log");
+
+        runner_.fullPrecisionTrajectoryFileName_ = defaultTrrFileName;
+        runner_.edrFileName_                     = defaultEdrFileName;
+        runner_.logFileName_                     = defaultLogFileName_;
+        runMdrun(&runner_);
+
+        runner_.fullPrecisionTrajectoryFileName_ = modeTrrFileName;
+        runner_.edrFileName_                     = modeEdrFileName;
+        runner_.logFileName_                     = modeLogFileName_;
+        gmxSetenv(environmentVariable, "1", 1);
+        runMdrun(&runner_);
+        gmxUnsetenv(environmentVariable);
+
+        TrajectoryFrameMatchSettings matchSettings{ true,
+                                                    true,
+                                                    true,
+                                                    ComparisonConditions::NoComparison,
+                                                    ComparisonConditions::NoComparison,
+                                                    ComparisonConditions::MustCompare,
+                                                    MaxNumFrames(1) };
+        const TrajectoryTolerances tolerances = TrajectoryComparison::s_defaultTrajectoryTolerances;
+        TrajectoryComparison       trajectoryComparison{ matchSettings, tolerances };
+        compareTrajectories(defaultTrrFileName, modeTrrFileName, trajectoryComparison);
+        compareEnergies(defaultEdrFileName, modeEdrFileName, energyTermsToCompare);
+    }
+
+    //! The log file of the run with the default settings
+    std::string defaultLogFileName_;
+    //! The log file of the run with the mode enabled
+    std::string modeLogFileName_;
+};
+
+/*! \brief Returns the average number of atoms communicated per step for \p purpose
+ *
+ * Reads the domain decomposition statistics from the log file \p logFileName,
+ * returns -1 when these are not present.
+ */
+double averageNumAtomsCommunicated(const std::string& logFileName, const std::string& purpose)
+{
+    const std::string log = TextReader::readFileToString(logFileName);
+    const std::string key = "av. #atoms communicated per step for " + purpose + ":";
+    const size_t      pos = log.find(key);
+    if (pos == std::string::npos)
+    {
+        return -1;
+    }
+    int    numCommunications = 0;
+    double average           = 0;
+    if (sscanf(log.c_str() + pos + key.size(), " %d x %lf", &numCommunications, &average) != 2)
+    {
+        return -1;
+    }
+    return average;
+}
+
+//! Returns the energy terms to compare with the default relative tolerance
+EnergyTermsToCompare energyTermsToCompare(std::initializer_list<const char*> names)
+{
+    EnergyTermsToCompare terms;
+    for (const char* name : names)
+    {
+        terms.emplace(name, relativeToleranceAsPrecisionDependentFloatingPoint(10.0, 1e-4, 1e-9));
+    }
+    return terms;
+}
+
+TEST_F(DomainDecompositionModeTest, HaloPruningMatchesDefault)
+{
+    /* Use a protein that is cut by the domain boundary close to its edge,
+     * so the receiving domain has atoms close to part of the boundary only.
+     */
+    runner_.useGroFromDatabase("villin_shifted");
+    runWithAndWithoutMode("GMX_DD_PRUNE_HALO", "h-bonds",
+                          energyTermsToCompare({ interaction_function[F_EPOT].longname,
+                                                 interaction_function[F_EKIN].longname }));
+
+    // Pruning should remove a significant part of the halo
+    const double defaultNumAtoms = averageNumAtomsCommunicated(defaultLogFileName_, "force");
+    if (defaultNumAtoms > 0)
+    {
+        EXPECT_LT(averageNumAtomsCommunicated(modeLogFileName_, "force"), defaultNumAtoms);
+    }
+}
+
+TEST_F(DomainDecompositionModeTest, BondedSpatialDivisionMatchesDefault)
+{
+    // The division only changes with more than one OpenMP thread per rank
+    runWithAndWithoutMode("GMX_BONDED_SPATIAL_DIVISION", "h-bonds",
+                          energyTermsToCompare({ interaction_function[F_EPOT].longname,
+                                                 interaction_function[F_BONDS].longname,
+                                                 interaction_function[F_UREY_BRADLEY].longname,
+                                                 interaction_function[F_PDIHS].longname,
+                                                 interaction_function[F_IDIHS].longname,
+                                                 interaction_function[F_CMAP].longname,
+                                                 interaction_function[F_LJ14].longname,
+                                                 interaction_function[F_COUL14].longname }));
+}
+
+TEST_F(DomainDecompositionModeTest, LincsExpandedHaloMatchesDefault)
+{
+    runWithAndWithoutMode("GMX_LINCS_EXPANDED_HALO", "all-bonds",
+                          energyTermsToCompare({ interaction_function[F_EPOT].longname,
+                                                 interaction_function[F_EKIN].longname,
+                                                 "Constr. rmsd" }));
+
+    // The expanded halo should contain at least the atoms of the default constraint halo
+    const double defaultNumAtoms = averageNumAtomsCommunicated(defaultLogFileName_, "LINCS");
+    EXPECT_GE(averageNumAtomsCommunicated(modeLogFileName_, "LINCS"), defaultNumAtoms);
+}
+
+TEST_F(DomainDecompositionModeTest, UpdateGroupsMatchAtomDecomposition)
+{
+    /* Use water and a flexible molecule, so the update-group fast path
+     * in the local topology assignment covers bondeds, constraints and
+     * SETTLE. With update groups, mdrun checks at every partitioning that
+     * the bonded, constraint and SETTLE counts summed over the domains
+     * match the global counts. Here the energy terms and forces of those
+     * interactions are compared with a run without update groups.
+     */
+    runner_.useTopGroAndNdxFromDatabase("nonanol_vacuo");
+    runWithAndWithoutMode("GMX_NO_UPDATEGROUPS", "h-bonds",
+                          energyTermsToCompare({ interaction_function[F_EPOT].longname,
+                                                 interaction_function[F_BONDS].longname,
+                                                 interaction_function[F_ANGLES].longname,
+                                                 interaction_function[F_RBDIHS].longname,
+                                                 interaction_function[F_LJ14].longname,
+                                                 interaction_function[F_COUL14].longname,
+                                                 "Constr. rmsd" }));
+
+    // Update groups are only used with domain decomposition
+    if (getNumberOfTestMpiRanks() > 1)
+    {
+        const std::string usingUpdateGroups = "Using update groups";
+        EXPECT_NE(TextReader::readFileToString(defaultLogFileName_).find(usingUpdateGroups),
+                  std::string::npos);
+        EXPECT_EQ(TextReader::readFileToString(modeLogFileName_).find(usingUpdateGroups),
+                  std::string::npos);
+    }
+}
+
 } // namespace
+} // namespace test
+} // namespace gmx
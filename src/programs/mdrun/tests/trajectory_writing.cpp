@@ -45,12 +45,21 @@
 
 #include "config.h"
 
+#include <string>
+
 #include <gtest/gtest.h>
 
 #include "gromacs/options/filenameoption.h"
 #include "gromacs/utility/stringutil.h"
+#include "gromacs/utility/textreader.h"
+
+#include "testutils/cmdlinetest.h"
+#include "testutils/setenv.h"
+#include "testutils/testasserts.h"
 
 #include "moduletest.h"
+#include "simulatorcomparison.h"
+#include "trajectorycomparison.h"
 
 namespace
 {
@@ -142,6 +151,81 @@ INSTANTIATE_TEST_CASE_P(MdrunCanWrite,
                         NptTrajectories,
                         ::testing::Values("no", "Berendsen", "Parrinello-Rahman"));
 
+//! Test fixture for comparing TNG output written in the background with synchronous output
+typedef gmx::test::MdrunTestFixture AsyncTngTrajectories;
+
+/* This test ensures that TNG files written by the background writer
+   threads contain the same frames as those written synchronously. */
+TEST_F(AsyncTngTrajectories, MatchSynchronouslyWrittenTrajectories)
+{
+    // The TNG reader only reports times of frames after time zero
+    runner_.useStringAsMdpFile(
+            "integrator = md\n"
+            "tinit = 1\n"
+            "nsteps = 20\n"
+            "nstxout = 2\n"
+            "nstvout = 4\n"
+            "nstfout = 4\n"
+            "nstxout-compressed = 2\n"
+            "compressed-x-grps = Sol\n"
+            "tcoupl = v-rescale\n"
+            "tc-grps = System\n"
+            "tau-t = 1\n"
+            "ref-t = 298\n");
+    runner_.useTopGroAndNdxFromDatabase("spc-and-methanol");
+    EXPECT_EQ(0, runner_.callGrompp());
+
+    // Use small frame sets, so several full sets and a partial last set are written
+    gmx::test::gmxSetenv("GMX_TNG_FRAMES_PER_FRAME_SET", "3", 1);
+    for (const std::string name : { "sync", "async" })
+    {
+        const bool writeAsynchronously = (name == "async");
+        SCOPED_TRACE(writeAsynchronously ? "Writing asynchronously" : "Writing synchronously");
+        if (writeAsynchronously)
+        {
+            gmx::test::gmxSetenv("GMX_ASYNC_TRAJECTORY_OUTPUT", "4", 1);
+        }
+        runner_.fullPrecisionTrajectoryFileName_ = fileManager_.getTemporaryFilePath(name + ".tng");
+        runner_.reducedPrecisionTrajectoryFileName_ =
+                fileManager_.getTemporaryFilePath(name + "-reduced.tng");
+        gmx::test::CommandLine caller;
+        caller.append("mdrun");
+        caller.append("-reprod");
+        const int result = runner_.callMdrun(caller);
+        if (writeAsynchronously)
+        {
+            gmx::test::gmxUnsetenv("GMX_ASYNC_TRAJECTORY_OUTPUT");
+            EXPECT_NE(std::string::npos,
+                      gmx::TextReader::readFileToString(runner_.logFileName_)
+                              .find("Compressing and writing TNG frames on a separate thread"))
+                    << "asynchronous TNG output was not used";
+        }
+        ASSERT_EQ(0, result);
+    }
+    gmx::test::gmxUnsetenv("GMX_TNG_FRAMES_PER_FRAME_SET");
+
+    gmx::test::TrajectoryFrameMatchSettings matchSettings;
+    matchSettings.mustCompareBox        = true;
+    matchSettings.coordinatesComparison = gmx::test::ComparisonConditions::MustCompare;
+    // Velocities and forces are written less often than coordinates
+    matchSettings.velocitiesComparison = gmx::test::ComparisonConditions::CompareIfReferenceFound;
+    matchSettings.forcesComparison     = gmx::test::ComparisonConditions::CompareIfReferenceFound;
+    gmx::test::TrajectoryTolerances tolerances =
+            gmx::test::TrajectoryComparison::s_defaultTrajectoryTolerances;
+    tolerances.box         = gmx::test::absoluteTolerance(0);
+    tolerances.coordinates = gmx::test::absoluteTolerance(0);
+    tolerances.velocities  = gmx::test::absoluteTolerance(0);
+    tolerances.forces      = gmx::test::absoluteTolerance(0);
+    const gmx::test::TrajectoryComparison comparison(matchSettings, tolerances);
+    for (const char* suffix : { ".tng", "-reduced.tng" })
+    {
+        SCOPED_TRACE(std::string("Comparing the *") + suffix + " files");
+        gmx::test::compareTrajectories(
+                fileManager_.getTemporaryFilePath(std::string("sync") + suffix),
+                fileManager_.getTemporaryFilePath(std::string("async") + suffix), comparison);
+    }
+}
+
 #endif
 
 } // namespace
@@ -46,6 +46,8 @@
 
 #include <string>
 
+#include <gtest/gtest.h>
+
 #include "gromacs/utility/classhelpers.h"
 
 namespace gmx
@@ -238,6 +240,36 @@ private:
     PrivateImplPointer<Impl> impl_;
 };
 
+/*! \libinternal \brief
+ * Test fixture for tests that write and read back a temporary file.
+ *
+ * \tparam TestBase  Google Test base class of the fixture, e.g.
+ *      ::testing::TestWithParam for parametrized tests.
+ *
+ * Parametrized fixtures that need the parameter for the file name
+ * should use the default constructor and set \p filename_ in their
+ * constructor body.
+ *
+ * \inlibraryapi
+ * \ingroup module_testutils
+ */
+template<class TestBase = ::testing::Test>
+class TemporaryFileTest : public TestBase
+{
+public:
+    TemporaryFileTest() = default;
+    //! Names the temporary file with \p suffix, see TestFileManager::getTemporaryFilePath()
+    explicit TemporaryFileTest(const std::string& suffix) :
+        filename_(fileManager_.getTemporaryFilePath(suffix))
+    {
+    }
+
+    //! Manages the temporary files
+    TestFileManager fileManager_;
+    //! The temporary file
+    std::string filename_;
+};
+
 } // namespace test
 } // namespace gmx
 
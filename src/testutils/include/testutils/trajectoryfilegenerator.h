@@ -0,0 +1,96 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Helpers for writing small test trajectories with known contents.
+ *
+ * \inlibraryapi
+ * \ingroup module_testutils
+ */
+#ifndef GMX_TESTUTILS_TRAJECTORYFILEGENERATOR_H
+#define GMX_TESTUTILS_TRAJECTORYFILEGENERATOR_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "gromacs/math/vectypes.h"
+
+struct t_trxframe;
+struct t_trxstatus;
+
+namespace gmx
+{
+namespace test
+{
+
+//! The number of atoms in test trajectories
+const int c_numTestTrajectoryAtoms = 5;
+
+/*! \brief
+ * Returns the vectors of kind \p kind in frame \p frame of test trajectories
+ *
+ * Kind 0 are the coordinates, 1 the velocities and 2 the forces.
+ * The vectors differ per frame, atom and kind and can be stored
+ * exactly enough in XTC files to compare them as floats.
+ */
+std::vector<RVec> testTrajectoryVectors(int frame, int kind);
+
+/*! \brief
+ * Writes \p numFrames frames of a test trajectory to \p filename, starting at frame \p firstFrame
+ *
+ * Frame i has step 10*i, time 0.5*i, lambda 0.1*i, a triclinic box
+ * and the coordinates from testTrajectoryVectors(). Frames in TRR files
+ * also have velocities and forces.
+ *
+ * \param[in] filename     The trajectory file, the type is taken from the extension.
+ * \param[in] mode         Mode for open_trx(), "w" or "a".
+ * \param[in] firstFrame   The index of the first frame to write.
+ * \param[in] numFrames    The number of frames to write.
+ * \param[in] prepareFile  If set, called with the opened trajectory before writing.
+ * \param[in] prepareFrame If set, called with the index and the frame before writing
+ *                         each frame, e.g. to leave out some of the vectors.
+ */
+void writeTestTrajectoryFrames(const std::string&                           filename,
+                               const char*                                  mode,
+                               int                                          firstFrame,
+                               int                                          numFrames,
+                               const std::function<void(t_trxstatus*)>&     prepareFile  = {},
+                               const std::function<void(int, t_trxframe*)>& prepareFrame = {});
+
+} // namespace test
+} // namespace gmx
+
+#endif
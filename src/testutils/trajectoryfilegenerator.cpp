@@ -0,0 +1,116 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements helpers for writing small test trajectories.
+ *
+ * \ingroup module_testutils
+ */
+
+#include "gmxpre.h"
+
+#include "testutils/trajectoryfilegenerator.h"
+
+#include "gromacs/fileio/filetypes.h"
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+
+namespace gmx
+{
+namespace test
+{
+
+std::vector<RVec> testTrajectoryVectors(int frame, int kind)
+{
+    std::vector<RVec> v(c_numTestTrajectoryAtoms);
+    for (int i = 0; i < c_numTestTrajectoryAtoms; i++)
+    {
+        v[i] = { 0.1F * frame + i, 0.2F * i - 0.5F * kind, 1 + 0.25F * kind };
+    }
+    return v;
+}
+
+void writeTestTrajectoryFrames(const std::string&                           filename,
+                               const char*                                  mode,
+                               int                                          firstFrame,
+                               int                                          numFrames,
+                               const std::function<void(t_trxstatus*)>&     prepareFile,
+                               const std::function<void(int, t_trxframe*)>& prepareFrame)
+{
+    t_trxstatus* status = open_trx(filename.c_str(), mode);
+    if (prepareFile)
+    {
+        prepareFile(status);
+    }
+    const bool isTrr = (fn2ftp(filename.c_str()) == efTRR);
+    for (int frame = firstFrame; frame < firstFrame + numFrames; frame++)
+    {
+        std::vector<RVec> x = testTrajectoryVectors(frame, 0);
+        std::vector<RVec> v = testTrajectoryVectors(frame, 1);
+        std::vector<RVec> f = testTrajectoryVectors(frame, 2);
+        t_trxframe        fr;
+        clear_trxframe(&fr, TRUE);
+        fr.natoms      = c_numTestTrajectoryAtoms;
+        fr.bStep       = TRUE;
+        fr.step        = 10 * frame;
+        fr.bTime       = TRUE;
+        fr.time        = 0.5 * frame;
+        fr.bLambda     = TRUE;
+        fr.lambda      = 0.1 * frame;
+        fr.bBox        = TRUE;
+        fr.box[XX][XX] = 3;
+        fr.box[YY][XX] = 0.5;
+        fr.box[YY][YY] = 4;
+        fr.box[ZZ][XX] = 0.25;
+        fr.box[ZZ][YY] = 0.75;
+        fr.box[ZZ][ZZ] = 5;
+        fr.bX          = TRUE;
+        fr.x           = as_rvec_array(x.data());
+        fr.bV          = isTrr;
+        fr.v           = as_rvec_array(v.data());
+        fr.bF          = isTrr;
+        fr.f           = as_rvec_array(f.data());
+        if (prepareFrame)
+        {
+            prepareFrame(frame, &fr);
+        }
+        write_trxframe(status, &fr, nullptr);
+    }
+    close_trx(status);
+}
+
+} // namespace test
+} // namespace gmx